@@ -71,12 +71,55 @@ LIBS="-L${BUILD_DIR}/hurdygurdy/lib -lhurdygurdy"
 
 SHADERS=(
     ${SRC_DIR}/src/model.vert
-    ${SRC_DIR}/src/model.frag
+    ${SRC_DIR}/src/model_packed.vert
+    ${SRC_DIR}/src/model_pooled.vert
+    ${SRC_DIR}/src/depth.vert
+    ${SRC_DIR}/src/depth_packed.vert
+    ${SRC_DIR}/src/depth_pooled.vert
+    ${SRC_DIR}/src/depth.frag
+    ${SRC_DIR}/src/upscale.vert
+    ${SRC_DIR}/src/upscale.frag
 )
 
+# model.frag is compiled once per HgShaderFeature combination, as
+# model_<features>.frag. 8 is unlit, which ignores the other bits
+MODEL_FRAG_VARIANTS=(0 1 2 3 4 5 6 7 8)
+
 SRCS=(
-    ${SRC_DIR}/src/main.c
     ${SRC_DIR}/src/renderer_3d.c
+    ${SRC_DIR}/src/mesh_3d.c
+    ${SRC_DIR}/src/file_map_3d.c
+    ${SRC_DIR}/src/texture_3d.c
+    ${SRC_DIR}/src/suballocator_3d.c
+    ${SRC_DIR}/src/frame_arena_3d.c
+    ${SRC_DIR}/src/simd_kernels_3d.c
+    ${SRC_DIR}/src/profiler_3d.c
+    ${SRC_DIR}/src/dynamic_resolution_3d.c
+    ${SRC_DIR}/src/memory_tracker_3d.c
+    ${SRC_DIR}/src/upload_queue_3d.c
+    ${SRC_DIR}/src/cull_3d.c
+    ${SRC_DIR}/src/light_clusters_3d.c
+    ${SRC_DIR}/src/occlusion_3d.c
+)
+
+# On x86-64 simd_kernels_3d.c is compiled a second time with AVX2 and FMA,
+# and the renderer picks between the two at runtime
+SIMD_FLAGS=""
+case "$(uname -m)" in
+    "x86_64" | "amd64")
+        SIMD_FLAGS="-DHG_3D_AVX_KERNELS"
+        ;;
+esac
+
+# Programs linked against every object in SRCS, installed as pbr_<name>
+APPS=(
+    ${SRC_DIR}/src/main.c:renderer
+    ${SRC_DIR}/src/bench.c:bench
+    ${SRC_DIR}/src/context_stress.c:context_stress
+)
+
+TOOLS=(
+    ${SRC_DIR}/src/mesh_cooker.c
 )
 
 OBJS=""
@@ -111,13 +154,28 @@ for shader in "${SHADERS[@]}"; do
 
 done
 
+for features in "${MODEL_FRAG_VARIANTS[@]}"; do
+    name=model_${features}.frag
+    echo "${name}"
+
+    glslc -DFEATURES=${features} -o ${BUILD_DIR}/shaders/${name}.spv ${SRC_DIR}/src/model.frag
+    if [ $? -ne 0 ]; then EXIT_CODE=1; fi
+
+    ${BUILD_DIR}/hurdygurdy/bin/hg_embed_file \
+        ${BUILD_DIR}/shaders/${name}.spv \
+        ${name}.spv \
+        > ${BUILD_DIR}/shaders/${name}.spv.h
+    if [ $? -ne 0 ]; then EXIT_CODE=1; fi
+
+done
+
 mkdir -p ${BUILD_DIR}/obj
 
 for file in "${SRCS[@]}"; do
     name=$(basename ${file} .c)
     echo "${name}.c..."
 
-    cc ${CVERSION} ${CONFIG_FLAGS} ${WARNING_FLAGS} ${INCLUDES} \
+    cc ${CVERSION} ${CONFIG_FLAGS} ${WARNING_FLAGS} ${SIMD_FLAGS} ${INCLUDES} \
         -o "${BUILD_DIR}/obj/${name}.o" \
         -c ${file}
     if [ $? -ne 0 ]; then EXIT_CODE=1; fi
@@ -125,18 +183,65 @@ for file in "${SRCS[@]}"; do
 
 done
 
+if [ -n "${SIMD_FLAGS}" ]; then
+    echo "simd_kernels_3d.c (avx2)..."
+
+    cc ${CVERSION} ${CONFIG_FLAGS} ${WARNING_FLAGS} ${SIMD_FLAGS} -mavx2 -mfma -DHG_SIMD_VARIANT=avx ${INCLUDES} \
+        -o "${BUILD_DIR}/obj/simd_kernels_3d_avx.o" \
+        -c ${SRC_DIR}/src/simd_kernels_3d.c
+    if [ $? -ne 0 ]; then EXIT_CODE=1; fi
+    OBJS+=" ${BUILD_DIR}/obj/simd_kernels_3d_avx.o"
+fi
+
 echo "Linking..."
 
-c++ ${CVERSION} ${CXXVERSION} ${CONFIG_FLAGS} ${WARNING_FLAGS} \
-    -o ${BUILD_DIR}/out \
-    ${OBJS} ${LIBS}
-if [ $? -ne 0 ]; then EXIT_CODE=1; fi
+for app in "${APPS[@]}"; do
+    file=${app%%:*}
+    name=${app##*:}
+    echo "${name}"
+
+    cc ${CVERSION} ${CONFIG_FLAGS} ${WARNING_FLAGS} ${INCLUDES} \
+        -o "${BUILD_DIR}/obj/$(basename ${file} .c).o" \
+        -c ${file}
+    if [ $? -ne 0 ]; then EXIT_CODE=1; fi
+
+    c++ ${CVERSION} ${CXXVERSION} ${CONFIG_FLAGS} ${WARNING_FLAGS} \
+        -o ${BUILD_DIR}/${name} \
+        "${BUILD_DIR}/obj/$(basename ${file} .c).o" ${OBJS} ${LIBS}
+    if [ $? -ne 0 ]; then EXIT_CODE=1; fi
+
+done
+
+echo "Building tools..."
+
+mkdir -p ${BUILD_DIR}/tools
+
+for file in "${TOOLS[@]}"; do
+    name=$(basename ${file} .c)
+    echo "${name}"
+
+    cc ${CVERSION} ${CONFIG_FLAGS} ${WARNING_FLAGS} ${INCLUDES} \
+        -o "${BUILD_DIR}/obj/${name}.o" \
+        -c ${file}
+    if [ $? -ne 0 ]; then EXIT_CODE=1; fi
+
+    c++ ${CVERSION} ${CXXVERSION} ${CONFIG_FLAGS} ${WARNING_FLAGS} \
+        -o ${BUILD_DIR}/tools/${name} \
+        ${BUILD_DIR}/obj/${name}.o ${BUILD_DIR}/obj/mesh_3d.o ${LIBS}
+    if [ $? -ne 0 ]; then EXIT_CODE=1; fi
+
+done
 
 echo "Installing..."
 
 mkdir -p ${INSTALL_DIR}
 
-cp ${BUILD_DIR}/out ${INSTALL_DIR}/pbr_renderer
+for app in "${APPS[@]}"; do
+    cp ${BUILD_DIR}/${app##*:} ${INSTALL_DIR}/pbr_${app##*:}
+done
+for file in "${TOOLS[@]}"; do
+    cp ${BUILD_DIR}/tools/$(basename ${file} .c) ${INSTALL_DIR}/
+done
 
 END_TIME=$(date +%s.%N)
 printf "Build complete: %.6f seconds\n" "$(echo "$END_TIME - $START_TIME" | bc)"
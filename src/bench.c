@@ -0,0 +1,711 @@
+#include "hurdygurdy.h"
+
+#include "renderer_3d.h"
+#include "profiler_3d.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Renders a procedurally generated stress scene along a scripted camera path
+// with a fixed timestep, so runs with the same options do the same work, and
+// writes per frame timings. It opens a window at the requested size; on a
+// machine without a display or GPU, run under xvfb-run with VK_DRIVER_FILES
+// pointing at lavapipe's ICD. The output hashed for correctness is the last
+// frame's draw stream: every model drawn, in order, with its sort key and
+// transform. Two runs with the same options and the same hash drew the same
+// thing
+
+#define BENCH_TIMESTEP (1.0f / 60.0f)
+// Radians per second the camera orbits the scene
+#define BENCH_ORBIT_SPEED 0.25f
+
+typedef struct BenchOptions {
+    u32 models;
+    u32 meshes;
+    u32 textures;
+    u32 point_lights;
+    u32 directional_lights;
+    u32 frames;
+    u32 warmup;
+    u32 width;
+    u32 height;
+    u32 seed;
+    bool prepass;
+    bool dedicated_buffers;
+    bool retained;
+    bool prepare_shaders;
+    bool pipelined;
+    bool occlusion;
+    bool gpu_timing;
+    const char* csv_path;
+    const char* json_path;
+    const char* trace_path;
+} BenchOptions;
+
+typedef struct BenchFrame {
+    f64 frame_ms;
+    f64 draw_ms;
+    f64 present_ms;
+    f64 gpu_ms;
+    HgRenderer3DStats stats;
+} BenchFrame;
+
+// Time to the first frame, split by step. The first frame includes creating
+// the shaders it draws with, unless --prepare-shaders created them up front
+typedef struct BenchStartup {
+    f64 init_ms;
+    f64 renderer_init_ms;
+    f64 window_ms;
+    f64 prepare_shaders_ms;
+    f64 first_frame_ms;
+    u32 first_frame_shaders;
+} BenchStartup;
+
+// xorshift32, so scenes are the same on every platform for a seed
+static u32 bench_random(u32* state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static f32 bench_random_range(u32* state, f32 min, f32 max) {
+    return min + (max - min) * (f32)(bench_random(state) >> 8) / (f32)(1u << 24);
+}
+
+static HgVec3 bench_rotate(HgQuat rotation, HgVec3 v) {
+    f32 q[4];
+    memcpy(q, &rotation, sizeof(q));
+
+    HgVec3 t = {
+        2.0f * (q[2] * v.z - q[3] * v.y),
+        2.0f * (q[3] * v.x - q[1] * v.z),
+        2.0f * (q[1] * v.y - q[2] * v.x),
+    };
+    return (HgVec3){
+        v.x + q[0] * t.x + (q[2] * t.z - q[3] * t.y),
+        v.y + q[0] * t.y + (q[3] * t.x - q[1] * t.z),
+        v.z + q[0] * t.z + (q[1] * t.y - q[2] * t.x),
+    };
+}
+
+// A UV sphere of radius 0.5; mesh i gets more segments than mesh i - 1, so
+// the meshes span a range of triangle counts
+// A cube inside every sphere mesh, even the coarsest, as their occluder
+static const HgVec3 bench_cube_positions[8] = {
+    {-0.24f, -0.24f, -0.24f}, {0.24f, -0.24f, -0.24f}, {0.24f, 0.24f, -0.24f}, {-0.24f, 0.24f, -0.24f},
+    {-0.24f, -0.24f, 0.24f}, {0.24f, -0.24f, 0.24f}, {0.24f, 0.24f, 0.24f}, {-0.24f, 0.24f, 0.24f},
+};
+static const u32 bench_cube_indices[36] = {
+    0, 1, 2, 0, 2, 3,
+    4, 6, 5, 4, 7, 6,
+    0, 4, 5, 0, 5, 1,
+    3, 2, 6, 3, 6, 7,
+    0, 3, 7, 0, 7, 4,
+    1, 5, 6, 1, 6, 2,
+};
+static void bench_sphere_create(
+    u32 segments, HgVertex3D** vertices, u32* vertex_count, u32** indices, u32* index_count
+) {
+    u32 rings = segments / 2;
+    *vertex_count = (segments + 1) * (rings + 1);
+    *index_count = segments * rings * 6;
+    *vertices = hg_heap_alloc(*vertex_count * sizeof(HgVertex3D));
+    *indices = hg_heap_alloc(*index_count * sizeof(u32));
+
+    u32 v = 0;
+    for (u32 ring = 0; ring <= rings; ++ring) {
+        f32 phi = (f32)HG_PI * (f32)ring / (f32)rings;
+        for (u32 segment = 0; segment <= segments; ++segment) {
+            f32 theta = (f32)HG_TAU * (f32)segment / (f32)segments;
+            HgVec3 normal = {sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta)};
+            (*vertices)[v++] = (HgVertex3D){
+                .position = {normal.x * 0.5f, normal.y * 0.5f, normal.z * 0.5f},
+                .normal = normal,
+                .tangent = {-sinf(theta), 0.0f, cosf(theta), 1.0f},
+                .uv = {(f32)segment / (f32)segments, (f32)ring / (f32)rings},
+            };
+        }
+    }
+
+    u32 i = 0;
+    for (u32 ring = 0; ring < rings; ++ring) {
+        for (u32 segment = 0; segment < segments; ++segment) {
+            u32 a = ring * (segments + 1) + segment;
+            u32 b = a + segments + 1;
+            (*indices)[i++] = a;
+            (*indices)[i++] = b;
+            (*indices)[i++] = a + 1;
+            (*indices)[i++] = a + 1;
+            (*indices)[i++] = b;
+            (*indices)[i++] = b + 1;
+        }
+    }
+}
+
+static bool bench_parse_u32(const char* arg, u32* value) {
+    char* end;
+    unsigned long parsed = strtoul(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || parsed > 0xffffffffu)
+        return false;
+    *value = (u32)parsed;
+    return true;
+}
+
+static void bench_usage(const char* name) {
+    printf("Usage: %s [Options]\n", name);
+    printf("Options:\n");
+    printf("  --models <n>              Models in the scene (default 10000)\n");
+    printf("  --meshes <n>              Distinct meshes (default 8)\n");
+    printf("  --textures <n>            Distinct color maps (default 16)\n");
+    printf("  --point-lights <n>        Point lights (default 256)\n");
+    printf("  --directional-lights <n>  Directional lights (default 1)\n");
+    printf("  --frames <n>              Frames measured (default 600)\n");
+    printf("  --warmup <n>              Frames rendered before measuring (default 60)\n");
+    printf("  --width <n>               Target width (default 1280)\n");
+    printf("  --height <n>              Target height (default 720)\n");
+    printf("  --seed <n>                Scene seed (default 1)\n");
+    printf("  --prepass                 Enable the depth pre-pass\n");
+    printf("  --dedicated-buffers       Give each mesh its own vertex buffer instead of the pool\n");
+    printf("  --retained                Create the models as retained objects instead of queueing them\n");
+    printf("  --prepare-shaders         Create every shader before the first frame instead of on first use\n");
+    printf("  --pipelined               Submit each frame on the render thread while the next is built.\n");
+    printf("                            draw_ms is then the whole frame call, and counters lag a frame\n");
+    printf("  --occlusion               Enable occlusion culling, with a cube inside each pooled sphere as occluder\n");
+    printf("  --gpu-timing              Wait for the GPU after each frame and record its time. Stalls the CPU\n");
+    printf("  --csv <path>              Write per frame timings and counters as CSV\n");
+    printf("  --json <path>             Write the options and a summary as JSON\n");
+    printf("  --trace <path>            Capture the measured frames as a Chrome trace\n");
+    printf("  --help                    Show this help message\n");
+}
+
+static bool bench_parse(int argc, char** argv, BenchOptions* options) {
+    *options = (BenchOptions){
+        .models = 10000,
+        .meshes = 8,
+        .textures = 16,
+        .point_lights = 256,
+        .directional_lights = 1,
+        .frames = 600,
+        .warmup = 60,
+        .width = 1280,
+        .height = 720,
+        .seed = 1,
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        u32* number = NULL;
+        const char** path = NULL;
+
+        if (strcmp(arg, "--models") == 0) number = &options->models;
+        else if (strcmp(arg, "--meshes") == 0) number = &options->meshes;
+        else if (strcmp(arg, "--textures") == 0) number = &options->textures;
+        else if (strcmp(arg, "--point-lights") == 0) number = &options->point_lights;
+        else if (strcmp(arg, "--directional-lights") == 0) number = &options->directional_lights;
+        else if (strcmp(arg, "--frames") == 0) number = &options->frames;
+        else if (strcmp(arg, "--warmup") == 0) number = &options->warmup;
+        else if (strcmp(arg, "--width") == 0) number = &options->width;
+        else if (strcmp(arg, "--height") == 0) number = &options->height;
+        else if (strcmp(arg, "--seed") == 0) number = &options->seed;
+        else if (strcmp(arg, "--csv") == 0) path = &options->csv_path;
+        else if (strcmp(arg, "--json") == 0) path = &options->json_path;
+        else if (strcmp(arg, "--trace") == 0) path = &options->trace_path;
+        else if (strcmp(arg, "--prepass") == 0) {
+            options->prepass = true;
+            continue;
+        } else if (strcmp(arg, "--dedicated-buffers") == 0) {
+            options->dedicated_buffers = true;
+            continue;
+        } else if (strcmp(arg, "--retained") == 0) {
+            options->retained = true;
+            continue;
+        } else if (strcmp(arg, "--prepare-shaders") == 0) {
+            options->prepare_shaders = true;
+            continue;
+        } else if (strcmp(arg, "--pipelined") == 0) {
+            options->pipelined = true;
+            continue;
+        } else if (strcmp(arg, "--occlusion") == 0) {
+            options->occlusion = true;
+            continue;
+        } else if (strcmp(arg, "--gpu-timing") == 0) {
+            options->gpu_timing = true;
+            continue;
+        } else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            bench_usage(argv[0]);
+            exit(0);
+        } else {
+            printf("Unknown option: %s\n", arg);
+            return false;
+        }
+
+        if (value == NULL) {
+            printf("Missing value for %s\n", arg);
+            return false;
+        }
+        if (number != NULL && !bench_parse_u32(value, number)) {
+            printf("Invalid value for %s: %s\n", arg, value);
+            return false;
+        }
+        if (path != NULL)
+            *path = value;
+        ++i;
+    }
+
+    if (options->models == 0 || options->meshes == 0 || options->textures == 0 || options->frames == 0
+     || options->width == 0 || options->height == 0) {
+        printf("--models, --meshes, --textures, --frames, --width and --height must be above 0\n");
+        return false;
+    }
+    if (options->seed == 0)
+        options->seed = 1;
+    return true;
+}
+
+static int bench_f64_compare(const void* lhs, const void* rhs) {
+    f64 a = *(const f64*)lhs;
+    f64 b = *(const f64*)rhs;
+    return a < b ? -1 : a > b;
+}
+
+// Average, p50 and p99 of one column of the measured frames
+static void bench_summarize(const BenchFrame* frames, u32 count, usize offset, f64 out[3]) {
+    f64* values = hg_heap_alloc(count * sizeof(f64));
+    f64 total = 0.0;
+    for (u32 i = 0; i < count; ++i) {
+        memcpy(&values[i], (const u8*)&frames[i] + offset, sizeof(f64));
+        total += values[i];
+    }
+    qsort(values, count, sizeof(f64), bench_f64_compare);
+    out[0] = total / (f64)count;
+    out[1] = values[(count - 1) / 2];
+    out[2] = values[(u32)((f64)(count - 1) * 0.99)];
+    hg_heap_free(values);
+}
+
+#define BENCH_FNV_OFFSET 0xcbf29ce484222325ull
+#define BENCH_FNV_PRIME 0x100000001b3ull
+
+static u64 bench_hash_bytes(u64 hash, const void* data, usize size) {
+    const u8* bytes = data;
+    for (usize i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * BENCH_FNV_PRIME;
+    }
+    return hash;
+}
+
+// FNV-1a over the last prepared frame's draw order, field by field so
+// padding never reaches the hash
+static u64 bench_draw_hash(u32 capacity, u32* draw_count) {
+    HgDrawRecord3D* records = hg_heap_alloc(capacity * sizeof(HgDrawRecord3D));
+    u32 count = hg_3d_renderer_get_draw_order(records, capacity);
+    if (count > capacity)
+        count = capacity;
+
+    u64 hash = BENCH_FNV_OFFSET;
+    for (u32 i = 0; i < count; ++i) {
+        hash = bench_hash_bytes(hash, &records[i].sort_key, sizeof(records[i].sort_key));
+        hash = bench_hash_bytes(hash, &records[i].queue_index, sizeof(records[i].queue_index));
+        hash = bench_hash_bytes(hash, &records[i].transform.position, sizeof(records[i].transform.position));
+        hash = bench_hash_bytes(hash, &records[i].transform.scale, sizeof(records[i].transform.scale));
+        hash = bench_hash_bytes(hash, &records[i].transform.rotation, sizeof(records[i].transform.rotation));
+    }
+    hg_heap_free(records);
+    *draw_count = count;
+    return hash;
+}
+
+static u32 bench_triangles(const HgRenderer3DStats* stats) {
+    u32 triangles = 0;
+    for (u32 level = 0; level < HG_3D_MAX_LODS; ++level) {
+        triangles += stats->lod_triangles[level];
+    }
+    return triangles;
+}
+
+static void bench_write_csv(const char* path, const BenchFrame* frames, u32 count) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        printf("Could not open %s\n", path);
+        return;
+    }
+    fprintf(file, "frame,frame_ms,draw_ms,present_ms,gpu_ms,visible,draws,batches,descriptor_binds,triangles,"
+        "prepass_draws,transforms_uploaded,occluded,arena_bytes,arena_overflows\n");
+    for (u32 i = 0; i < count; ++i) {
+        const BenchFrame* frame = &frames[i];
+        fprintf(file, "%u,%.4f,%.4f,%.4f,%.4f,%u,%u,%u,%u,%u,%u,%u,%u,%zu,%u\n",
+            i,
+            frame->frame_ms,
+            frame->draw_ms,
+            frame->present_ms,
+            frame->gpu_ms,
+            frame->stats.visible,
+            frame->stats.draws,
+            frame->stats.batches,
+            frame->stats.descriptor_binds,
+            bench_triangles(&frame->stats),
+            frame->stats.prepass_draws,
+            frame->stats.transforms_uploaded,
+            frame->stats.occluded,
+            frame->stats.arena_bytes,
+            frame->stats.arena_overflows);
+    }
+    fclose(file);
+}
+
+static void bench_write_json(
+    const char* path, const BenchOptions* options, const BenchStartup* startup, const BenchFrame* frames, u32 count,
+    u64 draw_hash
+) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        printf("Could not open %s\n", path);
+        return;
+    }
+
+    f64 frame[3];
+    f64 draw[3];
+    f64 present[3];
+    f64 gpu[3];
+    bench_summarize(frames, count, offsetof(BenchFrame, frame_ms), frame);
+    bench_summarize(frames, count, offsetof(BenchFrame, draw_ms), draw);
+    bench_summarize(frames, count, offsetof(BenchFrame, present_ms), present);
+    bench_summarize(frames, count, offsetof(BenchFrame, gpu_ms), gpu);
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"options\": {\"models\": %u, \"meshes\": %u, \"textures\": %u, \"point_lights\": %u, "
+        "\"directional_lights\": %u, \"frames\": %u, \"warmup\": %u, \"width\": %u, \"height\": %u, "
+        "\"seed\": %u, \"prepass\": %s, \"dedicated_buffers\": %s, \"retained\": %s, "
+        "\"prepare_shaders\": %s, \"pipelined\": %s, \"occlusion\": %s, \"gpu_timing\": %s},\n",
+        options->models, options->meshes, options->textures, options->point_lights,
+        options->directional_lights, options->frames, options->warmup, options->width, options->height,
+        options->seed, options->prepass ? "true" : "false", options->dedicated_buffers ? "true" : "false",
+        options->retained ? "true" : "false", options->prepare_shaders ? "true" : "false",
+        options->pipelined ? "true" : "false", options->occlusion ? "true" : "false",
+        options->gpu_timing ? "true" : "false");
+    fprintf(file, "  \"startup_ms\": {\"init\": %.4f, \"renderer_init\": %.4f, \"window\": %.4f, "
+        "\"prepare_shaders\": %.4f, \"first_frame\": %.4f, \"first_frame_shaders\": %u},\n",
+        startup->init_ms, startup->renderer_init_ms, startup->window_ms, startup->prepare_shaders_ms,
+        startup->first_frame_ms, startup->first_frame_shaders);
+    fprintf(file, "  \"frame_ms\": {\"average\": %.4f, \"p50\": %.4f, \"p99\": %.4f},\n", frame[0], frame[1], frame[2]);
+    fprintf(file, "  \"draw_ms\": {\"average\": %.4f, \"p50\": %.4f, \"p99\": %.4f},\n", draw[0], draw[1], draw[2]);
+    fprintf(file, "  \"present_ms\": {\"average\": %.4f, \"p50\": %.4f, \"p99\": %.4f},\n",
+        present[0], present[1], present[2]);
+    fprintf(file, "  \"gpu_ms\": {\"average\": %.4f, \"p50\": %.4f, \"p99\": %.4f},\n", gpu[0], gpu[1], gpu[2]);
+    fprintf(file, "  \"last_frame\": {\"visible\": %u, \"draws\": %u, \"batches\": %u, \"triangles\": %u},\n",
+        frames[count - 1].stats.visible, frames[count - 1].stats.draws, frames[count - 1].stats.batches,
+        bench_triangles(&frames[count - 1].stats));
+    fprintf(file, "  \"draw_hash\": \"%016llx\",\n", (unsigned long long)draw_hash);
+    fprintf(file, "  \"peaks\": {\"models\": %u, \"directional_lights\": %u, \"point_lights\": %u, "
+        "\"arena_bytes\": %zu},\n",
+        frames[count - 1].stats.peak_models, frames[count - 1].stats.peak_dir_lights,
+        frames[count - 1].stats.peak_point_lights, frames[count - 1].stats.peak_arena_bytes);
+
+    HgMemoryStats3D memory;
+    hg_3d_renderer_get_memory_stats(&memory);
+    fprintf(file, "  \"gpu_memory_bytes\": {\"mesh\": %zu, \"texture\": %zu, \"frame\": %zu, \"target\": %zu, "
+        "\"total\": %zu, \"peak\": %zu}\n",
+        memory.bytes[HG_MEMORY_CATEGORY_3D_MESH], memory.bytes[HG_MEMORY_CATEGORY_3D_TEXTURE],
+        memory.bytes[HG_MEMORY_CATEGORY_3D_FRAME], memory.bytes[HG_MEMORY_CATEGORY_3D_TARGET],
+        memory.total_bytes, memory.peak_total_bytes);
+    fprintf(file, "}\n");
+    fclose(file);
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!bench_parse(argc, argv, &options)) {
+        bench_usage(argv[0]);
+        return 1;
+    }
+
+    BenchStartup startup = {0};
+    HgClock startup_clock;
+    (void)hg_clock_tick(&startup_clock);
+
+    hg_init();
+    startup.init_ms = hg_clock_tick(&startup_clock) * 1.0e3;
+    hg_3d_renderer_init();
+    hg_3d_renderer_set_depth_prepass(options.prepass);
+    hg_3d_renderer_set_pipelined(options.pipelined);
+    hg_3d_renderer_set_occlusion_culling(options.occlusion);
+    hg_3d_renderer_set_gpu_timing(options.gpu_timing);
+    startup.renderer_init_ms = hg_clock_tick(&startup_clock) * 1.0e3;
+
+    hg_window_open(&(HgWindowConfig){
+        .title = "Hurdy Gurdy Bench",
+        .width = options.width,
+        .height = options.height,
+        .windowed = true,
+    });
+    startup.window_ms = hg_clock_tick(&startup_clock) * 1.0e3;
+
+    if (options.prepare_shaders) {
+        hg_3d_renderer_prepare_shaders();
+        startup.prepare_shaders_ms = hg_clock_tick(&startup_clock) * 1.0e3;
+    }
+
+    HgTexture* target;
+    HgTexture* depth_buffer;
+    hg_3d_renderer_target_create(options.width, options.height, &target, &depth_buffer);
+    hg_3d_renderer_update_projection(
+        (f32)HG_PI / 3.0f, (f32)options.width / (f32)options.height, 0.1f, 200.0f
+    );
+
+    u32 random = options.seed;
+
+    // Meshes from 8 segments up, each a step finer than the last
+    HgMesh3D** meshes = hg_heap_alloc(options.meshes * sizeof(HgMesh3D*));
+    HgBuffer** vertex_buffers = hg_heap_alloc(options.meshes * sizeof(HgBuffer*));
+    HgBuffer** index_buffers = hg_heap_alloc(options.meshes * sizeof(HgBuffer*));
+    u32* index_counts = hg_heap_alloc(options.meshes * sizeof(u32));
+    HgBounds3D* bounds = hg_heap_alloc(options.meshes * sizeof(HgBounds3D));
+    for (u32 i = 0; i < options.meshes; ++i) {
+        HgVertex3D* vertices;
+        u32 vertex_count;
+        u32* indices;
+        bench_sphere_create(8 + 4 * i, &vertices, &vertex_count, &indices, &index_counts[i]);
+
+        meshes[i] = NULL;
+        vertex_buffers[i] = NULL;
+        if (options.dedicated_buffers)
+            vertex_buffers[i] = hg_3d_vertex_buffer_create(vertices, vertex_count, &bounds[i]);
+        else
+            meshes[i] = hg_3d_mesh_create(vertices, vertex_count, &bounds[i]);
+        if (meshes[i] != NULL && options.occlusion) {
+            hg_3d_mesh_set_occluder(
+                meshes[i], bench_cube_positions, HG_ARRAY_SIZE(bench_cube_positions),
+                bench_cube_indices, HG_ARRAY_SIZE(bench_cube_indices)
+            );
+        }
+        index_buffers[i] = hg_3d_index_buffer_create(indices, index_counts[i]);
+
+        hg_heap_free(indices);
+        hg_heap_free(vertices);
+    }
+
+    // Checkerboards in random colors
+    HgTexture** textures = hg_heap_alloc(options.textures * sizeof(HgTexture*));
+    for (u32 i = 0; i < options.textures; ++i) {
+        u32 color = 0xff000000 | (bench_random(&random) & 0x00ffffff);
+        u32 pixels[8 * 8];
+        for (u32 p = 0; p < HG_ARRAY_SIZE(pixels); ++p) {
+            pixels[p] = ((p / 8 + p % 8) % 2 == 0) ? color : 0xffffffff;
+        }
+        textures[i] = hg_3d_texture_map_create(
+            pixels, 8, 8, HG_FORMAT_R8G8B8A8_UNORM, HG_TEXTURE_COMPRESSION_3D_NONE, HG_TEXTURE_MAP_3D_MIPMAPS_BIT
+        );
+    }
+
+    // Models fill a cube whose side grows with the count, so density stays
+    // about the same as the scene scales
+    f32 extent = cbrtf((f32)options.models) * 1.5f;
+    HgModel3D* models = hg_heap_alloc(options.models * sizeof(HgModel3D));
+    HgTransform3D* transforms = hg_heap_alloc(options.models * sizeof(HgTransform3D));
+    for (u32 i = 0; i < options.models; ++i) {
+        u32 mesh = bench_random(&random) % options.meshes;
+        models[i] = (HgModel3D){
+            .mesh = meshes[mesh],
+            .vertex_buffer = vertex_buffers[mesh],
+            .index_buffer = index_buffers[mesh],
+            .color_map = textures[bench_random(&random) % options.textures],
+            .bounds = bounds[mesh],
+            .vertex_format = HG_VERTEX_FORMAT_3D_FLOAT,
+            .index_count = index_counts[mesh],
+        };
+        f32 scale = bench_random_range(&random, 0.5f, 1.5f);
+        transforms[i] = (HgTransform3D){
+            .position = {
+                bench_random_range(&random, -extent, extent),
+                bench_random_range(&random, -extent, extent),
+                bench_random_range(&random, -extent, extent),
+            },
+            .scale = {scale, scale, scale},
+            .rotation = hg_axis_angle((HgVec3){0.0f, 1.0f, 0.0f}, bench_random_range(&random, 0.0f, (f32)HG_TAU)),
+        };
+    }
+
+    HgObject3D** objects = NULL;
+    if (options.retained) {
+        objects = hg_heap_alloc(options.models * sizeof(HgObject3D*));
+        for (u32 i = 0; i < options.models; ++i) {
+            objects[i] = hg_3d_object_create(&models[i], &transforms[i]);
+        }
+    }
+
+    // One spare, so no lights still allocates
+    HgVec3* light_positions = hg_heap_alloc((options.point_lights + 1) * sizeof(HgVec3));
+    HgVec3* light_colors = hg_heap_alloc((options.point_lights + 1) * sizeof(HgVec3));
+    for (u32 i = 0; i < options.point_lights; ++i) {
+        light_positions[i] = (HgVec3){
+            bench_random_range(&random, -extent, extent),
+            bench_random_range(&random, -extent, extent),
+            bench_random_range(&random, -extent, extent),
+        };
+        light_colors[i] = (HgVec3){
+            bench_random_range(&random, 0.2f, 1.0f),
+            bench_random_range(&random, 0.2f, 1.0f),
+            bench_random_range(&random, 0.2f, 1.0f),
+        };
+    }
+
+    BenchFrame* frames = hg_heap_alloc(options.frames * sizeof(BenchFrame));
+    u32 total_frames = options.warmup + options.frames;
+    u32 measured = 0;
+
+    // frame_clock spans whole frames, event processing and queueing included;
+    // clock splits out the draw call and the present
+    HgClock frame_clock;
+    HgClock clock;
+    (void)hg_clock_tick(&frame_clock);
+    for (u32 frame = 0; frame < total_frames; ++frame) {
+        hg_process_events();
+        if (hg_was_window_closed())
+            break;
+
+        if (frame == options.warmup && options.trace_path != NULL)
+            hg_profiler_capture(options.trace_path, options.frames);
+
+        // The camera orbits the scene at a fixed rate per frame, looking at
+        // the center from just outside the cube, slightly from above
+        f32 time = (f32)frame * BENCH_TIMESTEP;
+        HgQuat rotation = hg_qmul(
+            hg_axis_angle((HgVec3){0.0f, 1.0f, 0.0f}, time * BENCH_ORBIT_SPEED),
+            hg_axis_angle((HgVec3){-1.0f, 0.0f, 0.0f}, 0.3f)
+        );
+        HgVec3 forward = bench_rotate(rotation, (HgVec3){0.0f, 0.0f, 1.0f});
+        f32 distance = extent * 2.0f;
+        HgVec3 position = {-forward.x * distance, -forward.y * distance, -forward.z * distance};
+        hg_3d_renderer_update_view(position, 1.0f, rotation);
+
+        // Pipelined frames begin and end on the render thread
+        if (!options.pipelined) {
+            HgError begin_result = hg_frame_begin();
+            if (begin_result != HG_SUCCESS) {
+                HG_DEBUG("Failed to begin frame");
+                continue;
+            }
+        }
+
+        for (u32 i = 0; i < options.directional_lights; ++i) {
+            f32 angle = (f32)HG_TAU * (f32)i / (f32)options.directional_lights;
+            hg_3d_renderer_queue_directional_light(
+                (HgVec3){cosf(angle), 1.0f, sinf(angle)}, (HgVec3){1.0f, 0.95f, 0.9f}, 0.5f
+            );
+        }
+        for (u32 i = 0; i < options.point_lights; ++i) {
+            hg_3d_renderer_queue_point_light(light_positions[i], light_colors[i], 2.0f, 6.0f);
+        }
+        if (!options.retained)
+            hg_3d_renderer_queue_models(models, transforms, options.models);
+
+        (void)hg_clock_tick(&clock);
+        HgError end_result;
+        if (options.pipelined) {
+            end_result = hg_3d_renderer_frame(target, depth_buffer);
+        } else {
+            hg_3d_renderer_draw(target, depth_buffer);
+        }
+        f64 draw_seconds = hg_clock_tick(&clock);
+
+        // hg_3d_renderer_draw leaves the present to the caller, so with GPU
+        // timing on, bench times the GPU here as hg_3d_renderer_frame would
+        u64 submitted = hg_profiler_time();
+        if (!options.pipelined)
+            end_result = hg_frame_end(target);
+        f64 present_seconds = hg_clock_tick(&clock);
+        f64 gpu_ms = 0.0;
+        if (!options.pipelined && options.gpu_timing && end_result == HG_SUCCESS) {
+            hg_graphics_wait();
+            u64 idle = hg_profiler_time();
+            hg_profiler_gpu_scope("gpu", submitted, idle);
+            gpu_ms = (f64)(idle - submitted) * 1.0e-6;
+        }
+        f64 frame_seconds = hg_clock_tick(&frame_clock);
+        if (end_result != HG_SUCCESS) {
+            HG_DEBUG("Failed to end frame");
+            continue;
+        }
+
+        if (frame == 0) {
+            // The first frame's submission counts toward startup
+            hg_3d_renderer_wait();
+            frame_seconds += hg_clock_tick(&frame_clock);
+            HgRenderer3DStats stats;
+            hg_3d_renderer_get_stats(&stats);
+            startup.first_frame_ms = frame_seconds * 1.0e3;
+            startup.first_frame_shaders = stats.shaders_created;
+        }
+
+        if (frame >= options.warmup) {
+            BenchFrame* out = &frames[measured++];
+            out->frame_ms = frame_seconds * 1.0e3;
+            out->draw_ms = draw_seconds * 1.0e3;
+            out->present_ms = present_seconds * 1.0e3;
+            hg_3d_renderer_get_stats(&out->stats);
+            out->gpu_ms = options.pipelined ? (f64)out->stats.gpu_ms : gpu_ms;
+        }
+    }
+
+    hg_3d_renderer_wait();
+    hg_graphics_wait();
+
+    u32 hashed_draws;
+    u64 draw_hash = bench_draw_hash(options.models, &hashed_draws);
+
+    printf("startup: init %.3fms, renderer %.3fms, window %.3fms, shaders %.3fms, first frame %.3fms (%u shaders)\n",
+        startup.init_ms, startup.renderer_init_ms, startup.window_ms, startup.prepare_shaders_ms,
+        startup.first_frame_ms, startup.first_frame_shaders);
+    printf("draw hash: %016llx (%u draws)\n", (unsigned long long)draw_hash, hashed_draws);
+    if (measured > 0) {
+        if (options.csv_path != NULL)
+            bench_write_csv(options.csv_path, frames, measured);
+        if (options.json_path != NULL)
+            bench_write_json(options.json_path, &options, &startup, frames, measured, draw_hash);
+
+        f64 frame[3];
+        bench_summarize(frames, measured, offsetof(BenchFrame, frame_ms), frame);
+        printf("%u frames: avg %.3fms, p50 %.3fms, p99 %.3fms\n", measured, frame[0], frame[1], frame[2]);
+    }
+
+    hg_heap_free(frames);
+    if (objects != NULL) {
+        for (u32 i = 0; i < options.models; ++i) {
+            hg_3d_object_destroy(objects[i]);
+        }
+        hg_heap_free(objects);
+    }
+    hg_heap_free(light_colors);
+    hg_heap_free(light_positions);
+    hg_heap_free(transforms);
+    hg_heap_free(models);
+    for (u32 i = 0; i < options.textures; ++i) {
+        hg_3d_texture_destroy(textures[i]);
+    }
+    hg_heap_free(textures);
+    for (u32 i = 0; i < options.meshes; ++i) {
+        if (meshes[i] != NULL)
+            hg_3d_mesh_destroy(meshes[i]);
+        if (vertex_buffers[i] != NULL)
+            hg_3d_buffer_destroy(vertex_buffers[i]);
+        hg_3d_buffer_destroy(index_buffers[i]);
+    }
+    hg_heap_free(bounds);
+    hg_heap_free(index_counts);
+    hg_heap_free(index_buffers);
+    hg_heap_free(vertex_buffers);
+    hg_heap_free(meshes);
+    hg_3d_texture_destroy(depth_buffer);
+    hg_3d_texture_destroy(target);
+
+    hg_window_close();
+    hg_3d_renderer_shutdown();
+    hg_shutdown();
+    return 0;
+}
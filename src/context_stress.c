@@ -0,0 +1,382 @@
+#include "hurdygurdy.h"
+
+#include "renderer_3d.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+// Queues one scene from many threads at once, each into its own render
+// context, and checks that every frame draws exactly what queueing the same
+// contexts from one thread draws: the same sort keys, in the same order,
+// from the same places in the merged queue, with the same transforms. The
+// threads split their queueing into random runs of single and batched calls
+// with lights in between, differently every frame, so only the merge keeps
+// the output the same. Exits with 1 at the first frame that differs. Like
+// bench, it draws through a window; on a machine without a display, run it
+// under xvfb-run with lavapipe
+
+typedef struct StressOptions {
+    u32 threads;
+    u32 iterations;
+    u32 models;
+    u32 point_lights;
+    u32 seed;
+} StressOptions;
+
+// One thread's share of the scene, queued into its own context
+typedef struct StressThread {
+    HgRenderContext3D* context;
+    HgModel3D* models;
+    HgTransform3D* transforms;
+    u32 model_count;
+    HgVec3* light_positions;
+    u32 light_count;
+    // Picks how the queueing is split; reseeded every frame
+    u32 random;
+} StressThread;
+
+// xorshift32, as in bench
+static u32 stress_random(u32* state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static f32 stress_random_range(u32* state, f32 min, f32 max) {
+    return min + (max - min) * (f32)(stress_random(state) >> 8) / (f32)(1u << 24);
+}
+
+static bool stress_parse_u32(const char* arg, u32* value) {
+    char* end;
+    unsigned long parsed = strtoul(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || parsed > 0xffffffffu)
+        return false;
+    *value = (u32)parsed;
+    return true;
+}
+
+static void stress_usage(const char* name) {
+    printf("Usage: %s [Options]\n", name);
+    printf("Options:\n");
+    printf("  --threads <n>       Queueing threads, each with its own context (default 8)\n");
+    printf("  --iterations <n>    Frames queued from the threads and compared (default 100)\n");
+    printf("  --models <n>        Models per thread (default 2000)\n");
+    printf("  --point-lights <n>  Point lights per thread (default 16)\n");
+    printf("  --seed <n>          Scene seed (default 1)\n");
+    printf("  --help              Show this help message\n");
+}
+
+static bool stress_parse(int argc, char** argv, StressOptions* options) {
+    *options = (StressOptions){
+        .threads = 8,
+        .iterations = 100,
+        .models = 2000,
+        .point_lights = 16,
+        .seed = 1,
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        u32* number = NULL;
+
+        if (strcmp(arg, "--threads") == 0) number = &options->threads;
+        else if (strcmp(arg, "--iterations") == 0) number = &options->iterations;
+        else if (strcmp(arg, "--models") == 0) number = &options->models;
+        else if (strcmp(arg, "--point-lights") == 0) number = &options->point_lights;
+        else if (strcmp(arg, "--seed") == 0) number = &options->seed;
+        else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            stress_usage(argv[0]);
+            exit(0);
+        } else {
+            printf("Unknown option: %s\n", arg);
+            return false;
+        }
+
+        if (value == NULL) {
+            printf("Missing value for %s\n", arg);
+            return false;
+        }
+        if (!stress_parse_u32(value, number)) {
+            printf("Invalid value for %s: %s\n", arg, value);
+            return false;
+        }
+        ++i;
+    }
+
+    if (options->threads == 0 || options->iterations == 0 || options->models == 0) {
+        printf("--threads, --iterations and --models must be above 0\n");
+        return false;
+    }
+    if (options->seed == 0)
+        options->seed = 1;
+    return true;
+}
+
+// Queues the thread's models in runs of 1 to 64, singly or as a batch, with a
+// light after each run while there are lights left
+static int stress_thread_queue(void* data) {
+    StressThread* thread = data;
+
+    u32 light = 0;
+    u32 i = 0;
+    while (i < thread->model_count) {
+        u32 run = 1 + stress_random(&thread->random) % 64;
+        if (run > thread->model_count - i)
+            run = thread->model_count - i;
+
+        if (stress_random(&thread->random) % 2 == 0) {
+            hg_3d_render_context_queue_models(thread->context, thread->models + i, thread->transforms + i, run);
+        } else {
+            for (u32 j = i; j < i + run; ++j) {
+                hg_3d_render_context_queue_model(thread->context, &thread->models[j], &thread->transforms[j]);
+            }
+        }
+        i += run;
+
+        if (light < thread->light_count) {
+            hg_3d_render_context_queue_point_light(
+                thread->context, thread->light_positions[light], (HgVec3){1.0f, 1.0f, 1.0f}, 2.0f, 6.0f
+            );
+            ++light;
+        }
+        if (stress_random(&thread->random) % 8 == 0)
+            thrd_yield();
+    }
+    for (; light < thread->light_count; ++light) {
+        hg_3d_render_context_queue_point_light(
+            thread->context, thread->light_positions[light], (HgVec3){1.0f, 1.0f, 1.0f}, 2.0f, 6.0f
+        );
+    }
+    return 0;
+}
+
+// Queues every thread's share, from the threads at once or one after another
+// on this thread, draws the frame and copies its draw order into records.
+// Returns the number drawn, or UINT32_MAX if the frame failed
+static u32 stress_frame(
+    StressThread* threads,
+    u32 thread_count,
+    bool threaded,
+    u32 seed,
+    HgTexture* target,
+    HgTexture* depth_buffer,
+    HgDrawRecord3D* records,
+    u32 capacity
+) {
+    hg_process_events();
+    if (hg_frame_begin() != HG_SUCCESS) {
+        printf("Failed to begin frame\n");
+        return UINT32_MAX;
+    }
+
+    for (u32 i = 0; i < thread_count; ++i) {
+        threads[i].random = seed * 0x9e3779b9u + i + 1;
+        if (threads[i].random == 0)
+            threads[i].random = 1;
+    }
+
+    if (threaded) {
+        thrd_t* handles = hg_heap_alloc(thread_count * sizeof(thrd_t));
+        for (u32 i = 0; i < thread_count; ++i) {
+            if (thrd_create(&handles[i], stress_thread_queue, &threads[i]) != thrd_success) {
+                printf("Failed to start thread %u\n", i);
+                exit(1);
+            }
+        }
+        // The renderer's own queue is merged first, whatever its thread
+        hg_3d_renderer_queue_directional_light((HgVec3){0.3f, -1.0f, 0.2f}, (HgVec3){1.0f, 0.95f, 0.9f}, 0.5f);
+        for (u32 i = 0; i < thread_count; ++i) {
+            thrd_join(handles[i], NULL);
+        }
+        hg_heap_free(handles);
+    } else {
+        hg_3d_renderer_queue_directional_light((HgVec3){0.3f, -1.0f, 0.2f}, (HgVec3){1.0f, 0.95f, 0.9f}, 0.5f);
+        for (u32 i = 0; i < thread_count; ++i) {
+            (void)stress_thread_queue(&threads[i]);
+        }
+    }
+
+    hg_3d_renderer_draw(target, depth_buffer);
+    u32 count = hg_3d_renderer_get_draw_order(records, capacity);
+    if (hg_frame_end(target) != HG_SUCCESS) {
+        printf("Failed to end frame\n");
+        return UINT32_MAX;
+    }
+    return count;
+}
+
+int main(int argc, char** argv) {
+    StressOptions options;
+    if (!stress_parse(argc, argv, &options)) {
+        stress_usage(argv[0]);
+        return 1;
+    }
+
+    hg_init();
+    hg_3d_renderer_init();
+    hg_window_open(&(HgWindowConfig){
+        .title = "Hurdy Gurdy Context Stress",
+        .width = 640,
+        .height = 360,
+        .windowed = true,
+    });
+
+    HgTexture* target;
+    HgTexture* depth_buffer;
+    hg_3d_renderer_target_create(640, 360, &target, &depth_buffer);
+    hg_3d_renderer_update_projection((f32)HG_PI / 3.0f, 640.0f / 360.0f, 0.1f, 200.0f);
+    hg_3d_renderer_update_view((HgVec3){0.0f, 0.0f, -40.0f}, 1.0f, hg_axis_angle((HgVec3){0.0f, 1.0f, 0.0f}, 0.0f));
+
+    // A cube, and a few color maps so the sort keys differ
+    static const u32 cube_indices[36] = {
+        0, 1, 2, 0, 2, 3,
+        4, 6, 5, 4, 7, 6,
+        0, 4, 5, 0, 5, 1,
+        3, 2, 6, 3, 6, 7,
+        0, 3, 7, 0, 7, 4,
+        1, 5, 6, 1, 6, 2,
+    };
+    HgVertex3D cube_vertices[8];
+    for (u32 i = 0; i < HG_ARRAY_SIZE(cube_vertices); ++i) {
+        HgVec3 corner = {i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f};
+        cube_vertices[i] = (HgVertex3D){
+            .position = corner,
+            .normal = {corner.x * 1.1547f, corner.y * 1.1547f, corner.z * 1.1547f},
+            .tangent = {1.0f, 0.0f, 0.0f, 1.0f},
+            .uv = {corner.x + 0.5f, corner.y + 0.5f},
+        };
+    }
+    HgBounds3D bounds;
+    HgMesh3D* mesh = hg_3d_mesh_create(cube_vertices, HG_ARRAY_SIZE(cube_vertices), &bounds);
+    HgBuffer* index_buffer = hg_3d_index_buffer_create(cube_indices, HG_ARRAY_SIZE(cube_indices));
+
+    u32 random = options.seed;
+    HgTexture* textures[4];
+    for (u32 i = 0; i < HG_ARRAY_SIZE(textures); ++i) {
+        u32 color = 0xff000000 | (stress_random(&random) & 0x00ffffff);
+        textures[i] = hg_3d_texture_map_create(
+            &color, 1, 1, HG_FORMAT_R8G8B8A8_UNORM, HG_TEXTURE_COMPRESSION_3D_NONE, 0
+        );
+    }
+
+    StressThread* threads = hg_heap_alloc(options.threads * sizeof(StressThread));
+    for (u32 t = 0; t < options.threads; ++t) {
+        StressThread* thread = &threads[t];
+        *thread = (StressThread){
+            .context = hg_3d_render_context_create(),
+            .models = hg_heap_alloc(options.models * sizeof(HgModel3D)),
+            .transforms = hg_heap_alloc(options.models * sizeof(HgTransform3D)),
+            .model_count = options.models,
+            .light_positions = hg_heap_alloc((options.point_lights + 1) * sizeof(HgVec3)),
+            .light_count = options.point_lights,
+        };
+        for (u32 i = 0; i < options.models; ++i) {
+            thread->models[i] = (HgModel3D){
+                .mesh = mesh,
+                .index_buffer = index_buffer,
+                .color_map = textures[stress_random(&random) % HG_ARRAY_SIZE(textures)],
+                .unlit = stress_random(&random) % 4 == 0,
+                .bounds = bounds,
+                .vertex_format = HG_VERTEX_FORMAT_3D_FLOAT,
+                .index_count = HG_ARRAY_SIZE(cube_indices),
+            };
+            thread->transforms[i] = (HgTransform3D){
+                .position = {
+                    stress_random_range(&random, -20.0f, 20.0f),
+                    stress_random_range(&random, -12.0f, 12.0f),
+                    stress_random_range(&random, -20.0f, 20.0f),
+                },
+                .scale = {1.0f, 1.0f, 1.0f},
+                .rotation = hg_axis_angle((HgVec3){0.0f, 1.0f, 0.0f}, stress_random_range(&random, 0.0f, (f32)HG_TAU)),
+            };
+        }
+        for (u32 i = 0; i < options.point_lights; ++i) {
+            thread->light_positions[i] = (HgVec3){
+                stress_random_range(&random, -20.0f, 20.0f),
+                stress_random_range(&random, -12.0f, 12.0f),
+                stress_random_range(&random, -20.0f, 20.0f),
+            };
+        }
+    }
+
+    u32 capacity = options.threads * options.models;
+    HgDrawRecord3D* expected = hg_heap_alloc(capacity * sizeof(HgDrawRecord3D));
+    HgDrawRecord3D* records = hg_heap_alloc(capacity * sizeof(HgDrawRecord3D));
+
+    // Level of detail hysteresis depends on the frames before, so the
+    // reference is drawn twice and the second kept
+    u32 expected_count = 0;
+    for (u32 i = 0; i < 2; ++i) {
+        expected_count = stress_frame(threads, options.threads, false, 0, target, depth_buffer, expected, capacity);
+    }
+
+    int result = expected_count == UINT32_MAX ? 1 : 0;
+    HgRenderer3DStats expected_stats;
+    hg_3d_renderer_get_stats(&expected_stats);
+    printf("reference: %u models drawn of %u, %u point lights\n",
+        expected_count, capacity, expected_stats.point_lights);
+
+    for (u32 iteration = 0; iteration < options.iterations && result == 0; ++iteration) {
+        u32 count = stress_frame(
+            threads, options.threads, true, iteration + 1, target, depth_buffer, records, capacity
+        );
+        if (count == UINT32_MAX) {
+            result = 1;
+            break;
+        }
+
+        HgRenderer3DStats stats;
+        hg_3d_renderer_get_stats(&stats);
+        if (count != expected_count || stats.models != expected_stats.models
+         || stats.dir_lights != expected_stats.dir_lights || stats.point_lights != expected_stats.point_lights) {
+            printf("iteration %u: drew %u models of %u with %u + %u lights, expected %u of %u with %u + %u\n",
+                iteration, count, stats.models, stats.dir_lights, stats.point_lights,
+                expected_count, expected_stats.models, expected_stats.dir_lights, expected_stats.point_lights);
+            result = 1;
+            break;
+        }
+        for (u32 i = 0; i < count; ++i) {
+            if (records[i].sort_key != expected[i].sort_key || records[i].queue_index != expected[i].queue_index
+             || memcmp(&records[i].transform, &expected[i].transform, sizeof(HgTransform3D)) != 0) {
+                printf("iteration %u: draw %u is key %016llx from %u, expected key %016llx from %u\n",
+                    iteration, i, (unsigned long long)records[i].sort_key, records[i].queue_index,
+                    (unsigned long long)expected[i].sort_key, expected[i].queue_index);
+                result = 1;
+                break;
+            }
+        }
+    }
+    if (result == 0)
+        printf("%u iterations on %u threads matched the single threaded draw order\n",
+            options.iterations, options.threads);
+
+    hg_graphics_wait();
+
+    hg_heap_free(records);
+    hg_heap_free(expected);
+    for (u32 t = 0; t < options.threads; ++t) {
+        hg_3d_render_context_destroy(threads[t].context);
+        hg_heap_free(threads[t].light_positions);
+        hg_heap_free(threads[t].transforms);
+        hg_heap_free(threads[t].models);
+    }
+    hg_heap_free(threads);
+    for (u32 i = 0; i < HG_ARRAY_SIZE(textures); ++i) {
+        hg_3d_texture_destroy(textures[i]);
+    }
+    hg_3d_buffer_destroy(index_buffer);
+    hg_3d_mesh_destroy(mesh);
+    hg_3d_texture_destroy(depth_buffer);
+    hg_3d_texture_destroy(target);
+
+    hg_window_close();
+    hg_3d_renderer_shutdown();
+    hg_shutdown();
+    return result;
+}
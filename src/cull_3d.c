@@ -0,0 +1,82 @@
+#include "cull_3d.h"
+
+#include <math.h>
+#include <string.h>
+
+f32 hg_view_depth(const HgMat4* view, HgVec3 position) {
+    f32 v[4][4];
+    memcpy(v, view, sizeof(v));
+    return v[0][2] * position.x + v[1][2] * position.y + v[2][2] * position.z + v[3][2];
+}
+
+// HgQuat is stored real part first, as in the identity {1, 0, 0, 0}
+_Static_assert(sizeof(HgQuat) == 4 * sizeof(f32), "HgQuat must be 4 floats");
+
+HgVec3 hg_rotate_vec3(HgQuat rotation, HgVec3 v) {
+    f32 q[4];
+    memcpy(q, &rotation, sizeof(q));
+
+    HgVec3 t = {
+        2.0f * (q[2] * v.z - q[3] * v.y),
+        2.0f * (q[3] * v.x - q[1] * v.z),
+        2.0f * (q[1] * v.y - q[2] * v.x),
+    };
+    return (HgVec3){
+        v.x + q[0] * t.x + (q[2] * t.z - q[3] * t.y),
+        v.y + q[0] * t.y + (q[3] * t.x - q[1] * t.z),
+        v.z + q[0] * t.z + (q[1] * t.y - q[2] * t.x),
+    };
+}
+
+void hg_view_projection(const HgMat4* view, const HgMat4* proj, f32 vp[4][4]) {
+    f32 v[4][4];
+    f32 p[4][4];
+    memcpy(v, view, sizeof(v));
+    memcpy(p, proj, sizeof(p));
+
+    for (u32 c = 0; c < 4; ++c) {
+        for (u32 r = 0; r < 4; ++r) {
+            vp[c][r] = p[0][r] * v[c][0] + p[1][r] * v[c][1] + p[2][r] * v[c][2] + p[3][r] * v[c][3];
+        }
+    }
+}
+
+// Near uses -w <= z so it stays conservative under either depth convention
+void hg_frustum_planes(const HgMat4* view, const HgMat4* proj, f32 planes[6][4]) {
+    f32 vp[4][4];
+    hg_view_projection(view, proj, vp);
+
+    for (u32 i = 0; i < 4; ++i) {
+        planes[0][i] = vp[i][3] + vp[i][0];
+        planes[1][i] = vp[i][3] - vp[i][0];
+        planes[2][i] = vp[i][3] + vp[i][1];
+        planes[3][i] = vp[i][3] - vp[i][1];
+        planes[4][i] = vp[i][3] + vp[i][2];
+        planes[5][i] = vp[i][3] - vp[i][2];
+    }
+    for (u32 p = 0; p < 6; ++p) {
+        f32 len = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+        if (len > 0.0f) {
+            for (u32 i = 0; i < 4; ++i) {
+                planes[p][i] /= len;
+            }
+        }
+    }
+}
+
+u32 hg_cull_spheres(
+    HgCullSpheresKernel kernel, const f32* spheres, u32 stride, u32 count, u32 first, f32 planes[6][4], u32* visible
+) {
+    if (count == 0)
+        return 0;
+
+    const f32* xs = spheres;
+    const f32* ys = spheres + stride;
+    const f32* zs = spheres + 2 * stride;
+    const f32* rs = spheres + 3 * stride;
+    u32 visible_count = kernel(xs, ys, zs, rs, count, (const f32 (*)[4])planes, visible);
+    for (u32 i = 0; i < visible_count; ++i) {
+        visible[i] += first;
+    }
+    return visible_count;
+}
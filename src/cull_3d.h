@@ -0,0 +1,27 @@
+#ifndef HG_CULL_3D_H
+#define HG_CULL_3D_H
+
+#include "hg_math.h"
+#include "simd_kernels_3d.h"
+
+// The view math culling shares with level of detail selection, light
+// clustering and occlusion. Matrices are column major, with the view looking
+// down +z, so view space z is the depth in front of the camera
+
+// View space depth of a world space position
+f32 hg_view_depth(const HgMat4* view, HgVec3 position);
+HgVec3 hg_rotate_vec3(HgQuat rotation, HgVec3 v);
+void hg_view_projection(const HgMat4* view, const HgMat4* proj, f32 vp[4][4]);
+// Normalized planes of the view projection frustum, pointing inward, for
+// hg_cull_spheres
+void hg_frustum_planes(const HgMat4* view, const HgMat4* proj, f32 planes[6][4]);
+
+// Tests count bounding spheres against the frustum with kernel. The spheres
+// are four arrays of x, y, z and radius, each stride floats after the last.
+// Writes the indices of the visible ones, plus first, to visible in
+// ascending order, and returns how many there were
+u32 hg_cull_spheres(
+    HgCullSpheresKernel kernel, const f32* spheres, u32 stride, u32 count, u32 first, f32 planes[6][4], u32* visible
+);
+
+#endif // HG_CULL_3D_H
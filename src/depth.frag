@@ -0,0 +1,5 @@
+#version 460
+
+// Depth only: no outputs, the main pass overwrites every pixel written here
+void main() {
+}
@@ -0,0 +1,21 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+layout(location = 0) in vec3 in_pos;
+
+#include "model_common.glsl"
+#include "model_position.glsl"
+
+// Up to p_depth_bias, the pre-pass depth is bit-identical to the main pass's
+layout(push_constant) uniform DepthPush {
+    uint p_instance;
+    float p_depth_bias;
+};
+
+void main() {
+    const ModelInstance instance = u_instances[u_instance_base + p_instance + gl_InstanceIndex];
+    const ModelTransform transform = u_transforms[u_transform_base + instance.transform];
+    const vec4 pos = model_view_position(transform.model, in_pos);
+    model_set_position(pos);
+    model_apply_depth_bias(p_depth_bias);
+}
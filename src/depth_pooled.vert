@@ -0,0 +1,26 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "model_common.glsl"
+#include "model_position.glsl"
+
+// HgVertex3D as 12 floats, position first
+layout(set = 0, binding = 5) readonly buffer VertexPool {
+    float u_vertex_pool[];
+};
+
+// Up to p_depth_bias, the pre-pass depth is bit-identical to the main pass's
+layout(push_constant) uniform DepthPush {
+    uint p_instance;
+    float p_depth_bias;
+};
+
+void main() {
+    const ModelInstance instance = u_instances[u_instance_base + p_instance + gl_InstanceIndex];
+    const ModelTransform transform = u_transforms[u_transform_base + instance.transform];
+    const uint base = (instance.vertex_offset + gl_VertexIndex) * 12;
+    const vec3 in_pos = vec3(u_vertex_pool[base], u_vertex_pool[base + 1], u_vertex_pool[base + 2]);
+    const vec4 pos = model_view_position(transform.model, in_pos);
+    model_set_position(pos);
+    model_apply_depth_bias(p_depth_bias);
+}
@@ -0,0 +1,161 @@
+#include "dynamic_resolution_3d.h"
+
+#include "renderer_3d.h"
+
+#include <math.h>
+
+// Each level renders an eighth less of the full width and height
+#define HG_RESOLUTION_STEP 0.125f
+// Weight of the newest frame in the average
+#define HG_RESOLUTION_SMOOTHING 0.1
+// Frames over budget before lowering the resolution, short so spikes are
+// caught quickly
+#define HG_RESOLUTION_DROP_DELAY 8
+// Bounds on raise_delay, in frames
+#define HG_RESOLUTION_RAISE_DELAY 60
+#define HG_RESOLUTION_MAX_RAISE_DELAY 1920
+// Fraction of the budget the average must stay under to raise the resolution
+#define HG_RESOLUTION_HEADROOM 0.85
+
+static f32 hg_resolution_level_scale(u32 level) {
+    return 1.0f - HG_RESOLUTION_STEP * (f32)level;
+}
+
+// Frames in flight may still draw to the current targets, but the renderer
+// only destroys them once those are done
+static void hg_resolution_targets_destroy(HgDynamicResolution3D* resolution) {
+    if (resolution->target != NULL) {
+        hg_3d_renderer_set_render_scale(1.0f, NULL);
+        hg_3d_texture_destroy(resolution->output);
+        hg_3d_texture_destroy(resolution->depth_buffer);
+        hg_3d_texture_destroy(resolution->target);
+    }
+    resolution->target = NULL;
+    resolution->depth_buffer = NULL;
+    resolution->output = NULL;
+}
+
+void hg_dynamic_resolution_init(HgDynamicResolution3D* resolution, u32 width, u32 height, f64 budget) {
+    HG_ASSERT(resolution != NULL);
+    HG_ASSERT(width > 0 && height > 0);
+    HG_ASSERT(budget > 0.0);
+
+    *resolution = (HgDynamicResolution3D){
+        .width = width,
+        .height = height,
+        .budget = budget,
+        .raise_delay = HG_RESOLUTION_RAISE_DELAY,
+        .enabled = true,
+    };
+}
+
+void hg_dynamic_resolution_destroy(HgDynamicResolution3D* resolution) {
+    HG_ASSERT(resolution != NULL);
+
+    hg_resolution_targets_destroy(resolution);
+    *resolution = (HgDynamicResolution3D){0};
+}
+
+void hg_dynamic_resolution_resize(HgDynamicResolution3D* resolution, u32 width, u32 height) {
+    HG_ASSERT(resolution != NULL);
+    HG_ASSERT(width > 0 && height > 0);
+
+    hg_resolution_targets_destroy(resolution);
+    resolution->width = width;
+    resolution->height = height;
+    resolution->raise_delay = HG_RESOLUTION_RAISE_DELAY;
+}
+
+void hg_dynamic_resolution_set_enabled(HgDynamicResolution3D* resolution, bool enabled) {
+    HG_ASSERT(resolution != NULL);
+
+    resolution->enabled = enabled;
+    if (!enabled) {
+        resolution->level = 0;
+        resolution->frames_at_level = 0;
+    }
+}
+
+// Fragment cost goes with pixel count, so the average at another level can be
+// predicted rather than waited for. Overestimates raises, as not all of a
+// frame's cost scales, which errs on the side of the budget
+static f64 hg_resolution_predict(const HgDynamicResolution3D* resolution, u32 level) {
+    f64 ratio = (f64)(hg_resolution_level_scale(level) / hg_resolution_level_scale(resolution->level));
+    return resolution->average * ratio * ratio;
+}
+
+static void hg_resolution_change(HgDynamicResolution3D* resolution, u32 level) {
+    resolution->average = hg_resolution_predict(resolution, level);
+    resolution->raised = level < resolution->level;
+    resolution->level = level;
+    resolution->frames_at_level = 0;
+}
+
+void hg_dynamic_resolution_update(HgDynamicResolution3D* resolution, f64 frame_time) {
+    HG_ASSERT(resolution != NULL);
+
+    if (!resolution->enabled)
+        return;
+
+    if (resolution->average == 0.0)
+        resolution->average = frame_time;
+    resolution->average += (frame_time - resolution->average) * HG_RESOLUTION_SMOOTHING;
+    ++resolution->frames_at_level;
+
+    if (resolution->average > resolution->budget
+     && resolution->frames_at_level >= HG_RESOLUTION_DROP_DELAY
+     && resolution->level + 1 < HG_DYNAMIC_RESOLUTION_LEVELS) {
+        // Drops straight to the scale predicted to fit the budget
+        f32 fit = hg_resolution_level_scale(resolution->level)
+            * (f32)sqrt(resolution->budget / resolution->average);
+        u32 level = resolution->level + 1;
+        while (level + 1 < HG_DYNAMIC_RESOLUTION_LEVELS && hg_resolution_level_scale(level) > fit) {
+            ++level;
+        }
+
+        if (resolution->raised && resolution->frames_at_level < resolution->raise_delay) {
+            resolution->raise_delay *= 2;
+            if (resolution->raise_delay > HG_RESOLUTION_MAX_RAISE_DELAY)
+                resolution->raise_delay = HG_RESOLUTION_MAX_RAISE_DELAY;
+        }
+        hg_resolution_change(resolution, level);
+    } else if (resolution->average < resolution->budget * HG_RESOLUTION_HEADROOM
+     && resolution->frames_at_level >= resolution->raise_delay
+     && resolution->level > 0
+     && hg_resolution_predict(resolution, resolution->level - 1) < resolution->budget) {
+        // The last raise held, so the load has likely eased
+        if (resolution->raised && resolution->raise_delay > HG_RESOLUTION_RAISE_DELAY)
+            resolution->raise_delay /= 2;
+        hg_resolution_change(resolution, resolution->level - 1);
+    }
+}
+
+void hg_dynamic_resolution_targets(
+    HgDynamicResolution3D* resolution, HgTexture** target, HgTexture** depth_buffer
+) {
+    HG_ASSERT(resolution != NULL);
+    HG_ASSERT(target != NULL);
+    HG_ASSERT(depth_buffer != NULL);
+
+    f32 scale = hg_resolution_level_scale(resolution->level);
+    u32 width = (u32)fmaxf(roundf((f32)resolution->width * scale), 1.0f);
+    u32 height = (u32)fmaxf(roundf((f32)resolution->height * scale), 1.0f);
+
+    if (resolution->target == NULL) {
+        hg_3d_renderer_target_create(
+            resolution->width, resolution->height, &resolution->target, &resolution->depth_buffer
+        );
+        hg_3d_renderer_target_create(resolution->width, resolution->height, &resolution->output, NULL);
+    }
+    hg_3d_renderer_set_target_size(width, height);
+    hg_3d_renderer_set_render_scale(scale, resolution->output);
+
+    *target = resolution->target;
+    *depth_buffer = resolution->depth_buffer;
+}
+
+f32 hg_dynamic_resolution_scale(const HgDynamicResolution3D* resolution) {
+    HG_ASSERT(resolution != NULL);
+
+    return hg_resolution_level_scale(resolution->level);
+}
@@ -0,0 +1,63 @@
+#ifndef HG_DYNAMIC_RESOLUTION_3D_H
+#define HG_DYNAMIC_RESOLUTION_3D_H
+
+#include "hg_math.h"
+#include "hg_graphics.h"
+
+// Lowers the render resolution when frames run over a time budget, and
+// raises it again when there is headroom, so heavy frames hold the frame rate
+// at the cost of sharpness. Resolutions are quantized to
+// HG_DYNAMIC_RESOLUTION_LEVELS steps between full size and half size. One
+// full size target is created, and lower resolutions draw to its top left
+// corner, which the renderer then stretches over a full size output with
+// bilinear filtering, see hg_3d_renderer_set_render_scale. So changing
+// resolution never reallocates
+#define HG_DYNAMIC_RESOLUTION_LEVELS 5
+
+typedef struct HgDynamicResolution3D {
+    // Full resolution, that of the window
+    u32 width;
+    u32 height;
+    f64 budget;
+    // Index into the levels, 0 being full resolution
+    u32 level;
+    // Exponential moving average of frame time, in seconds
+    f64 average;
+    u32 frames_at_level;
+    // Frames of headroom needed before raising the resolution. Doubles each
+    // time a raise goes over budget, so the level settles instead of
+    // oscillating
+    u32 raise_delay;
+    // Whether the last change was a raise
+    bool raised;
+    bool enabled;
+    // At full resolution, created on first use
+    HgTexture* target;
+    HgTexture* depth_buffer;
+    HgTexture* output;
+} HgDynamicResolution3D;
+
+// budget is the frame time to hold, in seconds. Frame time with vsync snaps
+// to multiples of the refresh interval, so give a budget a little above it,
+// such as 20ms at 60Hz: whole refreshes then read as headroom, and missed
+// ones as over budget
+void hg_dynamic_resolution_init(HgDynamicResolution3D* resolution, u32 width, u32 height, f64 budget);
+void hg_dynamic_resolution_destroy(HgDynamicResolution3D* resolution);
+
+// For window resizes. Destroys every target, to be recreated at the new size
+void hg_dynamic_resolution_resize(HgDynamicResolution3D* resolution, u32 width, u32 height);
+// While disabled, renders at full resolution
+void hg_dynamic_resolution_set_enabled(HgDynamicResolution3D* resolution, bool enabled);
+
+// Feeds the last frame's time, in seconds, and picks this frame's resolution
+void hg_dynamic_resolution_update(HgDynamicResolution3D* resolution, f64 frame_time);
+// This frame's target and depth buffer, and tells the renderer the picked
+// resolution, for it to draw at and select levels of detail for
+void hg_dynamic_resolution_targets(
+    HgDynamicResolution3D* resolution, HgTexture** target, HgTexture** depth_buffer
+);
+
+// The fraction of full width and height rendered this frame
+f32 hg_dynamic_resolution_scale(const HgDynamicResolution3D* resolution);
+
+#endif // HG_DYNAMIC_RESOLUTION_3D_H
@@ -0,0 +1,125 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "file_map_3d.h"
+
+#include <stdio.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HG_FILE_MAP_POSIX
+#endif
+
+// The fallback: one read of the whole file
+static bool hg_file_read(const char* path, HgFileMap3D* file) {
+    FILE* stream = fopen(path, "rb");
+    if (stream == NULL)
+        return false;
+
+    fseek(stream, 0, SEEK_END);
+    long size = ftell(stream);
+    fseek(stream, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(stream);
+        return false;
+    }
+
+    u8* data = hg_heap_alloc(size > 0 ? (usize)size : 1);
+    usize read_size = fread(data, 1, (usize)size, stream);
+    fclose(stream);
+    if (read_size != (usize)size) {
+        hg_heap_free(data);
+        return false;
+    }
+
+    *file = (HgFileMap3D){.data = data, .size = (usize)size, .mapped = false};
+    return true;
+}
+
+bool hg_file_map(const char* path, HgFileMap3D* file) {
+    HG_ASSERT(path != NULL);
+    HG_ASSERT(file != NULL);
+
+    *file = (HgFileMap3D){0};
+
+#if defined(HG_FILE_MAP_POSIX)
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < 0) {
+        close(fd);
+        return false;
+    }
+    // Empty files can't be mapped, and need no memory anyway
+    if (info.st_size == 0) {
+        close(fd);
+        return hg_file_read(path, file);
+    }
+
+    // The mapping holds its own reference to the file
+    void* data = mmap(NULL, (usize)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return hg_file_read(path, file);
+
+    *file = (HgFileMap3D){.data = data, .size = (usize)info.st_size, .mapped = true};
+    return true;
+#elif defined(_WIN32)
+    HANDLE handle = CreateFileA(
+        path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL
+    );
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+        CloseHandle(handle);
+        return hg_file_read(path, file);
+    }
+
+    // The view holds its own reference to the mapping, and it to the file
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if (mapping == NULL)
+        return hg_file_read(path, file);
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == NULL)
+        return hg_file_read(path, file);
+
+    *file = (HgFileMap3D){.data = data, .size = (usize)size.QuadPart, .mapped = true};
+    return true;
+#else
+    return hg_file_read(path, file);
+#endif
+}
+
+void hg_file_unmap(HgFileMap3D* file) {
+    HG_ASSERT(file != NULL);
+
+    if (file->data != NULL) {
+#if defined(HG_FILE_MAP_POSIX)
+        if (file->mapped)
+            munmap((void*)file->data, file->size);
+        else
+            hg_heap_free((void*)file->data);
+#elif defined(_WIN32)
+        if (file->mapped)
+            UnmapViewOfFile(file->data);
+        else
+            hg_heap_free((void*)file->data);
+#else
+        hg_heap_free((void*)file->data);
+#endif
+    }
+    *file = (HgFileMap3D){0};
+}
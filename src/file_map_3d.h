@@ -0,0 +1,19 @@
+#ifndef HG_FILE_MAP_3D_H
+#define HG_FILE_MAP_3D_H
+
+#include "hg_math.h"
+
+// A read only view of a whole file. Mapped into memory where the platform
+// allows, so loading touches only the pages used and copies nothing, and
+// read into a heap copy elsewhere
+typedef struct HgFileMap3D {
+    const u8* data;
+    usize size;
+    bool mapped;
+} HgFileMap3D;
+
+// Returns false, leaving file empty, if the file can't be opened or read
+bool hg_file_map(const char* path, HgFileMap3D* file);
+void hg_file_unmap(HgFileMap3D* file);
+
+#endif // HG_FILE_MAP_3D_H
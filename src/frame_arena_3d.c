@@ -0,0 +1,80 @@
+#include "frame_arena_3d.h"
+
+#define HG_FRAME_ARENA_ALIGNMENT 16
+
+static HgFrameArenaBlock3D* hg_frame_arena_block_create(usize capacity, HgFrameArenaBlock3D* prev) {
+    HgFrameArenaBlock3D* block = hg_heap_alloc(sizeof(HgFrameArenaBlock3D) + capacity);
+    block->prev = prev;
+    block->capacity = capacity;
+    return block;
+}
+
+static void hg_frame_arena_blocks_free(HgFrameArenaBlock3D* block) {
+    while (block != NULL) {
+        HgFrameArenaBlock3D* prev = block->prev;
+        hg_heap_free(block);
+        block = prev;
+    }
+}
+
+void hg_frame_arena_init(HgFrameArena3D* arena, usize capacity) {
+    HG_ASSERT(arena != NULL);
+    HG_ASSERT(capacity > 0);
+
+    *arena = (HgFrameArena3D){
+        .block = hg_frame_arena_block_create(capacity, NULL),
+    };
+}
+
+void hg_frame_arena_destroy(HgFrameArena3D* arena) {
+    HG_ASSERT(arena != NULL);
+
+    hg_frame_arena_blocks_free(arena->block);
+    *arena = (HgFrameArena3D){0};
+}
+
+void* hg_frame_arena_alloc(HgFrameArena3D* arena, usize size) {
+    HG_ASSERT(arena != NULL);
+
+    size = (size + HG_FRAME_ARENA_ALIGNMENT - 1) & ~(usize)(HG_FRAME_ARENA_ALIGNMENT - 1);
+    if (arena->used + size > arena->block->capacity) {
+        usize capacity = 2 * arena->block->capacity;
+        if (capacity < size)
+            capacity = size;
+        arena->block = hg_frame_arena_block_create(capacity, arena->block);
+        arena->used = 0;
+        ++arena->overflows;
+    }
+
+    void* allocation = arena->block->data + arena->used;
+    arena->used += size;
+    arena->frame_bytes += size;
+    return allocation;
+}
+
+void hg_frame_arena_reset(HgFrameArena3D* arena) {
+    HG_ASSERT(arena != NULL);
+
+    if (arena->frame_bytes > arena->high_water)
+        arena->high_water = arena->frame_bytes;
+
+    // One block of the high water mark holds any frame seen so far
+    if (arena->block->prev != NULL) {
+        usize capacity = arena->high_water > arena->block->capacity ? arena->high_water : arena->block->capacity;
+        hg_frame_arena_blocks_free(arena->block);
+        arena->block = hg_frame_arena_block_create(capacity, NULL);
+    }
+    arena->used = 0;
+    arena->frame_bytes = 0;
+    arena->overflows = 0;
+}
+
+void hg_frame_arena_reserve(HgFrameArena3D* arena, usize capacity) {
+    HG_ASSERT(arena != NULL);
+
+    hg_frame_arena_reset(arena);
+    if (capacity > arena->block->capacity) {
+        hg_frame_arena_blocks_free(arena->block);
+        arena->block = hg_frame_arena_block_create(capacity, NULL);
+    }
+}
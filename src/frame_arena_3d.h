@@ -0,0 +1,40 @@
+#ifndef HG_FRAME_ARENA_3D_H
+#define HG_FRAME_ARENA_3D_H
+
+#include "hg_math.h"
+
+// A bump allocator for data that lives until the next reset, typically one
+// frame. Allocations are never moved: when a block fills, another is started
+// and the filled one is kept until the reset, so growing mid-frame copies
+// nothing. The reset then folds every block into one as big as the most the
+// arena has held, so once a scene's high water mark is reached it allocates
+// nothing. Allocations are 16 byte aligned
+typedef struct HgFrameArenaBlock3D {
+    struct HgFrameArenaBlock3D* prev;
+    usize capacity;
+    _Alignas(16) u8 data[];
+} HgFrameArenaBlock3D;
+
+typedef struct HgFrameArena3D {
+    // The block being allocated from, linked to the ones filled before it
+    HgFrameArenaBlock3D* block;
+    usize used;
+    // Bytes allocated since the reset, in every block
+    usize frame_bytes;
+    // The most frame_bytes has been at a reset
+    usize high_water;
+    // Blocks started because the current one was full, since the reset
+    u32 overflows;
+} HgFrameArena3D;
+
+void hg_frame_arena_init(HgFrameArena3D* arena, usize capacity);
+void hg_frame_arena_destroy(HgFrameArena3D* arena);
+
+void* hg_frame_arena_alloc(HgFrameArena3D* arena, usize size);
+// Frees everything allocated since the last reset
+void hg_frame_arena_reset(HgFrameArena3D* arena);
+// Resets, and makes the block at least capacity bytes, to preset the arena
+// from a known high water mark instead of growing into it
+void hg_frame_arena_reserve(HgFrameArena3D* arena, usize capacity);
+
+#endif // HG_FRAME_ARENA_3D_H
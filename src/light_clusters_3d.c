@@ -0,0 +1,196 @@
+#include "light_clusters_3d.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+void hg_light_clusters_init(HgLightClusters3D* clusters) {
+    HG_ASSERT(clusters != NULL);
+
+    *clusters = (HgLightClusters3D){
+        .offsets = hg_heap_alloc(2 * HG_CLUSTER_COUNT * sizeof(u32)),
+    };
+}
+
+void hg_light_clusters_destroy(HgLightClusters3D* clusters) {
+    HG_ASSERT(clusters != NULL);
+
+    hg_heap_free(clusters->offsets);
+    *clusters = (HgLightClusters3D){0};
+}
+
+static u8 hg_cluster_tile(f32 ndc, u32 tile_count) {
+    f32 tile = (ndc * 0.5f + 0.5f) * (f32)tile_count;
+    if (tile < 0.0f)
+        return 0;
+    if (tile > (f32)(tile_count - 1))
+        return (u8)(tile_count - 1);
+    return (u8)tile;
+}
+
+static u8 hg_cluster_slice(f32 depth, f32 near, f32 far) {
+    f32 scale = (f32)HG_CLUSTER_Z / logf(far / near);
+    f32 slice = (logf(depth) - logf(near)) * scale;
+    if (slice < 0.0f)
+        return 0;
+    if (slice > (f32)(HG_CLUSTER_Z - 1))
+        return HG_CLUSTER_Z - 1;
+    return (u8)slice;
+}
+
+static void hg_cluster_light_ranges(
+    const HgMat4* view_matrix,
+    const HgMat4* proj_matrix,
+    f32 near,
+    f32 far,
+    const HgPointLight* lights,
+    u32 light_count,
+    HgLightClusterRange* ranges
+) {
+    f32 proj[4][4];
+    memcpy(proj, proj_matrix, sizeof(proj));
+
+#if defined(__AVX__) || defined(__SSE__) || defined(_M_X64)
+    __m128 view_cols[4];
+    for (u32 c = 0; c < 4; ++c) {
+        view_cols[c] = _mm_loadu_ps((const f32*)view_matrix + 4 * c);
+    }
+#else
+    f32 view[4][4];
+    memcpy(view, view_matrix, sizeof(view));
+#endif
+
+    for (u32 i = 0; i < light_count; ++i) {
+        HgVec4 world = lights[i].position;
+        f32 range = world.w;
+
+        f32 pos[4];
+#if defined(__AVX__) || defined(__SSE__) || defined(_M_X64)
+        __m128 v = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(view_cols[0], _mm_set1_ps(world.x)), _mm_mul_ps(view_cols[1], _mm_set1_ps(world.y))),
+            _mm_add_ps(_mm_mul_ps(view_cols[2], _mm_set1_ps(world.z)), view_cols[3]));
+        _mm_storeu_ps(pos, v);
+#else
+        for (u32 r = 0; r < 4; ++r) {
+            pos[r] = view[0][r] * world.x + view[1][r] * world.y + view[2][r] * world.z + view[3][r];
+        }
+#endif
+
+        HgLightClusterRange* cluster_range = &ranges[i];
+        cluster_range->visible = false;
+
+        f32 z_min = pos[2] - range;
+        f32 z_max = pos[2] + range;
+        if (z_max < near || z_min > far)
+            continue;
+
+        cluster_range->min_z = hg_cluster_slice(fmaxf(z_min, near), near, far);
+        cluster_range->max_z = hg_cluster_slice(fminf(z_max, far), near, far);
+
+        if (z_min <= near) {
+            // The box crosses the near plane and can't be projected, but the
+            // light is close enough to touch most tiles anyway
+            cluster_range->min_x = 0;
+            cluster_range->max_x = HG_CLUSTER_X - 1;
+            cluster_range->min_y = 0;
+            cluster_range->max_y = HG_CLUSTER_Y - 1;
+            cluster_range->visible = true;
+            continue;
+        }
+
+        f32 ndc_min[2] = {FLT_MAX, FLT_MAX};
+        f32 ndc_max[2] = {-FLT_MAX, -FLT_MAX};
+        for (u32 corner = 0; corner < 8; ++corner) {
+            f32 x = pos[0] + (corner & 1 ? range : -range);
+            f32 y = pos[1] + (corner & 2 ? range : -range);
+            f32 z = pos[2] + (corner & 4 ? range : -range);
+            f32 w = proj[0][3] * x + proj[1][3] * y + proj[2][3] * z + proj[3][3];
+            for (u32 axis = 0; axis < 2; ++axis) {
+                f32 ndc = (proj[0][axis] * x + proj[1][axis] * y + proj[2][axis] * z + proj[3][axis]) / w;
+                ndc_min[axis] = fminf(ndc_min[axis], ndc);
+                ndc_max[axis] = fmaxf(ndc_max[axis], ndc);
+            }
+        }
+        if (ndc_max[0] < -1.0f || ndc_min[0] > 1.0f || ndc_max[1] < -1.0f || ndc_min[1] > 1.0f)
+            continue;
+
+        cluster_range->min_x = hg_cluster_tile(ndc_min[0], HG_CLUSTER_X);
+        cluster_range->max_x = hg_cluster_tile(ndc_max[0], HG_CLUSTER_X);
+        cluster_range->min_y = hg_cluster_tile(ndc_min[1], HG_CLUSTER_Y);
+        cluster_range->max_y = hg_cluster_tile(ndc_max[1], HG_CLUSTER_Y);
+        cluster_range->visible = true;
+    }
+}
+
+// Builds the clusters in two passes, counting then filling, so the index
+// list comes out packed with no per cluster allocation
+u32* hg_light_clusters_build(
+    HgLightClusters3D* light_clusters,
+    const HgMat4* view,
+    const HgMat4* proj,
+    f32 near,
+    f32 far,
+    const HgPointLight* lights,
+    u32 light_count,
+    HgFrameArena3D* arena,
+    u32* size
+) {
+    HG_ASSERT(light_clusters != NULL);
+    HG_ASSERT(arena != NULL);
+    HG_ASSERT(size != NULL);
+
+    HgLightClusterRange* ranges = hg_frame_arena_alloc(arena, light_count * sizeof(HgLightClusterRange));
+    hg_cluster_light_ranges(view, proj, near, far, lights, light_count, ranges);
+
+    u32* offsets = light_clusters->offsets;
+    memset(offsets, 0, 2 * HG_CLUSTER_COUNT * sizeof(u32));
+
+    for (u32 i = 0; i < light_count; ++i) {
+        HgLightClusterRange range = ranges[i];
+        if (!range.visible)
+            continue;
+        for (u32 z = range.min_z; z <= range.max_z; ++z) {
+            for (u32 y = range.min_y; y <= range.max_y; ++y) {
+                for (u32 x = range.min_x; x <= range.max_x; ++x) {
+                    ++offsets[2 * ((z * HG_CLUSTER_Y + y) * HG_CLUSTER_X + x) + 1];
+                }
+            }
+        }
+    }
+
+    u32 total = 2 * HG_CLUSTER_COUNT;
+    for (u32 c = 0; c < HG_CLUSTER_COUNT; ++c) {
+        u32 count = offsets[2 * c + 1];
+        offsets[2 * c] = total - 2 * HG_CLUSTER_COUNT;
+        offsets[2 * c + 1] = 0;
+        total += count < HG_CLUSTER_MAX_LIGHTS ? count : HG_CLUSTER_MAX_LIGHTS;
+    }
+
+    u32* clusters = hg_frame_arena_alloc(arena, total * sizeof(u32));
+    memcpy(clusters, offsets, 2 * HG_CLUSTER_COUNT * sizeof(u32));
+    offsets = clusters;
+
+    for (u32 i = 0; i < light_count; ++i) {
+        HgLightClusterRange range = ranges[i];
+        if (!range.visible)
+            continue;
+        for (u32 z = range.min_z; z <= range.max_z; ++z) {
+            for (u32 y = range.min_y; y <= range.max_y; ++y) {
+                for (u32 x = range.min_x; x <= range.max_x; ++x) {
+                    u32* cluster = &offsets[2 * ((z * HG_CLUSTER_Y + y) * HG_CLUSTER_X + x)];
+                    if (cluster[1] < HG_CLUSTER_MAX_LIGHTS) {
+                        clusters[2 * HG_CLUSTER_COUNT + cluster[0] + cluster[1]] = i;
+                        ++cluster[1];
+                    }
+                }
+            }
+        }
+    }
+
+    *size = total;
+    return clusters;
+}
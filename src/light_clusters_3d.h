@@ -0,0 +1,55 @@
+#ifndef HG_LIGHT_CLUSTERS_3D_H
+#define HG_LIGHT_CLUSTERS_3D_H
+
+#include "hg_math.h"
+#include "frame_arena_3d.h"
+
+// Point lights are binned into a froxel grid over the view frustum: tiles in
+// NDC x and y, exponential slices in view depth. Must match model.frag
+#define HG_CLUSTER_X 16
+#define HG_CLUSTER_Y 9
+#define HG_CLUSTER_Z 24
+#define HG_CLUSTER_COUNT (HG_CLUSTER_X * HG_CLUSTER_Y * HG_CLUSTER_Z)
+#define HG_CLUSTER_MAX_LIGHTS 128
+
+// position.w holds the range. Matches std430 layout
+typedef struct HgPointLight {
+    HgVec4 position;
+    HgVec4 color;
+} HgPointLight;
+
+// The block of clusters touched by the view space bounding box of a point
+// light's sphere of influence
+typedef struct HgLightClusterRange {
+    u8 min_x, max_x;
+    u8 min_y, max_y;
+    u8 min_z, max_z;
+    bool visible;
+} HgLightClusterRange;
+
+typedef struct HgLightClusters3D {
+    // The offset and count pairs while counting, before the indices' total
+    // is known and the arena's copy can be allocated
+    u32* offsets;
+} HgLightClusters3D;
+
+void hg_light_clusters_init(HgLightClusters3D* clusters);
+void hg_light_clusters_destroy(HgLightClusters3D* clusters);
+
+// Bins the lights into clusters allocated from arena, along with a range per
+// light, and returns them, with their size in u32s in size. They are an
+// offset and count pair for each cluster, followed by the light indices;
+// offsets are relative to the start of the indices
+u32* hg_light_clusters_build(
+    HgLightClusters3D* light_clusters,
+    const HgMat4* view,
+    const HgMat4* proj,
+    f32 near,
+    f32 far,
+    const HgPointLight* lights,
+    u32 light_count,
+    HgFrameArena3D* arena,
+    u32* size
+);
+
+#endif // HG_LIGHT_CLUSTERS_3D_H
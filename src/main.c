@@ -1,13 +1,26 @@
 #include "hurdygurdy.h"
 
 #include "renderer_3d.h"
+#include "profiler_3d.h"
+#include "dynamic_resolution_3d.h"
 
 #define MOUSE_SPEED 0.003f
 #define MOVE_SPEED 1.5f
+// A little over a 60Hz refresh, see hg_dynamic_resolution_init
+#define FRAME_BUDGET 0.020
 
 int main(void) {
+    // Startup is timed by step, and logged with the first frame, which
+    // creates the shaders it draws with
+    HgClock startup_clock;
+    (void)hg_clock_tick(&startup_clock);
+    f64 startup_ms[4];
+    bool startup_logged = false;
+
     hg_init();
+    startup_ms[0] = hg_clock_tick(&startup_clock) * 1.0e3;
     hg_3d_renderer_init();
+    startup_ms[1] = hg_clock_tick(&startup_clock) * 1.0e3;
 
     hg_window_open(&(HgWindowConfig){
         .title = "Hurdy Gurdy",
@@ -15,13 +28,14 @@ int main(void) {
         // .height = 600,
         // .windowed = true,
     });
+    startup_ms[2] = hg_clock_tick(&startup_clock) * 1.0e3;
 
     u32 window_width, window_height;
     hg_window_get_size(&window_width, &window_height);
 
-    HgTexture* target;
-    HgTexture* depth_buffer;
-    hg_3d_renderer_target_create(window_width, window_height, &target, &depth_buffer);
+    HgDynamicResolution3D resolution;
+    hg_dynamic_resolution_init(&resolution, window_width, window_height, FRAME_BUDGET);
+    bool dynamic_resolution = true;
 
     f32 camera_fov = (f32)HG_PI / 3.0f;
     hg_3d_renderer_update_projection(camera_fov, (f32)window_width / (f32)window_height, 0.1f, 100.0f);
@@ -52,7 +66,8 @@ int main(void) {
         .tangent = {1.0f, 0.0f, 0.0f, 1.0f},
         .uv = {1.0f, 0.0f},
     }};
-    HgBuffer* vertex_buffer = hg_3d_vertex_buffer_create(vertices, HG_ARRAY_SIZE(vertices));
+    HgBounds3D bounds;
+    HgBuffer* vertex_buffer = hg_3d_vertex_buffer_create(vertices, HG_ARRAY_SIZE(vertices), &bounds);
 
     const u32 indices[] = {
         0, 1, 2, 2, 3, 0,
@@ -65,21 +80,36 @@ int main(void) {
         0xff0000ff,
         0xff00ffff,
     };
-    HgTexture* texture = hg_3d_texture_map_create(texture_data, 2, 2, HG_FORMAT_R8G8B8A8_UNORM, false);
+    HgTexture* texture = hg_3d_texture_map_create(
+        texture_data, 2, 2, HG_FORMAT_R8G8B8A8_UNORM, HG_TEXTURE_COMPRESSION_3D_NONE, 0
+    );
 
     HgClock game_clock;
     (void)hg_clock_tick(&game_clock);
     f64 time_elapsed = 0.0;
     u64 frame_count = 0;
 
+    bool depth_prepass = false;
+    bool occlusion_culling = false;
+    // Latency mode draws each frame start to finish before the next, instead
+    // of building the next one while the render thread submits it
+    bool pipelined = true;
+    hg_3d_renderer_set_pipelined(pipelined);
+
     bool running = true;
     while (running) {
         f64 delta = hg_clock_tick(&game_clock);
         time_elapsed += delta;
         ++frame_count;
         if (time_elapsed > 1.0) {
-            HG_LOGF("avg: %fms, fps: %" PRIu64, 1.0e3 / (f64)frame_count, frame_count);
-            time_elapsed -= 1.0;
+            HgProfilerSummary frame;
+            if (hg_profiler_summary("frame", &frame)) {
+                HG_LOGF("avg: %fms, p50: %fms, p99: %fms, fps: %" PRIu64,
+                    1.0e3 * time_elapsed / (f64)frame_count, frame.p50, frame.p99, frame_count);
+            } else {
+                HG_LOGF("avg: %fms, fps: %" PRIu64, 1.0e3 * time_elapsed / (f64)frame_count, frame_count);
+            }
+            time_elapsed = 0.0;
             frame_count = 0;
         }
 
@@ -90,13 +120,42 @@ int main(void) {
             continue;
         }
 
+        if (hg_was_key_pressed(HG_KEY_P)) {
+            depth_prepass = !depth_prepass;
+            hg_3d_renderer_set_depth_prepass(depth_prepass);
+            HG_LOGF("depth pre-pass %s", depth_prepass ? "on" : "off");
+        }
+
+        if (hg_was_key_pressed(HG_KEY_O)) {
+            occlusion_culling = !occlusion_culling;
+            hg_3d_renderer_set_occlusion_culling(occlusion_culling);
+            HG_LOGF("occlusion culling %s", occlusion_culling ? "on" : "off");
+        }
+
+        if (hg_was_key_pressed(HG_KEY_L)) {
+            pipelined = !pipelined;
+            hg_3d_renderer_set_pipelined(pipelined);
+            HG_LOGF("latency mode %s", pipelined ? "off" : "on");
+        }
+
+        if (hg_was_key_pressed(HG_KEY_T))
+            hg_profiler_capture("trace.json", 120);
+
+        if (hg_was_key_pressed(HG_KEY_M))
+            hg_3d_renderer_log_memory();
+
+        if (hg_was_key_pressed(HG_KEY_R)) {
+            dynamic_resolution = !dynamic_resolution;
+            hg_dynamic_resolution_set_enabled(&resolution, dynamic_resolution);
+            HG_LOGF("dynamic resolution %s", dynamic_resolution ? "on" : "off");
+        }
+
         if (hg_was_window_resized()) {
+            hg_3d_renderer_wait();
             hg_window_update_size();
             hg_window_get_size(&window_width, &window_height);
 
-            hg_texture_destroy(target);
-            hg_texture_destroy(depth_buffer);
-            hg_3d_renderer_target_create(window_width, window_height, &target, &depth_buffer);
+            hg_dynamic_resolution_resize(&resolution, window_width, window_height);
 
             f32 aspect = (f32)window_width / (f32)window_height;
             hg_3d_renderer_update_projection(camera_fov, aspect, 0.1f, 100.0f);
@@ -150,11 +209,10 @@ int main(void) {
 
         hg_3d_renderer_update_view(camera_position, camera_zoom, camera_rotation);
 
-        HgError begin_result = hg_frame_begin();
-        if (begin_result != HG_SUCCESS) {
-            HG_DEBUG("Failed to begin frame");
-            continue;
-        }
+        hg_dynamic_resolution_update(&resolution, delta);
+        HgTexture* target;
+        HgTexture* depth_buffer;
+        hg_dynamic_resolution_targets(&resolution, &target, &depth_buffer);
 
         static f32 time = 0.0f;
         time += (f32)delta * 2.0f;
@@ -162,13 +220,15 @@ int main(void) {
             time -= (f32)HG_TAU;
         }
         hg_3d_renderer_queue_directional_light((HgVec3){1.0f, 1.0f, 1.0f}, (HgVec3){1.0f, 0.3f, 0.1f}, 0.5f);
-        hg_3d_renderer_queue_point_light((HgVec3){cosf(time) * 3.0f, -1.0f, -sinf(time)}, (HgVec3){1.0f, 1.0f, 1.0f}, 5.0f);
+        hg_3d_renderer_queue_point_light((HgVec3){cosf(time) * 3.0f, -1.0f, -sinf(time)}, (HgVec3){1.0f, 1.0f, 1.0f}, 5.0f, 10.0f);
 
         HgModel3D model = {
             .vertex_buffer = vertex_buffer,
             .index_buffer = index_buffer,
             .color_map = texture,
             .normal_map = NULL,
+            .bounds = bounds,
+            .index_count = HG_ARRAY_SIZE(indices),
         };
 
         hg_3d_renderer_queue_model(&model, &(HgTransform3D){
@@ -182,23 +242,32 @@ int main(void) {
             .rotation = (HgQuat){1.0f, 0.0f, 0.0f, 0.0f},
         });
 
-        hg_3d_renderer_draw(target, depth_buffer);
-
-        HgError end_result = hg_frame_end(target);
-        if (end_result != HG_SUCCESS) {
-            HG_DEBUG("Failed to end frame");
+        HgError frame_result = hg_3d_renderer_frame(target, depth_buffer);
+        if (frame_result != HG_SUCCESS) {
+            HG_DEBUG("Failed to draw frame");
             continue;
         }
+
+        if (!startup_logged) {
+            // The first frame's submission counts, so wait for it
+            hg_3d_renderer_wait();
+            startup_ms[3] = hg_clock_tick(&startup_clock) * 1.0e3;
+            HgRenderer3DStats stats;
+            hg_3d_renderer_get_stats(&stats);
+            HG_LOGF("startup: init %fms, renderer %fms, window %fms, scene and first frame %fms (%u shaders)",
+                startup_ms[0], startup_ms[1], startup_ms[2], startup_ms[3], stats.shaders_created);
+            startup_logged = true;
+        }
     }
 
 #if !defined(NDEBUG)
+    hg_3d_renderer_wait();
     hg_graphics_wait();
 
-    hg_buffer_destroy(index_buffer);
-    hg_buffer_destroy(vertex_buffer);
-    hg_texture_destroy(texture);
-    hg_texture_destroy(depth_buffer);
-    hg_texture_destroy(target);
+    hg_3d_buffer_destroy(index_buffer);
+    hg_3d_buffer_destroy(vertex_buffer);
+    hg_3d_texture_destroy(texture);
+    hg_dynamic_resolution_destroy(&resolution);
 
     hg_window_close();
     hg_3d_renderer_shutdown();
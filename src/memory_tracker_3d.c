@@ -0,0 +1,190 @@
+#include "memory_tracker_3d.h"
+#include "profiler_3d.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+void hg_memory_tracker_init(HgMemoryTracker3D* tracker) {
+    HG_ASSERT(tracker != NULL);
+
+    *tracker = (HgMemoryTracker3D){
+        .allocation_capacity = 256,
+    };
+    tracker->allocations = hg_heap_alloc(tracker->allocation_capacity * sizeof(HgGpuAllocation3D));
+    mtx_init(&tracker->mutex, mtx_plain);
+}
+
+void hg_memory_tracker_destroy(HgMemoryTracker3D* tracker) {
+    HG_ASSERT(tracker != NULL);
+
+    if (tracker->allocation_count > 0) {
+        HG_LOGF("%u GPU resources were never destroyed", tracker->allocation_count);
+        hg_memory_log(tracker);
+    }
+    hg_heap_free(tracker->allocations);
+    mtx_destroy(&tracker->mutex);
+    *tracker = (HgMemoryTracker3D){0};
+}
+
+static u32 hg_gpu_allocation_find(const HgMemoryTracker3D* tracker, const void* resource) {
+    u32 lo = 0;
+    u32 hi = tracker->allocation_count;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if ((uintptr_t)tracker->allocations[mid].resource < (uintptr_t)resource)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+void hg_memory_track(
+    HgMemoryTracker3D* tracker, const void* resource, usize size, HgMemoryCategory3D category, const char* name,
+    u64 frame
+) {
+    HG_ASSERT(tracker != NULL);
+
+    mtx_lock(&tracker->mutex);
+    if (tracker->allocation_count >= tracker->allocation_capacity) {
+        tracker->allocation_capacity *= 2;
+        tracker->allocations = hg_heap_realloc(
+            tracker->allocations, tracker->allocation_capacity * sizeof(HgGpuAllocation3D));
+    }
+    u32 index = hg_gpu_allocation_find(tracker, resource);
+    memmove(&tracker->allocations[index + 1], &tracker->allocations[index],
+        (tracker->allocation_count - index) * sizeof(HgGpuAllocation3D));
+    tracker->allocations[index] = (HgGpuAllocation3D){
+        .resource = resource,
+        .name = name,
+        .size = size,
+        .frame = frame,
+        .category = category,
+    };
+    ++tracker->allocation_count;
+
+    HgMemoryStats3D* stats = &tracker->stats;
+    stats->bytes[category] += size;
+    ++stats->resources[category];
+    stats->total_bytes += size;
+    if (stats->bytes[category] > stats->peak_bytes[category])
+        stats->peak_bytes[category] = stats->bytes[category];
+    if (stats->total_bytes > stats->peak_total_bytes)
+        stats->peak_total_bytes = stats->total_bytes;
+    ++tracker->frame_allocations;
+    tracker->frame_allocated_bytes += size;
+    mtx_unlock(&tracker->mutex);
+}
+
+void hg_memory_untrack(HgMemoryTracker3D* tracker, const void* resource) {
+    HG_ASSERT(tracker != NULL);
+
+    mtx_lock(&tracker->mutex);
+    u32 index = hg_gpu_allocation_find(tracker, resource);
+    if (index < tracker->allocation_count && tracker->allocations[index].resource == resource) {
+        HgGpuAllocation3D allocation = tracker->allocations[index];
+        memmove(&tracker->allocations[index], &tracker->allocations[index + 1],
+            (tracker->allocation_count - index - 1) * sizeof(HgGpuAllocation3D));
+        --tracker->allocation_count;
+
+        HgMemoryStats3D* stats = &tracker->stats;
+        stats->bytes[allocation.category] -= allocation.size;
+        --stats->resources[allocation.category];
+        stats->total_bytes -= allocation.size;
+        ++tracker->frame_frees;
+        tracker->frame_freed_bytes += allocation.size;
+    }
+    mtx_unlock(&tracker->mutex);
+}
+
+void hg_memory_frame(HgMemoryTracker3D* tracker) {
+    HG_ASSERT(tracker != NULL);
+
+    mtx_lock(&tracker->mutex);
+    HgMemoryStats3D* stats = &tracker->stats;
+    stats->frame_allocations = tracker->frame_allocations;
+    stats->frame_frees = tracker->frame_frees;
+    stats->frame_allocated_bytes = tracker->frame_allocated_bytes;
+    stats->frame_freed_bytes = tracker->frame_freed_bytes;
+    tracker->frame_allocations = 0;
+    tracker->frame_frees = 0;
+    tracker->frame_allocated_bytes = 0;
+    tracker->frame_freed_bytes = 0;
+    usize total = stats->total_bytes;
+    usize budget = stats->budget;
+    mtx_unlock(&tracker->mutex);
+
+    hg_profiler_counter("gpu memory", (f64)total);
+
+    if (budget == 0 || total <= budget) {
+        tracker->over_budget = false;
+        return;
+    }
+    // The callback destroys resources, which takes the mutex
+    if (tracker->evict != NULL) {
+        tracker->evict(total - budget, tracker->evict_data);
+    } else if (!tracker->over_budget) {
+        HG_LOGF("GPU memory over budget: %zu bytes against %zu", total, budget);
+    }
+    tracker->over_budget = true;
+}
+
+void hg_memory_set_budget(HgMemoryTracker3D* tracker, usize budget, HgMemoryEvictCallback3D evict, void* user_data) {
+    HG_ASSERT(tracker != NULL);
+
+    mtx_lock(&tracker->mutex);
+    tracker->stats.budget = budget;
+    mtx_unlock(&tracker->mutex);
+    tracker->evict = evict;
+    tracker->evict_data = user_data;
+    tracker->over_budget = false;
+}
+
+void hg_memory_get_stats(HgMemoryTracker3D* tracker, HgMemoryStats3D* stats) {
+    HG_ASSERT(tracker != NULL);
+    HG_ASSERT(stats != NULL);
+
+    mtx_lock(&tracker->mutex);
+    *stats = tracker->stats;
+    mtx_unlock(&tracker->mutex);
+}
+
+static const char* const s_memory_category_names[HG_MEMORY_CATEGORY_3D_COUNT] = {
+    [HG_MEMORY_CATEGORY_3D_MESH] = "mesh",
+    [HG_MEMORY_CATEGORY_3D_TEXTURE] = "texture",
+    [HG_MEMORY_CATEGORY_3D_FRAME] = "frame",
+    [HG_MEMORY_CATEGORY_3D_TARGET] = "target",
+};
+
+static int hg_gpu_allocation_size_compare(const void* lhs, const void* rhs) {
+    usize a = ((const HgGpuAllocation3D*)lhs)->size;
+    usize b = ((const HgGpuAllocation3D*)rhs)->size;
+    return a > b ? -1 : a < b;
+}
+
+void hg_memory_log(HgMemoryTracker3D* tracker) {
+    HG_ASSERT(tracker != NULL);
+
+    mtx_lock(&tracker->mutex);
+    u32 count = tracker->allocation_count;
+    HgGpuAllocation3D* allocations = hg_heap_alloc((count + 1) * sizeof(HgGpuAllocation3D));
+    memcpy(allocations, tracker->allocations, count * sizeof(HgGpuAllocation3D));
+    HgMemoryStats3D memory = tracker->stats;
+    mtx_unlock(&tracker->mutex);
+
+    HG_LOGF("GPU memory: %u resources, %zu bytes, peak %zu", count, memory.total_bytes, memory.peak_total_bytes);
+    for (u32 category = 0; category < HG_MEMORY_CATEGORY_3D_COUNT; ++category) {
+        HG_LOGF("  %s: %u resources, %zu bytes, peak %zu", s_memory_category_names[category],
+            memory.resources[category], memory.bytes[category], memory.peak_bytes[category]);
+    }
+
+    qsort(allocations, count, sizeof(HgGpuAllocation3D), hg_gpu_allocation_size_compare);
+    for (u32 i = 0; i < count; ++i) {
+        HG_LOGF("  %p %s (%s): %zu bytes, created in frame %" PRIu64, allocations[i].resource,
+            allocations[i].name, s_memory_category_names[allocations[i].category], allocations[i].size,
+            allocations[i].frame);
+    }
+    hg_heap_free(allocations);
+}
@@ -0,0 +1,57 @@
+#ifndef HG_MEMORY_TRACKER_3D_H
+#define HG_MEMORY_TRACKER_3D_H
+
+#include "renderer_3d.h"
+
+#include <threads.h>
+
+// Every GPU resource the renderer created and hasn't destroyed, for the
+// memory accounting and the leak report. Per frame buffers also grow and are
+// destroyed on the render thread, so the tracker is behind its own mutex
+typedef struct HgGpuAllocation3D {
+    const void* resource;
+    const char* name;
+    usize size;
+    u64 frame;
+    HgMemoryCategory3D category;
+} HgGpuAllocation3D;
+
+typedef struct HgMemoryTracker3D {
+    mtx_t mutex;
+    // Sorted by resource address
+    HgGpuAllocation3D* allocations;
+    u32 allocation_count;
+    u32 allocation_capacity;
+    HgMemoryStats3D stats;
+    // Churn of the frame in progress, moved into stats as it ends
+    u32 frame_allocations;
+    u32 frame_frees;
+    usize frame_allocated_bytes;
+    usize frame_freed_bytes;
+    HgMemoryEvictCallback3D evict;
+    void* evict_data;
+    bool over_budget;
+} HgMemoryTracker3D;
+
+void hg_memory_tracker_init(HgMemoryTracker3D* tracker);
+// Logs whatever is still tracked as leaked
+void hg_memory_tracker_destroy(HgMemoryTracker3D* tracker);
+
+// Labels the allocation with the frame it was made in
+void hg_memory_track(
+    HgMemoryTracker3D* tracker, const void* resource, usize size, HgMemoryCategory3D category, const char* name,
+    u64 frame
+);
+// Resources that were never tracked are ignored
+void hg_memory_untrack(HgMemoryTracker3D* tracker, const void* resource);
+
+// Ends the frame's churn, and asks the app to evict if over budget. Called
+// at the start of each frame, on the renderer's thread
+void hg_memory_frame(HgMemoryTracker3D* tracker);
+
+void hg_memory_set_budget(HgMemoryTracker3D* tracker, usize budget, HgMemoryEvictCallback3D evict, void* user_data);
+void hg_memory_get_stats(HgMemoryTracker3D* tracker, HgMemoryStats3D* stats);
+// Logs the totals per category, then every allocation, largest first
+void hg_memory_log(HgMemoryTracker3D* tracker);
+
+#endif // HG_MEMORY_TRACKER_3D_H
@@ -0,0 +1,627 @@
+#include "mesh_3d.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+HgBounds3D hg_mesh_bounds(const HgVertex3D* vertices, u32 vertex_count) {
+    HG_ASSERT(vertices != NULL);
+    HG_ASSERT(vertex_count > 0);
+
+    HgVec3 min = vertices[0].position;
+    HgVec3 max = vertices[0].position;
+    for (u32 i = 1; i < vertex_count; ++i) {
+        HgVec3 p = vertices[i].position;
+        min = (HgVec3){fminf(min.x, p.x), fminf(min.y, p.y), fminf(min.z, p.z)};
+        max = (HgVec3){fmaxf(max.x, p.x), fmaxf(max.y, p.y), fmaxf(max.z, p.z)};
+    }
+    HgVec3 center = {(min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f};
+
+    f32 radius_sq = 0.0f;
+    for (u32 i = 0; i < vertex_count; ++i) {
+        HgVec3 d = {
+            vertices[i].position.x - center.x,
+            vertices[i].position.y - center.y,
+            vertices[i].position.z - center.z,
+        };
+        radius_sq = fmaxf(radius_sq, d.x * d.x + d.y * d.y + d.z * d.z);
+    }
+
+    // A flat mesh would otherwise get a zero radius, which means unbounded
+    return (HgBounds3D){.center = center, .radius = fmaxf(sqrtf(radius_sq), FLT_EPSILON)};
+}
+
+f32 hg_mesh_acmr(const u32* indices, u32 index_count, u32 vertex_count, u32 cache_size) {
+    HG_ASSERT(indices != NULL);
+    HG_ASSERT(cache_size > 0);
+
+    if (index_count < 3)
+        return 0.0f;
+
+    // A vertex is still cached if fewer than cache_size misses came after its own
+    u32* cached_at = hg_heap_alloc(vertex_count * sizeof(u32));
+    for (u32 i = 0; i < vertex_count; ++i) {
+        cached_at[i] = HG_MESH_NO_INDEX;
+    }
+
+    u32 misses = 0;
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 v = indices[i];
+        if (cached_at[v] == HG_MESH_NO_INDEX || misses - cached_at[v] >= cache_size) {
+            cached_at[v] = misses;
+            ++misses;
+        }
+    }
+
+    hg_heap_free(cached_at);
+    return (f32)misses / (f32)(index_count / 3);
+}
+
+// Forsyth's scoring tables assume this many cache entries
+#define HG_MESH_FORSYTH_CACHE_SIZE 32
+
+static f32 hg_forsyth_vertex_score(i32 cache_position, u32 remaining) {
+    if (remaining == 0)
+        return -1.0f;
+
+    f32 score = 0.0f;
+    if (cache_position >= 0) {
+        // The last triangle's vertices get a fixed score, so the next
+        // triangle doesn't just reuse the same edge
+        if (cache_position < 3) {
+            score = 0.75f;
+        } else {
+            f32 scale = 1.0f / (f32)(HG_MESH_FORSYTH_CACHE_SIZE - 3);
+            score = powf(1.0f - (f32)(cache_position - 3) * scale, 1.5f);
+        }
+    }
+
+    // Favour vertices with few triangles left, to finish them off
+    return score + 2.0f / sqrtf((f32)remaining);
+}
+
+void hg_mesh_optimize_vertex_cache(u32* indices, u32 index_count, u32 vertex_count) {
+    HG_ASSERT(indices != NULL);
+    HG_ASSERT(index_count % 3 == 0);
+
+    u32 triangle_count = index_count / 3;
+    if (triangle_count == 0)
+        return;
+
+    u32* remaining = hg_heap_alloc(vertex_count * sizeof(u32));
+    u32* adjacency_offsets = hg_heap_alloc(vertex_count * sizeof(u32));
+    u32* adjacency = hg_heap_alloc(index_count * sizeof(u32));
+    i32* cache_positions = hg_heap_alloc(vertex_count * sizeof(i32));
+    f32* vertex_scores = hg_heap_alloc(vertex_count * sizeof(f32));
+    f32* triangle_scores = hg_heap_alloc(triangle_count * sizeof(f32));
+    bool* emitted = hg_heap_alloc(triangle_count * sizeof(bool));
+    u32* output = hg_heap_alloc(index_count * sizeof(u32));
+
+    memset(remaining, 0, vertex_count * sizeof(u32));
+    for (u32 i = 0; i < index_count; ++i) {
+        ++remaining[indices[i]];
+    }
+    u32 offset = 0;
+    for (u32 v = 0; v < vertex_count; ++v) {
+        adjacency_offsets[v] = offset;
+        offset += remaining[v];
+        remaining[v] = 0;
+    }
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 v = indices[i];
+        adjacency[adjacency_offsets[v] + remaining[v]] = i / 3;
+        ++remaining[v];
+    }
+
+    for (u32 v = 0; v < vertex_count; ++v) {
+        cache_positions[v] = -1;
+        vertex_scores[v] = hg_forsyth_vertex_score(-1, remaining[v]);
+    }
+
+    u32 best = 0;
+    for (u32 t = 0; t < triangle_count; ++t) {
+        emitted[t] = false;
+        triangle_scores[t] = vertex_scores[indices[3 * t]]
+                           + vertex_scores[indices[3 * t + 1]]
+                           + vertex_scores[indices[3 * t + 2]];
+        if (triangle_scores[t] > triangle_scores[best])
+            best = t;
+    }
+
+    u32 cache[HG_MESH_FORSYTH_CACHE_SIZE];
+    u32 cache_count = 0;
+    u32 scan_cursor = 0;
+
+    for (u32 out = 0; out < triangle_count; ++out) {
+        if (best == HG_MESH_NO_INDEX) {
+            // Nothing in the cache touches a remaining triangle, so restart
+            // from the first one left
+            while (emitted[scan_cursor]) {
+                ++scan_cursor;
+            }
+            best = scan_cursor;
+        }
+
+        emitted[best] = true;
+        const u32* triangle = &indices[3 * best];
+        memcpy(&output[3 * out], triangle, 3 * sizeof(u32));
+
+        for (u32 k = 0; k < 3; ++k) {
+            u32 v = triangle[k];
+            u32* list = &adjacency[adjacency_offsets[v]];
+            for (u32 j = 0; j < remaining[v]; ++j) {
+                if (list[j] == best) {
+                    list[j] = list[remaining[v] - 1];
+                    break;
+                }
+            }
+            --remaining[v];
+        }
+
+        // The triangle's vertices move to the front; anything pushed past
+        // the end of the cache falls out
+        u32 next_cache[HG_MESH_FORSYTH_CACHE_SIZE + 3];
+        u32 next_count = 0;
+        for (u32 k = 0; k < 3; ++k) {
+            bool duplicate = false;
+            for (u32 j = 0; j < next_count; ++j) {
+                duplicate = duplicate || next_cache[j] == triangle[k];
+            }
+            if (!duplicate)
+                next_cache[next_count++] = triangle[k];
+        }
+        for (u32 i = 0; i < cache_count; ++i) {
+            u32 v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                next_cache[next_count++] = v;
+        }
+
+        for (u32 i = 0; i < next_count; ++i) {
+            u32 v = next_cache[i];
+            cache_positions[v] = i < HG_MESH_FORSYTH_CACHE_SIZE ? (i32)i : -1;
+            vertex_scores[v] = hg_forsyth_vertex_score(cache_positions[v], remaining[v]);
+        }
+        cache_count = next_count < HG_MESH_FORSYTH_CACHE_SIZE ? next_count : HG_MESH_FORSYTH_CACHE_SIZE;
+        memcpy(cache, next_cache, cache_count * sizeof(u32));
+
+        // Only triangles touching vertices whose scores changed can become
+        // the new best, so the search stays local to the cache
+        best = HG_MESH_NO_INDEX;
+        f32 best_score = -1.0f;
+        for (u32 i = 0; i < next_count; ++i) {
+            u32 v = next_cache[i];
+            const u32* list = &adjacency[adjacency_offsets[v]];
+            for (u32 j = 0; j < remaining[v]; ++j) {
+                u32 t = list[j];
+                triangle_scores[t] = vertex_scores[indices[3 * t]]
+                                   + vertex_scores[indices[3 * t + 1]]
+                                   + vertex_scores[indices[3 * t + 2]];
+                if (triangle_scores[t] > best_score) {
+                    best_score = triangle_scores[t];
+                    best = t;
+                }
+            }
+        }
+    }
+
+    memcpy(indices, output, index_count * sizeof(u32));
+
+    hg_heap_free(output);
+    hg_heap_free(emitted);
+    hg_heap_free(triangle_scores);
+    hg_heap_free(vertex_scores);
+    hg_heap_free(cache_positions);
+    hg_heap_free(adjacency);
+    hg_heap_free(adjacency_offsets);
+    hg_heap_free(remaining);
+}
+
+typedef struct HgMeshCluster {
+    f32 sort_key;
+    u32 begin;
+    u32 end;
+} HgMeshCluster;
+
+static int hg_mesh_cluster_compare(const void* lhs, const void* rhs) {
+    const HgMeshCluster* a = lhs;
+    const HgMeshCluster* b = rhs;
+    if (a->sort_key != b->sort_key)
+        return a->sort_key > b->sort_key ? -1 : 1;
+    return a->begin < b->begin ? -1 : 1;
+}
+
+void hg_mesh_optimize_overdraw(
+    u32* indices, u32 index_count, const HgVertex3D* vertices, u32 vertex_count, u32 cache_size
+) {
+    HG_ASSERT(indices != NULL);
+    HG_ASSERT(vertices != NULL);
+    HG_ASSERT(index_count % 3 == 0);
+
+    u32 triangle_count = index_count / 3;
+    if (triangle_count == 0)
+        return;
+
+    // A triangle that misses on all three vertices starts from a cold cache,
+    // so reordering at those points costs no extra transforms
+    HgMeshCluster* clusters = hg_heap_alloc(triangle_count * sizeof(HgMeshCluster));
+    u32 cluster_count = 0;
+
+    u32* cached_at = hg_heap_alloc(vertex_count * sizeof(u32));
+    for (u32 i = 0; i < vertex_count; ++i) {
+        cached_at[i] = HG_MESH_NO_INDEX;
+    }
+    u32 misses = 0;
+    for (u32 t = 0; t < triangle_count; ++t) {
+        u32 triangle_misses = 0;
+        for (u32 k = 0; k < 3; ++k) {
+            u32 v = indices[3 * t + k];
+            if (cached_at[v] == HG_MESH_NO_INDEX || misses - cached_at[v] >= cache_size) {
+                cached_at[v] = misses;
+                ++misses;
+                ++triangle_misses;
+            }
+        }
+        if (t == 0 || triangle_misses == 3) {
+            if (cluster_count > 0)
+                clusters[cluster_count - 1].end = 3 * t;
+            clusters[cluster_count++] = (HgMeshCluster){.begin = 3 * t};
+        }
+    }
+    clusters[cluster_count - 1].end = index_count;
+    hg_heap_free(cached_at);
+
+    HgVec3* centroids = hg_heap_alloc(cluster_count * sizeof(HgVec3));
+    HgVec3* normals = hg_heap_alloc(cluster_count * sizeof(HgVec3));
+    HgVec3 mesh_center = {0.0f, 0.0f, 0.0f};
+    f32 mesh_area = 0.0f;
+    for (u32 c = 0; c < cluster_count; ++c) {
+        HgVec3 center = {0.0f, 0.0f, 0.0f};
+        HgVec3 normal = {0.0f, 0.0f, 0.0f};
+        f32 area = 0.0f;
+        for (u32 i = clusters[c].begin; i < clusters[c].end; i += 3) {
+            HgVec3 p0 = vertices[indices[i]].position;
+            HgVec3 p1 = vertices[indices[i + 1]].position;
+            HgVec3 p2 = vertices[indices[i + 2]].position;
+            HgVec3 e0 = {p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
+            HgVec3 e1 = {p2.x - p0.x, p2.y - p0.y, p2.z - p0.z};
+            HgVec3 cross = {e0.y * e1.z - e0.z * e1.y, e0.z * e1.x - e0.x * e1.z, e0.x * e1.y - e0.y * e1.x};
+            f32 triangle_area = sqrtf(cross.x * cross.x + cross.y * cross.y + cross.z * cross.z);
+
+            center.x += (p0.x + p1.x + p2.x) * triangle_area;
+            center.y += (p0.y + p1.y + p2.y) * triangle_area;
+            center.z += (p0.z + p1.z + p2.z) * triangle_area;
+            normal.x += cross.x;
+            normal.y += cross.y;
+            normal.z += cross.z;
+            area += triangle_area;
+        }
+
+        mesh_center.x += center.x;
+        mesh_center.y += center.y;
+        mesh_center.z += center.z;
+        mesh_area += area;
+
+        f32 inv_area = area > 0.0f ? 1.0f / (3.0f * area) : 0.0f;
+        centroids[c] = (HgVec3){center.x * inv_area, center.y * inv_area, center.z * inv_area};
+        f32 length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        f32 inv_length = length > 0.0f ? 1.0f / length : 0.0f;
+        normals[c] = (HgVec3){normal.x * inv_length, normal.y * inv_length, normal.z * inv_length};
+    }
+
+    f32 inv_mesh_area = mesh_area > 0.0f ? 1.0f / (3.0f * mesh_area) : 0.0f;
+    mesh_center.x *= inv_mesh_area;
+    mesh_center.y *= inv_mesh_area;
+    mesh_center.z *= inv_mesh_area;
+
+    // Clusters facing away from the mesh center are on the outside, and
+    // are the most likely to occlude the rest from any view
+    for (u32 c = 0; c < cluster_count; ++c) {
+        clusters[c].sort_key = (centroids[c].x - mesh_center.x) * normals[c].x
+                             + (centroids[c].y - mesh_center.y) * normals[c].y
+                             + (centroids[c].z - mesh_center.z) * normals[c].z;
+    }
+    qsort(clusters, cluster_count, sizeof(HgMeshCluster), hg_mesh_cluster_compare);
+
+    u32* output = hg_heap_alloc(index_count * sizeof(u32));
+    u32 written = 0;
+    for (u32 c = 0; c < cluster_count; ++c) {
+        u32 length = clusters[c].end - clusters[c].begin;
+        memcpy(&output[written], &indices[clusters[c].begin], length * sizeof(u32));
+        written += length;
+    }
+    memcpy(indices, output, index_count * sizeof(u32));
+
+    hg_heap_free(output);
+    hg_heap_free(normals);
+    hg_heap_free(centroids);
+    hg_heap_free(clusters);
+}
+
+u32 hg_mesh_optimize_vertex_fetch(HgVertex3D* vertices, u32 vertex_count, u32* indices, u32 index_count) {
+    HG_ASSERT(vertices != NULL);
+    HG_ASSERT(indices != NULL);
+
+    u32* remap = hg_heap_alloc(vertex_count * sizeof(u32));
+    for (u32 v = 0; v < vertex_count; ++v) {
+        remap[v] = HG_MESH_NO_INDEX;
+    }
+
+    u32 used_count = 0;
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 v = indices[i];
+        if (remap[v] == HG_MESH_NO_INDEX)
+            remap[v] = used_count++;
+        indices[i] = remap[v];
+    }
+
+    HgVertex3D* reordered = hg_heap_alloc(vertex_count * sizeof(HgVertex3D));
+    for (u32 v = 0; v < vertex_count; ++v) {
+        if (remap[v] != HG_MESH_NO_INDEX)
+            reordered[remap[v]] = vertices[v];
+    }
+    memcpy(vertices, reordered, used_count * sizeof(HgVertex3D));
+
+    hg_heap_free(reordered);
+    hg_heap_free(remap);
+    return used_count;
+}
+
+// Symmetric 4x4 matrix summing squared distances to planes:
+// xx, xy, xz, xw, yy, yz, yw, zz, zw, ww, then the total plane weight
+typedef struct HgQuadric {
+    f64 m[10];
+    f64 weight;
+} HgQuadric;
+
+static void hg_quadric_add(HgQuadric* dst, const HgQuadric* src) {
+    for (u32 i = 0; i < 10; ++i) {
+        dst->m[i] += src->m[i];
+    }
+    dst->weight += src->weight;
+}
+
+// Weighted mean squared distance from p to the quadric's planes
+static f64 hg_quadric_error(const HgQuadric* q, HgVec3 p) {
+    f64 x = p.x;
+    f64 y = p.y;
+    f64 z = p.z;
+    const f64* m = q->m;
+    f64 error = m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x
+              + m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y
+              + m[7] * z * z + 2.0 * m[8] * z
+              + m[9];
+    return q->weight > 0.0 ? fabs(error) / q->weight : 0.0;
+}
+
+static HgVec3 hg_triangle_normal(HgVec3 p0, HgVec3 p1, HgVec3 p2) {
+    HgVec3 e0 = {p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
+    HgVec3 e1 = {p2.x - p0.x, p2.y - p0.y, p2.z - p0.z};
+    return (HgVec3){e0.y * e1.z - e0.z * e1.y, e0.z * e1.x - e0.x * e1.z, e0.x * e1.y - e0.y * e1.x};
+}
+
+static int hg_mesh_edge_compare(const void* lhs, const void* rhs) {
+    u64 a = *(const u64*)lhs;
+    u64 b = *(const u64*)rhs;
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+typedef struct HgMeshCollapse {
+    f32 cost;
+    u32 from;
+    u32 to;
+} HgMeshCollapse;
+
+static int hg_mesh_collapse_compare(const void* lhs, const void* rhs) {
+    const HgMeshCollapse* a = lhs;
+    const HgMeshCollapse* b = rhs;
+    if (a->cost != b->cost)
+        return a->cost < b->cost ? -1 : 1;
+    if (a->from != b->from)
+        return a->from < b->from ? -1 : 1;
+    return a->to < b->to ? -1 : a->to > b->to ? 1 : 0;
+}
+
+u32 hg_mesh_simplify(
+    const HgVertex3D* vertices,
+    u32 vertex_count,
+    const u32* indices,
+    u32 index_count,
+    u32 target_index_count,
+    f32 max_error,
+    u32* out_indices,
+    f32* error
+) {
+    HG_ASSERT(vertices != NULL);
+    HG_ASSERT(indices != NULL);
+    HG_ASSERT(out_indices != NULL);
+    HG_ASSERT(index_count % 3 == 0);
+
+    memcpy(out_indices, indices, index_count * sizeof(u32));
+    f64 max_cost = 0.0;
+
+    HgQuadric* quadrics = hg_heap_alloc(vertex_count * sizeof(HgQuadric));
+    memset(quadrics, 0, vertex_count * sizeof(HgQuadric));
+    for (u32 i = 0; i < index_count; i += 3) {
+        HgVec3 p0 = vertices[indices[i]].position;
+        HgVec3 normal = hg_triangle_normal(p0, vertices[indices[i + 1]].position, vertices[indices[i + 2]].position);
+        f64 length = sqrt((f64)normal.x * normal.x + (f64)normal.y * normal.y + (f64)normal.z * normal.z);
+        if (length <= 0.0)
+            continue;
+
+        f64 a = normal.x / length;
+        f64 b = normal.y / length;
+        f64 c = normal.z / length;
+        f64 d = -(a * p0.x + b * p0.y + c * p0.z);
+        f64 area = length * 0.5;
+        HgQuadric plane = {
+            .m = {a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d},
+            .weight = area,
+        };
+        for (u32 k = 0; k < 10; ++k) {
+            plane.m[k] *= area;
+        }
+        for (u32 k = 0; k < 3; ++k) {
+            hg_quadric_add(&quadrics[indices[i + k]], &plane);
+        }
+    }
+
+    // An edge used by one triangle is on a border, or on an attribute seam
+    // where the vertices were split. Either way its vertices must not move,
+    // or the mesh would open up. Sorting directed edges finds the unpaired ones
+    bool* locked = hg_heap_alloc(vertex_count * sizeof(bool));
+    memset(locked, 0, vertex_count * sizeof(bool));
+    u64* edges = hg_heap_alloc(index_count * sizeof(u64));
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 a = indices[i];
+        u32 b = indices[i - i % 3 + (i + 1) % 3];
+        u32 lo = a < b ? a : b;
+        u32 hi = a < b ? b : a;
+        edges[i] = (u64)lo << 32 | hi;
+    }
+    qsort(edges, index_count, sizeof(u64), hg_mesh_edge_compare);
+    for (u32 i = 0; i < index_count;) {
+        u32 j = i + 1;
+        while (j < index_count && edges[j] == edges[i]) {
+            ++j;
+        }
+        if (j - i != 2) {
+            locked[edges[i] >> 32] = true;
+            locked[edges[i] & 0xffffffff] = true;
+        }
+        i = j;
+    }
+    hg_heap_free(edges);
+
+    u32* remap = hg_heap_alloc(vertex_count * sizeof(u32));
+    bool* touched = hg_heap_alloc(vertex_count * sizeof(bool));
+    u32* adjacency_offsets = hg_heap_alloc((vertex_count + 1) * sizeof(u32));
+    u32* adjacency = hg_heap_alloc(index_count * sizeof(u32));
+    HgMeshCollapse* collapses = hg_heap_alloc(2 * index_count * sizeof(HgMeshCollapse));
+    f64 max_cost_limit = (f64)max_error * (f64)max_error;
+
+    u32 current_count = index_count;
+    while (current_count > target_index_count) {
+        memset(adjacency_offsets, 0, (vertex_count + 1) * sizeof(u32));
+        for (u32 i = 0; i < current_count; ++i) {
+            ++adjacency_offsets[out_indices[i] + 1];
+        }
+        for (u32 v = 0; v < vertex_count; ++v) {
+            adjacency_offsets[v + 1] += adjacency_offsets[v];
+        }
+        for (u32 i = 0; i < current_count; ++i) {
+            adjacency[adjacency_offsets[out_indices[i]]++] = i / 3;
+        }
+        for (u32 v = vertex_count; v > 0; --v) {
+            adjacency_offsets[v] = adjacency_offsets[v - 1];
+        }
+        adjacency_offsets[0] = 0;
+
+        u32 collapse_count = 0;
+        for (u32 i = 0; i < current_count; ++i) {
+            u32 from = out_indices[i];
+            u32 to = out_indices[i - i % 3 + (i + 1) % 3];
+            for (u32 direction = 0; direction < 2; ++direction) {
+                if (!locked[from]) {
+                    HgQuadric q = quadrics[from];
+                    hg_quadric_add(&q, &quadrics[to]);
+                    collapses[collapse_count++] = (HgMeshCollapse){
+                        .cost = (f32)hg_quadric_error(&q, vertices[to].position),
+                        .from = from,
+                        .to = to,
+                    };
+                }
+                u32 swap = from;
+                from = to;
+                to = swap;
+            }
+        }
+        qsort(collapses, collapse_count, sizeof(HgMeshCollapse), hg_mesh_collapse_compare);
+
+        for (u32 v = 0; v < vertex_count; ++v) {
+            remap[v] = v;
+            touched[v] = false;
+        }
+
+        // Each pass only collapses edges whose neighbourhoods don't overlap,
+        // so every cost and flip test is against the current surface
+        u32 triangle_count = current_count / 3;
+        u32 target_triangles = target_index_count / 3;
+        u32 applied = 0;
+        for (u32 c = 0; c < collapse_count && triangle_count > target_triangles; ++c) {
+            HgMeshCollapse collapse = collapses[c];
+            if ((f64)collapse.cost > max_cost_limit)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            HgVec3 target = vertices[collapse.to].position;
+            u32 removed = 0;
+            bool flips = false;
+            for (u32 j = adjacency_offsets[collapse.from]; j < adjacency_offsets[collapse.from + 1]; ++j) {
+                const u32* triangle = &out_indices[3 * adjacency[j]];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                    ++removed;
+                    continue;
+                }
+
+                HgVec3 before[3];
+                HgVec3 after[3];
+                for (u32 k = 0; k < 3; ++k) {
+                    before[k] = vertices[triangle[k]].position;
+                    after[k] = triangle[k] == collapse.from ? target : before[k];
+                }
+                HgVec3 n0 = hg_triangle_normal(before[0], before[1], before[2]);
+                HgVec3 n1 = hg_triangle_normal(after[0], after[1], after[2]);
+                f32 n0_len = sqrtf(n0.x * n0.x + n0.y * n0.y + n0.z * n0.z);
+                f32 n1_len = sqrtf(n1.x * n1.x + n1.y * n1.y + n1.z * n1.z);
+                if (n0.x * n1.x + n0.y * n1.y + n0.z * n1.z <= 0.25f * n0_len * n1_len) {
+                    flips = true;
+                    break;
+                }
+            }
+            if (flips || removed == 0)
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            hg_quadric_add(&quadrics[collapse.to], &quadrics[collapse.from]);
+            max_cost = fmax(max_cost, (f64)collapse.cost);
+            triangle_count -= removed;
+            ++applied;
+
+            for (u32 j = adjacency_offsets[collapse.from]; j < adjacency_offsets[collapse.from + 1]; ++j) {
+                const u32* triangle = &out_indices[3 * adjacency[j]];
+                touched[triangle[0]] = true;
+                touched[triangle[1]] = true;
+                touched[triangle[2]] = true;
+            }
+        }
+        if (applied == 0)
+            break;
+
+        u32 write = 0;
+        for (u32 i = 0; i < current_count; i += 3) {
+            u32 a = remap[out_indices[i]];
+            u32 b = remap[out_indices[i + 1]];
+            u32 c = remap[out_indices[i + 2]];
+            if (a == b || b == c || c == a)
+                continue;
+            out_indices[write++] = a;
+            out_indices[write++] = b;
+            out_indices[write++] = c;
+        }
+        current_count = write;
+    }
+
+    hg_heap_free(collapses);
+    hg_heap_free(adjacency);
+    hg_heap_free(adjacency_offsets);
+    hg_heap_free(touched);
+    hg_heap_free(remap);
+    hg_heap_free(locked);
+    hg_heap_free(quadrics);
+
+    if (error != NULL)
+        *error = (f32)sqrt(max_cost);
+    return current_count;
+}
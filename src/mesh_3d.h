@@ -0,0 +1,72 @@
+#ifndef HG_MESH_3D_H
+#define HG_MESH_3D_H
+
+#include "renderer_3d.h"
+
+// A cooked mesh file is this header followed directly by vertex_count
+// HgVertex3D, index_count indices, then each level of detail's indices in
+// order, so every array can be uploaded straight from the file's bytes.
+// Indices are u16 when every vertex fits, halving their size, and u32
+// otherwise. Written by the mesh_cooker tool and read by hg_3d_mesh_load
+#define HG_MESH_FILE_MAGIC 0x534d4748 // "HGMS"
+#define HG_MESH_FILE_VERSION 3
+
+typedef struct HgMeshFileLod {
+    u32 index_count;
+    f32 error;
+} HgMeshFileLod;
+
+typedef struct HgMeshFileHeader {
+    u32 magic;
+    u32 version;
+    u32 vertex_count;
+    u32 index_count;
+    // Bytes per index, for every index array: 2 or 4
+    u32 index_size;
+    HgBounds3D bounds;
+    u32 lod_count;
+    HgMeshFileLod lods[HG_3D_MAX_LODS - 1];
+} HgMeshFileHeader;
+
+// Marks an unused slot in index remaps
+#define HG_MESH_NO_INDEX 0xffffffffu
+
+// A sphere around the vertices' bounding box center, never zero radius
+HgBounds3D hg_mesh_bounds(const HgVertex3D* vertices, u32 vertex_count);
+
+// Average cache miss ratio: post transform cache misses per triangle for a
+// FIFO cache of cache_size entries. 0.5 is ideal, 3.0 the worst possible
+f32 hg_mesh_acmr(const u32* indices, u32 index_count, u32 vertex_count, u32 cache_size);
+
+// Reorders triangles to maximize post transform cache hits (Forsyth)
+void hg_mesh_optimize_vertex_cache(u32* indices, u32 index_count, u32 vertex_count);
+
+// Reorders clusters of an already cache optimized index buffer so that
+// outward facing clusters draw first, reducing overdraw without breaking
+// cache locality inside clusters
+void hg_mesh_optimize_overdraw(
+    u32* indices, u32 index_count, const HgVertex3D* vertices, u32 vertex_count, u32 cache_size
+);
+
+// Reorders vertices by first use in the index buffer, remapping the indices,
+// and drops unreferenced vertices. Returns the new vertex count
+u32 hg_mesh_optimize_vertex_fetch(HgVertex3D* vertices, u32 vertex_count, u32* indices, u32 index_count);
+
+// Collapses edges onto their cheapest neighbour by quadric error until at
+// most target_index_count indices remain, or the next collapse would move the
+// surface further than max_error. Vertices only move onto existing ones and
+// border and seam vertices stay put, so the result indexes the original
+// vertex buffer. out_indices needs index_count entries; error, if not NULL,
+// receives the largest distance moved. Returns the new index count
+u32 hg_mesh_simplify(
+    const HgVertex3D* vertices,
+    u32 vertex_count,
+    const u32* indices,
+    u32 index_count,
+    u32 target_index_count,
+    f32 max_error,
+    u32* out_indices,
+    f32* error
+);
+
+#endif // HG_MESH_3D_H
@@ -0,0 +1,1181 @@
+#include "mesh_3d.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Offline tool converting Wavefront OBJ and glTF 2.0 (.gltf or .glb) files
+// into the cooked mesh format loaded by hg_3d_mesh_load: vertices are
+// deduplicated, normals and tangents generated, the index buffer optimized
+// for the post transform cache, overdraw and vertex fetch, and simplified
+// levels of detail appended
+//
+// Usage: mesh_cooker <input.obj|.gltf|.glb> <output.hgmesh>
+
+#define HG_COOKER_CACHE_SIZE 32
+#define HG_COOKER_OVERDRAW_CACHE_SIZE 16
+// Largest error a level of detail may have, as a fraction of the bounding radius
+#define HG_COOKER_LOD_MAX_ERROR 0.05f
+
+typedef struct HgObjCorner {
+    u32 position;
+    u32 uv;
+    u32 normal;
+} HgObjCorner;
+
+typedef struct HgObjMesh {
+    HgVec3* positions;
+    u32 position_count;
+    u32 position_capacity;
+    HgVec2* uvs;
+    u32 uv_count;
+    u32 uv_capacity;
+    HgVec3* normals;
+    u32 normal_count;
+    u32 normal_capacity;
+    HgObjCorner* corners;
+    u32 corner_count;
+    u32 corner_capacity;
+} HgObjMesh;
+
+static void* hg_cooker_grow(void* array, u32* capacity, u32 count, usize element_size) {
+    if (count < *capacity)
+        return array;
+    u32 new_capacity = *capacity == 0 ? 256 : *capacity * 2;
+    array = hg_heap_realloc(array, (usize)new_capacity * element_size);
+    *capacity = new_capacity;
+    return array;
+}
+
+// The file's contents with a NUL appended, so text can be parsed in place
+static char* hg_cooker_read_file(const char* path, usize* file_size) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    char* text = hg_heap_alloc((usize)size + 1);
+    usize read_size = fread(text, 1, (usize)size, file);
+    fclose(file);
+    text[read_size] = '\0';
+    *file_size = read_size;
+    return text;
+}
+
+// OBJ indices are 1 based, and negative ones count back from the end
+static bool hg_obj_resolve(long index, u32 count, u32* resolved) {
+    if (index > 0 && (u64)index <= count) {
+        *resolved = (u32)(index - 1);
+        return true;
+    }
+    if (index < 0 && (u64)-index <= count) {
+        *resolved = (u32)((long)count + index);
+        return true;
+    }
+    return false;
+}
+
+static bool hg_obj_parse_corner(const char** cursor, const HgObjMesh* mesh, HgObjCorner* corner) {
+    char* end;
+    long position = strtol(*cursor, &end, 10);
+    if (end == *cursor || !hg_obj_resolve(position, mesh->position_count, &corner->position))
+        return false;
+    *cursor = end;
+
+    corner->uv = HG_MESH_NO_INDEX;
+    corner->normal = HG_MESH_NO_INDEX;
+    if (**cursor != '/')
+        return true;
+
+    ++*cursor;
+    if (**cursor != '/') {
+        long uv = strtol(*cursor, &end, 10);
+        if (end == *cursor || !hg_obj_resolve(uv, mesh->uv_count, &corner->uv))
+            return false;
+        *cursor = end;
+    }
+    if (**cursor != '/')
+        return true;
+
+    ++*cursor;
+    long normal = strtol(*cursor, &end, 10);
+    if (end == *cursor || !hg_obj_resolve(normal, mesh->normal_count, &corner->normal))
+        return false;
+    *cursor = end;
+    return true;
+}
+
+static bool hg_obj_parse(const char* text, HgObjMesh* mesh) {
+    u32 line_number = 1;
+    const char* line = text;
+    while (*line != '\0') {
+        const char* cursor = line;
+        while (*cursor == ' ' || *cursor == '\t') {
+            ++cursor;
+        }
+
+        if (cursor[0] == 'v' && cursor[1] == ' ') {
+            mesh->positions = hg_cooker_grow(mesh->positions, &mesh->position_capacity, mesh->position_count, sizeof(HgVec3));
+            char* end;
+            HgVec3* p = &mesh->positions[mesh->position_count++];
+            p->x = strtof(cursor + 2, &end);
+            p->y = strtof(end, &end);
+            p->z = strtof(end, &end);
+        } else if (cursor[0] == 'v' && cursor[1] == 't' && cursor[2] == ' ') {
+            mesh->uvs = hg_cooker_grow(mesh->uvs, &mesh->uv_capacity, mesh->uv_count, sizeof(HgVec2));
+            char* end;
+            HgVec2* uv = &mesh->uvs[mesh->uv_count++];
+            uv->x = strtof(cursor + 3, &end);
+            // OBJ puts the uv origin at the bottom left, Vulkan at the top left
+            uv->y = 1.0f - strtof(end, &end);
+        } else if (cursor[0] == 'v' && cursor[1] == 'n' && cursor[2] == ' ') {
+            mesh->normals = hg_cooker_grow(mesh->normals, &mesh->normal_capacity, mesh->normal_count, sizeof(HgVec3));
+            char* end;
+            HgVec3* n = &mesh->normals[mesh->normal_count++];
+            n->x = strtof(cursor + 3, &end);
+            n->y = strtof(end, &end);
+            n->z = strtof(end, &end);
+        } else if (cursor[0] == 'f' && cursor[1] == ' ') {
+            // Polygons are triangulated as fans around the first corner
+            cursor += 2;
+            HgObjCorner first = {0};
+            HgObjCorner previous = {0};
+            u32 corner_count = 0;
+            for (;;) {
+                while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r') {
+                    ++cursor;
+                }
+                if (*cursor == '\n' || *cursor == '\0')
+                    break;
+
+                HgObjCorner corner;
+                if (!hg_obj_parse_corner(&cursor, mesh, &corner)) {
+                    fprintf(stderr, "Invalid face on line %u\n", line_number);
+                    return false;
+                }
+
+                if (corner_count >= 2) {
+                    for (u32 i = 0; i < 3; ++i) {
+                        mesh->corners = hg_cooker_grow(
+                            mesh->corners, &mesh->corner_capacity, mesh->corner_count, sizeof(HgObjCorner)
+                        );
+                        mesh->corners[mesh->corner_count++] = i == 0 ? first : i == 1 ? previous : corner;
+                    }
+                }
+                if (corner_count == 0)
+                    first = corner;
+                previous = corner;
+                ++corner_count;
+            }
+        }
+
+        while (*line != '\n' && *line != '\0') {
+            ++line;
+        }
+        if (*line == '\n') {
+            ++line;
+            ++line_number;
+        }
+    }
+    return true;
+}
+
+static u32 hg_obj_corner_hash(HgObjCorner corner) {
+    u32 hash = 2166136261u;
+    hash = (hash ^ corner.position) * 16777619u;
+    hash = (hash ^ corner.uv) * 16777619u;
+    hash = (hash ^ corner.normal) * 16777619u;
+    return hash;
+}
+
+// Each distinct (position, uv, normal) triple becomes one vertex
+static u32 hg_obj_deduplicate(
+    const HgObjMesh* mesh, HgVertex3D* vertices, u32* indices, u32* vertex_sources
+) {
+    u32 table_capacity = 1;
+    while (table_capacity < mesh->corner_count * 2) {
+        table_capacity *= 2;
+    }
+    u32* table = hg_heap_alloc(table_capacity * sizeof(u32));
+    for (u32 i = 0; i < table_capacity; ++i) {
+        table[i] = HG_MESH_NO_INDEX;
+    }
+
+    u32 vertex_count = 0;
+    for (u32 i = 0; i < mesh->corner_count; ++i) {
+        HgObjCorner corner = mesh->corners[i];
+        u32 slot = hg_obj_corner_hash(corner) & (table_capacity - 1);
+        for (;;) {
+            u32 existing = table[slot];
+            if (existing == HG_MESH_NO_INDEX) {
+                table[slot] = i;
+                vertex_sources[vertex_count] = i;
+                vertices[vertex_count] = (HgVertex3D){
+                    .position = mesh->positions[corner.position],
+                    .normal = corner.normal != HG_MESH_NO_INDEX
+                        ? mesh->normals[corner.normal] : (HgVec3){0.0f, 0.0f, 0.0f},
+                    .uv = corner.uv != HG_MESH_NO_INDEX
+                        ? mesh->uvs[corner.uv] : (HgVec2){0.0f, 0.0f},
+                };
+                indices[i] = vertex_count++;
+                break;
+            }
+
+            HgObjCorner other = mesh->corners[existing];
+            if (other.position == corner.position && other.uv == corner.uv && other.normal == corner.normal) {
+                indices[i] = indices[existing];
+                break;
+            }
+            slot = (slot + 1) & (table_capacity - 1);
+        }
+    }
+
+    hg_heap_free(table);
+    return vertex_count;
+}
+
+static HgVec3 hg_cooker_normalize(HgVec3 v, HgVec3 fallback) {
+    f32 length = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+    if (length <= 1e-12f)
+        return fallback;
+    return (HgVec3){v.x / length, v.y / length, v.z / length};
+}
+
+// A JSON document as a flat array of tokens in document order, each value
+// followed by its children. Object members are a string token for the key
+// followed by the value
+typedef enum HgJsonType {
+    HG_JSON_OBJECT,
+    HG_JSON_ARRAY,
+    HG_JSON_STRING,
+    HG_JSON_PRIMITIVE,
+} HgJsonType;
+
+typedef struct HgJsonToken {
+    HgJsonType type;
+    // Text range, inside the quotes for strings
+    u32 start;
+    u32 end;
+    // Members of an object, elements of an array
+    u32 size;
+    // The token after this one's children
+    u32 next;
+} HgJsonToken;
+
+typedef struct HgJson {
+    const char* text;
+    HgJsonToken* tokens;
+    u32 count;
+    u32 capacity;
+} HgJson;
+
+#define HG_JSON_MAX_DEPTH 64
+
+static void hg_json_skip_space(const char* text, u32* pos) {
+    while (text[*pos] == ' ' || text[*pos] == '\t' || text[*pos] == '\r' || text[*pos] == '\n') {
+        ++*pos;
+    }
+}
+
+static u32 hg_json_push(HgJson* json, HgJsonType type, u32 start) {
+    json->tokens = hg_cooker_grow(json->tokens, &json->capacity, json->count, sizeof(HgJsonToken));
+    json->tokens[json->count] = (HgJsonToken){.type = type, .start = start};
+    return json->count++;
+}
+
+static bool hg_json_parse_value(HgJson* json, u32* pos, u32 depth) {
+    const char* text = json->text;
+    hg_json_skip_space(text, pos);
+    if (depth > HG_JSON_MAX_DEPTH)
+        return false;
+
+    char c = text[*pos];
+    if (c == '"') {
+        u32 token = hg_json_push(json, HG_JSON_STRING, ++*pos);
+        while (text[*pos] != '"') {
+            if (text[*pos] == '\0')
+                return false;
+            if (text[*pos] == '\\' && text[*pos + 1] != '\0')
+                ++*pos;
+            ++*pos;
+        }
+        json->tokens[token].end = (*pos)++;
+        json->tokens[token].next = json->count;
+        return true;
+    }
+
+    if (c == '{' || c == '[') {
+        bool object = c == '{';
+        char close = object ? '}' : ']';
+        u32 token = hg_json_push(json, object ? HG_JSON_OBJECT : HG_JSON_ARRAY, (*pos)++);
+        u32 size = 0;
+        for (;;) {
+            hg_json_skip_space(text, pos);
+            if (text[*pos] == close && size == 0)
+                break;
+            if (object) {
+                if (text[*pos] != '"' || !hg_json_parse_value(json, pos, depth + 1))
+                    return false;
+                hg_json_skip_space(text, pos);
+                if (text[*pos] != ':')
+                    return false;
+                ++*pos;
+            }
+            if (!hg_json_parse_value(json, pos, depth + 1))
+                return false;
+            ++size;
+
+            hg_json_skip_space(text, pos);
+            if (text[*pos] == ',') {
+                ++*pos;
+            } else if (text[*pos] == close) {
+                break;
+            } else {
+                return false;
+            }
+        }
+        json->tokens[token].end = ++*pos;
+        json->tokens[token].size = size;
+        json->tokens[token].next = json->count;
+        return true;
+    }
+
+    // Numbers, true, false and null
+    u32 token = hg_json_push(json, HG_JSON_PRIMITIVE, *pos);
+    while (text[*pos] != '\0' && text[*pos] != ',' && text[*pos] != '}' && text[*pos] != ']'
+        && text[*pos] != ' ' && text[*pos] != '\t' && text[*pos] != '\r' && text[*pos] != '\n') {
+        ++*pos;
+    }
+    json->tokens[token].end = *pos;
+    json->tokens[token].next = json->count;
+    return *pos > json->tokens[token].start;
+}
+
+static bool hg_json_parse(const char* text, HgJson* json) {
+    *json = (HgJson){.text = text};
+    u32 pos = 0;
+    if (!hg_json_parse_value(json, &pos, 0))
+        return false;
+    hg_json_skip_space(text, &pos);
+    return text[pos] == '\0' && json->tokens[0].type == HG_JSON_OBJECT;
+}
+
+static bool hg_json_equals(const HgJson* json, u32 token, const char* string) {
+    const HgJsonToken* t = &json->tokens[token];
+    usize length = strlen(string);
+    return t->type == HG_JSON_STRING && t->end - t->start == length
+        && memcmp(json->text + t->start, string, length) == 0;
+}
+
+// The value of key in object, or HG_MESH_NO_INDEX if it has none
+static u32 hg_json_find(const HgJson* json, u32 object, const char* key) {
+    if (object == HG_MESH_NO_INDEX || json->tokens[object].type != HG_JSON_OBJECT)
+        return HG_MESH_NO_INDEX;
+    u32 member = object + 1;
+    for (u32 i = 0; i < json->tokens[object].size; ++i) {
+        if (hg_json_equals(json, member, key))
+            return member + 1;
+        member = json->tokens[member + 1].next;
+    }
+    return HG_MESH_NO_INDEX;
+}
+
+// Element index of array, or HG_MESH_NO_INDEX if it is out of range
+static u32 hg_json_element(const HgJson* json, u32 array, u32 index) {
+    if (array == HG_MESH_NO_INDEX || json->tokens[array].type != HG_JSON_ARRAY || index >= json->tokens[array].size)
+        return HG_MESH_NO_INDEX;
+    u32 element = array + 1;
+    for (u32 i = 0; i < index; ++i) {
+        element = json->tokens[element].next;
+    }
+    return element;
+}
+
+static u32 hg_json_size(const HgJson* json, u32 array) {
+    if (array == HG_MESH_NO_INDEX || json->tokens[array].type != HG_JSON_ARRAY)
+        return 0;
+    return json->tokens[array].size;
+}
+
+static f64 hg_json_number(const HgJson* json, u32 token, f64 fallback) {
+    if (token == HG_MESH_NO_INDEX || json->tokens[token].type != HG_JSON_PRIMITIVE)
+        return fallback;
+    char* end;
+    f64 value = strtod(json->text + json->tokens[token].start, &end);
+    return end == json->text + json->tokens[token].start ? fallback : value;
+}
+
+// A non-negative integer member, or fallback if it is missing or not one
+static u32 hg_json_u32(const HgJson* json, u32 object, const char* key, u32 fallback) {
+    f64 value = hg_json_number(json, hg_json_find(json, object, key), -1.0);
+    if (value < 0.0 || value > 4294967295.0 || value != floor(value))
+        return fallback;
+    return (u32)value;
+}
+
+// glTF 2.0 input: the triangles of every mesh the default scene places, in
+// world space, or of every mesh as is when there is no scene. Buffers may be
+// embedded as base64, separate files beside the .gltf, or a .glb's binary
+// chunk. Each glTF vertex becomes one corner triple, so the rest of the
+// cooker treats it like OBJ input
+#define HG_GLTF_MAGIC 0x46546c67 // "glTF"
+#define HG_GLTF_CHUNK_JSON 0x4e4f534a
+#define HG_GLTF_CHUNK_BIN 0x004e4942
+#define HG_GLTF_MAX_NODE_DEPTH 64
+
+#define HG_GLTF_UNSIGNED_BYTE 5121
+#define HG_GLTF_UNSIGNED_SHORT 5123
+#define HG_GLTF_UNSIGNED_INT 5125
+#define HG_GLTF_FLOAT 5126
+#define HG_GLTF_TRIANGLES 4
+
+typedef struct HgGltfBuffer {
+    const u8* data;
+    usize size;
+    // Whether data was allocated for this buffer, rather than pointing into
+    // the .glb
+    bool owned;
+} HgGltfBuffer;
+
+typedef struct HgGltf {
+    HgJson json;
+    HgGltfBuffer* buffers;
+    u32 buffer_count;
+} HgGltf;
+
+// An accessor's elements resolved to memory
+typedef struct HgGltfAccessor {
+    const u8* data;
+    u32 count;
+    u32 stride;
+    u32 component_type;
+    u32 component_count;
+    bool normalized;
+} HgGltfAccessor;
+
+static i32 hg_base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+' || c == '-') return 62;
+    if (c == '/' || c == '_') return 63;
+    return -1;
+}
+
+static u8* hg_base64_decode(const char* text, usize length, usize* size) {
+    u8* data = hg_heap_alloc(length / 4 * 3 + 3);
+    usize out = 0;
+    u32 bits = 0;
+    u32 bit_count = 0;
+    for (usize i = 0; i < length && text[i] != '='; ++i) {
+        i32 value = hg_base64_value(text[i]);
+        if (value < 0) {
+            hg_heap_free(data);
+            return NULL;
+        }
+        bits = (bits << 6) | (u32)value;
+        bit_count += 6;
+        if (bit_count >= 8) {
+            bit_count -= 8;
+            data[out++] = (u8)(bits >> bit_count);
+        }
+    }
+    *size = out;
+    return data;
+}
+
+static bool hg_gltf_load_buffers(HgGltf* gltf, const char* path, const u8* glb_bin, usize glb_bin_size) {
+    const HgJson* json = &gltf->json;
+    u32 buffers = hg_json_find(json, 0, "buffers");
+    gltf->buffer_count = hg_json_size(json, buffers);
+    gltf->buffers = hg_heap_alloc((gltf->buffer_count + 1) * sizeof(HgGltfBuffer));
+    memset(gltf->buffers, 0, (gltf->buffer_count + 1) * sizeof(HgGltfBuffer));
+
+    for (u32 i = 0; i < gltf->buffer_count; ++i) {
+        u32 buffer = hg_json_element(json, buffers, i);
+        u32 byte_length = hg_json_u32(json, buffer, "byteLength", 0);
+        u32 uri = hg_json_find(json, buffer, "uri");
+        HgGltfBuffer* out = &gltf->buffers[i];
+
+        if (uri == HG_MESH_NO_INDEX) {
+            // Only a .glb's first buffer may leave out its uri
+            if (i != 0 || glb_bin == NULL) {
+                fprintf(stderr, "Buffer %u has no data\n", i);
+                return false;
+            }
+            *out = (HgGltfBuffer){.data = glb_bin, .size = glb_bin_size};
+        } else {
+            const char* text = json->text + json->tokens[uri].start;
+            usize length = json->tokens[uri].end - json->tokens[uri].start;
+            const char* base64 = NULL;
+            if (length > 5 && memcmp(text, "data:", 5) == 0) {
+                for (usize c = 5; c + 7 <= length && base64 == NULL; ++c) {
+                    if (memcmp(text + c, ";base64,", 8) == 0)
+                        base64 = text + c + 8;
+                }
+                if (base64 == NULL) {
+                    fprintf(stderr, "Buffer %u has a data uri that isn't base64\n", i);
+                    return false;
+                }
+                usize size;
+                u8* data = hg_base64_decode(base64, length - (usize)(base64 - text), &size);
+                if (data == NULL) {
+                    fprintf(stderr, "Buffer %u has invalid base64\n", i);
+                    return false;
+                }
+                *out = (HgGltfBuffer){.data = data, .size = size, .owned = true};
+            } else {
+                // Relative to the .gltf
+                const char* slash = strrchr(path, '/');
+                const char* backslash = strrchr(path, '\\');
+                if (backslash != NULL && (slash == NULL || backslash > slash))
+                    slash = backslash;
+                usize directory = slash != NULL ? (usize)(slash - path) + 1 : 0;
+                char* buffer_path = hg_heap_alloc(directory + length + 1);
+                memcpy(buffer_path, path, directory);
+                memcpy(buffer_path + directory, text, length);
+                buffer_path[directory + length] = '\0';
+
+                usize size;
+                char* data = hg_cooker_read_file(buffer_path, &size);
+                if (data == NULL) {
+                    fprintf(stderr, "Could not read %s\n", buffer_path);
+                    hg_heap_free(buffer_path);
+                    return false;
+                }
+                hg_heap_free(buffer_path);
+                *out = (HgGltfBuffer){.data = (const u8*)data, .size = size, .owned = true};
+            }
+        }
+
+        if (out->size < byte_length) {
+            fprintf(stderr, "Buffer %u is shorter than its byteLength\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+static u32 hg_gltf_type_components(const HgJson* json, u32 type) {
+    if (hg_json_equals(json, type, "SCALAR")) return 1;
+    if (hg_json_equals(json, type, "VEC2")) return 2;
+    if (hg_json_equals(json, type, "VEC3")) return 3;
+    if (hg_json_equals(json, type, "VEC4")) return 4;
+    return 0;
+}
+
+static u32 hg_gltf_component_size(u32 component_type) {
+    switch (component_type) {
+        case HG_GLTF_UNSIGNED_BYTE: return 1;
+        case HG_GLTF_UNSIGNED_SHORT: return 2;
+        case HG_GLTF_UNSIGNED_INT: return 4;
+        case HG_GLTF_FLOAT: return 4;
+        default: return 0;
+    }
+}
+
+// Resolves an accessor and checks it lies inside its buffer
+static bool hg_gltf_accessor(const HgGltf* gltf, u32 index, HgGltfAccessor* accessor) {
+    const HgJson* json = &gltf->json;
+    u32 object = hg_json_element(json, hg_json_find(json, 0, "accessors"), index);
+    if (object == HG_MESH_NO_INDEX) {
+        fprintf(stderr, "Accessor %u doesn't exist\n", index);
+        return false;
+    }
+    if (hg_json_find(json, object, "sparse") != HG_MESH_NO_INDEX) {
+        fprintf(stderr, "Accessor %u is sparse, which isn't supported\n", index);
+        return false;
+    }
+
+    u32 view_index = hg_json_u32(json, object, "bufferView", HG_MESH_NO_INDEX);
+    u32 view = hg_json_element(json, hg_json_find(json, 0, "bufferViews"), view_index);
+    if (view == HG_MESH_NO_INDEX) {
+        fprintf(stderr, "Accessor %u has no buffer view\n", index);
+        return false;
+    }
+    u32 buffer = hg_json_u32(json, view, "buffer", HG_MESH_NO_INDEX);
+    if (buffer >= gltf->buffer_count) {
+        fprintf(stderr, "Buffer view %u has no buffer\n", view_index);
+        return false;
+    }
+
+    u32 normalized = hg_json_find(json, object, "normalized");
+    *accessor = (HgGltfAccessor){
+        .count = hg_json_u32(json, object, "count", 0),
+        .component_type = hg_json_u32(json, object, "componentType", 0),
+        .component_count = hg_gltf_type_components(json, hg_json_find(json, object, "type")),
+        .normalized = normalized != HG_MESH_NO_INDEX && json->text[json->tokens[normalized].start] == 't',
+    };
+    u32 element_size = hg_gltf_component_size(accessor->component_type) * accessor->component_count;
+    if (element_size == 0) {
+        fprintf(stderr, "Accessor %u has an unsupported type\n", index);
+        return false;
+    }
+    accessor->stride = hg_json_u32(json, view, "byteStride", element_size);
+
+    u64 view_offset = hg_json_u32(json, view, "byteOffset", 0);
+    u64 view_length = hg_json_u32(json, view, "byteLength", 0);
+    u64 offset = hg_json_u32(json, object, "byteOffset", 0);
+    u64 used = accessor->count == 0 ? 0 : offset + (u64)accessor->stride * (accessor->count - 1) + element_size;
+    if (view_offset + view_length > gltf->buffers[buffer].size || used > view_length) {
+        fprintf(stderr, "Accessor %u reads past its buffer\n", index);
+        return false;
+    }
+    accessor->data = gltf->buffers[buffer].data + view_offset + offset;
+    return true;
+}
+
+// Component c of element i as a float, unpacking normalized integers
+static f32 hg_gltf_read_f32(const HgGltfAccessor* accessor, u32 i, u32 c) {
+    const u8* element = accessor->data + (usize)accessor->stride * i;
+    switch (accessor->component_type) {
+        case HG_GLTF_FLOAT: {
+            f32 value;
+            memcpy(&value, element + 4 * c, sizeof(value));
+            return value;
+        }
+        case HG_GLTF_UNSIGNED_BYTE:
+            return (f32)element[c] / (accessor->normalized ? 255.0f : 1.0f);
+        case HG_GLTF_UNSIGNED_SHORT: {
+            u16 value;
+            memcpy(&value, element + 2 * c, sizeof(value));
+            return (f32)value / (accessor->normalized ? 65535.0f : 1.0f);
+        }
+        default:
+            return 0.0f;
+    }
+}
+
+static u32 hg_gltf_read_index(const HgGltfAccessor* accessor, u32 i) {
+    const u8* element = accessor->data + (usize)accessor->stride * i;
+    switch (accessor->component_type) {
+        case HG_GLTF_UNSIGNED_BYTE:
+            return element[0];
+        case HG_GLTF_UNSIGNED_SHORT: {
+            u16 value;
+            memcpy(&value, element, sizeof(value));
+            return value;
+        }
+        default: {
+            u32 value;
+            memcpy(&value, element, sizeof(value));
+            return value;
+        }
+    }
+}
+
+// Column major 4x4 matrices
+static void hg_gltf_matrix_multiply(const f32 a[16], const f32 b[16], f32 out[16]) {
+    f32 result[16];
+    for (u32 c = 0; c < 4; ++c) {
+        for (u32 r = 0; r < 4; ++r) {
+            result[4 * c + r] = a[r] * b[4 * c] + a[4 + r] * b[4 * c + 1]
+                              + a[8 + r] * b[4 * c + 2] + a[12 + r] * b[4 * c + 3];
+        }
+    }
+    memcpy(out, result, sizeof(result));
+}
+
+// The node's local transform, from its matrix or its translation, rotation
+// and scale
+static void hg_gltf_node_matrix(const HgJson* json, u32 node, f32 out[16]) {
+    u32 matrix = hg_json_find(json, node, "matrix");
+    if (hg_json_size(json, matrix) == 16) {
+        for (u32 i = 0; i < 16; ++i) {
+            out[i] = (f32)hg_json_number(json, hg_json_element(json, matrix, i), i % 5 == 0 ? 1.0 : 0.0);
+        }
+        return;
+    }
+
+    u32 translation = hg_json_find(json, node, "translation");
+    u32 rotation = hg_json_find(json, node, "rotation");
+    u32 scale = hg_json_find(json, node, "scale");
+    f32 t[3];
+    f32 s[3];
+    for (u32 i = 0; i < 3; ++i) {
+        t[i] = (f32)hg_json_number(json, hg_json_element(json, translation, i), 0.0);
+        s[i] = (f32)hg_json_number(json, hg_json_element(json, scale, i), 1.0);
+    }
+    f32 x = (f32)hg_json_number(json, hg_json_element(json, rotation, 0), 0.0);
+    f32 y = (f32)hg_json_number(json, hg_json_element(json, rotation, 1), 0.0);
+    f32 z = (f32)hg_json_number(json, hg_json_element(json, rotation, 2), 0.0);
+    f32 w = (f32)hg_json_number(json, hg_json_element(json, rotation, 3), 1.0);
+
+    f32 r[9] = {
+        1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y),
+        2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x),
+        2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y),
+    };
+    for (u32 c = 0; c < 3; ++c) {
+        for (u32 row = 0; row < 3; ++row) {
+            out[4 * c + row] = r[3 * c + row] * s[c];
+        }
+        out[4 * c + 3] = 0.0f;
+    }
+    out[12] = t[0];
+    out[13] = t[1];
+    out[14] = t[2];
+    out[15] = 1.0f;
+}
+
+static bool hg_gltf_add_primitive(const HgGltf* gltf, u32 primitive, const f32 transform[16], HgObjMesh* mesh) {
+    const HgJson* json = &gltf->json;
+    if (hg_json_u32(json, primitive, "mode", HG_GLTF_TRIANGLES) != HG_GLTF_TRIANGLES) {
+        fprintf(stderr, "Skipping a primitive that isn't a triangle list\n");
+        return true;
+    }
+
+    u32 attributes = hg_json_find(json, primitive, "attributes");
+    u32 position_index = hg_json_u32(json, attributes, "POSITION", HG_MESH_NO_INDEX);
+    u32 normal_index = hg_json_u32(json, attributes, "NORMAL", HG_MESH_NO_INDEX);
+    u32 uv_index = hg_json_u32(json, attributes, "TEXCOORD_0", HG_MESH_NO_INDEX);
+    u32 indices_index = hg_json_u32(json, primitive, "indices", HG_MESH_NO_INDEX);
+
+    HgGltfAccessor positions;
+    if (position_index == HG_MESH_NO_INDEX || !hg_gltf_accessor(gltf, position_index, &positions))
+        return false;
+    if (positions.component_type != HG_GLTF_FLOAT || positions.component_count != 3) {
+        fprintf(stderr, "Positions must be float VEC3\n");
+        return false;
+    }
+    HgGltfAccessor normals = {0};
+    if (normal_index != HG_MESH_NO_INDEX) {
+        if (!hg_gltf_accessor(gltf, normal_index, &normals))
+            return false;
+        if (normals.component_type != HG_GLTF_FLOAT || normals.component_count != 3 || normals.count != positions.count) {
+            fprintf(stderr, "Normals must be float VEC3, one per position\n");
+            return false;
+        }
+    }
+    HgGltfAccessor uvs = {0};
+    if (uv_index != HG_MESH_NO_INDEX) {
+        if (!hg_gltf_accessor(gltf, uv_index, &uvs))
+            return false;
+        if (uvs.component_count != 2 || uvs.count != positions.count
+         || (uvs.component_type != HG_GLTF_FLOAT && !uvs.normalized)) {
+            fprintf(stderr, "Texture coordinates must be float or normalized VEC2, one per position\n");
+            return false;
+        }
+    }
+    HgGltfAccessor indices = {0};
+    u32 index_count = positions.count;
+    if (indices_index != HG_MESH_NO_INDEX) {
+        if (!hg_gltf_accessor(gltf, indices_index, &indices))
+            return false;
+        if (indices.component_count != 1 || indices.component_type == HG_GLTF_FLOAT) {
+            fprintf(stderr, "Indices must be unsigned integer scalars\n");
+            return false;
+        }
+        index_count = indices.count;
+    }
+
+    // Normals transform by the inverse transpose, which is the cofactor
+    // matrix up to a scale the normalization removes
+    const f32* a = transform;
+    const f32* b = transform + 4;
+    const f32* c = transform + 8;
+    f32 cofactor[9] = {
+        b[1] * c[2] - b[2] * c[1], b[2] * c[0] - b[0] * c[2], b[0] * c[1] - b[1] * c[0],
+        c[1] * a[2] - c[2] * a[1], c[2] * a[0] - c[0] * a[2], c[0] * a[1] - c[1] * a[0],
+        a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0],
+    };
+    f32 determinant = a[0] * cofactor[0] + a[1] * cofactor[1] + a[2] * cofactor[2];
+
+    u32 first_position = mesh->position_count;
+    u32 first_normal = mesh->normal_count;
+    u32 first_uv = mesh->uv_count;
+    for (u32 i = 0; i < positions.count; ++i) {
+        f32 p[3] = {hg_gltf_read_f32(&positions, i, 0), hg_gltf_read_f32(&positions, i, 1), hg_gltf_read_f32(&positions, i, 2)};
+        mesh->positions = hg_cooker_grow(mesh->positions, &mesh->position_capacity, mesh->position_count, sizeof(HgVec3));
+        mesh->positions[mesh->position_count++] = (HgVec3){
+            transform[0] * p[0] + transform[4] * p[1] + transform[8] * p[2] + transform[12],
+            transform[1] * p[0] + transform[5] * p[1] + transform[9] * p[2] + transform[13],
+            transform[2] * p[0] + transform[6] * p[1] + transform[10] * p[2] + transform[14],
+        };
+
+        if (normal_index != HG_MESH_NO_INDEX) {
+            f32 n[3] = {hg_gltf_read_f32(&normals, i, 0), hg_gltf_read_f32(&normals, i, 1), hg_gltf_read_f32(&normals, i, 2)};
+            HgVec3 world = {
+                cofactor[0] * n[0] + cofactor[3] * n[1] + cofactor[6] * n[2],
+                cofactor[1] * n[0] + cofactor[4] * n[1] + cofactor[7] * n[2],
+                cofactor[2] * n[0] + cofactor[5] * n[1] + cofactor[8] * n[2],
+            };
+            if (determinant < 0.0f)
+                world = (HgVec3){-world.x, -world.y, -world.z};
+            mesh->normals = hg_cooker_grow(mesh->normals, &mesh->normal_capacity, mesh->normal_count, sizeof(HgVec3));
+            mesh->normals[mesh->normal_count++] = hg_cooker_normalize(world, (HgVec3){0.0f, 1.0f, 0.0f});
+        }
+        if (uv_index != HG_MESH_NO_INDEX) {
+            // glTF already puts the uv origin at the top left
+            mesh->uvs = hg_cooker_grow(mesh->uvs, &mesh->uv_capacity, mesh->uv_count, sizeof(HgVec2));
+            mesh->uvs[mesh->uv_count++] = (HgVec2){hg_gltf_read_f32(&uvs, i, 0), hg_gltf_read_f32(&uvs, i, 1)};
+        }
+    }
+
+    // A mirroring transform turns the winding inside out, so it is swapped back
+    for (u32 i = 0; i + 2 < index_count; i += 3) {
+        u32 triangle[3];
+        for (u32 k = 0; k < 3; ++k) {
+            triangle[k] = indices_index != HG_MESH_NO_INDEX ? hg_gltf_read_index(&indices, i + k) : i + k;
+            if (triangle[k] >= positions.count) {
+                fprintf(stderr, "Index %u is out of range\n", triangle[k]);
+                return false;
+            }
+        }
+        if (determinant < 0.0f) {
+            u32 swap = triangle[1];
+            triangle[1] = triangle[2];
+            triangle[2] = swap;
+        }
+        for (u32 k = 0; k < 3; ++k) {
+            mesh->corners = hg_cooker_grow(mesh->corners, &mesh->corner_capacity, mesh->corner_count, sizeof(HgObjCorner));
+            mesh->corners[mesh->corner_count++] = (HgObjCorner){
+                .position = first_position + triangle[k],
+                .uv = uv_index != HG_MESH_NO_INDEX ? first_uv + triangle[k] : HG_MESH_NO_INDEX,
+                .normal = normal_index != HG_MESH_NO_INDEX ? first_normal + triangle[k] : HG_MESH_NO_INDEX,
+            };
+        }
+    }
+    return true;
+}
+
+static bool hg_gltf_add_mesh(const HgGltf* gltf, u32 mesh_index, const f32 transform[16], HgObjMesh* mesh) {
+    const HgJson* json = &gltf->json;
+    u32 object = hg_json_element(json, hg_json_find(json, 0, "meshes"), mesh_index);
+    if (object == HG_MESH_NO_INDEX) {
+        fprintf(stderr, "Mesh %u doesn't exist\n", mesh_index);
+        return false;
+    }
+    u32 primitives = hg_json_find(json, object, "primitives");
+    for (u32 i = 0; i < hg_json_size(json, primitives); ++i) {
+        if (!hg_gltf_add_primitive(gltf, hg_json_element(json, primitives, i), transform, mesh))
+            return false;
+    }
+    return true;
+}
+
+static bool hg_gltf_add_node(const HgGltf* gltf, u32 node_index, const f32 parent[16], u32 depth, HgObjMesh* mesh) {
+    const HgJson* json = &gltf->json;
+    u32 node = hg_json_element(json, hg_json_find(json, 0, "nodes"), node_index);
+    if (node == HG_MESH_NO_INDEX || depth > HG_GLTF_MAX_NODE_DEPTH) {
+        fprintf(stderr, "Node %u doesn't exist or is nested too deep\n", node_index);
+        return false;
+    }
+
+    f32 local[16];
+    f32 world[16];
+    hg_gltf_node_matrix(json, node, local);
+    hg_gltf_matrix_multiply(parent, local, world);
+
+    u32 mesh_index = hg_json_u32(json, node, "mesh", HG_MESH_NO_INDEX);
+    if (mesh_index != HG_MESH_NO_INDEX && !hg_gltf_add_mesh(gltf, mesh_index, world, mesh))
+        return false;
+
+    u32 children = hg_json_find(json, node, "children");
+    for (u32 i = 0; i < hg_json_size(json, children); ++i) {
+        u32 child = (u32)hg_json_number(json, hg_json_element(json, children, i), -1.0);
+        if (!hg_gltf_add_node(gltf, child, world, depth + 1, mesh))
+            return false;
+    }
+    return true;
+}
+
+static bool hg_gltf_parse(const char* path, const char* data, usize size, HgObjMesh* mesh) {
+    // A .glb is a header, then the JSON chunk, then optionally the binary one
+    char* text = NULL;
+    const u8* bin = NULL;
+    usize bin_size = 0;
+    u32 header[3];
+    if (size >= sizeof(header) && (memcpy(header, data, sizeof(header)), header[0] == HG_GLTF_MAGIC)) {
+        if (header[1] != 2 || header[2] > size) {
+            fprintf(stderr, "%s isn't a glTF 2.0 binary\n", path);
+            return false;
+        }
+        usize offset = sizeof(header);
+        while (offset + 8 <= header[2]) {
+            u32 chunk[2];
+            memcpy(chunk, data + offset, sizeof(chunk));
+            offset += 8;
+            if (chunk[0] > header[2] - offset)
+                break;
+            if (chunk[1] == HG_GLTF_CHUNK_JSON && text == NULL) {
+                text = hg_heap_alloc((usize)chunk[0] + 1);
+                memcpy(text, data + offset, chunk[0]);
+                text[chunk[0]] = '\0';
+            } else if (chunk[1] == HG_GLTF_CHUNK_BIN && bin == NULL) {
+                bin = (const u8*)data + offset;
+                bin_size = chunk[0];
+            }
+            offset += (chunk[0] + 3) & ~3u;
+        }
+        if (text == NULL) {
+            fprintf(stderr, "%s has no JSON chunk\n", path);
+            return false;
+        }
+    }
+
+    HgGltf gltf = {0};
+    bool parsed = hg_json_parse(text != NULL ? text : data, &gltf.json);
+    if (!parsed)
+        fprintf(stderr, "%s has invalid JSON\n", path);
+    parsed = parsed && hg_gltf_load_buffers(&gltf, path, bin, bin_size);
+
+    if (parsed) {
+        const HgJson* json = &gltf.json;
+        f32 identity[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+        u32 scenes = hg_json_find(json, 0, "scenes");
+        u32 scene = hg_json_element(json, scenes, hg_json_u32(json, 0, "scene", 0));
+        if (scene != HG_MESH_NO_INDEX) {
+            u32 nodes = hg_json_find(json, scene, "nodes");
+            for (u32 i = 0; i < hg_json_size(json, nodes) && parsed; ++i) {
+                u32 node = (u32)hg_json_number(json, hg_json_element(json, nodes, i), -1.0);
+                parsed = hg_gltf_add_node(&gltf, node, identity, 0, mesh);
+            }
+        } else {
+            u32 meshes = hg_json_find(json, 0, "meshes");
+            for (u32 i = 0; i < hg_json_size(json, meshes) && parsed; ++i) {
+                parsed = hg_gltf_add_mesh(&gltf, i, identity, mesh);
+            }
+        }
+    }
+
+    for (u32 i = 0; i < gltf.buffer_count; ++i) {
+        if (gltf.buffers[i].owned)
+            hg_heap_free((void*)gltf.buffers[i].data);
+    }
+    hg_heap_free(gltf.buffers);
+    hg_heap_free(gltf.json.tokens);
+    hg_heap_free(text);
+    return parsed;
+}
+
+// Corners without a normal get the area weighted average of the faces around
+// their position, so smooth surfaces stay smooth across uv seams
+static void hg_cooker_generate_normals(
+    const HgObjMesh* mesh, HgVertex3D* vertices, u32 vertex_count, const u32* vertex_sources, const u32* indices
+) {
+    bool missing = false;
+    for (u32 v = 0; v < vertex_count; ++v) {
+        missing = missing || mesh->corners[vertex_sources[v]].normal == HG_MESH_NO_INDEX;
+    }
+    if (!missing)
+        return;
+
+    HgVec3* sums = hg_heap_alloc(mesh->position_count * sizeof(HgVec3));
+    memset(sums, 0, mesh->position_count * sizeof(HgVec3));
+    for (u32 i = 0; i < mesh->corner_count; i += 3) {
+        HgVec3 p0 = vertices[indices[i]].position;
+        HgVec3 p1 = vertices[indices[i + 1]].position;
+        HgVec3 p2 = vertices[indices[i + 2]].position;
+        HgVec3 e0 = {p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
+        HgVec3 e1 = {p2.x - p0.x, p2.y - p0.y, p2.z - p0.z};
+        HgVec3 cross = {e0.y * e1.z - e0.z * e1.y, e0.z * e1.x - e0.x * e1.z, e0.x * e1.y - e0.y * e1.x};
+        for (u32 k = 0; k < 3; ++k) {
+            HgVec3* sum = &sums[mesh->corners[i + k].position];
+            sum->x += cross.x;
+            sum->y += cross.y;
+            sum->z += cross.z;
+        }
+    }
+
+    for (u32 v = 0; v < vertex_count; ++v) {
+        HgObjCorner corner = mesh->corners[vertex_sources[v]];
+        if (corner.normal == HG_MESH_NO_INDEX)
+            vertices[v].normal = hg_cooker_normalize(sums[corner.position], (HgVec3){0.0f, 1.0f, 0.0f});
+    }
+    hg_heap_free(sums);
+}
+
+// Per triangle uv derivatives, accumulated per vertex then orthogonalized
+// against the normal; w holds the bitangent's handedness
+static void hg_cooker_generate_tangents(HgVertex3D* vertices, u32 vertex_count, const u32* indices, u32 index_count) {
+    HgVec3* tangents = hg_heap_alloc(vertex_count * sizeof(HgVec3));
+    HgVec3* bitangents = hg_heap_alloc(vertex_count * sizeof(HgVec3));
+    memset(tangents, 0, vertex_count * sizeof(HgVec3));
+    memset(bitangents, 0, vertex_count * sizeof(HgVec3));
+
+    for (u32 i = 0; i < index_count; i += 3) {
+        const HgVertex3D* v0 = &vertices[indices[i]];
+        const HgVertex3D* v1 = &vertices[indices[i + 1]];
+        const HgVertex3D* v2 = &vertices[indices[i + 2]];
+
+        HgVec3 e0 = {v1->position.x - v0->position.x, v1->position.y - v0->position.y, v1->position.z - v0->position.z};
+        HgVec3 e1 = {v2->position.x - v0->position.x, v2->position.y - v0->position.y, v2->position.z - v0->position.z};
+        f32 du0 = v1->uv.x - v0->uv.x;
+        f32 dv0 = v1->uv.y - v0->uv.y;
+        f32 du1 = v2->uv.x - v0->uv.x;
+        f32 dv1 = v2->uv.y - v0->uv.y;
+
+        f32 det = du0 * dv1 - du1 * dv0;
+        if (fabsf(det) <= 1e-12f)
+            continue;
+        f32 r = 1.0f / det;
+
+        HgVec3 t = {(e0.x * dv1 - e1.x * dv0) * r, (e0.y * dv1 - e1.y * dv0) * r, (e0.z * dv1 - e1.z * dv0) * r};
+        HgVec3 b = {(e1.x * du0 - e0.x * du1) * r, (e1.y * du0 - e0.y * du1) * r, (e1.z * du0 - e0.z * du1) * r};
+        for (u32 k = 0; k < 3; ++k) {
+            u32 v = indices[i + k];
+            tangents[v] = (HgVec3){tangents[v].x + t.x, tangents[v].y + t.y, tangents[v].z + t.z};
+            bitangents[v] = (HgVec3){bitangents[v].x + b.x, bitangents[v].y + b.y, bitangents[v].z + b.z};
+        }
+    }
+
+    for (u32 v = 0; v < vertex_count; ++v) {
+        HgVec3 n = vertices[v].normal;
+        HgVec3 t = tangents[v];
+        f32 n_dot_t = n.x * t.x + n.y * t.y + n.z * t.z;
+        t = (HgVec3){t.x - n.x * n_dot_t, t.y - n.y * n_dot_t, t.z - n.z * n_dot_t};
+
+        // Any direction perpendicular to the normal will do without uvs
+        HgVec3 axis = fabsf(n.x) < 0.9f ? (HgVec3){1.0f, 0.0f, 0.0f} : (HgVec3){0.0f, 1.0f, 0.0f};
+        f32 n_dot_axis = n.x * axis.x + n.y * axis.y + n.z * axis.z;
+        HgVec3 fallback = hg_cooker_normalize(
+            (HgVec3){axis.x - n.x * n_dot_axis, axis.y - n.y * n_dot_axis, axis.z - n.z * n_dot_axis},
+            (HgVec3){1.0f, 0.0f, 0.0f}
+        );
+        t = hg_cooker_normalize(t, fallback);
+
+        HgVec3 b = bitangents[v];
+        HgVec3 n_cross_t = {n.y * t.z - n.z * t.y, n.z * t.x - n.x * t.z, n.x * t.y - n.y * t.x};
+        f32 handedness = n_cross_t.x * b.x + n_cross_t.y * b.y + n_cross_t.z * b.z < 0.0f ? -1.0f : 1.0f;
+
+        vertices[v].tangent = (HgVec4){t.x, t.y, t.z, handedness};
+    }
+
+    hg_heap_free(bitangents);
+    hg_heap_free(tangents);
+}
+
+// Rewrites the indices as u16 in the first half of their array. Each u16
+// lands at or before the u32 it is read from, so it works in place
+static void hg_cooker_narrow_indices(u32* indices, u32 index_count) {
+    u16* narrow = (u16*)indices;
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 index = indices[i];
+        HG_ASSERT(index <= UINT16_MAX);
+        narrow[i] = (u16)index;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <input.obj|.gltf|.glb> <output.hgmesh>\n", argv[0]);
+        return 1;
+    }
+
+    usize size;
+    char* text = hg_cooker_read_file(argv[1], &size);
+    if (text == NULL) {
+        fprintf(stderr, "Could not read %s\n", argv[1]);
+        return 1;
+    }
+
+    const char* extension = strrchr(argv[1], '.');
+    bool gltf = extension != NULL && (strcmp(extension, ".gltf") == 0 || strcmp(extension, ".glb") == 0);
+
+    HgObjMesh mesh = {0};
+    bool parsed = gltf ? hg_gltf_parse(argv[1], text, size, &mesh) : hg_obj_parse(text, &mesh);
+    hg_heap_free(text);
+    if (!parsed || mesh.corner_count == 0) {
+        fprintf(stderr, "No triangles in %s\n", argv[1]);
+        return 1;
+    }
+
+    u32 index_count = mesh.corner_count;
+    u32* indices = hg_heap_alloc(index_count * sizeof(u32));
+    HgVertex3D* vertices = hg_heap_alloc(index_count * sizeof(HgVertex3D));
+    u32* vertex_sources = hg_heap_alloc(index_count * sizeof(u32));
+
+    u32 vertex_count = hg_obj_deduplicate(&mesh, vertices, indices, vertex_sources);
+    hg_cooker_generate_normals(&mesh, vertices, vertex_count, vertex_sources, indices);
+    hg_cooker_generate_tangents(vertices, vertex_count, indices, index_count);
+
+    f32 acmr_before = hg_mesh_acmr(indices, index_count, vertex_count, HG_COOKER_CACHE_SIZE);
+    hg_mesh_optimize_vertex_cache(indices, index_count, vertex_count);
+    hg_mesh_optimize_overdraw(indices, index_count, vertices, vertex_count, HG_COOKER_OVERDRAW_CACHE_SIZE);
+    vertex_count = hg_mesh_optimize_vertex_fetch(vertices, vertex_count, indices, index_count);
+    f32 acmr_after = hg_mesh_acmr(indices, index_count, vertex_count, HG_COOKER_CACHE_SIZE);
+
+    printf("%s: %u vertices, %u triangles\n", argv[1], vertex_count, index_count / 3);
+    printf("ACMR (%u entry FIFO): %.3f -> %.3f\n", HG_COOKER_CACHE_SIZE, (f64)acmr_before, (f64)acmr_after);
+
+    HgMeshFileHeader header = {
+        .magic = HG_MESH_FILE_MAGIC,
+        .version = HG_MESH_FILE_VERSION,
+        .vertex_count = vertex_count,
+        .index_count = index_count,
+        .index_size = vertex_count <= UINT16_MAX ? sizeof(u16) : sizeof(u32),
+        .bounds = hg_mesh_bounds(vertices, vertex_count),
+    };
+
+    // Each level aims for half the triangles of the last, simplifying from
+    // the full mesh so errors don't compound. A level that can't get well
+    // under its predecessor isn't worth a buffer, and ends the chain
+    u32* lod_indices[HG_3D_MAX_LODS - 1] = {NULL};
+    u32 previous_count = index_count;
+    for (u32 level = 0; level < HG_3D_MAX_LODS - 1; ++level) {
+        u32 target = (index_count >> (level + 1)) / 3 * 3;
+        f32 max_error = header.bounds.radius * HG_COOKER_LOD_MAX_ERROR;
+
+        u32* lod = hg_heap_alloc(index_count * sizeof(u32));
+        f32 error;
+        u32 lod_count = hg_mesh_simplify(vertices, vertex_count, indices, index_count, target, max_error, lod, &error);
+        if (lod_count == 0 || (f32)lod_count > (f32)previous_count * 0.8f) {
+            hg_heap_free(lod);
+            break;
+        }
+        hg_mesh_optimize_vertex_cache(lod, lod_count, vertex_count);
+
+        lod_indices[level] = lod;
+        header.lods[level] = (HgMeshFileLod){.index_count = lod_count, .error = error};
+        header.lod_count = level + 1;
+        previous_count = lod_count;
+
+        printf("LOD %u: %u triangles, error %.5f\n", level + 1, lod_count / 3, (f64)error);
+    }
+
+    if (header.index_size == sizeof(u16)) {
+        hg_cooker_narrow_indices(indices, index_count);
+        for (u32 level = 0; level < header.lod_count; ++level) {
+            hg_cooker_narrow_indices(lod_indices[level], header.lods[level].index_count);
+        }
+    }
+    printf("Indices: %u bit\n", header.index_size * 8);
+
+    int result = 0;
+    FILE* file = fopen(argv[2], "wb");
+    bool written = file != NULL
+        && fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(vertices, sizeof(HgVertex3D), vertex_count, file) == vertex_count
+        && fwrite(indices, header.index_size, index_count, file) == index_count;
+    for (u32 level = 0; level < header.lod_count && written; ++level) {
+        u32 count = header.lods[level].index_count;
+        written = fwrite(lod_indices[level], header.index_size, count, file) == count;
+    }
+    if (!written) {
+        fprintf(stderr, "Could not write %s\n", argv[2]);
+        result = 1;
+    }
+    if (file != NULL)
+        fclose(file);
+
+    for (u32 level = 0; level < header.lod_count; ++level) {
+        hg_heap_free(lod_indices[level]);
+    }
+    hg_heap_free(vertex_sources);
+    hg_heap_free(vertices);
+    hg_heap_free(indices);
+    hg_heap_free(mesh.corners);
+    hg_heap_free(mesh.normals);
+    hg_heap_free(mesh.uvs);
+    hg_heap_free(mesh.positions);
+    return result;
+}
@@ -1,18 +1,28 @@
 #version 460
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
+
+// Feature bits, see HgShaderFeature in renderer_3d.c. build.sh compiles this
+// once per variant, so unused paths compile out. These would be
+// specialization constants, but HgShaderConfig takes only SPIR-V, with no
+// specialization info to set them
+#ifndef FEATURES
+#define FEATURES 7
+#endif
+#define NORMAL_MAP ((FEATURES & 1) != 0)
+#define DIRECTIONAL_LIGHTS ((FEATURES & 2) != 0)
+#define POINT_LIGHTS ((FEATURES & 4) != 0)
+#define UNLIT ((FEATURES & 8) != 0)
 
 layout(location = 0) in vec3 v_pos;
 layout(location = 1) in vec3 v_normal;
 layout(location = 2) in vec4 v_tangent;
 layout(location = 3) in vec2 v_uv;
+layout(location = 4) flat in uvec2 v_material;
 
 layout(location = 0) out vec4 out_color;
 
-layout(set = 0, binding = 0) uniform VPUniform {
-    mat4 u_view;
-    mat4 u_proj;
-    uint u_dir_light_count;
-    uint u_point_light_count;
-};
+#include "model_common.glsl"
 
 struct DirectionalLight {
     vec4 direction;
@@ -30,7 +40,22 @@ layout(set = 0, binding = 2) readonly buffer PointLights {
     PointLight u_point_lights[];
 };
 
-layout(set = 1, binding = 0) uniform sampler2D u_textures[2];
+// Must match the cluster grid in renderer_3d.c
+const uvec3 CLUSTER_GRID = uvec3(16, 9, 24);
+
+const uint CLUSTER_COUNT = CLUSTER_GRID.x * CLUSTER_GRID.y * CLUSTER_GRID.z;
+
+// Each cluster's first light and light count, then the light lists
+layout(set = 0, binding = 4) readonly buffer LightClusters {
+    uint u_clusters[];
+};
+
+// Must match HG_MATERIAL_TABLE_SIZE in renderer_3d.c. A merged draw covers
+// instances of different materials, so v_material may vary within a draw
+// and indexes the table through nonuniformEXT
+const uint MATERIAL_TABLE_SIZE = 128;
+
+layout(set = 1, binding = 0) uniform sampler2D u_textures[MATERIAL_TABLE_SIZE];
 
 float blinn_phong(vec3 normal, vec3 light_dir, float shininess) {
     float ambient = 0.03;
@@ -39,30 +64,62 @@ float blinn_phong(vec3 normal, vec3 light_dir, float shininess) {
     return ambient + diffuse + specular;
 }
 
+uint cluster_index() {
+    vec4 clip = u_proj * vec4(v_pos, 1.0);
+    vec2 tile = clamp((clip.xy / clip.w * 0.5 + 0.5) * vec2(CLUSTER_GRID.xy), vec2(0.0), vec2(CLUSTER_GRID.xy - 1u));
+    float slice = clamp(log(max(v_pos.z, 1e-4)) * u_cluster_z_scale + u_cluster_z_bias, 0.0, float(CLUSTER_GRID.z - 1));
+    return (uint(slice) * CLUSTER_GRID.y + uint(tile.y)) * CLUSTER_GRID.x + uint(tile.x);
+}
+
 void main() {
+#if UNLIT
+    vec4 hdr_color = texture(u_textures[nonuniformEXT(v_material.x)], v_uv);
+#else
+#if NORMAL_MAP
     mat3 tangent_to_world = mat3(
         v_tangent.xyz,
         cross(v_tangent.xyz, v_normal) * v_tangent.w,
         -v_normal
     );
-    vec3 normal = normalize(tangent_to_world * texture(u_textures[1], v_uv).xyz);
+    // Normal maps may be two channel, so z is rebuilt; the tangent frame's z
+    // is -v_normal, so outward normals have negative z
+    vec2 normal_xy = texture(u_textures[nonuniformEXT(v_material.y)], v_uv).xy;
+    vec3 normal_ts = vec3(normal_xy, -sqrt(max(1.0 - dot(normal_xy, normal_xy), 0.0)));
+    vec3 normal = normalize(tangent_to_world * normal_ts);
+#else
+    vec3 normal = normalize(v_normal);
+#endif
 
     vec3 lighting = vec3(0.0);
+#if DIRECTIONAL_LIGHTS
     for (uint i = 0; i < u_dir_light_count; ++i) {
-        vec3 light_dir = -normalize(mat3(u_view) * u_directional_lights[i].direction.xyz);
-        vec3 light_color = u_directional_lights[i].color.xyz * u_directional_lights[i].color.w;
+        DirectionalLight light = u_directional_lights[u_dir_light_base + i];
+        vec3 light_dir = -normalize(mat3(u_view) * light.direction.xyz);
+        vec3 light_color = light.color.xyz * light.color.w;
         lighting += blinn_phong(normal, light_dir, 16.0) * light_color;
     }
-    for (uint i = 0; i < u_point_light_count; ++i) {
-        vec3 light_pos = (u_view * u_point_lights[i].position).xyz;
+#endif
+#if POINT_LIGHTS
+    uint cluster = u_cluster_base + 2 * cluster_index();
+    uint cluster_lights = u_cluster_base + 2 * CLUSTER_COUNT + u_clusters[cluster];
+    for (uint i = 0; i < u_clusters[cluster + 1]; ++i) {
+        PointLight light = u_point_lights[u_point_light_base + u_clusters[cluster_lights + i]];
+        vec3 light_pos = (u_view * vec4(light.position.xyz, 1.0)).xyz;
         vec3 light_diff = light_pos - v_pos;
         float light_dist = dot(light_diff, light_diff);
         vec3 light_dir = normalize(light_diff);
-        vec3 light_color = u_point_lights[i].color.xyz * u_point_lights[i].color.w;
-        lighting += blinn_phong(normal, light_dir, 16.0) * light_color / light_dist;
+        vec3 light_color = light.color.xyz * light.color.w;
+
+        // Fades to zero at the light's range, so the cluster bounds are exact
+        float range_ratio = light_dist / (light.position.w * light.position.w);
+        float window = clamp(1.0 - range_ratio * range_ratio, 0.0, 1.0);
+
+        lighting += blinn_phong(normal, light_dir, 16.0) * light_color * (window * window) / light_dist;
     }
+#endif
 
-    vec4 hdr_color = vec4(lighting, 1.0) * texture(u_textures[0], v_uv);
+    vec4 hdr_color = vec4(lighting, 1.0) * texture(u_textures[nonuniformEXT(v_material.x)], v_uv);
+#endif
     vec4 ldr_color = vec4(1.0) - exp(-hdr_color);
     out_color = ldr_color;
 }
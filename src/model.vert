@@ -1,4 +1,5 @@
 #version 460
+#extension GL_GOOGLE_include_directive : require
 
 layout(location = 0) in vec3 in_pos;
 layout(location = 1) in vec3 in_normal;
@@ -9,34 +10,27 @@ layout(location = 0) out vec3 f_pos;
 layout(location = 1) out vec3 f_normal;
 layout(location = 2) out vec4 f_tangent;
 layout(location = 3) out vec2 f_uv;
+layout(location = 4) flat out uvec2 f_material;
 
-layout(set = 0, binding = 0) uniform VPUniform {
-    mat4 u_view;
-    mat4 u_proj;
-    uint u_dir_light_count;
-    uint u_point_light_count;
-};
+#include "model_common.glsl"
+#include "model_position.glsl"
 
 layout(push_constant) uniform ModelPush {
-    mat4 p_model;
-};
-
-struct Space {
-    vec4 position;
-    vec3 normal;
-    vec3 tangent;
+    uint p_instance;
 };
 
 void main() {
-    const mat4 mv = u_view * p_model;
-    const mat3 imv = mat3(transpose(inverse(mv)));
-    const vec4 pos = mv * vec4(in_pos, 1.0);
+    const ModelInstance instance = u_instances[u_instance_base + p_instance + gl_InstanceIndex];
+    const ModelTransform transform = u_transforms[u_transform_base + instance.transform];
+    const vec4 pos = model_view_position(transform.model, in_pos);
+    const mat3 normal = mat3(u_view) * transform.normal;
 
     f_pos = pos.xyz;
-    f_normal = imv * in_normal;
-    f_tangent = vec4(imv * in_tangent.xyz, in_tangent.w);
+    f_normal = normal * in_normal;
+    f_tangent = vec4(normal * in_tangent.xyz, in_tangent.w);
     f_uv = in_uv;
+    f_material = instance.material;
 
-    gl_Position = u_proj * pos;
+    model_set_position(pos);
 }
 
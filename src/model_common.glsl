@@ -0,0 +1,38 @@
+// The declarations the model and depth shaders share. Must match
+// HgWorldUniform, HgModelInstance and HgModelTransform in renderer_3d.c
+
+layout(set = 0, binding = 0) uniform VPUniform {
+    mat4 u_view;
+    mat4 u_proj;
+    uint u_dir_light_count;
+    float u_cluster_z_scale;
+    float u_cluster_z_bias;
+    // Where the frame's arrays start in the frame ring, in elements
+    uint u_transform_base;
+    uint u_instance_base;
+    uint u_dir_light_base;
+    uint u_point_light_base;
+    uint u_cluster_base;
+    // The fraction of the target's width and height drawn to
+    float u_render_scale;
+};
+
+struct ModelInstance {
+    // Color and normal map slots in the material table
+    uvec2 material;
+    // First vertex in the vertex pool, for pooled meshes
+    uint vertex_offset;
+    uint transform;
+};
+layout(set = 0, binding = 3) readonly buffer ModelInstances {
+    ModelInstance u_instances[];
+};
+
+// World space model and normal matrices, indexed by ModelInstance.transform
+struct ModelTransform {
+    mat4 model;
+    mat3 normal;
+};
+layout(set = 0, binding = 6) readonly buffer ModelTransforms {
+    ModelTransform u_transforms[];
+};
@@ -0,0 +1,43 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+layout(location = 0) in vec4 in_pos;
+layout(location = 1) in vec2 in_normal;
+layout(location = 2) in vec2 in_tangent;
+layout(location = 3) in vec2 in_uv;
+
+layout(location = 0) out vec3 f_pos;
+layout(location = 1) out vec3 f_normal;
+layout(location = 2) out vec4 f_tangent;
+layout(location = 3) out vec2 f_uv;
+layout(location = 4) flat out uvec2 f_material;
+
+#include "model_common.glsl"
+#include "model_position.glsl"
+
+layout(push_constant) uniform ModelPush {
+    uint p_instance;
+};
+
+vec3 unpack_octahedral(vec2 packed) {
+    vec3 v = vec3(packed, 1.0 - abs(packed.x) - abs(packed.y));
+    float fold = max(-v.z, 0.0);
+    v.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(v.xy, vec2(0.0)));
+    return normalize(v);
+}
+
+// The position dequantization is already folded into the model matrix
+void main() {
+    const ModelInstance instance = u_instances[u_instance_base + p_instance + gl_InstanceIndex];
+    const ModelTransform transform = u_transforms[u_transform_base + instance.transform];
+    const vec4 pos = model_view_position(transform.model, in_pos.xyz);
+    const mat3 normal = mat3(u_view) * transform.normal;
+
+    f_pos = pos.xyz;
+    f_normal = normal * unpack_octahedral(in_normal);
+    f_tangent = vec4(normal * unpack_octahedral(in_tangent), sign(in_pos.w));
+    f_uv = in_uv;
+    f_material = instance.material;
+
+    model_set_position(pos);
+}
@@ -0,0 +1,59 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+layout(location = 0) out vec3 f_pos;
+layout(location = 1) out vec3 f_normal;
+layout(location = 2) out vec4 f_tangent;
+layout(location = 3) out vec2 f_uv;
+layout(location = 4) flat out uvec2 f_material;
+
+#include "model_common.glsl"
+#include "model_position.glsl"
+
+// HgVertex3D, as 12 floats: position, normal, tangent, uv. Pooled meshes'
+// vertices are fetched from here instead of through vertex input, so every
+// mesh in the pool shares one buffer and only the offset differs
+layout(set = 0, binding = 5) readonly buffer VertexPool {
+    float u_vertex_pool[];
+};
+
+// A merged index buffer repeats the mesh's indices once per instance, each
+// copy offset by p_vertex_stride, so the copy a vertex index falls in picks
+// the instance. Copies past p_instance_count collapse to a point, so their
+// triangles draw nothing. Unmerged draws pass a count of 1 and a stride no
+// index reaches
+layout(push_constant) uniform ModelPush {
+    uint p_instance;
+    uint p_instance_count;
+    uint p_vertex_stride;
+};
+
+void main() {
+    const uint copy = uint(gl_VertexIndex) / p_vertex_stride;
+    if (copy >= p_instance_count) {
+        gl_Position = vec4(0.0);
+        return;
+    }
+    const uint vertex = uint(gl_VertexIndex) - copy * p_vertex_stride;
+
+    const ModelInstance instance = u_instances[u_instance_base + p_instance + copy + gl_InstanceIndex];
+    const ModelTransform transform = u_transforms[u_transform_base + instance.transform];
+    const uint base = (instance.vertex_offset + vertex) * 12;
+    const vec3 in_pos = vec3(u_vertex_pool[base], u_vertex_pool[base + 1], u_vertex_pool[base + 2]);
+    const vec3 in_normal = vec3(u_vertex_pool[base + 3], u_vertex_pool[base + 4], u_vertex_pool[base + 5]);
+    const vec4 in_tangent = vec4(
+        u_vertex_pool[base + 6], u_vertex_pool[base + 7], u_vertex_pool[base + 8], u_vertex_pool[base + 9]
+    );
+    const vec2 in_uv = vec2(u_vertex_pool[base + 10], u_vertex_pool[base + 11]);
+    const vec4 pos = model_view_position(transform.model, in_pos);
+    const mat3 normal = mat3(u_view) * transform.normal;
+
+    f_pos = pos.xyz;
+    f_normal = normal * in_normal;
+    f_tangent = vec4(normal * in_tangent.xyz, in_tangent.w);
+    f_uv = in_uv;
+    f_material = instance.material;
+
+    model_set_position(pos);
+}
+
@@ -0,0 +1,29 @@
+// Included by every model and depth vertex shader after model_common.glsl,
+// so the depth pre-pass and the main pass compute a vertex's position with
+// the same operations in the same order. invariant stops the compiler from
+// reordering or fusing them differently in either, so the two passes agree
+// to the bit
+invariant gl_Position;
+
+vec4 model_view_position(mat4 model, vec3 pos) {
+    return u_view * (model * vec4(pos, 1.0));
+}
+
+out float gl_ClipDistance[2];
+
+// Squeezes clip space toward the top left corner, at -1, so the frame covers
+// the top left u_render_scale of the target, as a viewport would. The clip
+// distances cut triangles off at its right and bottom edges
+void model_set_position(vec4 view_pos) {
+    vec4 clip = u_proj * view_pos;
+    clip.xy = clip.xy * u_render_scale + (u_render_scale - 1.0) * clip.w;
+    gl_Position = clip;
+    gl_ClipDistance[0] = (2.0 * u_render_scale - 1.0) * clip.w - clip.x;
+    gl_ClipDistance[1] = (2.0 * u_render_scale - 1.0) * clip.w - clip.y;
+}
+
+// Moves the depth pre-pass's depth just away from the camera, so the main
+// pass's depth test passes at the same surface
+void model_apply_depth_bias(float bias) {
+    gl_Position.z += bias * gl_Position.w;
+}
@@ -0,0 +1,297 @@
+#include "occlusion_3d.h"
+#include "cull_3d.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+void hg_occlusion_init(HgOcclusion3D* occlusion) {
+    HG_ASSERT(occlusion != NULL);
+
+    *occlusion = (HgOcclusion3D){
+        .occluder_vertex_capacity = 256,
+    };
+    occlusion->pyramid = hg_heap_alloc(2 * HG_OCCLUSION_WIDTH * HG_OCCLUSION_HEIGHT * sizeof(f32));
+    occlusion->occluder_vertices = hg_heap_alloc(3 * occlusion->occluder_vertex_capacity * sizeof(f32));
+}
+
+void hg_occlusion_destroy(HgOcclusion3D* occlusion) {
+    HG_ASSERT(occlusion != NULL);
+
+    hg_heap_free(occlusion->occluder_vertices);
+    hg_heap_free(occlusion->pyramid);
+    *occlusion = (HgOcclusion3D){0};
+}
+
+void hg_occlusion_begin(HgOcclusion3D* occlusion, const HgMat4* view, const HgMat4* proj, f32 near) {
+    HG_ASSERT(occlusion != NULL);
+
+    occlusion->history_index ^= 1;
+    memset(occlusion->history[occlusion->history_index], 0, sizeof(occlusion->history[0]));
+
+    for (u32 i = 0; i < HG_OCCLUSION_WIDTH * HG_OCCLUSION_HEIGHT; ++i) {
+        occlusion->pyramid[i] = FLT_MAX;
+    }
+
+    occlusion->view = *view;
+    occlusion->proj = *proj;
+    occlusion->near = near;
+    hg_view_projection(view, proj, occlusion->view_proj);
+}
+
+bool hg_occlusion_was_drawn(const HgOcclusion3D* occlusion, u32 key) {
+    key &= HG_OCCLUSION_HISTORY_SIZE - 1;
+    return (occlusion->history[occlusion->history_index ^ 1][key / 64] >> (key % 64) & 1) != 0;
+}
+
+void hg_occlusion_mark_drawn(HgOcclusion3D* occlusion, u32 key) {
+    key &= HG_OCCLUSION_HISTORY_SIZE - 1;
+    occlusion->history[occlusion->history_index][key / 64] |= (u64)1 << (key % 64);
+}
+
+// Level's texels, and its size, which halves per level down to 1x1
+static f32* hg_occlusion_level(const HgOcclusion3D* occlusion, u32 level, u32* width, u32* height) {
+    f32* texels = occlusion->pyramid;
+    for (u32 i = 0; i < level; ++i) {
+        u32 w = HG_OCCLUSION_WIDTH >> i;
+        u32 h = HG_OCCLUSION_HEIGHT >> i;
+        texels += (w > 0 ? w : 1) * (h > 0 ? h : 1);
+    }
+    *width = HG_OCCLUSION_WIDTH >> level;
+    *height = HG_OCCLUSION_HEIGHT >> level;
+    if (*width == 0)
+        *width = 1;
+    if (*height == 0)
+        *height = 1;
+    return texels;
+}
+
+static f32 hg_edge(const f32* a, const f32* b, f32 x, f32 y) {
+    return (b[0] - a[0]) * (y - a[1]) - (b[1] - a[1]) * (x - a[0]);
+}
+
+// Rasterizes a triangle of screen space x, y and 1 / w into level 0, keeping
+// each pixel's nearest depth. Pixels are covered by their centers, but take
+// the farthest depth the triangle's plane reaches across them, so a sloped
+// occluder never claims to be nearer than it is
+static void hg_occlusion_raster(HgOcclusion3D* occlusion, const f32* a, const f32* b, const f32* c) {
+    f32 area = hg_edge(a, b, c[0], c[1]);
+    if (fabsf(area) < 1e-6f)
+        return;
+    // Both windings are drawn, so flip the edges to be positive inside
+    if (area < 0.0f) {
+        const f32* swap = b;
+        b = c;
+        c = swap;
+        area = -area;
+    }
+
+    f32 min_x = fmaxf(floorf(fminf(a[0], fminf(b[0], c[0]))), 0.0f);
+    f32 min_y = fmaxf(floorf(fminf(a[1], fminf(b[1], c[1]))), 0.0f);
+    f32 max_x = fminf(ceilf(fmaxf(a[0], fmaxf(b[0], c[0]))), (f32)HG_OCCLUSION_WIDTH);
+    f32 max_y = fminf(ceilf(fmaxf(a[1], fmaxf(b[1], c[1]))), (f32)HG_OCCLUSION_HEIGHT);
+    if (min_x >= max_x || min_y >= max_y)
+        return;
+
+    // 1 / w is affine in screen space, and smallest at one of a pixel's
+    // corners, half a pixel along each axis from its center
+    f32 dz_dx = ((b[2] - a[2]) * (c[1] - a[1]) - (c[2] - a[2]) * (b[1] - a[1])) / area;
+    f32 dz_dy = ((c[2] - a[2]) * (b[0] - a[0]) - (b[2] - a[2]) * (c[0] - a[0])) / area;
+    f32 corner = 0.5f * (fabsf(dz_dx) + fabsf(dz_dy));
+
+    for (u32 y = (u32)min_y; y < (u32)max_y; ++y) {
+        f32* row = occlusion->pyramid + y * HG_OCCLUSION_WIDTH;
+        f32 py = (f32)y + 0.5f;
+        for (u32 x = (u32)min_x; x < (u32)max_x; ++x) {
+            f32 px = (f32)x + 0.5f;
+            if (hg_edge(a, b, px, py) < 0.0f || hg_edge(b, c, px, py) < 0.0f || hg_edge(c, a, px, py) < 0.0f)
+                continue;
+
+            f32 inv_w = a[2] + dz_dx * (px - a[0]) + dz_dy * (py - a[1]) - corner;
+            if (inv_w <= 0.0f)
+                continue;
+            f32 depth = 1.0f / inv_w;
+            if (depth < row[x])
+                row[x] = depth;
+        }
+    }
+}
+
+// Clips a triangle of clip space x, y and w to w >= near, which leaves at
+// most a quad, and rasterizes what is left
+static void hg_occlusion_triangle(HgOcclusion3D* occlusion, const f32* a, const f32* b, const f32* c) {
+    const f32* corners[3] = {a, b, c};
+    f32 clipped[4][3];
+    u32 count = 0;
+    for (u32 i = 0; i < 3; ++i) {
+        const f32* from = corners[i];
+        const f32* to = corners[(i + 1) % 3];
+        bool from_in = from[2] >= occlusion->near;
+        bool to_in = to[2] >= occlusion->near;
+        if (from_in) {
+            memcpy(clipped[count++], from, sizeof(clipped[0]));
+        }
+        if (from_in != to_in) {
+            f32 t = (occlusion->near - from[2]) / (to[2] - from[2]);
+            for (u32 k = 0; k < 3; ++k) {
+                clipped[count][k] = from[k] + t * (to[k] - from[k]);
+            }
+            ++count;
+        }
+    }
+    if (count < 3)
+        return;
+
+    f32 screen[4][3];
+    for (u32 i = 0; i < count; ++i) {
+        f32 inv_w = 1.0f / clipped[i][2];
+        screen[i][0] = (clipped[i][0] * inv_w * 0.5f + 0.5f) * (f32)HG_OCCLUSION_WIDTH;
+        screen[i][1] = (clipped[i][1] * inv_w * 0.5f + 0.5f) * (f32)HG_OCCLUSION_HEIGHT;
+        screen[i][2] = inv_w;
+    }
+    hg_occlusion_raster(occlusion, screen[0], screen[1], screen[2]);
+    if (count == 4)
+        hg_occlusion_raster(occlusion, screen[0], screen[2], screen[3]);
+}
+
+void hg_occlusion_rasterize(
+    HgOcclusion3D* occlusion,
+    const HgTransform3D* transform,
+    const HgVec3* positions,
+    u32 vertex_count,
+    const u32* indices,
+    u32 index_count
+) {
+    HG_ASSERT(occlusion != NULL);
+    HG_ASSERT(transform != NULL);
+
+    if (vertex_count > occlusion->occluder_vertex_capacity) {
+        while (vertex_count > occlusion->occluder_vertex_capacity) {
+            occlusion->occluder_vertex_capacity *= 2;
+        }
+        occlusion->occluder_vertices = hg_heap_realloc(
+            occlusion->occluder_vertices, 3 * occlusion->occluder_vertex_capacity * sizeof(f32));
+    }
+
+    f32 (*vp)[4] = occlusion->view_proj;
+    for (u32 i = 0; i < vertex_count; ++i) {
+        HgVec3 p = positions[i];
+        HgVec3 world = hg_rotate_vec3(transform->rotation, (HgVec3){
+            p.x * transform->scale.x,
+            p.y * transform->scale.y,
+            p.z * transform->scale.z,
+        });
+        world.x += transform->position.x;
+        world.y += transform->position.y;
+        world.z += transform->position.z;
+
+        f32* clip = occlusion->occluder_vertices + 3 * i;
+        clip[0] = vp[0][0] * world.x + vp[1][0] * world.y + vp[2][0] * world.z + vp[3][0];
+        clip[1] = vp[0][1] * world.x + vp[1][1] * world.y + vp[2][1] * world.z + vp[3][1];
+        clip[2] = vp[0][3] * world.x + vp[1][3] * world.y + vp[2][3] * world.z + vp[3][3];
+    }
+
+    for (u32 i = 0; i < index_count; i += 3) {
+        const u32* triangle = indices + i;
+        hg_occlusion_triangle(
+            occlusion,
+            occlusion->occluder_vertices + 3 * triangle[0],
+            occlusion->occluder_vertices + 3 * triangle[1],
+            occlusion->occluder_vertices + 3 * triangle[2]
+        );
+    }
+}
+
+void hg_occlusion_build(HgOcclusion3D* occlusion) {
+    HG_ASSERT(occlusion != NULL);
+
+    u32 src_width, src_height;
+    const f32* src = hg_occlusion_level(occlusion, 0, &src_width, &src_height);
+    for (u32 level = 1; level < HG_OCCLUSION_LEVELS; ++level) {
+        u32 width, height;
+        f32* dst = hg_occlusion_level(occlusion, level, &width, &height);
+        for (u32 y = 0; y < height; ++y) {
+            u32 y0 = 2 * y < src_height ? 2 * y : src_height - 1;
+            u32 y1 = 2 * y + 1 < src_height ? 2 * y + 1 : src_height - 1;
+            for (u32 x = 0; x < width; ++x) {
+                u32 x0 = 2 * x < src_width ? 2 * x : src_width - 1;
+                u32 x1 = 2 * x + 1 < src_width ? 2 * x + 1 : src_width - 1;
+                dst[y * width + x] = fmaxf(
+                    fmaxf(src[y0 * src_width + x0], src[y0 * src_width + x1]),
+                    fmaxf(src[y1 * src_width + x0], src[y1 * src_width + x1]));
+            }
+        }
+        src = dst;
+        src_width = width;
+        src_height = height;
+    }
+}
+
+// The sphere's screen rectangle is read at the level where it spans at most
+// 2 texels a side, and every texel there must be nearer than the sphere's
+// nearest point
+bool hg_occlusion_test(const HgOcclusion3D* occlusion, HgVec4 sphere) {
+    HG_ASSERT(occlusion != NULL);
+
+    HgVec3 center = {sphere.x, sphere.y, sphere.z};
+    f32 radius = sphere.w;
+    f32 depth = hg_view_depth(&occlusion->view, center);
+    f32 nearest = depth - radius;
+    if (nearest <= occlusion->near)
+        return false;
+
+    f32 view[4][4];
+    f32 proj[4][4];
+    memcpy(view, &occlusion->view, sizeof(view));
+    memcpy(proj, &occlusion->proj, sizeof(proj));
+    f32 pos[2];
+    for (u32 r = 0; r < 2; ++r) {
+        pos[r] = view[0][r] * center.x + view[1][r] * center.y + view[2][r] * center.z + view[3][r];
+    }
+
+    // The corners of the sphere's view space bounding box, all in front of
+    // the near plane by now
+    f32 ndc_min[2] = {FLT_MAX, FLT_MAX};
+    f32 ndc_max[2] = {-FLT_MAX, -FLT_MAX};
+    for (u32 corner = 0; corner < 8; ++corner) {
+        f32 x = pos[0] + (corner & 1 ? radius : -radius);
+        f32 y = pos[1] + (corner & 2 ? radius : -radius);
+        f32 z = depth + (corner & 4 ? radius : -radius);
+        f32 w = proj[0][3] * x + proj[1][3] * y + proj[2][3] * z + proj[3][3];
+        for (u32 axis = 0; axis < 2; ++axis) {
+            f32 ndc = (proj[0][axis] * x + proj[1][axis] * y + proj[2][axis] * z + proj[3][axis]) / w;
+            ndc_min[axis] = fminf(ndc_min[axis], ndc);
+            ndc_max[axis] = fmaxf(ndc_max[axis], ndc);
+        }
+    }
+    f32 min_x = (fmaxf(ndc_min[0], -1.0f) * 0.5f + 0.5f) * (f32)HG_OCCLUSION_WIDTH;
+    f32 max_x = (fminf(ndc_max[0], 1.0f) * 0.5f + 0.5f) * (f32)HG_OCCLUSION_WIDTH;
+    f32 min_y = (fmaxf(ndc_min[1], -1.0f) * 0.5f + 0.5f) * (f32)HG_OCCLUSION_HEIGHT;
+    f32 max_y = (fminf(ndc_max[1], 1.0f) * 0.5f + 0.5f) * (f32)HG_OCCLUSION_HEIGHT;
+    if (min_x > max_x || min_y > max_y)
+        return false;
+
+    u32 level = 0;
+    f32 extent = fmaxf(max_x - min_x, max_y - min_y);
+    while (extent > 2.0f && level + 1 < HG_OCCLUSION_LEVELS) {
+        extent *= 0.5f;
+        ++level;
+    }
+
+    u32 width, height;
+    const f32* texels = hg_occlusion_level(occlusion, level, &width, &height);
+    f32 scale = 1.0f / (f32)(1u << level);
+    u32 x0 = (u32)(min_x * scale);
+    u32 y0 = (u32)(min_y * scale);
+    u32 x1 = (u32)(max_x * scale);
+    u32 y1 = (u32)(max_y * scale);
+    x1 = x1 < width ? x1 : width - 1;
+    y1 = y1 < height ? y1 : height - 1;
+    for (u32 y = y0; y <= y1; ++y) {
+        for (u32 x = x0; x <= x1; ++x) {
+            if (texels[y * width + x] >= nearest)
+                return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef HG_OCCLUSION_3D_H
+#define HG_OCCLUSION_3D_H
+
+#include "renderer_3d.h"
+
+// Occluders are rasterized on the CPU into a small depth buffer of view
+// depths. Level 0 of the pyramid is that buffer, and each level above holds
+// the farthest of the 2x2 texels under it
+#define HG_OCCLUSION_WIDTH 256
+#define HG_OCCLUSION_HEIGHT 128
+#define HG_OCCLUSION_LEVELS 9
+// Direct mapped over the caller's keys; a collision only rasterizes an
+// occluder that wasn't needed
+#define HG_OCCLUSION_HISTORY_SIZE 4096
+
+typedef struct HgOcclusion3D {
+    f32* pyramid;
+    // Clip space x, y and w of the occluder being rasterized
+    f32* occluder_vertices;
+    u32 occluder_vertex_capacity;
+    // Bitsets of the keys of occluders drawn last frame, and this frame
+    u64 history[2][HG_OCCLUSION_HISTORY_SIZE / 64];
+    u32 history_index;
+
+    // The view of the frame in progress
+    HgMat4 view;
+    HgMat4 proj;
+    f32 near;
+    f32 view_proj[4][4];
+} HgOcclusion3D;
+
+void hg_occlusion_init(HgOcclusion3D* occlusion);
+void hg_occlusion_destroy(HgOcclusion3D* occlusion);
+
+// Starts a frame: clears the depth buffer, and moves the occluders drawn
+// this frame to last frame's
+void hg_occlusion_begin(HgOcclusion3D* occlusion, const HgMat4* view, const HgMat4* proj, f32 near);
+// Whether the occluder with key was drawn last frame
+bool hg_occlusion_was_drawn(const HgOcclusion3D* occlusion, u32 key);
+void hg_occlusion_mark_drawn(HgOcclusion3D* occlusion, u32 key);
+
+// Rasterizes an occluder's triangles, in model space, placed by transform
+void hg_occlusion_rasterize(
+    HgOcclusion3D* occlusion,
+    const HgTransform3D* transform,
+    const HgVec3* positions,
+    u32 vertex_count,
+    const u32* indices,
+    u32 index_count
+);
+// Builds the pyramid over the rasterized occluders, before any tests
+void hg_occlusion_build(HgOcclusion3D* occlusion);
+// Whether a world space bounding sphere, with the radius in w, is behind
+// the occluders everywhere it covers
+bool hg_occlusion_test(const HgOcclusion3D* occlusion, HgVec4 sphere);
+
+#endif // HG_OCCLUSION_3D_H
@@ -0,0 +1,312 @@
+#include "profiler_3d.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+
+#define HG_PROFILER_MAX_SERIES 64
+#define HG_PROFILER_MAX_DEPTH 32
+// Threads are numbered from 1, leaving 0 for the GPU's track
+#define HG_PROFILER_GPU_THREAD 0
+
+// One named scope or counter, with its value for each recorded frame
+typedef struct HgProfilerSeries {
+    const char* name;
+    bool is_counter;
+    f64 current;
+    // Frames recorded since the series first appeared, and where the next
+    // one goes
+    u32 count;
+    u32 head;
+    f64 history[HG_PROFILER_HISTORY];
+} HgProfilerSeries;
+
+typedef struct HgTraceEvent {
+    const char* name;
+    u64 start;
+    // Duration of a scope, or the value of a counter
+    f64 value;
+    u32 thread;
+    bool is_counter;
+} HgTraceEvent;
+
+typedef struct HgProfilerScope {
+    const char* name;
+    u64 start;
+} HgProfilerScope;
+
+static mtx_t s_mutex;
+
+static HgProfilerSeries* s_series;
+static u32 s_series_count;
+static u64 s_frame_start;
+
+static HgTraceEvent* s_events;
+static u32 s_event_count;
+static u32 s_event_capacity;
+static u32 s_capture_frames;
+static u64 s_capture_start;
+static char s_capture_path[256];
+
+static atomic_uint s_next_thread;
+static _Thread_local HgProfilerScope t_scopes[HG_PROFILER_MAX_DEPTH];
+static _Thread_local u32 t_depth;
+static _Thread_local u32 t_thread;
+
+static u64 hg_profiler_now(void) {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (u64)time.tv_sec * 1000000000ull + (u64)time.tv_nsec;
+}
+
+// Small ids in order of first use read better in trace viewers than thread
+// handles
+static u32 hg_profiler_thread(void) {
+    if (t_thread == 0)
+        t_thread = atomic_fetch_add(&s_next_thread, 1) + 1;
+    return t_thread;
+}
+
+void hg_profiler_init(void) {
+    mtx_init(&s_mutex, mtx_plain);
+    s_series = hg_heap_alloc(HG_PROFILER_MAX_SERIES * sizeof(HgProfilerSeries));
+    s_series_count = 0;
+    s_frame_start = hg_profiler_now();
+
+    s_events = NULL;
+    s_event_count = 0;
+    s_event_capacity = 0;
+    s_capture_frames = 0;
+}
+
+void hg_profiler_shutdown(void) {
+    hg_heap_free(s_events);
+    hg_heap_free(s_series);
+    mtx_destroy(&s_mutex);
+}
+
+// Finds or adds the series called name. Called with the mutex held
+static HgProfilerSeries* hg_profiler_series(const char* name, bool is_counter) {
+    for (u32 i = 0; i < s_series_count; ++i) {
+        if (s_series[i].name == name)
+            return &s_series[i];
+    }
+    for (u32 i = 0; i < s_series_count; ++i) {
+        if (strcmp(s_series[i].name, name) == 0)
+            return &s_series[i];
+    }
+    if (s_series_count == HG_PROFILER_MAX_SERIES)
+        return NULL;
+
+    HgProfilerSeries* series = &s_series[s_series_count++];
+    *series = (HgProfilerSeries){.name = name, .is_counter = is_counter};
+    return series;
+}
+
+// Called with the mutex held
+static void hg_profiler_event(HgTraceEvent event) {
+    if (s_event_count == s_event_capacity) {
+        s_event_capacity = s_event_capacity == 0 ? 1024 : 2 * s_event_capacity;
+        s_events = hg_heap_realloc(s_events, s_event_capacity * sizeof(HgTraceEvent));
+    }
+    s_events[s_event_count++] = event;
+}
+
+void hg_profiler_begin(const char* name) {
+    HG_ASSERT(name != NULL);
+    HG_ASSERT(t_depth < HG_PROFILER_MAX_DEPTH);
+
+    if (t_depth < HG_PROFILER_MAX_DEPTH)
+        t_scopes[t_depth] = (HgProfilerScope){.name = name, .start = hg_profiler_now()};
+    ++t_depth;
+}
+
+static void hg_profiler_scope_record(const char* name, u64 start, u64 end, u32 thread) {
+    mtx_lock(&s_mutex);
+    HgProfilerSeries* series = hg_profiler_series(name, false);
+    if (series != NULL)
+        series->current += (f64)(end - start) * 1.0e-6;
+    if (s_capture_frames > 0) {
+        hg_profiler_event((HgTraceEvent){
+            .name = name,
+            .start = start,
+            .value = (f64)(end - start),
+            .thread = thread,
+        });
+    }
+    mtx_unlock(&s_mutex);
+}
+
+void hg_profiler_end(void) {
+    HG_ASSERT(t_depth > 0);
+
+    u64 end = hg_profiler_now();
+    --t_depth;
+    if (t_depth >= HG_PROFILER_MAX_DEPTH)
+        return;
+    HgProfilerScope scope = t_scopes[t_depth];
+    hg_profiler_scope_record(scope.name, scope.start, end, hg_profiler_thread());
+}
+
+u64 hg_profiler_time(void) {
+    return hg_profiler_now();
+}
+
+void hg_profiler_gpu_scope(const char* name, u64 start, u64 end) {
+    HG_ASSERT(name != NULL);
+    HG_ASSERT(end >= start);
+
+    hg_profiler_scope_record(name, start, end, HG_PROFILER_GPU_THREAD);
+}
+
+void hg_profiler_counter(const char* name, f64 value) {
+    HG_ASSERT(name != NULL);
+
+    mtx_lock(&s_mutex);
+    HgProfilerSeries* series = hg_profiler_series(name, true);
+    if (series != NULL)
+        series->current = value;
+    if (s_capture_frames > 0) {
+        hg_profiler_event((HgTraceEvent){
+            .name = name,
+            .start = hg_profiler_now(),
+            .value = value,
+            .is_counter = true,
+        });
+    }
+    mtx_unlock(&s_mutex);
+}
+
+// Names are expected to be plain identifiers, but quotes and backslashes
+// would break the JSON, so they are escaped
+static void hg_profiler_write_name(FILE* file, const char* name) {
+    fputc('"', file);
+    for (const char* c = name; *c != '\0'; ++c) {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', file);
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+// Called with the mutex held
+static void hg_profiler_capture_write(void) {
+    FILE* file = fopen(s_capture_path, "w");
+    if (file == NULL) {
+        HG_LOGF("Could not open %s to write a trace", s_capture_path);
+        return;
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"GPU\"}}%s\n",
+        HG_PROFILER_GPU_THREAD, s_event_count > 0 ? "," : "");
+    for (u32 i = 0; i < s_event_count; ++i) {
+        const HgTraceEvent* event = &s_events[i];
+        f64 timestamp = (f64)(event->start - s_capture_start) * 1.0e-3;
+        fprintf(file, "{\"name\":");
+        hg_profiler_write_name(file, event->name);
+        if (event->is_counter) {
+            fprintf(file, ",\"ph\":\"C\",\"ts\":%.3f,\"pid\":0,\"tid\":0,\"args\":{\"value\":%g}}",
+                timestamp, event->value);
+        } else {
+            fprintf(file, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u}",
+                timestamp, event->value * 1.0e-3, event->thread);
+        }
+        fprintf(file, i + 1 < s_event_count ? ",\n" : "\n");
+    }
+    fprintf(file, "]}\n");
+    fclose(file);
+
+    HG_LOGF("Wrote %u trace events to %s", s_event_count, s_capture_path);
+}
+
+void hg_profiler_frame(void) {
+    u64 now = hg_profiler_now();
+    u32 thread = hg_profiler_thread();
+
+    mtx_lock(&s_mutex);
+    HgProfilerSeries* frame = hg_profiler_series("frame", false);
+    if (frame != NULL)
+        frame->current = (f64)(now - s_frame_start) * 1.0e-6;
+    if (s_capture_frames > 0) {
+        hg_profiler_event((HgTraceEvent){
+            .name = "frame",
+            .start = s_frame_start,
+            .value = (f64)(now - s_frame_start),
+            .thread = thread,
+        });
+    }
+    s_frame_start = now;
+
+    for (u32 i = 0; i < s_series_count; ++i) {
+        HgProfilerSeries* series = &s_series[i];
+        series->history[series->head] = series->current;
+        series->head = (series->head + 1) % HG_PROFILER_HISTORY;
+        if (series->count < HG_PROFILER_HISTORY)
+            ++series->count;
+        if (!series->is_counter)
+            series->current = 0.0;
+    }
+
+    if (s_capture_frames > 0 && --s_capture_frames == 0) {
+        hg_profiler_capture_write();
+        s_event_count = 0;
+    }
+    mtx_unlock(&s_mutex);
+}
+
+static int hg_f64_compare(const void* lhs, const void* rhs) {
+    f64 a = *(const f64*)lhs;
+    f64 b = *(const f64*)rhs;
+    return a < b ? -1 : a > b;
+}
+
+bool hg_profiler_summary(const char* name, HgProfilerSummary* summary) {
+    HG_ASSERT(name != NULL);
+    HG_ASSERT(summary != NULL);
+
+    f64 sorted[HG_PROFILER_HISTORY];
+    u32 count = 0;
+
+    mtx_lock(&s_mutex);
+    for (u32 i = 0; i < s_series_count; ++i) {
+        if (strcmp(s_series[i].name, name) == 0) {
+            count = s_series[i].count;
+            memcpy(sorted, s_series[i].history, count * sizeof(f64));
+            break;
+        }
+    }
+    mtx_unlock(&s_mutex);
+    if (count == 0)
+        return false;
+
+    // The history isn't in frame order until it wraps, but order doesn't
+    // matter once sorted
+    qsort(sorted, count, sizeof(f64), hg_f64_compare);
+    f64 total = 0.0;
+    for (u32 i = 0; i < count; ++i) {
+        total += sorted[i];
+    }
+    *summary = (HgProfilerSummary){
+        .average = total / (f64)count,
+        .p50 = sorted[(count - 1) / 2],
+        .p99 = sorted[(u32)((f64)(count - 1) * 0.99)],
+        .max = sorted[count - 1],
+    };
+    return true;
+}
+
+void hg_profiler_capture(const char* path, u32 frame_count) {
+    HG_ASSERT(path != NULL);
+    HG_ASSERT(frame_count > 0);
+
+    mtx_lock(&s_mutex);
+    snprintf(s_capture_path, sizeof(s_capture_path), "%s", path);
+    s_capture_frames = frame_count;
+    s_capture_start = s_frame_start;
+    s_event_count = 0;
+    mtx_unlock(&s_mutex);
+}
@@ -0,0 +1,49 @@
+#ifndef HG_PROFILER_3D_H
+#define HG_PROFILER_3D_H
+
+#include "hg_math.h"
+
+// CPU timing scopes and per frame counters, kept as a rolling history of
+// the last HG_PROFILER_HISTORY frames for percentiles, and optionally
+// captured to a Chrome trace (chrome://tracing, or ui.perfetto.dev). Scopes
+// nest, and may be opened on any thread. Names are compared by address
+// first, so pass string literals
+#define HG_PROFILER_HISTORY 512
+
+void hg_profiler_init(void);
+void hg_profiler_shutdown(void);
+
+void hg_profiler_begin(const char* name);
+// Closes the innermost scope opened on this thread
+void hg_profiler_end(void);
+
+// Sets a counter's value for the current frame
+void hg_profiler_counter(const char* name, f64 value);
+
+// The profiler's clock, in nanoseconds
+u64 hg_profiler_time(void);
+// Records GPU work the caller timed on the profiler's clock. It sums into
+// its series like a CPU scope, but traces show it on a GPU track of its own,
+// apart from every thread's
+void hg_profiler_gpu_scope(const char* name, u64 start, u64 end);
+
+// Ends the frame: records the time since the last call as "frame", and
+// every scope's total and every counter's value for this frame
+void hg_profiler_frame(void);
+
+typedef struct HgProfilerSummary {
+    f64 average;
+    f64 p50;
+    f64 p99;
+    f64 max;
+} HgProfilerSummary;
+
+// Over the recorded history, in milliseconds for scopes and "frame".
+// Returns false if nothing named name has been recorded
+bool hg_profiler_summary(const char* name, HgProfilerSummary* summary);
+
+// Records every scope and counter of the next frame_count frames, then
+// writes them to path as Chrome trace JSON
+void hg_profiler_capture(const char* path, u32 frame_count);
+
+#endif // HG_PROFILER_3D_H
@@ -1,50 +1,461 @@
 #include "renderer_3d.h"
+#include "mesh_3d.h"
+#include "file_map_3d.h"
+#include "texture_3d.h"
+#include "suballocator_3d.h"
+#include "frame_arena_3d.h"
+#include "memory_tracker_3d.h"
+#include "cull_3d.h"
+#include "light_clusters_3d.h"
+#include "occlusion_3d.h"
+#include "upload_queue_3d.h"
+#include "profiler_3d.h"
+#include "simd_kernels_3d.h"
+
+#include <float.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <threads.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "model.vert.spv.h"
-#include "model.frag.spv.h"
+#include "model_packed.vert.spv.h"
+#include "model_pooled.vert.spv.h"
+#include "model_0.frag.spv.h"
+#include "model_1.frag.spv.h"
+#include "model_2.frag.spv.h"
+#include "model_3.frag.spv.h"
+#include "model_4.frag.spv.h"
+#include "model_5.frag.spv.h"
+#include "model_6.frag.spv.h"
+#include "model_7.frag.spv.h"
+#include "model_8.frag.spv.h"
+#include "depth.vert.spv.h"
+#include "depth_packed.vert.spv.h"
+#include "depth_pooled.vert.spv.h"
+#include "depth.frag.spv.h"
+#include "upscale.vert.spv.h"
+#include "upscale.frag.spv.h"
 
 typedef struct HgWorldUniform {
     HgMat4 view;
     HgMat4 proj;
     u32 dir_light_count;
-    u32 point_light_count;
+    f32 cluster_z_scale;
+    f32 cluster_z_bias;
+    // Where the frame's arrays start in the frame ring, in elements
+    u32 transform_base;
+    u32 instance_base;
+    u32 dir_light_base;
+    u32 point_light_base;
+    u32 cluster_base;
+    // The fraction of the target's width and height drawn to, from its top
+    // left corner
+    f32 render_scale;
 } HgWorldUniform;
 
 typedef struct HgModelPush {
-    HgMat4 model;
+    u32 instance;
+    // For merged index buffers, the instances the draw covers and the vertex
+    // stride between their copies of the indices
+    u32 instance_count;
+    u32 vertex_stride;
 } HgModelPush;
 
-static HgShader* s_shader;
-static HgBuffer* s_world_buffer;
+typedef struct HgDepthPush {
+    u32 instance;
+    f32 depth_bias;
+} HgDepthPush;
+
+// Each source has its own pair of shaders
+typedef enum HgVertexSource {
+    HG_VERTEX_SOURCE_FLOAT,
+    HG_VERTEX_SOURCE_PACKED,
+    HG_VERTEX_SOURCE_POOLED,
+    HG_VERTEX_SOURCE_COUNT,
+} HgVertexSource;
+
+// model.frag variants: the 8 lit combinations, then unlit
+typedef enum HgShaderFeature {
+    HG_SHADER_FEATURE_NORMAL_MAP_BIT = 0x1,
+    HG_SHADER_FEATURE_DIRECTIONAL_LIGHTS_BIT = 0x2,
+    HG_SHADER_FEATURE_POINT_LIGHTS_BIT = 0x4,
+    HG_SHADER_FEATURE_UNLIT_BIT = 0x8,
+} HgShaderFeature;
+
+#define HG_SHADER_VARIANT_COUNT 9
+
+// Created on first use
+static HgShader* s_shaders[HG_VERTEX_SOURCE_COUNT][HG_SHADER_VARIANT_COUNT];
+static HgShader* s_depth_shaders[HG_VERTEX_SOURCE_COUNT];
+static HgShader* s_upscale_shader;
+
+// Grown and destroyed buffers are retired until their frame completes
+#define HG_3D_FRAMES_IN_FLIGHT 2
+
+// One buffer per frame in flight
+typedef struct HgFrameBuffer {
+    const char* name;
+    HgBufferConfig config;
+    HgBuffer* buffers[HG_3D_FRAMES_IN_FLIGHT];
+    usize capacities[HG_3D_FRAMES_IN_FLIGHT];
+} HgFrameBuffer;
+
+// One of buffer and texture is set
+typedef struct HgRetiredResource {
+    HgBuffer* buffer;
+    HgTexture* texture;
+    u64 frame;
+} HgRetiredResource;
+
+// Advanced by the render thread and read without waiting for it
+static _Atomic u64 s_frame_number;
+static u32 s_frame_index;
+
+static u32 s_retired_resource_capacity;
+static u32 s_retired_resource_count;
+static HgRetiredResource* s_retired_resources;
+
+static HgMemoryTracker3D s_memory;
+
+static HgFrameBuffer s_world_buffer;
+
+// One region per frame in flight, holding that frame's storage arrays at
+// the offsets in the world uniform. The objects' transforms start each region
+typedef struct HgFrameRing {
+    HgBuffer* buffer;
+    // A multiple of sizeof(HgModelTransform)
+    usize region_size;
+    usize used;
+} HgFrameRing;
+static HgFrameRing s_frame_ring;
+
+// Suballocated in vertices. The CPU copy refills the buffer when it grows or
+// is defragmented
+#define HG_VERTEX_POOL_INITIAL_CAPACITY (1u << 16)
+
+struct HgMesh3D {
+    u32 offset;
+    u32 vertex_count;
+    // Position in s_meshes
+    u32 index;
+    // Copied from hg_3d_mesh_set_occluder, NULL without an occluder
+    HgVec3* occluder_positions;
+    u32 occluder_vertex_count;
+    u32* occluder_indices;
+    u32 occluder_index_count;
+};
+
+typedef struct HgPoolFree {
+    u32 offset;
+    u32 size;
+    u64 frame;
+} HgPoolFree;
+
+static HgSuballocator3D s_vertex_pool;
+static HgBuffer* s_vertex_pool_buffer;
+static HgVertex3D* s_vertex_pool_shadow;
+
+static HgMesh3D** s_meshes;
+static u32 s_mesh_count;
+static u32 s_mesh_capacity;
+
+static HgPoolFree* s_pool_frees;
+static u32 s_pool_free_count;
+static u32 s_pool_free_capacity;
+
+// Batches of small pooled meshes draw with merged index buffers: level l
+// repeats the indices 1 << l times, each copy offset by the vertex stride
+#define HG_MERGE_MAX_INDICES 3072
+#define HG_MERGE_MAX_LEVELS 11
+#define HG_MERGE_MAX_LEVEL_INDICES (1u << 18)
+// Caps the CPU copies levels are built from
+#define HG_MERGE_MAX_COPY_BYTES (8u << 20)
+
+typedef struct HgMergedIndices {
+    HgBuffer* source;
+    // Freed once every level is created
+    u32* indices;
+    u32 index_count;
+    u32 vertex_stride;
+    u32 max_level_count;
+    u32 level_count;
+    HgBuffer* levels[HG_MERGE_MAX_LEVELS];
+} HgMergedIndices;
+
+// Sorted by source
+static HgMergedIndices** s_merged_indices;
+static u32 s_merged_index_count;
+static u32 s_merged_index_capacity;
+static usize s_merged_copy_bytes;
 
 typedef struct HgDirectionalLight {
     HgVec4 direction;
     HgVec4 color;
 } HgDirectionalLight;
-static HgBuffer* s_dir_light_buffer;
 
-static u32 s_dir_light_capacity;
 static u32 s_dir_light_count;
 static HgDirectionalLight* s_dir_lights;
 
-typedef struct HgPointLight {
-    HgVec4 position;
-    HgVec4 color;
-} HgPointLight;
-static HgBuffer* s_point_light_buffer;
-
-static u32 s_point_light_capacity;
 static u32 s_point_light_count;
 static HgPointLight* s_point_lights;
 
+static HgLightClusters3D s_light_clusters;
+
+// The cold part of a ticket, read only once it is visible
 typedef struct HgModelTicket {
     HgModel3D model;
-    HgModelPush push;
+    HgTransform3D transform;
+    // Identifies the queued model across frames for level of detail hysteresis
+    u32 lod_key;
 } HgModelTicket;
 
-static u32 s_model_ticket_capacity;
-static u32 s_model_ticket_count;
-static HgModelTicket* s_model_tickets;
+// The part level of detail selection and sorting read
+typedef struct HgModelTicketHot {
+    // The vertex source, features, vertex buffer, finest index buffer and
+    // textures of the sort key, which don't depend on the view
+    u64 material_key;
+    HgVec3 position;
+    // Largest axis of the scale, to project level of detail errors with
+    f32 max_scale;
+    u32 lod_key;
+    u32 lod_count;
+    // Of the finest level
+    u32 index_count;
+} HgModelTicketHot;
+
+typedef struct HgTicketArrays {
+    u32 capacity;
+    HgModelTicket* tickets;
+    HgModelTicketHot* hot;
+    // World space bounding spheres, as four arrays of x, y, z and radius,
+    // each capacity long
+    f32* bounds;
+} HgTicketArrays;
+
+// Tickets are numbered objects first, then the frame's queued tickets
+struct HgObject3D {
+    u32 index;
+};
+
+static u32 s_object_count;
+static HgTicketArrays s_object_tickets;
+static HgObject3D** s_objects;
+// The models as given, before resolving
+static HgModel3D* s_object_models;
+
+static u32 s_queued_count;
+static HgTicketArrays s_queued_tickets;
+
+static u64* s_object_dirty;
+static u64* s_object_pending;
+static u32 s_object_pending_count;
+
+// Chunks from the context's arena, each bigger than the last
+typedef struct HgQueueChunk {
+    struct HgQueueChunk* next;
+    u32 count;
+    u32 capacity;
+    _Alignas(16) u8 items[];
+} HgQueueChunk;
+
+typedef struct HgQueue {
+    HgQueueChunk* head;
+    HgQueueChunk* tail;
+    u32 count;
+} HgQueue;
+
+// Private to the thread that queues into it. Draw merges contexts in
+// creation order
+struct HgRenderContext3D {
+    HgRenderContext3D* next;
+    u32 id;
+
+    HgFrameArena3D arena;
+    HgQueue models;
+    HgQueue dir_lights;
+    HgQueue point_lights;
+};
+
+static mtx_t s_context_mutex;
+static HgRenderContext3D* s_contexts;
+static u32 s_context_next_id;
+
+static HgRenderContext3D* s_main_context;
+
+static u32 s_context_order_capacity;
+static HgRenderContext3D** s_context_order;
+
+static u64* s_model_sort_keys;
+static u32* s_model_sort_indices;
+static u32 s_model_sort_count;
+
+static bool s_depth_prepass;
+static bool s_gpu_timing;
+
+// Matches std430 layout
+typedef struct HgModelInstance {
+    // Color and normal map slots in the material table
+    u32 material[2];
+    // First vertex in the vertex pool, for pooled meshes
+    u32 vertex_offset;
+    // Index into the transform buffer
+    u32 transform;
+} HgModelInstance;
+
+// Submission's copy of the objects' transforms, and per frame in flight the
+// objects stale in its region of the ring
+static HgModelTransform* s_transforms;
+static u32 s_transform_capacity;
+static u64* s_object_stale[HG_3D_FRAMES_IN_FLIGHT];
+
+// Bound as set 1 and indexed by instances. Must match MATERIAL_TABLE_SIZE in
+// model.frag
+#define HG_MATERIAL_TABLE_SIZE 128
+static HgTexture** s_material_textures;
+static u32* s_material_table_starts;
+static u32 s_material_table_count;
+static u32 s_material_table_capacity;
+
+static HgCullSpheresKernel s_cull_spheres;
+static HgBuildTransformsKernel s_build_transforms;
+
+static HgMat4 s_view;
+static HgMat4 s_proj;
+static f32 s_near;
+static f32 s_far;
+static f32 s_cluster_z_scale;
+static f32 s_cluster_z_bias;
+static f32 s_target_width;
+static f32 s_target_height;
+
+static f32 s_render_scale;
+static HgTexture* s_render_output;
+static HgBuffer* s_upscale_vertex_buffer;
+static HgBuffer* s_upscale_index_buffer;
+
+typedef struct HgUpscalePush {
+    f32 scale;
+} HgUpscalePush;
+
+// Signed by update_projection to suit the depth convention
+#define HG_DEPTH_PREPASS_BIAS 1e-6f
+static f32 s_depth_bias;
+
+#define HG_LOD_PIXEL_ERROR 1.0f
+#define HG_LOD_HYSTERESIS 0.25f
+#define HG_LOD_HISTORY_SIZE 4096
+
+typedef struct HgLodHistory {
+    u32 key;
+    u32 level;
+} HgLodHistory;
+static HgLodHistory s_lod_history[HG_LOD_HISTORY_SIZE];
+
+// Smaller occluders cost more to rasterize than they hide
+#define HG_OCCLUDER_MIN_COVERAGE 0.0005f
+
+static bool s_occlusion_culling;
+static HgOcclusion3D s_occlusion;
+
+static HgRenderer3DStats s_stats;
+static HgRenderer3DStats s_submitted_stats;
+
+static u32 s_peak_models;
+static u32 s_peak_dir_lights;
+static u32 s_peak_point_lights;
+static usize s_peak_arena_bytes;
+
+// A NULL vertex buffer means the vertex pool's
+typedef struct HgDrawCall {
+    HgBuffer* vertex_buffer;
+    HgBuffer* index_buffer;
+    HgVertexSource source;
+    u32 variant;
+} HgDrawCall;
+
+// Everything submitting a frame reads, allocated from its arena
+typedef struct HgFramePacket {
+    HgFrameArena3D arena;
+
+    HgTexture* target;
+    HgTexture* depth_buffer;
+    // NULL when the frame draws to the whole target
+    HgTexture* render_output;
+    // Set by hg_3d_renderer_frame
+    bool present;
+    bool gpu_timing;
+
+    HgWorldUniform world;
+    HgDirectionalLight* dir_lights;
+    u32 point_light_count;
+    HgPointLight* point_lights;
+    u32* clusters;
+    u32 cluster_size;
+
+    // Per visible model, in draw order, which is also the instance order
+    u32 draw_count;
+    HgDrawCall* draws;
+    HgModelInstance* instances;
+    // Positions in the draw order, front to back, with the pre-pass on
+    bool depth_prepass;
+    f32 depth_bias;
+    u32* prepass_order;
+
+    HgTexture** material_textures;
+    u32* material_table_starts;
+    u32 material_table_count;
+
+    // Pooled batches with merged index buffers, and their instance counts
+    u32 merged_batch_count;
+    HgMergedIndices** merged_batches;
+    u32* merged_batch_sizes;
+
+    // Objects whose transforms changed, with their transforms, then the
+    // visible queued tickets' transforms
+    u32 object_count;
+    u32 changed_count;
+    u32 queued_count;
+    u32* changed;
+    HgModelTransform* changed_transforms;
+    HgModelTransform* queued_transforms;
+
+    HgRenderer3DStats stats;
+    HgError result;
+} HgFramePacket;
+
+// Enough for about a thousand models
+#define HG_PACKET_ARENA_CAPACITY (1024 * 1024)
+#define HG_CONTEXT_ARENA_CAPACITY (64 * 1024)
+
+static HgFramePacket s_packets[2];
+static u32 s_packet_index;
+
+// While the render thread holds a packet, only it calls into the graphics
+// layer
+static bool s_pipelined;
+static thrd_t s_render_thread;
+static mtx_t s_render_mutex;
+static cnd_t s_render_work;
+static cnd_t s_render_idle;
+static bool s_render_quit;
+static HgFramePacket* s_render_packet;
+static HgError s_submitted_result;
+
+static u32 s_shader_count;
+
+static void hg_render_thread_wait(void) {
+    if (!s_pipelined)
+        return;
+
+    mtx_lock(&s_render_mutex);
+    while (s_render_packet != NULL) {
+        cnd_wait(&s_render_idle, &s_render_mutex);
+    }
+    mtx_unlock(&s_render_mutex);
+}
 
 typedef struct HgColor {
     u8 r;
@@ -59,320 +470,2930 @@ static const HgColor s_default_color_data[] = {
 };
 static HgTexture* s_default_color_map;
 
-static const HgVec4 s_default_normal_data[] = {
-    {0.0f, 0.0f, -1.0f, 1.0f}, {0.0f, 0.0f, -1.0f, 1.0f},
-    {0.0f, 0.0f, -1.0f, 1.0f}, {0.0f, 0.0f, -1.0f, 1.0f},
+static const i8 s_default_normal_data[] = {
+    0, 0, -127, 127, 0, 0, -127, 127,
+    0, 0, -127, 127, 0, 0, -127, 127,
 };
 static HgTexture* s_default_normal_map;
 
-void hg_3d_renderer_init(void) {
-    HgVertexAttribute vertex_attributes[] = {{
-        .format = HG_FORMAT_R32G32B32_SFLOAT,
-        .offset = offsetof(HgVertex3D, position),
-    }, {
-        .format = HG_FORMAT_R32G32B32_SFLOAT,
-        .offset = offsetof(HgVertex3D, normal),
-    }, {
-        .format = HG_FORMAT_R32G32B32A32_SFLOAT,
-        .offset = offsetof(HgVertex3D, tangent),
-    }, {
-        .format = HG_FORMAT_R32G32_SFLOAT,
-        .offset = offsetof(HgVertex3D, uv),
-    }};
-    HgVertexBinding vertex_bindings[] = {{
-        .attributes = vertex_attributes,
-        .attribute_count = HG_ARRAY_SIZE(vertex_attributes),
-        .stride = sizeof(HgVertex3D),
-    }};
+static HgBuffer* hg_tracked_buffer_create(const HgBufferConfig* config, HgMemoryCategory3D category, const char* name) {
+    HgBuffer* buffer = hg_buffer_create(config);
+    hg_memory_track(&s_memory, buffer, config->size, category, name, atomic_load(&s_frame_number));
+    return buffer;
+}
 
-    HgDescriptorSetBinding world_set_bindings[] = {{
-        .descriptor_type = HG_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-        .descriptor_count = 1,
-    }, {
-        .descriptor_type = HG_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-        .descriptor_count = 1,
-    }, {
-        .descriptor_type = HG_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-        .descriptor_count = 1,
-    }};
-    HgDescriptorSetBinding object_set_bindings[] = {{
-        .descriptor_type = HG_DESCRIPTOR_TYPE_SAMPLED_TEXTURE,
-        .descriptor_count = 2,
-    }};
-    HgDescriptorSet descriptor_sets[] = {{
-        .bindings = world_set_bindings,
-        .binding_count = HG_ARRAY_SIZE(world_set_bindings),
-    }, {
-        .bindings = object_set_bindings,
-        .binding_count = HG_ARRAY_SIZE(object_set_bindings),
-    }};
+static void hg_tracked_buffer_destroy(HgBuffer* buffer) {
+    hg_memory_untrack(&s_memory, buffer);
+    hg_buffer_destroy(buffer);
+}
 
-    s_shader = hg_shader_create(&(HgShaderConfig){
-        .color_format = HG_FORMAT_R8G8B8A8_UNORM,
-        .depth_format = HG_FORMAT_D32_SFLOAT,
-        .spirv_vertex_shader = model_vert_spv,
-        .vertex_shader_size = (u32)model_vert_spv_size,
-        .spirv_fragment_shader = model_frag_spv,
-        .fragment_shader_size = (u32)model_frag_spv_size,
-        .vertex_bindings = vertex_bindings,
-        .vertex_binding_count = HG_ARRAY_SIZE(vertex_bindings),
-        .descriptor_sets = descriptor_sets,
-        .descriptor_set_count = HG_ARRAY_SIZE(descriptor_sets),
-        .push_constant_size = sizeof(HgModelPush),
-        .topology = HG_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-        .cull_mode = HG_CULL_MODE_BACK_BIT,
-        .enable_color_blend = false,
-    });
+static HgTexture* hg_tracked_texture_create(
+    const HgTextureConfig* config, usize size, HgMemoryCategory3D category, const char* name
+) {
+    HgTexture* texture = hg_texture_create(config);
+    hg_memory_track(&s_memory, texture, size, category, name, atomic_load(&s_frame_number));
+    return texture;
+}
 
-    s_world_buffer = hg_buffer_create(&(HgBufferConfig){
-        .size = sizeof(HgWorldUniform),
-        .usage = HG_BUFFER_USAGE_UNIFORM_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
-    });
+static void hg_tracked_texture_destroy(HgTexture* texture) {
+    hg_memory_untrack(&s_memory, texture);
+    hg_texture_destroy(texture);
+}
 
-    s_dir_light_capacity = 32;
-    s_dir_light_count = 0;
-    s_dir_lights = hg_heap_alloc(s_dir_light_capacity * sizeof(HgDirectionalLight));
+static void hg_frame_buffer_create(HgFrameBuffer* frame_buffer, const char* name, const HgBufferConfig* config) {
+    frame_buffer->name = name;
+    frame_buffer->config = *config;
+    for (u32 i = 0; i < HG_3D_FRAMES_IN_FLIGHT; ++i) {
+        frame_buffer->buffers[i] = hg_tracked_buffer_create(config, HG_MEMORY_CATEGORY_3D_FRAME, name);
+        frame_buffer->capacities[i] = config->size;
+    }
+}
 
-    s_dir_light_buffer = hg_buffer_create(&(HgBufferConfig){
-        .size = sizeof(HgDirectionalLight) * s_dir_light_capacity,
-        .usage = HG_BUFFER_USAGE_STORAGE_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
-    });
+// Only call once the GPU is idle
+static void hg_frame_buffer_destroy(HgFrameBuffer* frame_buffer) {
+    for (u32 i = 0; i < HG_3D_FRAMES_IN_FLIGHT; ++i) {
+        hg_tracked_buffer_destroy(frame_buffer->buffers[i]);
+    }
+}
 
-    s_point_light_capacity = 128;
-    s_point_light_count = 0;
-    s_point_lights = hg_heap_alloc(s_point_light_capacity * sizeof(HgPointLight));
+static void hg_resource_retire(HgRetiredResource resource) {
+    if (s_retired_resource_count >= s_retired_resource_capacity) {
+        s_retired_resource_capacity *= 2;
+        s_retired_resources = hg_heap_realloc(
+            s_retired_resources, s_retired_resource_capacity * sizeof(HgRetiredResource)
+        );
+    }
+    resource.frame = atomic_load(&s_frame_number);
+    s_retired_resources[s_retired_resource_count++] = resource;
+}
 
-    s_point_light_buffer = hg_buffer_create(&(HgBufferConfig){
-        .size = sizeof(HgPointLight) * s_point_light_capacity,
-        .usage = HG_BUFFER_USAGE_STORAGE_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
-    });
+static void hg_buffer_retire(HgBuffer* buffer) {
+    hg_resource_retire((HgRetiredResource){.buffer = buffer});
+}
 
-    s_model_ticket_capacity = 1024;
-    s_model_ticket_count = 0;
-    s_model_tickets = hg_heap_alloc(s_model_ticket_capacity * sizeof(HgModelTicket));
+static void hg_retired_resource_destroy(const HgRetiredResource* resource) {
+    if (resource->buffer != NULL)
+        hg_tracked_buffer_destroy(resource->buffer);
+    else
+        hg_tracked_texture_destroy(resource->texture);
+}
 
-    s_default_color_map = hg_3d_texture_map_create(
-        s_default_color_data,
-        2, 2,
-        HG_FORMAT_R8G8B8A8_UNORM,
-        false
-    );
-    s_default_normal_map = hg_3d_texture_map_create(
-        s_default_normal_data, 
-        2, 2,
-        HG_FORMAT_R32G32B32A32_SFLOAT,
-        false
-    );
+static void hg_retired_resources_collect(void) {
+    u64 frame_number = atomic_load(&s_frame_number);
+    u32 kept = 0;
+    for (u32 i = 0; i < s_retired_resource_count; ++i) {
+        if (s_retired_resources[i].frame + HG_3D_FRAMES_IN_FLIGHT <= frame_number) {
+            hg_retired_resource_destroy(&s_retired_resources[i]);
+        } else {
+            s_retired_resources[kept++] = s_retired_resources[i];
+        }
+    }
+    s_retired_resource_count = kept;
 }
 
-void hg_3d_renderer_shutdown(void) {
-    hg_texture_destroy(s_default_normal_map);
-    hg_texture_destroy(s_default_color_map);
-    hg_buffer_destroy(s_point_light_buffer);
-    hg_buffer_destroy(s_dir_light_buffer);
-    hg_buffer_destroy(s_world_buffer);
-    hg_shader_destroy(s_shader);
+static HgBuffer* hg_vertex_pool_buffer_create(u32 capacity) {
+    return hg_tracked_buffer_create(&(HgBufferConfig){
+        .size = sizeof(HgVertex3D) * capacity,
+        .usage = HG_BUFFER_USAGE_VERTEX_BUFFER_BIT
+               | HG_BUFFER_USAGE_STORAGE_BUFFER_BIT
+               | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
+    }, HG_MEMORY_CATEGORY_3D_MESH, "vertex pool");
 }
 
-void hg_3d_renderer_target_create(u32 width, u32 height, HgTexture** target, HgTexture** depth_buffer) {
-    HG_ASSERT(target != NULL);
-    HG_ASSERT(depth_buffer != NULL);
+static void hg_vertex_pool_refill(u32 used) {
+    hg_buffer_retire(s_vertex_pool_buffer);
+    s_vertex_pool_buffer = hg_vertex_pool_buffer_create(s_vertex_pool.capacity);
+    if (used > 0)
+        hg_buffer_write(s_vertex_pool_buffer, 0, s_vertex_pool_shadow, sizeof(HgVertex3D) * used);
+}
 
-    *target = hg_texture_create(&(HgTextureConfig){
-        .width = width,
-        .height = height,
-        .depth = 1,
-        .array_layers = 1,
-        .mip_levels = 1,
-        .format = HG_FORMAT_R8G8B8A8_UNORM,
-        .aspect = HG_TEXTURE_ASPECT_COLOR_BIT,
-        .usage = HG_TEXTURE_USAGE_RENDER_TARGET_BIT | HG_TEXTURE_USAGE_TRANSFER_SRC_BIT,
-    });
+static void hg_vertex_pool_grow(u32 size) {
+    u32 old_capacity = s_vertex_pool.capacity;
 
-    *depth_buffer = hg_texture_create(&(HgTextureConfig){
-        .width = width,
-        .height = height,
-        .depth = 1,
-        .array_layers = 1,
-        .mip_levels = 1,
-        .format = HG_FORMAT_D32_SFLOAT,
-        .aspect = HG_TEXTURE_ASPECT_DEPTH_BIT,
-        .usage = HG_TEXTURE_USAGE_DEPTH_BUFFER_BIT | HG_TEXTURE_USAGE_TRANSFER_SRC_BIT,
-    });
+    // A free range at the end joins the new space
+    u32 tail_free = 0;
+    if (s_vertex_pool.free_count > 0) {
+        HgRange3D last = s_vertex_pool.free_ranges[s_vertex_pool.free_count - 1];
+        if (last.offset + last.size == old_capacity)
+            tail_free = last.size;
+    }
+
+    u32 capacity = old_capacity;
+    while (capacity - old_capacity + tail_free < size) {
+        capacity *= 2;
+    }
+    hg_suballocator_grow(&s_vertex_pool, capacity);
+    s_vertex_pool_shadow = hg_heap_realloc(s_vertex_pool_shadow, sizeof(HgVertex3D) * capacity);
+    hg_vertex_pool_refill(old_capacity - tail_free);
 }
 
-HgBuffer* hg_3d_vertex_buffer_create(const HgVertex3D* vertices, u32 vertex_count) {
-    HG_ASSERT(vertices != NULL);
-    HG_ASSERT(vertex_count > 0);
+static void hg_pool_frees_collect(void) {
+    u64 frame_number = atomic_load(&s_frame_number);
+    u32 kept = 0;
+    for (u32 i = 0; i < s_pool_free_count; ++i) {
+        if (s_pool_frees[i].frame + HG_3D_FRAMES_IN_FLIGHT <= frame_number) {
+            hg_suballocator_free(&s_vertex_pool, s_pool_frees[i].offset, s_pool_frees[i].size);
+        } else {
+            s_pool_frees[kept++] = s_pool_frees[i];
+        }
+    }
+    s_pool_free_count = kept;
+}
 
-    HgBuffer* buffer = hg_buffer_create(&(HgBufferConfig){
-        .size = sizeof(HgVertex3D) * vertex_count,
-        .usage = HG_BUFFER_USAGE_VERTEX_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
-    });
-    hg_buffer_write(buffer, 0, vertices, sizeof(HgVertex3D) * vertex_count);
+// Returns true if the buffer was replaced, losing its contents
+static bool hg_frame_buffer_grow(HgFrameBuffer* frame_buffer, u32 frame, usize size) {
+    if (size <= frame_buffer->capacities[frame])
+        return false;
 
-    return buffer;
+    usize capacity = frame_buffer->capacities[frame];
+    while (size > capacity) {
+        capacity *= 2;
+    }
+
+    hg_buffer_retire(frame_buffer->buffers[frame]);
+    HgBufferConfig config = frame_buffer->config;
+    config.size = capacity;
+    frame_buffer->buffers[frame] = hg_tracked_buffer_create(&config, HG_MEMORY_CATEGORY_3D_FRAME, frame_buffer->name);
+    frame_buffer->capacities[frame] = capacity;
+    return true;
 }
 
-HgBuffer* hg_3d_index_buffer_create(const u32* indices, u32 index_count) {
-    HG_ASSERT(indices != NULL);
-    HG_ASSERT(index_count > 0);
+static bool hg_frame_buffer_reserve(HgFrameBuffer* frame_buffer, usize size) {
+    return hg_frame_buffer_grow(frame_buffer, s_frame_index, size);
+}
 
-    HgBuffer* buffer = hg_buffer_create(&(HgBufferConfig){
-        .size = sizeof(u32) * index_count,
-        .usage = HG_BUFFER_USAGE_INDEX_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
-    });
-    hg_buffer_write(buffer, 0, indices, sizeof(u32) * index_count);
+static HgBuffer* hg_frame_buffer_upload(HgFrameBuffer* frame_buffer, const void* data, usize size) {
+    (void)hg_frame_buffer_reserve(frame_buffer, size);
 
+    HgBuffer* buffer = frame_buffer->buffers[s_frame_index];
+    if (size > 0)
+        hg_buffer_write(buffer, 0, data, size);
     return buffer;
 }
 
-HgTexture* hg_3d_texture_map_create(const void* data, u32 width, u32 height, HgFormat format, bool filter) {
-    HG_ASSERT(data != NULL);
-    HG_ASSERT(width > 0);
-    HG_ASSERT(height > 0);
+// The most a frame takes from the ring, with alignment
+static usize hg_frame_ring_bound(
+    usize transform_count, usize dir_light_count, usize point_light_count, usize cluster_size
+) {
+    return sizeof(HgModelTransform) * transform_count
+        + sizeof(HgModelInstance) * (transform_count + 1)
+        + sizeof(HgDirectionalLight) * (dir_light_count + 1)
+        + sizeof(HgPointLight) * (point_light_count + 1)
+        + sizeof(u32) * (cluster_size + 1);
+}
+
+static void hg_frame_ring_create(usize region_size) {
+    region_size = (region_size + sizeof(HgModelTransform) - 1) / sizeof(HgModelTransform) * sizeof(HgModelTransform);
+    s_frame_ring = (HgFrameRing){
+        .buffer = hg_tracked_buffer_create(&(HgBufferConfig){
+            .size = region_size * HG_3D_FRAMES_IN_FLIGHT,
+            .usage = HG_BUFFER_USAGE_STORAGE_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
+        }, HG_MEMORY_CATEGORY_3D_FRAME, "frame ring"),
+        .region_size = region_size,
+    };
+}
+
+// Returns true if the buffer was replaced, losing every frame's contents
+static bool hg_frame_ring_grow(usize size) {
+    if (size <= s_frame_ring.region_size)
+        return false;
 
-    HgTexture* texture = hg_texture_create(&(HgTextureConfig){
+    usize region_size = s_frame_ring.region_size;
+    while (size > region_size) {
+        region_size *= 2;
+    }
+    hg_buffer_retire(s_frame_ring.buffer);
+    hg_frame_ring_create(region_size);
+    return true;
+}
+
+static usize hg_frame_ring_region(void) {
+    return s_frame_ring.region_size * s_frame_index;
+}
+
+// Returns data's offset in elements
+static u32 hg_frame_ring_upload(const void* data, usize count, usize element_size) {
+    usize begin = hg_frame_ring_region();
+    usize offset = (begin + s_frame_ring.used + element_size - 1) / element_size * element_size;
+    HG_ASSERT(offset + element_size * count <= begin + s_frame_ring.region_size);
+
+    if (count > 0)
+        hg_buffer_write(s_frame_ring.buffer, offset, data, element_size * count);
+    s_frame_ring.used = offset + element_size * count - begin;
+    return (u32)(offset / element_size);
+}
+
+static HgFormat hg_texture_map_format(HgFormat format, HgTextureCompression3D compression) {
+    switch (compression) {
+        case HG_TEXTURE_COMPRESSION_3D_NONE:
+            return format;
+        case HG_TEXTURE_COMPRESSION_3D_BC1:
+            return format == HG_FORMAT_R8G8B8A8_SRGB ? HG_FORMAT_BC1_RGBA_SRGB_BLOCK : HG_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case HG_TEXTURE_COMPRESSION_3D_BC5:
+            return HG_FORMAT_BC5_SNORM_BLOCK;
+        case HG_TEXTURE_COMPRESSION_3D_BC7:
+            return format == HG_FORMAT_R8G8B8A8_SRGB ? HG_FORMAT_BC7_SRGB_BLOCK : HG_FORMAT_BC7_UNORM_BLOCK;
+    }
+    return format;
+}
+
+static HgTexture* hg_texture_map_texture_create(u32 width, u32 height, HgFormat gpu_format, u32 mip_levels, u32 flags) {
+    return hg_tracked_texture_create(&(HgTextureConfig){
         .width = width,
         .height = height,
         .depth = 1,
         .array_layers = 1,
-        .mip_levels = 1,
-        .format = format,
+        .mip_levels = mip_levels,
+        .format = gpu_format,
         .aspect = HG_TEXTURE_ASPECT_COLOR_BIT,
         .usage = HG_TEXTURE_USAGE_SAMPLED_BIT | HG_TEXTURE_USAGE_TRANSFER_DST_BIT,
         .edge_mode = HG_SAMPLER_EDGE_MODE_REPEAT,
-        .bilinear_filter = filter,
-    });
-    hg_texture_write(texture, data, HG_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-    return texture;
+        .bilinear_filter = (flags & HG_TEXTURE_MAP_3D_FILTER_BIT) != 0,
+    }, hg_texture_mip_chain_size(width, height, mip_levels, gpu_format), HG_MEMORY_CATEGORY_3D_TEXTURE, "texture map");
 }
 
-void hg_3d_renderer_update_projection(f32 fov, f32 aspect, f32 near, f32 far) {
-    HgMat4 proj = hg_projection_matrix_perspective(fov, aspect, near, far);
-    hg_buffer_write(s_world_buffer, offsetof(HgWorldUniform, proj), &proj, sizeof(proj));
+#define HG_UPLOAD_DEFAULT_BUDGET (8u << 20)
+
+static HgUploadQueue3D s_uploads;
+static usize s_upload_budget;
+
+static void hg_uploads_drain(usize budget) {
+    usize bytes;
+    s_stats.uploads_completed += hg_upload_queue_drain(&s_uploads, budget, &bytes);
+    s_stats.upload_bytes += bytes;
 }
 
-void hg_3d_renderer_update_view(HgVec3 position, f32 zoom, HgQuat rotation) {
-    HgMat4 view = hg_view_matrix(position, zoom, rotation);
-    hg_buffer_write(s_world_buffer, offsetof(HgWorldUniform, view), &view, sizeof(view));
+static bool hg_pending(const void* resource) {
+    return hg_upload_queue_pending(&s_uploads, resource);
 }
 
-void hg_3d_renderer_queue_directional_light(HgVec3 direction, HgVec3 color, f32 intensity) {
-    if (s_dir_light_count >= s_dir_light_capacity) {
-        s_dir_light_capacity *= 2;
-        s_dir_lights = hg_heap_realloc(s_dir_lights, s_dir_light_capacity * sizeof(HgDirectionalLight));
+static HgVertexAttribute s_vertex_attributes[] = {{
+    .format = HG_FORMAT_R32G32B32_SFLOAT,
+    .offset = offsetof(HgVertex3D, position),
+}, {
+    .format = HG_FORMAT_R32G32B32_SFLOAT,
+    .offset = offsetof(HgVertex3D, normal),
+}, {
+    .format = HG_FORMAT_R32G32B32A32_SFLOAT,
+    .offset = offsetof(HgVertex3D, tangent),
+}, {
+    .format = HG_FORMAT_R32G32_SFLOAT,
+    .offset = offsetof(HgVertex3D, uv),
+}};
+static HgVertexBinding s_vertex_bindings[] = {{
+    .attributes = s_vertex_attributes,
+    .attribute_count = HG_ARRAY_SIZE(s_vertex_attributes),
+    .stride = sizeof(HgVertex3D),
+}};
 
-        hg_buffer_destroy(s_dir_light_buffer);
-        s_dir_light_buffer = hg_buffer_create(&(HgBufferConfig){
-            .size = sizeof(HgDirectionalLight) * s_dir_light_capacity,
-            .usage = HG_BUFFER_USAGE_STORAGE_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
-        });
-    }
+static HgVertexAttribute s_packed_vertex_attributes[] = {{
+    .format = HG_FORMAT_R16G16B16A16_SNORM,
+    .offset = offsetof(HgPackedVertex3D, position),
+}, {
+    .format = HG_FORMAT_R16G16_SNORM,
+    .offset = offsetof(HgPackedVertex3D, normal),
+}, {
+    .format = HG_FORMAT_R16G16_SNORM,
+    .offset = offsetof(HgPackedVertex3D, tangent),
+}, {
+    .format = HG_FORMAT_R16G16_SFLOAT,
+    .offset = offsetof(HgPackedVertex3D, uv),
+}};
+static HgVertexBinding s_packed_vertex_bindings[] = {{
+    .attributes = s_packed_vertex_attributes,
+    .attribute_count = HG_ARRAY_SIZE(s_packed_vertex_attributes),
+    .stride = sizeof(HgPackedVertex3D),
+}};
 
-    s_dir_lights[s_dir_light_count] = (HgDirectionalLight){
-        .direction = {direction.x, direction.y, direction.z, 1.0f},
-            .color = {color.x, color.y, color.z, intensity},
+static HgDescriptorSetBinding s_world_set_bindings[] = {{
+    .descriptor_type = HG_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+    .descriptor_count = 1,
+}, {
+    .descriptor_type = HG_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    .descriptor_count = 1,
+}, {
+    .descriptor_type = HG_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    .descriptor_count = 1,
+}, {
+    .descriptor_type = HG_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    .descriptor_count = 1,
+}, {
+    .descriptor_type = HG_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    .descriptor_count = 1,
+}, {
+    .descriptor_type = HG_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    .descriptor_count = 1,
+}, {
+    .descriptor_type = HG_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    .descriptor_count = 1,
+}};
+static HgDescriptorSetBinding s_material_set_bindings[] = {{
+    .descriptor_type = HG_DESCRIPTOR_TYPE_SAMPLED_TEXTURE,
+    .descriptor_count = HG_MATERIAL_TABLE_SIZE,
+}};
+static HgDescriptorSet s_descriptor_sets[] = {{
+    .bindings = s_world_set_bindings,
+    .binding_count = HG_ARRAY_SIZE(s_world_set_bindings),
+}, {
+    .bindings = s_material_set_bindings,
+    .binding_count = HG_ARRAY_SIZE(s_material_set_bindings),
+}};
+
+// Pooled shaders keep the float layout, so the pool binds as a vertex buffer
+static HgShaderConfig hg_shader_config(HgVertexSource source) {
+    HgShaderConfig config = {
+        .color_format = HG_FORMAT_R8G8B8A8_UNORM,
+        .depth_format = HG_FORMAT_D32_SFLOAT,
+        .vertex_bindings = s_vertex_bindings,
+        .vertex_binding_count = HG_ARRAY_SIZE(s_vertex_bindings),
+        .descriptor_sets = s_descriptor_sets,
+        .descriptor_set_count = HG_ARRAY_SIZE(s_descriptor_sets),
+        .topology = HG_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .cull_mode = HG_CULL_MODE_BACK_BIT,
+        .enable_color_blend = false,
     };
-    ++s_dir_light_count;
+    if (source == HG_VERTEX_SOURCE_PACKED) {
+        config.vertex_bindings = s_packed_vertex_bindings;
+        config.vertex_binding_count = HG_ARRAY_SIZE(s_packed_vertex_bindings);
+    }
+    return config;
+}
+
+static void hg_model_frag_spirv(u32 variant, const u8** spirv, u32* size) {
+    switch (variant) {
+        case 0: *spirv = model_0_frag_spv; *size = (u32)model_0_frag_spv_size; break;
+        case 1: *spirv = model_1_frag_spv; *size = (u32)model_1_frag_spv_size; break;
+        case 2: *spirv = model_2_frag_spv; *size = (u32)model_2_frag_spv_size; break;
+        case 3: *spirv = model_3_frag_spv; *size = (u32)model_3_frag_spv_size; break;
+        case 4: *spirv = model_4_frag_spv; *size = (u32)model_4_frag_spv_size; break;
+        case 5: *spirv = model_5_frag_spv; *size = (u32)model_5_frag_spv_size; break;
+        case 6: *spirv = model_6_frag_spv; *size = (u32)model_6_frag_spv_size; break;
+        case 7: *spirv = model_7_frag_spv; *size = (u32)model_7_frag_spv_size; break;
+        default: *spirv = model_8_frag_spv; *size = (u32)model_8_frag_spv_size; break;
+    }
 }
 
-void hg_3d_renderer_queue_point_light(HgVec3 position, HgVec3 color, f32 intensity) {
-    if (s_point_light_count >= s_point_light_capacity) {
-        s_point_light_capacity *= 2;
-        s_point_lights = hg_heap_realloc(s_point_lights, s_point_light_capacity * sizeof(HgPointLight));
+static HgShader* hg_shader_get(HgVertexSource source, u32 variant) {
+    HG_ASSERT(variant < HG_SHADER_VARIANT_COUNT);
+    if (s_shaders[source][variant] != NULL)
+        return s_shaders[source][variant];
 
-        hg_buffer_destroy(s_point_light_buffer);
-        s_point_light_buffer = hg_buffer_create(&(HgBufferConfig){
-            .size = sizeof(HgPointLight) * s_point_light_capacity,
-            .usage = HG_BUFFER_USAGE_STORAGE_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
-        });
+    hg_profiler_begin("shader create");
+    HgShaderConfig config = hg_shader_config(source);
+    switch (source) {
+        case HG_VERTEX_SOURCE_PACKED:
+            config.spirv_vertex_shader = model_packed_vert_spv;
+            config.vertex_shader_size = (u32)model_packed_vert_spv_size;
+            break;
+        case HG_VERTEX_SOURCE_POOLED:
+            config.spirv_vertex_shader = model_pooled_vert_spv;
+            config.vertex_shader_size = (u32)model_pooled_vert_spv_size;
+            break;
+        default:
+            config.spirv_vertex_shader = model_vert_spv;
+            config.vertex_shader_size = (u32)model_vert_spv_size;
+            break;
     }
+    hg_model_frag_spirv(variant, &config.spirv_fragment_shader, &config.fragment_shader_size);
+    config.push_constant_size = sizeof(HgModelPush);
 
-    s_point_lights[s_point_light_count] = (HgPointLight){
-        .position = {position.x, position.y, position.z, 1.0f},
-        .color = {color.x, color.y, color.z, intensity},
-    };
-    ++s_point_light_count;
+    s_shaders[source][variant] = hg_shader_create(&config);
+    ++s_shader_count;
+    hg_profiler_end();
+    return s_shaders[source][variant];
 }
 
-void hg_3d_renderer_queue_model(HgModel3D* model, HgTransform3D* transform) {
-    HG_ASSERT(model != NULL);
-    HG_ASSERT(transform != NULL);
+static HgShader* hg_depth_shader_get(HgVertexSource source) {
+    if (s_depth_shaders[source] != NULL)
+        return s_depth_shaders[source];
 
-    if (s_model_ticket_count >= s_model_ticket_capacity) {
-        s_model_ticket_capacity *= 2;
-        s_model_tickets = hg_heap_realloc(s_model_tickets, s_model_ticket_capacity * sizeof(HgModelTicket));
+    hg_profiler_begin("shader create");
+    HgShaderConfig config = hg_shader_config(source);
+    switch (source) {
+        case HG_VERTEX_SOURCE_PACKED:
+            config.spirv_vertex_shader = depth_packed_vert_spv;
+            config.vertex_shader_size = (u32)depth_packed_vert_spv_size;
+            break;
+        case HG_VERTEX_SOURCE_POOLED:
+            config.spirv_vertex_shader = depth_pooled_vert_spv;
+            config.vertex_shader_size = (u32)depth_pooled_vert_spv_size;
+            break;
+        default:
+            config.spirv_vertex_shader = depth_vert_spv;
+            config.vertex_shader_size = (u32)depth_vert_spv_size;
+            break;
     }
+    config.spirv_fragment_shader = depth_frag_spv;
+    config.fragment_shader_size = (u32)depth_frag_spv_size;
+    config.push_constant_size = sizeof(HgDepthPush);
 
-    s_model_tickets[s_model_ticket_count] = (HgModelTicket){
-        .model = *model,
-        .push = (HgModelPush){
-            .model = hg_model_matrix_3d(transform->position, transform->scale, transform->rotation),
-        },
-    };
-    ++s_model_ticket_count;
+    s_depth_shaders[source] = hg_shader_create(&config);
+    ++s_shader_count;
+    hg_profiler_end();
+    return s_depth_shaders[source];
 }
 
-void hg_3d_renderer_draw(HgTexture* target, HgTexture* depth_buffer) {
-    HG_ASSERT(target != NULL);
-    HG_ASSERT(depth_buffer != NULL);
+static HgDescriptorSetBinding s_upscale_set_bindings[] = {{
+    .descriptor_type = HG_DESCRIPTOR_TYPE_SAMPLED_TEXTURE,
+    .descriptor_count = 1,
+}};
+static HgDescriptorSet s_upscale_descriptor_sets[] = {{
+    .bindings = s_upscale_set_bindings,
+    .binding_count = HG_ARRAY_SIZE(s_upscale_set_bindings),
+}};
 
-    hg_buffer_write(
-        s_world_buffer, offsetof(HgWorldUniform, dir_light_count), &s_dir_light_count, sizeof(s_dir_light_count)
-    );
-    hg_buffer_write(
-        s_world_buffer, offsetof(HgWorldUniform, point_light_count), &s_point_light_count, sizeof(s_point_light_count)
-    );
+static HgShader* hg_upscale_shader_get(void) {
+    if (s_upscale_shader != NULL)
+        return s_upscale_shader;
 
-    if (s_dir_light_count > 0)
-        hg_buffer_write(s_dir_light_buffer, 0, s_dir_lights, sizeof(HgDirectionalLight) * s_dir_light_count);
-    if (s_point_light_count > 0) {
-        hg_buffer_write(s_point_light_buffer, 0, s_point_lights, sizeof(HgPointLight) * s_point_light_count);
-    }
+    hg_profiler_begin("shader create");
+    HgShaderConfig config = hg_shader_config(HG_VERTEX_SOURCE_FLOAT);
+    config.spirv_vertex_shader = upscale_vert_spv;
+    config.vertex_shader_size = (u32)upscale_vert_spv_size;
+    config.spirv_fragment_shader = upscale_frag_spv;
+    config.fragment_shader_size = (u32)upscale_frag_spv_size;
+    config.descriptor_sets = s_upscale_descriptor_sets;
+    config.descriptor_set_count = HG_ARRAY_SIZE(s_upscale_descriptor_sets);
+    config.push_constant_size = sizeof(HgUpscalePush);
+    config.cull_mode = HG_CULL_MODE_NONE;
 
-    hg_renderpass_begin(target, depth_buffer, true, true);
+    s_upscale_shader = hg_shader_create(&config);
+    ++s_shader_count;
+    hg_profiler_end();
+    return s_upscale_shader;
+}
 
-    hg_shader_bind(s_shader);
+void hg_3d_renderer_prepare_shaders(void) {
+    hg_render_thread_wait();
 
-    HgDescriptor world_descriptor_set[] = {{
-        .type = HG_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-        .count = 1,
-        .buffers = &s_world_buffer,
-    }, {
-        .type = HG_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-        .count = 1,
-        .buffers = &s_dir_light_buffer,
-    }, {
-        .type = HG_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-        .count = 1,
-        .buffers = &s_point_light_buffer,
-    }};
-    hg_bind_descriptor_set(0, world_descriptor_set, HG_ARRAY_SIZE(world_descriptor_set));
+    for (u32 source = 0; source < HG_VERTEX_SOURCE_COUNT; ++source) {
+        for (u32 variant = 0; variant < HG_SHADER_VARIANT_COUNT; ++variant) {
+            hg_shader_get((HgVertexSource)source, variant);
+        }
+        hg_depth_shader_get((HgVertexSource)source);
+    }
+    hg_upscale_shader_get();
+}
 
-    for (u32 i = 0; i < s_model_ticket_count; ++i) {
-        HgModel3D* model = &s_model_tickets[i].model;
+void hg_3d_renderer_init(void) {
+    hg_profiler_init();
 
-        HgTexture* textures[] = {
-            model->color_map != NULL ? model->color_map : s_default_color_map,
-            model->normal_map != NULL ? model->normal_map : s_default_normal_map,
-        };
-        HgDescriptor object_descriptor_set[] = {{
-            .type = HG_DESCRIPTOR_TYPE_SAMPLED_TEXTURE,
-            .count = 2,
-            .textures = textures,
-        }};
-        hg_bind_descriptor_set(1, object_descriptor_set, HG_ARRAY_SIZE(object_descriptor_set));
+    s_cull_spheres = hg_cull_spheres_base;
+    s_build_transforms = hg_build_transforms_base;
+#if defined(HG_3D_AVX_KERNELS) && (defined(__GNUC__) || defined(__clang__))
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        s_cull_spheres = hg_cull_spheres_avx;
+        s_build_transforms = hg_build_transforms_avx;
+    }
+#endif
 
-        hg_bind_push_constant(&s_model_tickets[i].push, sizeof(HgModelPush));
-        hg_draw(model->vertex_buffer, model->index_buffer, 0);
+    s_depth_prepass = false;
+    s_gpu_timing = false;
+    memset(s_shaders, 0, sizeof(s_shaders));
+    memset(s_depth_shaders, 0, sizeof(s_depth_shaders));
+    s_upscale_shader = NULL;
+    s_shader_count = 0;
+
+    s_pipelined = false;
+    s_render_packet = NULL;
+    s_packet_index = 0;
+    memset(s_packets, 0, sizeof(s_packets));
+    s_peak_models = 0;
+    s_peak_dir_lights = 0;
+    s_peak_point_lights = 0;
+    s_peak_arena_bytes = 0;
+    for (u32 i = 0; i < HG_ARRAY_SIZE(s_packets); ++i) {
+        hg_frame_arena_init(&s_packets[i].arena, HG_PACKET_ARENA_CAPACITY);
     }
+    s_submitted_stats = (HgRenderer3DStats){0};
+    s_submitted_result = HG_SUCCESS;
+    mtx_init(&s_render_mutex, mtx_plain);
+    cnd_init(&s_render_work);
+    cnd_init(&s_render_idle);
 
-    hg_renderpass_end();
+    atomic_store(&s_frame_number, 0);
+    s_frame_index = 0;
 
-    s_dir_light_count = 0;
-    s_point_light_count = 0;
-    s_model_ticket_count = 0;
-}
+    s_retired_resource_capacity = 32;
+    s_retired_resource_count = 0;
+    s_retired_resources = hg_heap_alloc(s_retired_resource_capacity * sizeof(HgRetiredResource));
+
+    hg_memory_tracker_init(&s_memory);
+
+    hg_suballocator_init(&s_vertex_pool, HG_VERTEX_POOL_INITIAL_CAPACITY);
+    s_vertex_pool_buffer = hg_vertex_pool_buffer_create(s_vertex_pool.capacity);
+    s_vertex_pool_shadow = hg_heap_alloc(sizeof(HgVertex3D) * s_vertex_pool.capacity);
+
+    s_mesh_capacity = 64;
+    s_mesh_count = 0;
+    s_meshes = hg_heap_alloc(s_mesh_capacity * sizeof(HgMesh3D*));
 
+    s_pool_free_capacity = 16;
+    s_pool_free_count = 0;
+    s_pool_frees = hg_heap_alloc(s_pool_free_capacity * sizeof(HgPoolFree));
+
+    s_merged_index_capacity = 64;
+    s_merged_index_count = 0;
+    s_merged_indices = hg_heap_alloc(s_merged_index_capacity * sizeof(HgMergedIndices*));
+    s_merged_copy_bytes = 0;
+
+    s_render_scale = 1.0f;
+    s_render_output = NULL;
+
+    // Texture coordinates run 0 to 1 over the screen, 2 at the far corners
+    HgVertex3D upscale_vertices[] = {
+        {.position = {-1.0f, -1.0f, 0.5f}, .uv = {0.0f, 0.0f}},
+        {.position = {3.0f, -1.0f, 0.5f}, .uv = {2.0f, 0.0f}},
+        {.position = {-1.0f, 3.0f, 0.5f}, .uv = {0.0f, 2.0f}},
+    };
+    u32 upscale_indices[] = {0, 1, 2};
+    s_upscale_vertex_buffer = hg_tracked_buffer_create(&(HgBufferConfig){
+        .size = sizeof(upscale_vertices),
+        .usage = HG_BUFFER_USAGE_VERTEX_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
+    }, HG_MEMORY_CATEGORY_3D_TARGET, "upscale vertices");
+    hg_buffer_write(s_upscale_vertex_buffer, 0, upscale_vertices, sizeof(upscale_vertices));
+    s_upscale_index_buffer = hg_tracked_buffer_create(&(HgBufferConfig){
+        .size = sizeof(upscale_indices),
+        .usage = HG_BUFFER_USAGE_INDEX_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
+    }, HG_MEMORY_CATEGORY_3D_TARGET, "upscale indices");
+    hg_buffer_write(s_upscale_index_buffer, 0, upscale_indices, sizeof(upscale_indices));
+
+    hg_frame_buffer_create(&s_world_buffer, "world", &(HgBufferConfig){
+        .size = sizeof(HgWorldUniform),
+        .usage = HG_BUFFER_USAGE_UNIFORM_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
+    });
+
+    s_dir_light_count = 0;
+    s_dir_lights = NULL;
+
+    s_point_light_count = 0;
+    s_point_lights = NULL;
+
+    hg_light_clusters_init(&s_light_clusters);
+
+    s_model_sort_keys = NULL;
+    s_model_sort_indices = NULL;
+    s_model_sort_count = 0;
+
+    // The levels above the first add up to about a third of it
+    hg_occlusion_init(&s_occlusion);
+
+    s_object_count = 0;
+    s_object_tickets = (HgTicketArrays){.capacity = 1024};
+    s_object_tickets.tickets = hg_heap_alloc(s_object_tickets.capacity * sizeof(HgModelTicket));
+    s_object_tickets.hot = hg_heap_alloc(s_object_tickets.capacity * sizeof(HgModelTicketHot));
+    s_object_tickets.bounds = hg_heap_alloc(4 * s_object_tickets.capacity * sizeof(f32));
+    s_objects = hg_heap_alloc(s_object_tickets.capacity * sizeof(HgObject3D*));
+    s_object_models = hg_heap_alloc(s_object_tickets.capacity * sizeof(HgModel3D));
+    s_object_dirty = hg_heap_alloc(s_object_tickets.capacity / 64 * sizeof(u64));
+    memset(s_object_dirty, 0, s_object_tickets.capacity / 64 * sizeof(u64));
+    s_object_pending = hg_heap_alloc(s_object_tickets.capacity / 64 * sizeof(u64));
+    memset(s_object_pending, 0, s_object_tickets.capacity / 64 * sizeof(u64));
+    s_object_pending_count = 0;
+    s_queued_count = 0;
+    s_queued_tickets = (HgTicketArrays){0};
+
+    s_transform_capacity = 1024;
+    s_transforms = hg_heap_alloc(s_transform_capacity * sizeof(HgModelTransform));
+    for (u32 i = 0; i < HG_3D_FRAMES_IN_FLIGHT; ++i) {
+        s_object_stale[i] = hg_heap_alloc(s_transform_capacity / 64 * sizeof(u64));
+        memset(s_object_stale[i], 0, s_transform_capacity / 64 * sizeof(u64));
+    }
+    hg_frame_ring_create(hg_frame_ring_bound(1024, 32, 128, 2 * HG_CLUSTER_COUNT + 8 * 128));
+
+    mtx_init(&s_context_mutex, mtx_plain);
+    s_contexts = NULL;
+    s_context_next_id = 0;
+    s_context_order_capacity = 8;
+    s_context_order = hg_heap_alloc(s_context_order_capacity * sizeof(HgRenderContext3D*));
+    s_main_context = hg_3d_render_context_create();
+
+    hg_upload_queue_init(&s_uploads);
+    s_upload_budget = HG_UPLOAD_DEFAULT_BUDGET;
+
+    s_material_table_capacity = 4;
+    s_material_table_count = 0;
+    s_material_textures = hg_heap_alloc(
+        s_material_table_capacity * HG_MATERIAL_TABLE_SIZE * sizeof(HgTexture*)
+    );
+    s_material_table_starts = hg_heap_alloc(s_material_table_capacity * sizeof(u32));
+
+    s_default_color_map = hg_3d_texture_map_create(
+        s_default_color_data,
+        2, 2,
+        HG_FORMAT_R8G8B8A8_UNORM,
+        HG_TEXTURE_COMPRESSION_3D_NONE,
+        0
+    );
+    s_default_normal_map = hg_3d_texture_map_create(
+        s_default_normal_data,
+        2, 2,
+        HG_FORMAT_R8G8B8A8_SNORM,
+        HG_TEXTURE_COMPRESSION_3D_NONE,
+        0
+    );
+}
+
+void hg_3d_renderer_shutdown(void) {
+    hg_3d_renderer_set_pipelined(false);
+    hg_upload_queue_destroy(&s_uploads);
+    hg_profiler_shutdown();
+
+    while (s_contexts != NULL) {
+        hg_3d_render_context_destroy(s_contexts);
+    }
+    hg_heap_free(s_context_order);
+    mtx_destroy(&s_context_mutex);
+
+    for (u32 i = 0; i < s_object_count; ++i) {
+        hg_heap_free(s_objects[i]);
+    }
+    for (u32 i = 0; i < HG_3D_FRAMES_IN_FLIGHT; ++i) {
+        hg_heap_free(s_object_stale[i]);
+    }
+    hg_heap_free(s_object_pending);
+    hg_heap_free(s_object_dirty);
+    hg_heap_free(s_object_models);
+    hg_heap_free(s_objects);
+    hg_heap_free(s_object_tickets.bounds);
+    hg_heap_free(s_object_tickets.hot);
+    hg_heap_free(s_object_tickets.tickets);
+    hg_heap_free(s_transforms);
+
+    hg_occlusion_destroy(&s_occlusion);
+    hg_heap_free(s_material_table_starts);
+    hg_heap_free(s_material_textures);
+    hg_light_clusters_destroy(&s_light_clusters);
+    hg_tracked_texture_destroy(s_default_normal_map);
+    hg_tracked_texture_destroy(s_default_color_map);
+    hg_tracked_buffer_destroy(s_frame_ring.buffer);
+    hg_frame_buffer_destroy(&s_world_buffer);
+    hg_tracked_buffer_destroy(s_upscale_index_buffer);
+    hg_tracked_buffer_destroy(s_upscale_vertex_buffer);
+
+    for (u32 i = 0; i < s_mesh_count; ++i) {
+        hg_heap_free(s_meshes[i]->occluder_positions);
+        hg_heap_free(s_meshes[i]->occluder_indices);
+        hg_heap_free(s_meshes[i]);
+    }
+    hg_heap_free(s_meshes);
+    hg_heap_free(s_pool_frees);
+    for (u32 i = 0; i < s_merged_index_count; ++i) {
+        HgMergedIndices* merged = s_merged_indices[i];
+        for (u32 level = 1; level < merged->level_count; ++level) {
+            hg_tracked_buffer_destroy(merged->levels[level]);
+        }
+        if (merged->indices != NULL)
+            hg_heap_free(merged->indices);
+        hg_heap_free(merged);
+    }
+    hg_heap_free(s_merged_indices);
+    hg_heap_free(s_vertex_pool_shadow);
+    hg_tracked_buffer_destroy(s_vertex_pool_buffer);
+    hg_suballocator_destroy(&s_vertex_pool);
+
+    for (u32 i = 0; i < s_retired_resource_count; ++i) {
+        hg_retired_resource_destroy(&s_retired_resources[i]);
+    }
+    hg_heap_free(s_retired_resources);
+
+    for (u32 i = 0; i < HG_ARRAY_SIZE(s_packets); ++i) {
+        hg_frame_arena_destroy(&s_packets[i].arena);
+    }
+    cnd_destroy(&s_render_idle);
+    cnd_destroy(&s_render_work);
+    mtx_destroy(&s_render_mutex);
+
+    for (u32 source = 0; source < HG_VERTEX_SOURCE_COUNT; ++source) {
+        for (u32 variant = 0; variant < HG_SHADER_VARIANT_COUNT; ++variant) {
+            if (s_shaders[source][variant] != NULL)
+                hg_shader_destroy(s_shaders[source][variant]);
+        }
+        if (s_depth_shaders[source] != NULL)
+            hg_shader_destroy(s_depth_shaders[source]);
+    }
+    if (s_upscale_shader != NULL)
+        hg_shader_destroy(s_upscale_shader);
+
+    // Everything the renderer made itself is gone, so whatever is left leaked
+    hg_memory_tracker_destroy(&s_memory);
+}
+
+void hg_3d_renderer_target_create(u32 width, u32 height, HgTexture** target, HgTexture** depth_buffer) {
+    HG_ASSERT(target != NULL);
+
+    hg_render_thread_wait();
+
+    hg_3d_renderer_set_target_size(width, height);
+
+    *target = hg_tracked_texture_create(&(HgTextureConfig){
+        .width = width,
+        .height = height,
+        .depth = 1,
+        .array_layers = 1,
+        .mip_levels = 1,
+        .format = HG_FORMAT_R8G8B8A8_UNORM,
+        .aspect = HG_TEXTURE_ASPECT_COLOR_BIT,
+        .usage = HG_TEXTURE_USAGE_RENDER_TARGET_BIT
+               | HG_TEXTURE_USAGE_TRANSFER_SRC_BIT
+               | HG_TEXTURE_USAGE_SAMPLED_BIT,
+        .bilinear_filter = true,
+    }, 4 * (usize)width * height, HG_MEMORY_CATEGORY_3D_TARGET, "render target");
+
+    if (depth_buffer == NULL)
+        return;
+    *depth_buffer = hg_tracked_texture_create(&(HgTextureConfig){
+        .width = width,
+        .height = height,
+        .depth = 1,
+        .array_layers = 1,
+        .mip_levels = 1,
+        .format = HG_FORMAT_D32_SFLOAT,
+        .aspect = HG_TEXTURE_ASPECT_DEPTH_BIT,
+        .usage = HG_TEXTURE_USAGE_DEPTH_BUFFER_BIT | HG_TEXTURE_USAGE_TRANSFER_SRC_BIT,
+    }, 4 * (usize)width * height, HG_MEMORY_CATEGORY_3D_TARGET, "depth buffer");
+}
+
+void hg_3d_renderer_set_target_size(u32 width, u32 height) {
+    s_target_width = (f32)width;
+    s_target_height = (f32)height;
+}
+
+void hg_3d_renderer_set_render_scale(f32 scale, HgTexture* output) {
+    HG_ASSERT(scale > 0.0f && scale <= 1.0f);
+    HG_ASSERT(output != NULL || scale == 1.0f);
+
+    s_render_scale = scale;
+    s_render_output = scale < 1.0f ? output : NULL;
+}
+
+HgBuffer* hg_3d_vertex_buffer_create(const HgVertex3D* vertices, u32 vertex_count, HgBounds3D* bounds) {
+    HG_ASSERT(vertices != NULL);
+    HG_ASSERT(vertex_count > 0);
+
+    hg_render_thread_wait();
+
+    if (bounds != NULL)
+        *bounds = hg_mesh_bounds(vertices, vertex_count);
+
+    HgBuffer* buffer = hg_tracked_buffer_create(&(HgBufferConfig){
+        .size = sizeof(HgVertex3D) * vertex_count,
+        .usage = HG_BUFFER_USAGE_VERTEX_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
+    }, HG_MEMORY_CATEGORY_3D_MESH, "vertex buffer");
+    hg_buffer_write(buffer, 0, vertices, sizeof(HgVertex3D) * vertex_count);
+
+    return buffer;
+}
+
+static i16 hg_pack_snorm16(f32 value) {
+    f32 clamped = fminf(fmaxf(value, -1.0f), 1.0f);
+    return (i16)lrintf(clamped * 32767.0f);
+}
+
+// Round to nearest even; values too small for a normal half flush to zero
+static u16 hg_pack_half(f32 value) {
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    u16 sign = (u16)((bits >> 16) & 0x8000);
+    i32 exponent = (i32)((bits >> 23) & 0xff) - 127 + 15;
+    u32 mantissa = bits & 0x7fffff;
+
+    if (exponent >= 31)
+        return (u16)(sign | 0x7c00 | (((bits >> 23) & 0xff) == 0xff && mantissa != 0 ? 0x200 : 0));
+    if (exponent <= 0)
+        return sign;
+
+    u32 half = (u32)exponent << 10 | mantissa >> 13;
+    u32 rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        ++half;
+    return (u16)(sign | half);
+}
+
+// Projects the unit vector onto an octahedron, then unfolds the lower half
+// over the upper, mapping every direction into [-1, 1]^2
+static void hg_pack_octahedral(HgVec3 v, i16 packed[2]) {
+    f32 l1 = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+    f32 x = l1 > 0.0f ? v.x / l1 : 0.0f;
+    f32 y = l1 > 0.0f ? v.y / l1 : 0.0f;
+    if (v.z < 0.0f) {
+        f32 folded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        f32 folded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = folded_x;
+        y = folded_y;
+    }
+    packed[0] = hg_pack_snorm16(x);
+    packed[1] = hg_pack_snorm16(y);
+}
+
+void hg_3d_pack_vertices(
+    const HgVertex3D* vertices,
+    u32 vertex_count,
+    HgPackedVertex3D* packed,
+    HgVertexQuantization3D* quantization,
+    HgBounds3D* bounds
+) {
+    HG_ASSERT(vertices != NULL);
+    HG_ASSERT(vertex_count > 0);
+    HG_ASSERT(packed != NULL);
+    HG_ASSERT(quantization != NULL);
+
+    if (bounds != NULL)
+        *bounds = hg_mesh_bounds(vertices, vertex_count);
+
+    HgVec3 min = vertices[0].position;
+    HgVec3 max = vertices[0].position;
+    for (u32 i = 1; i < vertex_count; ++i) {
+        HgVec3 p = vertices[i].position;
+        min = (HgVec3){fminf(min.x, p.x), fminf(min.y, p.y), fminf(min.z, p.z)};
+        max = (HgVec3){fmaxf(max.x, p.x), fmaxf(max.y, p.y), fmaxf(max.z, p.z)};
+    }
+
+    // A zero extent would divide by zero, and any scale decodes it exactly
+    quantization->offset = (HgVec3){(min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f};
+    quantization->scale = (HgVec3){
+        max.x > min.x ? (max.x - min.x) * 0.5f : 1.0f,
+        max.y > min.y ? (max.y - min.y) * 0.5f : 1.0f,
+        max.z > min.z ? (max.z - min.z) * 0.5f : 1.0f,
+    };
+
+    for (u32 i = 0; i < vertex_count; ++i) {
+        const HgVertex3D* v = &vertices[i];
+        HgPackedVertex3D* p = &packed[i];
+
+        p->position[0] = hg_pack_snorm16((v->position.x - quantization->offset.x) / quantization->scale.x);
+        p->position[1] = hg_pack_snorm16((v->position.y - quantization->offset.y) / quantization->scale.y);
+        p->position[2] = hg_pack_snorm16((v->position.z - quantization->offset.z) / quantization->scale.z);
+        p->position[3] = v->tangent.w < 0.0f ? -32767 : 32767;
+
+        hg_pack_octahedral(v->normal, p->normal);
+        hg_pack_octahedral((HgVec3){v->tangent.x, v->tangent.y, v->tangent.z}, p->tangent);
+
+        p->uv[0] = hg_pack_half(v->uv.x);
+        p->uv[1] = hg_pack_half(v->uv.y);
+    }
+}
+
+HgBuffer* hg_3d_packed_vertex_buffer_create(const HgPackedVertex3D* vertices, u32 vertex_count) {
+    HG_ASSERT(vertices != NULL);
+    HG_ASSERT(vertex_count > 0);
+
+    hg_render_thread_wait();
+
+    HgBuffer* buffer = hg_tracked_buffer_create(&(HgBufferConfig){
+        .size = sizeof(HgPackedVertex3D) * vertex_count,
+        .usage = HG_BUFFER_USAGE_VERTEX_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
+    }, HG_MEMORY_CATEGORY_3D_MESH, "packed vertex buffer");
+    hg_buffer_write(buffer, 0, vertices, sizeof(HgPackedVertex3D) * vertex_count);
+
+    return buffer;
+}
+
+HgMesh3D* hg_3d_mesh_create(const HgVertex3D* vertices, u32 vertex_count, HgBounds3D* bounds) {
+    HG_ASSERT(vertices != NULL);
+    HG_ASSERT(vertex_count > 0);
+
+    hg_render_thread_wait();
+
+    if (bounds != NULL)
+        *bounds = hg_mesh_bounds(vertices, vertex_count);
+
+    u32 offset;
+    if (!hg_suballocator_alloc(&s_vertex_pool, vertex_count, &offset)) {
+        hg_vertex_pool_grow(vertex_count);
+        bool allocated = hg_suballocator_alloc(&s_vertex_pool, vertex_count, &offset);
+        HG_ASSERT(allocated);
+        (void)allocated;
+    }
+    memcpy(s_vertex_pool_shadow + offset, vertices, sizeof(HgVertex3D) * vertex_count);
+    hg_buffer_write(s_vertex_pool_buffer, sizeof(HgVertex3D) * offset, vertices, sizeof(HgVertex3D) * vertex_count);
+
+    if (s_mesh_count == s_mesh_capacity) {
+        s_mesh_capacity *= 2;
+        s_meshes = hg_heap_realloc(s_meshes, s_mesh_capacity * sizeof(HgMesh3D*));
+    }
+    HgMesh3D* mesh = hg_heap_alloc(sizeof(HgMesh3D));
+    *mesh = (HgMesh3D){
+        .offset = offset,
+        .vertex_count = vertex_count,
+        .index = s_mesh_count,
+    };
+    s_meshes[s_mesh_count++] = mesh;
+    return mesh;
+}
+
+void hg_3d_mesh_destroy(HgMesh3D* mesh) {
+    HG_ASSERT(mesh != NULL);
+    HG_ASSERT(mesh->index < s_mesh_count && s_meshes[mesh->index] == mesh);
+
+    hg_render_thread_wait();
+
+    if (s_pool_free_count == s_pool_free_capacity) {
+        s_pool_free_capacity *= 2;
+        s_pool_frees = hg_heap_realloc(s_pool_frees, s_pool_free_capacity * sizeof(HgPoolFree));
+    }
+    s_pool_frees[s_pool_free_count++] = (HgPoolFree){
+        .offset = mesh->offset,
+        .size = mesh->vertex_count,
+        .frame = atomic_load(&s_frame_number),
+    };
+
+    s_meshes[mesh->index] = s_meshes[--s_mesh_count];
+    s_meshes[mesh->index]->index = mesh->index;
+    hg_heap_free(mesh->occluder_positions);
+    hg_heap_free(mesh->occluder_indices);
+    hg_heap_free(mesh);
+}
+
+void hg_3d_mesh_set_occluder(
+    HgMesh3D* mesh, const HgVec3* positions, u32 vertex_count, const u32* indices, u32 index_count
+) {
+    HG_ASSERT(mesh != NULL);
+    HG_ASSERT(mesh->index < s_mesh_count && s_meshes[mesh->index] == mesh);
+    HG_ASSERT(vertex_count == 0 || (positions != NULL && indices != NULL && index_count % 3 == 0));
+
+    hg_render_thread_wait();
+
+    hg_heap_free(mesh->occluder_positions);
+    hg_heap_free(mesh->occluder_indices);
+    mesh->occluder_positions = NULL;
+    mesh->occluder_indices = NULL;
+    mesh->occluder_vertex_count = 0;
+    mesh->occluder_index_count = 0;
+    if (vertex_count == 0 || index_count == 0)
+        return;
+
+    for (u32 i = 0; i < index_count; ++i) {
+        HG_ASSERT(indices[i] < vertex_count);
+    }
+    mesh->occluder_positions = hg_heap_alloc(vertex_count * sizeof(HgVec3));
+    memcpy(mesh->occluder_positions, positions, vertex_count * sizeof(HgVec3));
+    mesh->occluder_indices = hg_heap_alloc(index_count * sizeof(u32));
+    memcpy(mesh->occluder_indices, indices, index_count * sizeof(u32));
+    mesh->occluder_vertex_count = vertex_count;
+    mesh->occluder_index_count = index_count;
+}
+
+static int hg_mesh_offset_compare(const void* lhs, const void* rhs) {
+    u32 a = (*(HgMesh3D* const*)lhs)->offset;
+    u32 b = (*(HgMesh3D* const*)rhs)->offset;
+    return a < b ? -1 : a > b;
+}
+
+void hg_3d_renderer_defragment_meshes(void) {
+    hg_render_thread_wait();
+
+    // Moving every mesh down in offset order never overwrites one not yet
+    // moved, so the CPU copy compacts in place
+    qsort(s_meshes, s_mesh_count, sizeof(HgMesh3D*), hg_mesh_offset_compare);
+    u32 used = 0;
+    for (u32 i = 0; i < s_mesh_count; ++i) {
+        HgMesh3D* mesh = s_meshes[i];
+        if (mesh->offset != used)
+            memmove(s_vertex_pool_shadow + used, s_vertex_pool_shadow + mesh->offset,
+                sizeof(HgVertex3D) * mesh->vertex_count);
+        mesh->offset = used;
+        mesh->index = i;
+        used += mesh->vertex_count;
+    }
+
+    // Pending frees were in the old buffer, which is retired with them
+    s_pool_free_count = 0;
+    hg_suballocator_reset(&s_vertex_pool, used, s_mesh_count);
+    hg_vertex_pool_refill(used);
+}
+
+static u32 hg_merged_indices_find(const HgBuffer* source) {
+    u32 lo = 0;
+    u32 hi = s_merged_index_count;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if ((uintptr_t)s_merged_indices[mid]->source < (uintptr_t)source)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static HgMergedIndices* hg_merged_indices_get(const HgBuffer* source) {
+    u32 index = hg_merged_indices_find(source);
+    if (index < s_merged_index_count && s_merged_indices[index]->source == source)
+        return s_merged_indices[index];
+    return NULL;
+}
+
+static void hg_merged_indices_add(HgBuffer* source, const u32* indices, u32 index_count) {
+    if (index_count > HG_MERGE_MAX_INDICES)
+        return;
+
+    u32 vertex_stride = 0;
+    for (u32 i = 0; i < index_count; ++i) {
+        if (indices[i] >= vertex_stride)
+            vertex_stride = indices[i] + 1;
+    }
+    u32 max_level_count = 1;
+    while (max_level_count < HG_MERGE_MAX_LEVELS
+        && ((usize)index_count << max_level_count) <= HG_MERGE_MAX_LEVEL_INDICES
+        && ((u64)vertex_stride << max_level_count) <= UINT32_MAX) {
+        ++max_level_count;
+    }
+    if (max_level_count == 1 || s_merged_copy_bytes + sizeof(u32) * index_count > HG_MERGE_MAX_COPY_BYTES)
+        return;
+
+    if (s_merged_index_count == s_merged_index_capacity) {
+        s_merged_index_capacity *= 2;
+        s_merged_indices = hg_heap_realloc(s_merged_indices, s_merged_index_capacity * sizeof(HgMergedIndices*));
+    }
+    HgMergedIndices* merged = hg_heap_alloc(sizeof(HgMergedIndices));
+    *merged = (HgMergedIndices){
+        .source = source,
+        .indices = hg_heap_alloc(sizeof(u32) * index_count),
+        .index_count = index_count,
+        .vertex_stride = vertex_stride,
+        .max_level_count = max_level_count,
+        .level_count = 1,
+        .levels = {source},
+    };
+    memcpy(merged->indices, indices, sizeof(u32) * index_count);
+    s_merged_copy_bytes += sizeof(u32) * index_count;
+
+    u32 index = hg_merged_indices_find(source);
+    memmove(&s_merged_indices[index + 1], &s_merged_indices[index],
+        (s_merged_index_count - index) * sizeof(HgMergedIndices*));
+    s_merged_indices[index] = merged;
+    ++s_merged_index_count;
+}
+
+static void hg_merged_indices_remove(const HgBuffer* source) {
+    u32 index = hg_merged_indices_find(source);
+    if (index >= s_merged_index_count || s_merged_indices[index]->source != source)
+        return;
+
+    HgMergedIndices* merged = s_merged_indices[index];
+    for (u32 level = 1; level < merged->level_count; ++level) {
+        hg_buffer_retire(merged->levels[level]);
+    }
+    if (merged->indices != NULL) {
+        s_merged_copy_bytes -= sizeof(u32) * merged->index_count;
+        hg_heap_free(merged->indices);
+    }
+    hg_heap_free(merged);
+    memmove(&s_merged_indices[index], &s_merged_indices[index + 1],
+        (s_merged_index_count - index - 1) * sizeof(HgMergedIndices*));
+    --s_merged_index_count;
+}
+
+// Called before the render pass
+static void hg_merged_indices_reserve(HgMergedIndices* merged, u32 count) {
+    while (merged->level_count < merged->max_level_count && (1u << (merged->level_count - 1)) < count) {
+        u32 copies = 1u << merged->level_count;
+        u32 size = merged->index_count * copies;
+        u32* indices = hg_heap_alloc(sizeof(u32) * size);
+        for (u32 copy = 0; copy < copies; ++copy) {
+            u32* dst = indices + copy * merged->index_count;
+            for (u32 i = 0; i < merged->index_count; ++i) {
+                dst[i] = merged->indices[i] + copy * merged->vertex_stride;
+            }
+        }
+
+        HgBuffer* buffer = hg_tracked_buffer_create(&(HgBufferConfig){
+            .size = sizeof(u32) * size,
+            .usage = HG_BUFFER_USAGE_INDEX_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
+        }, HG_MEMORY_CATEGORY_3D_MESH, "merged index buffer");
+        hg_buffer_write(buffer, 0, indices, sizeof(u32) * size);
+        hg_heap_free(indices);
+
+        merged->levels[merged->level_count++] = buffer;
+    }
+    if (merged->level_count == merged->max_level_count && merged->indices != NULL) {
+        s_merged_copy_bytes -= sizeof(u32) * merged->index_count;
+        hg_heap_free(merged->indices);
+        merged->indices = NULL;
+    }
+}
+
+HgBuffer* hg_3d_index_buffer_create(const u32* indices, u32 index_count) {
+    HG_ASSERT(indices != NULL);
+    HG_ASSERT(index_count > 0);
+
+    hg_render_thread_wait();
+
+    HgBuffer* buffer = hg_tracked_buffer_create(&(HgBufferConfig){
+        .size = sizeof(u32) * index_count,
+        .usage = HG_BUFFER_USAGE_INDEX_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
+    }, HG_MEMORY_CATEGORY_3D_MESH, "index buffer");
+    hg_buffer_write(buffer, 0, indices, sizeof(u32) * index_count);
+    hg_merged_indices_add(buffer, indices, index_count);
+
+    return buffer;
+}
+
+HgTexture* hg_3d_texture_map_create(
+    const void* data, u32 width, u32 height, HgFormat format, HgTextureCompression3D compression, u32 flags
+) {
+    HG_ASSERT(data != NULL);
+    HG_ASSERT(width > 0);
+    HG_ASSERT(height > 0);
+
+    hg_render_thread_wait();
+
+    u32 mip_levels = flags & HG_TEXTURE_MAP_3D_MIPMAPS_BIT ? hg_texture_mip_count(width, height) : 1;
+    HgFormat gpu_format = hg_texture_map_format(format, compression);
+    HgTexture* texture = hg_texture_map_texture_create(width, height, gpu_format, mip_levels, flags);
+
+    if (mip_levels == 1 && gpu_format == format) {
+        hg_texture_write(texture, data, HG_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    } else {
+        void* encoded = hg_heap_alloc(hg_texture_mip_chain_size(width, height, mip_levels, gpu_format));
+        hg_texture_encode(data, width, height, format, gpu_format, mip_levels, encoded);
+        hg_texture_write(texture, encoded, HG_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        hg_heap_free(encoded);
+    }
+
+    return texture;
+}
+
+HgBuffer* hg_3d_vertex_buffer_create_async(const HgVertex3D* vertices, u32 vertex_count, HgBounds3D* bounds) {
+    HG_ASSERT(vertices != NULL);
+    HG_ASSERT(vertex_count > 0);
+
+    hg_render_thread_wait();
+
+    if (bounds != NULL)
+        *bounds = hg_mesh_bounds(vertices, vertex_count);
+
+    HgUpload3D* upload = hg_heap_alloc(sizeof(HgUpload3D));
+    *upload = (HgUpload3D){
+        .kind = HG_UPLOAD_KIND_3D_BUFFER,
+        .buffer = hg_tracked_buffer_create(&(HgBufferConfig){
+            .size = sizeof(HgVertex3D) * vertex_count,
+            .usage = HG_BUFFER_USAGE_VERTEX_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
+        }, HG_MEMORY_CATEGORY_3D_MESH, "vertex buffer"),
+        .data = vertices,
+        .data_size = sizeof(HgVertex3D) * vertex_count,
+        .staged_size = sizeof(HgVertex3D) * vertex_count,
+    };
+    hg_upload_queue_submit(&s_uploads, upload);
+
+    return upload->buffer;
+}
+
+HgBuffer* hg_3d_index_buffer_create_async(const u32* indices, u32 index_count) {
+    HG_ASSERT(indices != NULL);
+    HG_ASSERT(index_count > 0);
+
+    hg_render_thread_wait();
+
+    HgUpload3D* upload = hg_heap_alloc(sizeof(HgUpload3D));
+    *upload = (HgUpload3D){
+        .kind = HG_UPLOAD_KIND_3D_BUFFER,
+        .buffer = hg_tracked_buffer_create(&(HgBufferConfig){
+            .size = sizeof(u32) * index_count,
+            .usage = HG_BUFFER_USAGE_INDEX_BUFFER_BIT | HG_BUFFER_USAGE_READ_WRITE_DST_BIT,
+        }, HG_MEMORY_CATEGORY_3D_MESH, "index buffer"),
+        .data = indices,
+        .data_size = sizeof(u32) * index_count,
+        .staged_size = sizeof(u32) * index_count,
+    };
+    hg_merged_indices_add(upload->buffer, indices, index_count);
+    hg_upload_queue_submit(&s_uploads, upload);
+
+    return upload->buffer;
+}
+
+HgTexture* hg_3d_texture_map_create_async(
+    const void* data, u32 width, u32 height, HgFormat format, HgTextureCompression3D compression, u32 flags
+) {
+    HG_ASSERT(data != NULL);
+    HG_ASSERT(width > 0);
+    HG_ASSERT(height > 0);
+
+    hg_render_thread_wait();
+
+    u32 mip_levels = flags & HG_TEXTURE_MAP_3D_MIPMAPS_BIT ? hg_texture_mip_count(width, height) : 1;
+    HgFormat gpu_format = hg_texture_map_format(format, compression);
+
+    HgUpload3D* upload = hg_heap_alloc(sizeof(HgUpload3D));
+    *upload = (HgUpload3D){
+        .kind = HG_UPLOAD_KIND_3D_TEXTURE,
+        .texture = hg_texture_map_texture_create(width, height, gpu_format, mip_levels, flags),
+        .data = data,
+        .width = width,
+        .height = height,
+        .mip_levels = mip_levels,
+        .format = format,
+        .gpu_format = gpu_format,
+        .staged_size = hg_texture_mip_chain_size(width, height, mip_levels, gpu_format),
+    };
+    hg_upload_queue_submit(&s_uploads, upload);
+
+    return upload->texture;
+}
+
+bool hg_3d_buffer_ready(const HgBuffer* buffer) {
+    return !hg_pending(buffer);
+}
+
+bool hg_3d_texture_ready(const HgTexture* texture) {
+    return !hg_pending(texture);
+}
+
+void hg_3d_buffer_destroy(HgBuffer* buffer) {
+    HG_ASSERT(buffer != NULL);
+
+    hg_render_thread_wait();
+    hg_upload_queue_cancel(&s_uploads, buffer);
+    hg_merged_indices_remove(buffer);
+    hg_resource_retire((HgRetiredResource){.buffer = buffer});
+}
+
+void hg_3d_texture_destroy(HgTexture* texture) {
+    HG_ASSERT(texture != NULL);
+
+    hg_render_thread_wait();
+    hg_upload_queue_cancel(&s_uploads, texture);
+    hg_resource_retire((HgRetiredResource){.texture = texture});
+}
+
+void hg_3d_renderer_set_upload_budget(usize bytes_per_frame) {
+    s_upload_budget = bytes_per_frame;
+}
+
+void hg_3d_renderer_flush_uploads(void) {
+    hg_render_thread_wait();
+
+    for (;;) {
+        hg_uploads_drain(SIZE_MAX);
+        if (!hg_upload_queue_wait(&s_uploads))
+            break;
+    }
+}
+
+// wide holds index_count u32s for widening u16 indices
+static HgBuffer* hg_mesh_index_buffer_create(const u8* indices, u32 index_count, u32 index_size, u32* wide) {
+    if (index_size == sizeof(u32))
+        return hg_3d_index_buffer_create((const u32*)indices, index_count);
+
+    for (u32 i = 0; i < index_count; ++i) {
+        u16 index;
+        memcpy(&index, indices + i * sizeof(u16), sizeof(u16));
+        wide[i] = index;
+    }
+    return hg_3d_index_buffer_create(wide, index_count);
+}
+
+bool hg_3d_mesh_load(const char* path, HgModel3D* model) {
+    HG_ASSERT(path != NULL);
+    HG_ASSERT(model != NULL);
+
+    // Mapped, so the arrays upload straight from the page cache
+    HgFileMap3D file;
+    if (!hg_file_map(path, &file)) {
+        HG_LOGF("Could not open mesh file %s", path);
+        return false;
+    }
+    if (file.size < sizeof(HgMeshFileHeader)) {
+        HG_LOGF("Mesh file %s is too small", path);
+        hg_file_unmap(&file);
+        return false;
+    }
+    const u8* data = file.data;
+
+    HgMeshFileHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    u64 index_size = header.index_size;
+    u64 expected_size = sizeof(HgMeshFileHeader)
+                      + (u64)header.vertex_count * sizeof(HgVertex3D)
+                      + (u64)header.index_count * index_size;
+    bool lods_valid = header.lod_count < HG_3D_MAX_LODS;
+    for (u32 i = 0; i < header.lod_count && lods_valid; ++i) {
+        lods_valid = header.lods[i].index_count > 0;
+        expected_size += (u64)header.lods[i].index_count * index_size;
+    }
+    if (header.magic != HG_MESH_FILE_MAGIC
+     || header.version != HG_MESH_FILE_VERSION
+     || header.vertex_count == 0
+     || header.index_count == 0
+     || (header.index_size != sizeof(u16) && header.index_size != sizeof(u32))
+     || (header.index_size == sizeof(u16) && header.vertex_count > UINT16_MAX)
+     || !lods_valid
+     || expected_size != (u64)file.size) {
+        HG_LOGF("Mesh file %s is invalid", path);
+        hg_file_unmap(&file);
+        return false;
+    }
+
+    const HgVertex3D* vertices = (const HgVertex3D*)(data + sizeof(HgMeshFileHeader));
+    const u8* indices = (const u8*)(vertices + header.vertex_count);
+
+    // u16 indices are widened for upload
+    u32* wide = NULL;
+    if (header.index_size == sizeof(u16)) {
+        u32 max_count = header.index_count;
+        for (u32 i = 0; i < header.lod_count; ++i) {
+            if (header.lods[i].index_count > max_count)
+                max_count = header.lods[i].index_count;
+        }
+        wide = hg_heap_alloc(max_count * sizeof(u32));
+    }
+
+    model->mesh = hg_3d_mesh_create(vertices, header.vertex_count, NULL);
+    model->vertex_buffer = NULL;
+    model->index_buffer = hg_mesh_index_buffer_create(indices, header.index_count, header.index_size, wide);
+    model->index_count = header.index_count;
+    model->bounds = header.bounds;
+    model->vertex_format = HG_VERTEX_FORMAT_3D_FLOAT;
+
+    indices += header.index_count * index_size;
+    model->lod_count = header.lod_count;
+    for (u32 i = 0; i < header.lod_count; ++i) {
+        u32 count = header.lods[i].index_count;
+        model->lods[i] = (HgModelLod3D){
+            .index_buffer = hg_mesh_index_buffer_create(indices, count, header.index_size, wide),
+            .index_count = count,
+            .error = header.lods[i].error,
+        };
+        indices += count * index_size;
+    }
+
+    hg_heap_free(wide);
+    hg_file_unmap(&file);
+    return true;
+}
+
+void hg_3d_renderer_update_projection(f32 fov, f32 aspect, f32 near, f32 far) {
+    s_near = near;
+    s_far = far;
+
+    s_proj = hg_projection_matrix_perspective(fov, aspect, near, far);
+
+    // Points the bias away from the camera whichever way depth runs
+    f32 proj[4][4];
+    memcpy(proj, &s_proj, sizeof(proj));
+    f32 forward = proj[2][3] < 0.0f ? -1.0f : 1.0f;
+    f32 near_z = forward * near;
+    f32 far_z = forward * far;
+    f32 near_ndc = (proj[2][2] * near_z + proj[3][2]) / (proj[2][3] * near_z + proj[3][3]);
+    f32 far_ndc = (proj[2][2] * far_z + proj[3][2]) / (proj[2][3] * far_z + proj[3][3]);
+    s_depth_bias = far_ndc > near_ndc ? HG_DEPTH_PREPASS_BIAS : -HG_DEPTH_PREPASS_BIAS;
+
+    // slice = log(z) * scale + bias maps [near, far] onto [0, HG_CLUSTER_Z]
+    s_cluster_z_scale = (f32)HG_CLUSTER_Z / logf(far / near);
+    s_cluster_z_bias = -logf(near) * s_cluster_z_scale;
+}
+
+void hg_3d_renderer_update_view(HgVec3 position, f32 zoom, HgQuat rotation) {
+    s_view = hg_view_matrix(position, zoom, rotation);
+}
+
+static u32 hg_hash_pointer(const void* ptr, u32 bits) {
+    u64 x = (u64)(uintptr_t)ptr;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return (u32)(x >> (64 - bits));
+}
+
+HgRenderContext3D* hg_3d_render_context_create(void) {
+    HgRenderContext3D* context = hg_heap_alloc(sizeof(HgRenderContext3D));
+    *context = (HgRenderContext3D){0};
+    hg_frame_arena_init(&context->arena, HG_CONTEXT_ARENA_CAPACITY);
+
+    mtx_lock(&s_context_mutex);
+    context->id = s_context_next_id++;
+    context->next = s_contexts;
+    s_contexts = context;
+    mtx_unlock(&s_context_mutex);
+
+    return context;
+}
+
+void hg_3d_render_context_destroy(HgRenderContext3D* context) {
+    HG_ASSERT(context != NULL);
+
+    mtx_lock(&s_context_mutex);
+    HgRenderContext3D** link = &s_contexts;
+    while (*link != context) {
+        link = &(*link)->next;
+    }
+    *link = context->next;
+    mtx_unlock(&s_context_mutex);
+
+    hg_frame_arena_destroy(&context->arena);
+    hg_heap_free(context);
+}
+
+static void* hg_queue_push(HgQueue* queue, HgFrameArena3D* arena, usize item_size, u32 count) {
+    HgQueueChunk* chunk = queue->tail;
+    if (chunk == NULL || chunk->count + count > chunk->capacity) {
+        // Doubling what is queued keeps the chunk count logarithmic
+        u32 capacity = queue->count > 32 ? queue->count : 32;
+        if (capacity < count)
+            capacity = count;
+        chunk = hg_frame_arena_alloc(arena, sizeof(HgQueueChunk) + capacity * item_size);
+        chunk->next = NULL;
+        chunk->count = 0;
+        chunk->capacity = capacity;
+        if (queue->tail != NULL)
+            queue->tail->next = chunk;
+        else
+            queue->head = chunk;
+        queue->tail = chunk;
+    }
+
+    void* items = chunk->items + chunk->count * item_size;
+    chunk->count += count;
+    queue->count += count;
+    return items;
+}
+
+void hg_3d_render_context_queue_directional_light(
+    HgRenderContext3D* context, HgVec3 direction, HgVec3 color, f32 intensity
+) {
+    HG_ASSERT(context != NULL);
+
+    HgDirectionalLight* light = hg_queue_push(
+        &context->dir_lights, &context->arena, sizeof(HgDirectionalLight), 1
+    );
+    *light = (HgDirectionalLight){
+        .direction = {direction.x, direction.y, direction.z, 1.0f},
+        .color = {color.x, color.y, color.z, intensity},
+    };
+}
+
+void hg_3d_render_context_queue_point_light(
+    HgRenderContext3D* context, HgVec3 position, HgVec3 color, f32 intensity, f32 range
+) {
+    HG_ASSERT(context != NULL);
+    HG_ASSERT(range > 0.0f);
+
+    HgPointLight* light = hg_queue_push(&context->point_lights, &context->arena, sizeof(HgPointLight), 1);
+    *light = (HgPointLight){
+        .position = {position.x, position.y, position.z, range},
+        .color = {color.x, color.y, color.z, intensity},
+    };
+}
+
+void hg_3d_render_context_queue_model(HgRenderContext3D* context, HgModel3D* model, HgTransform3D* transform) {
+    hg_3d_render_context_queue_models(context, model, transform, 1);
+}
+
+void hg_3d_render_context_queue_models(
+    HgRenderContext3D* context, const HgModel3D* models, const HgTransform3D* transforms, u32 count
+) {
+    HG_ASSERT(context != NULL);
+    HG_ASSERT(models != NULL);
+    HG_ASSERT(transforms != NULL);
+
+    if (count == 0)
+        return;
+
+    HgModelTicket* tickets = hg_queue_push(&context->models, &context->arena, sizeof(HgModelTicket), count);
+    for (u32 i = 0; i < count; ++i) {
+        tickets[i] = (HgModelTicket){
+            .model = models[i],
+            .transform = transforms[i],
+            .lod_key = hg_hash_pointer(&models[i], 32) * 31u + hg_hash_pointer(&transforms[i], 32),
+        };
+    }
+}
+
+void hg_3d_renderer_queue_directional_light(HgVec3 direction, HgVec3 color, f32 intensity) {
+    hg_3d_render_context_queue_directional_light(s_main_context, direction, color, intensity);
+}
+
+void hg_3d_renderer_queue_point_light(HgVec3 position, HgVec3 color, f32 intensity, f32 range) {
+    hg_3d_render_context_queue_point_light(s_main_context, position, color, intensity, range);
+}
+
+void hg_3d_renderer_queue_model(HgModel3D* model, HgTransform3D* transform) {
+    hg_3d_render_context_queue_models(s_main_context, model, transform, 1);
+}
+
+void hg_3d_renderer_queue_models(const HgModel3D* models, const HgTransform3D* transforms, u32 count) {
+    hg_3d_render_context_queue_models(s_main_context, models, transforms, count);
+}
+
+_Static_assert(sizeof(HgMat4) == 16 * sizeof(f32), "HgMat4 must be 16 floats");
+
+static const HgTicketArrays* hg_ticket_arrays(u32* index) {
+    if (*index < s_object_count)
+        return &s_object_tickets;
+    *index -= s_object_count;
+    return &s_queued_tickets;
+}
+
+static HgModelTicket* hg_ticket(u32 index) {
+    const HgTicketArrays* arrays = hg_ticket_arrays(&index);
+    return &arrays->tickets[index];
+}
+
+static const HgModelTicketHot* hg_ticket_hot(u32 index) {
+    const HgTicketArrays* arrays = hg_ticket_arrays(&index);
+    return &arrays->hot[index];
+}
+
+// World space, with the radius in w
+static HgVec4 hg_ticket_sphere(u32 index) {
+    const HgTicketArrays* arrays = hg_ticket_arrays(&index);
+    const f32* bounds = arrays->bounds + index;
+    return (HgVec4){bounds[0], bounds[arrays->capacity], bounds[2 * arrays->capacity], bounds[3 * arrays->capacity]};
+}
+
+static u32 hg_cull_tickets(const HgTicketArrays* arrays, u32 count, u32 first, f32 planes[6][4], u32* visible) {
+    return hg_cull_spheres(s_cull_spheres, arrays->bounds, arrays->capacity, count, first, planes, visible);
+}
+
+static u32 hg_cull_models(f32 planes[6][4], u32* visible) {
+    u32 count = hg_cull_tickets(&s_object_tickets, s_object_count, 0, planes, visible);
+    return count + hg_cull_tickets(&s_queued_tickets, s_queued_count, s_object_count, planes, visible + count);
+}
+
+static void hg_build_transforms(const f32* components, u32 stride, HgModelTransform* dst, u32 count) {
+    const f32* src[HG_TRANSFORM_COMPONENT_COUNT];
+    for (u32 c = 0; c < HG_TRANSFORM_COMPONENT_COUNT; ++c) {
+        src[c] = components + c * stride;
+    }
+    s_build_transforms(src, count, dst);
+}
+
+// slots maps hashed texture addresses to slots, linearly probed
+static u32 hg_material_slot(HgTexture* texture, u32* slots, u32* texture_count) {
+    HgTexture** table = s_material_textures + (s_material_table_count - 1) * HG_MATERIAL_TABLE_SIZE;
+    u32 mask = 2 * HG_MATERIAL_TABLE_SIZE - 1;
+    for (u32 h = hg_hash_pointer(texture, 8);; h = (h + 1) & mask) {
+        if (slots[h] == UINT32_MAX) {
+            slots[h] = (*texture_count)++;
+            table[slots[h]] = texture;
+            return slots[h];
+        }
+        if (table[slots[h]] == texture)
+            return slots[h];
+    }
+}
+
+// Every slot of a bound table must be valid
+static void hg_material_table_finish(u32 texture_count) {
+    HgTexture** table = s_material_textures + (s_material_table_count - 1) * HG_MATERIAL_TABLE_SIZE;
+    for (u32 slot = texture_count; slot < HG_MATERIAL_TABLE_SIZE; ++slot) {
+        table[slot] = s_default_color_map;
+    }
+    s_stats.material_textures += texture_count;
+}
+
+static void hg_build_material_tables(HgModelInstance* instances, u32 count) {
+    _Static_assert(2 * HG_MATERIAL_TABLE_SIZE == 1 << 8, "material slot hash must cover twice the table");
+
+    u32 slots[2 * HG_MATERIAL_TABLE_SIZE];
+    u32 texture_count = HG_MATERIAL_TABLE_SIZE;
+    s_material_table_count = 0;
+
+    for (u32 i = 0; i < count; ++i) {
+        const HgModel3D* model = &hg_ticket(s_model_sort_indices[i])->model;
+
+        // Both of an instance's textures must be in the same table
+        if (texture_count + 2 > HG_MATERIAL_TABLE_SIZE) {
+            if (s_material_table_count == s_material_table_capacity) {
+                s_material_table_capacity *= 2;
+                s_material_textures = hg_heap_realloc(s_material_textures,
+                    s_material_table_capacity * HG_MATERIAL_TABLE_SIZE * sizeof(HgTexture*));
+                s_material_table_starts = hg_heap_realloc(
+                    s_material_table_starts, s_material_table_capacity * sizeof(u32)
+                );
+            }
+            if (s_material_table_count > 0)
+                hg_material_table_finish(texture_count);
+            s_material_table_starts[s_material_table_count++] = i;
+            memset(slots, 0xff, sizeof(slots));
+            texture_count = 0;
+        }
+
+        instances[i].material[0] = hg_material_slot(model->color_map, slots, &texture_count);
+        instances[i].material[1] = hg_material_slot(model->normal_map, slots, &texture_count);
+    }
+    if (s_material_table_count > 0)
+        hg_material_table_finish(texture_count);
+}
+
+// The coarsest level whose error projects to under HG_LOD_PIXEL_ERROR, with
+// hysteresis around last frame's level
+static u32 hg_select_lod(u32 index) {
+    const HgModelTicketHot* hot = hg_ticket_hot(index);
+    if (hot->lod_count == 0)
+        return 0;
+    const HgModel3D* model = &hg_ticket(index)->model;
+
+    f32 proj[4][4];
+    memcpy(proj, &s_proj, sizeof(proj));
+
+    HgVec4 sphere = hg_ticket_sphere(index);
+    f32 depth = fmaxf(hg_view_depth(&s_view, (HgVec3){sphere.x, sphere.y, sphere.z}) - sphere.w, s_near);
+    f32 pixels_per_unit = 0.5f * fabsf(proj[1][1]) * s_target_height * hot->max_scale / depth;
+
+    HgLodHistory* history = &s_lod_history[hot->lod_key & (HG_LOD_HISTORY_SIZE - 1)];
+    u32 level = 0;
+    if (history->key == hot->lod_key && history->level <= model->lod_count) {
+        level = history->level;
+        f32 coarsen = HG_LOD_PIXEL_ERROR * (1.0f - HG_LOD_HYSTERESIS);
+        f32 refine = HG_LOD_PIXEL_ERROR * (1.0f + HG_LOD_HYSTERESIS);
+        while (level < model->lod_count && model->lods[level].error * pixels_per_unit <= coarsen) {
+            ++level;
+        }
+        while (level > 0 && model->lods[level - 1].error * pixels_per_unit > refine) {
+            --level;
+        }
+    } else {
+        while (level < model->lod_count && model->lods[level].error * pixels_per_unit <= HG_LOD_PIXEL_ERROR) {
+            ++level;
+        }
+    }
+
+    history->key = hot->lod_key;
+    history->level = level;
+    return level;
+}
+
+static HgVertexSource hg_vertex_source(const HgModel3D* model) {
+    if (model->mesh != NULL)
+        return HG_VERTEX_SOURCE_POOLED;
+    if (model->vertex_format == HG_VERTEX_FORMAT_3D_PACKED)
+        return HG_VERTEX_SOURCE_PACKED;
+    return HG_VERTEX_SOURCE_FLOAT;
+}
+
+// Call after hg_model_resolve
+static u32 hg_model_features(const HgModel3D* model) {
+    if (model->unlit)
+        return HG_SHADER_FEATURE_UNLIT_BIT;
+
+    u32 features = 0;
+    if (model->normal_map != s_default_normal_map)
+        features |= HG_SHADER_FEATURE_NORMAL_MAP_BIT;
+    if (s_dir_light_count > 0)
+        features |= HG_SHADER_FEATURE_DIRECTIONAL_LIGHTS_BIT;
+    if (s_point_light_count > 0)
+        features |= HG_SHADER_FEATURE_POINT_LIGHTS_BIT;
+    return features;
+}
+
+static u32 hg_model_variant(const HgModel3D* model) {
+    u32 features = hg_model_features(model);
+    return features & HG_SHADER_FEATURE_UNLIT_BIT ? HG_SHADER_VARIANT_COUNT - 1 : features;
+}
+
+// Most significant to least: vertex source (2 bits), normal map and unlit
+// (2 bits), vertex buffer (12 bits), index buffer (12 bits), textures (24
+// bits), view depth (12 bits). This is all but the depth
+#define HG_SORT_KEY_INDEX_BUFFER_SHIFT 36
+
+static u64 hg_model_material_key(const HgModel3D* model) {
+    u64 textures = hg_hash_pointer(model->color_map, 12) << 12 | hg_hash_pointer(model->normal_map, 12);
+    u64 buffers = hg_hash_pointer(model->vertex_buffer, 12) << 12 | hg_hash_pointer(model->index_buffer, 12);
+    u64 source = hg_vertex_source(model);
+    u64 features = (u64)(model->unlit ? 2 : 0) | (u64)(model->normal_map != s_default_normal_map ? 1 : 0);
+    return source << 62 | features << 60 | buffers << HG_SORT_KEY_INDEX_BUFFER_SHIFT | textures << 12;
+}
+
+static u64 hg_model_sort_key(u32 index, u32 level) {
+    const HgModelTicketHot* hot = hg_ticket_hot(index);
+    u64 key = hot->material_key;
+    if (level > 0) {
+        const HgBuffer* index_buffer = hg_ticket(index)->model.lods[level - 1].index_buffer;
+        key = (key & ~(0xfffull << HG_SORT_KEY_INDEX_BUFFER_SHIFT))
+            | (u64)hg_hash_pointer(index_buffer, 12) << HG_SORT_KEY_INDEX_BUFFER_SHIFT;
+    }
+
+    f32 depth = hg_view_depth(&s_view, hot->position);
+    f32 depth_norm = s_far > 0.0f ? depth / s_far : 0.0f;
+    if (depth_norm < 0.0f)
+        depth_norm = 0.0f;
+    if (depth_norm > 1.0f)
+        depth_norm = 1.0f;
+    return key | (u64)(depth_norm * 4095.0f);
+}
+
+// LSD radix sort on 8 bit digits. The result ends up in keys and indices
+static void hg_radix_sort(u64* keys, u32* indices, u64* keys_tmp, u32* indices_tmp, u32 count) {
+    u64* keys_out = keys;
+    u32* indices_out = indices;
+
+    for (u32 shift = 0; shift < 64; shift += 8) {
+        u32 histogram[256] = {0};
+        for (u32 i = 0; i < count; ++i) {
+            ++histogram[(keys[i] >> shift) & 0xff];
+        }
+        if (histogram[(keys[0] >> shift) & 0xff] == count)
+            continue;
+
+        u32 offset = 0;
+        for (u32 i = 0; i < 256; ++i) {
+            u32 bucket = histogram[i];
+            histogram[i] = offset;
+            offset += bucket;
+        }
+        for (u32 i = 0; i < count; ++i) {
+            u32 dst = histogram[(keys[i] >> shift) & 0xff]++;
+            keys_tmp[dst] = keys[i];
+            indices_tmp[dst] = indices[i];
+        }
+
+        u64* keys_swap = keys;
+        keys = keys_tmp;
+        keys_tmp = keys_swap;
+        u32* indices_swap = indices;
+        indices = indices_tmp;
+        indices_tmp = indices_swap;
+    }
+
+    if (indices != indices_out) {
+        memcpy(keys_out, keys, count * sizeof(u64));
+        memcpy(indices_out, indices, count * sizeof(u32));
+    }
+}
+
+// Vertex source, then near view depth
+static u64 hg_prepass_sort_key(u32 index) {
+    HgVec4 sphere = hg_ticket_sphere(index);
+    f32 depth = fmaxf(hg_view_depth(&s_view, (HgVec3){sphere.x, sphere.y, sphere.z}) - sphere.w, 0.0f);
+
+    u32 depth_bits;
+    memcpy(&depth_bits, &depth, sizeof(depth_bits));
+    u64 source = hg_ticket_hot(index)->material_key >> 62;
+    return source << 62 | depth_bits;
+}
+
+static f32 hg_screen_coverage(u32 index) {
+    if (s_target_width <= 0.0f || s_target_height <= 0.0f)
+        return 0.0f;
+
+    f32 proj[4][4];
+    memcpy(proj, &s_proj, sizeof(proj));
+
+    HgVec4 sphere = hg_ticket_sphere(index);
+    f32 depth = hg_view_depth(&s_view, (HgVec3){sphere.x, sphere.y, sphere.z});
+    if (depth <= sphere.w)
+        return 1.0f;
+
+    f32 pixels = sphere.w * 0.5f * fabsf(proj[1][1]) * s_target_height / depth;
+    return fminf(3.14159265f * pixels * pixels / (s_target_width * s_target_height), 1.0f);
+}
+
+static void hg_objects_reserve(u32 count) {
+    if (count <= s_object_tickets.capacity)
+        return;
+
+    u32 old_capacity = s_object_tickets.capacity;
+    u32 capacity = old_capacity;
+    while (count > capacity) {
+        capacity *= 2;
+    }
+    s_object_tickets.capacity = capacity;
+    s_object_tickets.tickets = hg_heap_realloc(s_object_tickets.tickets, capacity * sizeof(HgModelTicket));
+    s_object_tickets.hot = hg_heap_realloc(s_object_tickets.hot, capacity * sizeof(HgModelTicketHot));
+
+    // Each bounds array starts at a multiple of the capacity, so spread
+    // them out from the back to avoid overwriting one another
+    s_object_tickets.bounds = hg_heap_realloc(s_object_tickets.bounds, 4 * capacity * sizeof(f32));
+    for (u32 i = 4; i-- > 1;) {
+        memmove(s_object_tickets.bounds + i * capacity, s_object_tickets.bounds + i * old_capacity,
+            old_capacity * sizeof(f32));
+    }
+
+    s_objects = hg_heap_realloc(s_objects, capacity * sizeof(HgObject3D*));
+    s_object_models = hg_heap_realloc(s_object_models, capacity * sizeof(HgModel3D));
+
+    // The capacity is a multiple of 64, starting at 1024 and doubling
+    u32 old_words = old_capacity / 64;
+    u32 words = capacity / 64;
+    u64** bitsets[] = {&s_object_dirty, &s_object_pending};
+    for (u32 i = 0; i < HG_ARRAY_SIZE(bitsets); ++i) {
+        *bitsets[i] = hg_heap_realloc(*bitsets[i], words * sizeof(u64));
+        memset(*bitsets[i] + old_words, 0, (words - old_words) * sizeof(u64));
+    }
+}
+
+static bool hg_model_pending(const HgModel3D* model) {
+    if (s_uploads.pending_count == 0)
+        return false;
+    if (hg_pending(model->vertex_buffer) || hg_pending(model->index_buffer)
+     || hg_pending(model->color_map) || hg_pending(model->normal_map))
+        return true;
+    for (u32 level = 0; level < model->lod_count; ++level) {
+        if (hg_pending(model->lods[level].index_buffer))
+            return true;
+    }
+    return false;
+}
+
+// Returns false if a buffer it uses is still uploading
+static bool hg_model_resolve(HgModel3D* model) {
+    if (s_uploads.pending_count > 0) {
+        if (hg_pending(model->vertex_buffer) || hg_pending(model->index_buffer))
+            return false;
+        if (hg_pending(model->color_map))
+            model->color_map = NULL;
+        if (hg_pending(model->normal_map))
+            model->normal_map = NULL;
+        for (u32 level = 0; level < model->lod_count; ++level) {
+            if (hg_pending(model->lods[level].index_buffer)) {
+                model->lod_count = level;
+                break;
+            }
+        }
+    }
+    // The pool's buffer is looked up at draw time, as it can be replaced
+    if (model->mesh != NULL)
+        model->vertex_buffer = NULL;
+    if (model->color_map == NULL)
+        model->color_map = s_default_color_map;
+    if (model->normal_map == NULL)
+        model->normal_map = s_default_normal_map;
+    return true;
+}
+
+static void hg_ticket_store(HgTicketArrays* arrays, u32 index) {
+    const HgModelTicket* ticket = &arrays->tickets[index];
+    HgBounds3D bounds = ticket->model.bounds;
+    const HgTransform3D* transform = &ticket->transform;
+    HgVec3 scale = transform->scale;
+    HgVec3 center = hg_rotate_vec3(transform->rotation, (HgVec3){
+        bounds.center.x * scale.x,
+        bounds.center.y * scale.y,
+        bounds.center.z * scale.z,
+    });
+    f32 max_scale = fmaxf(fabsf(scale.x), fmaxf(fabsf(scale.y), fabsf(scale.z)));
+
+    f32* dst = arrays->bounds + index;
+    dst[0] = transform->position.x + center.x;
+    dst[arrays->capacity] = transform->position.y + center.y;
+    dst[2 * arrays->capacity] = transform->position.z + center.z;
+    dst[3 * arrays->capacity] = bounds.radius > 0.0f ? bounds.radius * max_scale : FLT_MAX;
+
+    arrays->hot[index] = (HgModelTicketHot){
+        .material_key = hg_model_material_key(&ticket->model),
+        .position = transform->position,
+        .max_scale = max_scale,
+        .lod_key = ticket->lod_key,
+        .lod_count = ticket->model.lod_count,
+        .index_count = ticket->model.index_count,
+    };
+}
+
+static void hg_model_tickets_append(const HgModelTicket* tickets, u32 count) {
+    HG_ASSERT(s_queued_count + count <= s_queued_tickets.capacity);
+
+    for (u32 i = 0; i < count; ++i) {
+        u32 index = s_queued_count;
+        HgModelTicket* ticket = &s_queued_tickets.tickets[index];
+        *ticket = tickets[i];
+        if (!hg_model_resolve(&ticket->model)) {
+            ++s_stats.models_not_resident;
+            continue;
+        }
+        hg_ticket_store(&s_queued_tickets, index);
+        ++s_queued_count;
+    }
+}
+
+static bool hg_bit_get(const u64* bits, u32 index) {
+    return (bits[index / 64] >> (index % 64)) & 1;
+}
+
+static void hg_bit_put(u64* bits, u32 index, bool value) {
+    u64 mask = 1ull << (index % 64);
+    bits[index / 64] = value ? bits[index / 64] | mask : bits[index / 64] & ~mask;
+}
+
+// The first set bit at or after index, or end
+static u32 hg_bit_next(const u64* bits, u32 index, u32 end) {
+    while (index < end) {
+        u64 word = bits[index / 64] >> (index % 64);
+        if (word == 0) {
+            index = (index / 64 + 1) * 64;
+            continue;
+        }
+        while ((word & 1) == 0) {
+            word >>= 1;
+            ++index;
+        }
+        return index < end ? index : end;
+    }
+    return end;
+}
+
+static void hg_object_mark_dirty(u32 index) {
+    hg_bit_put(s_object_dirty, index, true);
+}
+
+// Returns whether the object can be drawn
+static bool hg_object_update(u32 index) {
+    HgModelTicket* ticket = &s_object_tickets.tickets[index];
+    ticket->model = s_object_models[index];
+
+    bool pending = hg_model_pending(&ticket->model);
+    if (pending != hg_bit_get(s_object_pending, index)) {
+        hg_bit_put(s_object_pending, index, pending);
+        s_object_pending_count = pending ? s_object_pending_count + 1 : s_object_pending_count - 1;
+    }
+
+    bool resident = hg_model_resolve(&ticket->model);
+    if (resident) {
+        hg_ticket_store(&s_object_tickets, index);
+    } else {
+        u32 capacity = s_object_tickets.capacity;
+        s_object_tickets.bounds[index] = 0.0f;
+        s_object_tickets.bounds[index + capacity] = 0.0f;
+        s_object_tickets.bounds[index + 2 * capacity] = 0.0f;
+        s_object_tickets.bounds[index + 3 * capacity] = -FLT_MAX;
+    }
+    hg_object_mark_dirty(index);
+    return resident;
+}
+
+HgObject3D* hg_3d_object_create(const HgModel3D* model, const HgTransform3D* transform) {
+    HG_ASSERT(model != NULL);
+    HG_ASSERT(transform != NULL);
+
+    hg_objects_reserve(s_object_count + 1);
+
+    HgObject3D* object = hg_heap_alloc(sizeof(HgObject3D));
+    object->index = s_object_count;
+
+    s_objects[object->index] = object;
+    s_object_models[object->index] = *model;
+    s_object_tickets.tickets[object->index] = (HgModelTicket){
+        .transform = *transform,
+        .lod_key = hg_hash_pointer(object, 32),
+    };
+    ++s_object_count;
+
+    (void)hg_object_update(object->index);
+    return object;
+}
+
+void hg_3d_object_destroy(HgObject3D* object) {
+    HG_ASSERT(object != NULL);
+    HG_ASSERT(object->index < s_object_count && s_objects[object->index] == object);
+
+    u32 index = object->index;
+    u32 last = s_object_count - 1;
+    if (hg_bit_get(s_object_pending, index))
+        --s_object_pending_count;
+
+    // The last object fills the gap, and its transform is rebuilt at its new
+    // index, since submission's copy of the transforms may be a frame behind
+    if (index != last) {
+        s_objects[index] = s_objects[last];
+        s_objects[index]->index = index;
+        s_object_models[index] = s_object_models[last];
+        s_object_tickets.tickets[index] = s_object_tickets.tickets[last];
+        s_object_tickets.hot[index] = s_object_tickets.hot[last];
+        for (u32 i = 0; i < 4; ++i) {
+            u32 offset = i * s_object_tickets.capacity;
+            s_object_tickets.bounds[index + offset] = s_object_tickets.bounds[last + offset];
+        }
+        hg_bit_put(s_object_pending, index, hg_bit_get(s_object_pending, last));
+        hg_object_mark_dirty(index);
+    }
+    hg_bit_put(s_object_pending, last, false);
+    hg_bit_put(s_object_dirty, last, false);
+
+    --s_object_count;
+    hg_heap_free(object);
+}
+
+void hg_3d_object_set_transform(HgObject3D* object, const HgTransform3D* transform) {
+    HG_ASSERT(object != NULL);
+    HG_ASSERT(transform != NULL);
+    HG_ASSERT(object->index < s_object_count && s_objects[object->index] == object);
+
+    s_object_tickets.tickets[object->index].transform = *transform;
+    (void)hg_object_update(object->index);
+}
+
+void hg_3d_object_set_model(HgObject3D* object, const HgModel3D* model) {
+    HG_ASSERT(object != NULL);
+    HG_ASSERT(model != NULL);
+    HG_ASSERT(object->index < s_object_count && s_objects[object->index] == object);
+
+    s_object_models[object->index] = *model;
+    (void)hg_object_update(object->index);
+}
+
+void hg_3d_object_set_material(HgObject3D* object, HgTexture* color_map, HgTexture* normal_map) {
+    HG_ASSERT(object != NULL);
+    HG_ASSERT(object->index < s_object_count && s_objects[object->index] == object);
+
+    s_object_models[object->index].color_map = color_map;
+    s_object_models[object->index].normal_map = normal_map;
+    (void)hg_object_update(object->index);
+}
+
+static void hg_objects_resolve_pending(void) {
+    if (s_object_pending_count == 0)
+        return;
+
+    u32 index = hg_bit_next(s_object_pending, 0, s_object_count);
+    while (index < s_object_count) {
+        if (!hg_object_update(index))
+            ++s_stats.models_not_resident;
+        index = hg_bit_next(s_object_pending, index + 1, s_object_count);
+    }
+}
+
+static void hg_transform_components_store(f32* components, u32 stride, u32 column, const HgModelTicket* ticket) {
+    const HgTransform3D* transform = &ticket->transform;
+    f32 rotation[4];
+    memcpy(rotation, &transform->rotation, sizeof(rotation));
+
+    f32* dst = components + column;
+    dst[HG_TRANSFORM_POSITION_X * stride] = transform->position.x;
+    dst[HG_TRANSFORM_POSITION_Y * stride] = transform->position.y;
+    dst[HG_TRANSFORM_POSITION_Z * stride] = transform->position.z;
+    dst[HG_TRANSFORM_SCALE_X * stride] = transform->scale.x;
+    dst[HG_TRANSFORM_SCALE_Y * stride] = transform->scale.y;
+    dst[HG_TRANSFORM_SCALE_Z * stride] = transform->scale.z;
+    dst[HG_TRANSFORM_ROTATION_W * stride] = rotation[0];
+    dst[HG_TRANSFORM_ROTATION_X * stride] = rotation[1];
+    dst[HG_TRANSFORM_ROTATION_Y * stride] = rotation[2];
+    dst[HG_TRANSFORM_ROTATION_Z * stride] = rotation[3];
+
+    HgVertexQuantization3D quantization = {.offset = {0.0f, 0.0f, 0.0f}, .scale = {1.0f, 1.0f, 1.0f}};
+    if (ticket->model.vertex_format == HG_VERTEX_FORMAT_3D_PACKED)
+        quantization = ticket->model.quantization;
+    dst[HG_TRANSFORM_DEQUANT_OFFSET_X * stride] = quantization.offset.x;
+    dst[HG_TRANSFORM_DEQUANT_OFFSET_Y * stride] = quantization.offset.y;
+    dst[HG_TRANSFORM_DEQUANT_OFFSET_Z * stride] = quantization.offset.z;
+    dst[HG_TRANSFORM_DEQUANT_SCALE_X * stride] = quantization.scale.x;
+    dst[HG_TRANSFORM_DEQUANT_SCALE_Y * stride] = quantization.scale.y;
+    dst[HG_TRANSFORM_DEQUANT_SCALE_Z * stride] = quantization.scale.z;
+}
+
+static void* hg_packet_copy(HgFramePacket* packet, const void* data, usize size) {
+    void* dst = hg_frame_arena_alloc(&packet->arena, size);
+    if (size > 0)
+        memcpy(dst, data, size);
+    return dst;
+}
+
+static void hg_objects_rebuild(HgFramePacket* packet) {
+    // Counted first, so the list takes only its size from the arena
+    u32 changed_count = 0;
+    u32 index = hg_bit_next(s_object_dirty, 0, s_object_count);
+    while (index < s_object_count) {
+        ++changed_count;
+        index = hg_bit_next(s_object_dirty, index + 1, s_object_count);
+    }
+    packet->changed_count = changed_count;
+    if (changed_count == 0)
+        return;
+
+    u32* changed = hg_frame_arena_alloc(&packet->arena, changed_count * sizeof(u32));
+    changed_count = 0;
+    index = hg_bit_next(s_object_dirty, 0, s_object_count);
+    while (index < s_object_count) {
+        changed[changed_count++] = index;
+        index = hg_bit_next(s_object_dirty, index + 1, s_object_count);
+    }
+    packet->changed = changed;
+
+    f32* components = hg_frame_arena_alloc(&packet->arena, HG_TRANSFORM_COMPONENT_COUNT * changed_count * sizeof(f32));
+    for (u32 i = 0; i < changed_count; ++i) {
+        hg_transform_components_store(components, changed_count, i, &s_object_tickets.tickets[changed[i]]);
+        hg_bit_put(s_object_dirty, changed[i], false);
+    }
+    packet->changed_transforms = hg_frame_arena_alloc(&packet->arena, changed_count * sizeof(HgModelTransform));
+    hg_build_transforms(components, changed_count, packet->changed_transforms, changed_count);
+    s_stats.transforms_rebuilt += changed_count;
+}
+
+static void hg_object_transforms_apply(const HgFramePacket* packet) {
+    if (packet->object_count > s_transform_capacity) {
+        u32 old_words = s_transform_capacity / 64;
+        while (packet->object_count > s_transform_capacity) {
+            s_transform_capacity *= 2;
+        }
+        u32 words = s_transform_capacity / 64;
+        s_transforms = hg_heap_realloc(s_transforms, s_transform_capacity * sizeof(HgModelTransform));
+        for (u32 i = 0; i < HG_3D_FRAMES_IN_FLIGHT; ++i) {
+            s_object_stale[i] = hg_heap_realloc(s_object_stale[i], words * sizeof(u64));
+            memset(s_object_stale[i] + old_words, 0, (words - old_words) * sizeof(u64));
+        }
+    }
+
+    for (u32 i = 0; i < packet->changed_count; ++i) {
+        u32 index = packet->changed[i];
+        s_transforms[index] = packet->changed_transforms[i];
+        for (u32 frame = 0; frame < HG_3D_FRAMES_IN_FLIGHT; ++frame) {
+            hg_bit_put(s_object_stale[frame], index, true);
+        }
+    }
+}
+
+static void hg_frame_ring_grow_objects(usize size, u32 object_count) {
+    if (!hg_frame_ring_grow(size))
+        return;
+    for (u32 frame = 0; frame < HG_3D_FRAMES_IN_FLIGHT; ++frame) {
+        for (u32 i = 0; i < object_count; ++i) {
+            hg_bit_put(s_object_stale[frame], i, true);
+        }
+    }
+}
+
+// Returns the transforms' offset in elements
+static u32 hg_transforms_upload(HgFramePacket* packet) {
+    u32 object_count = packet->object_count;
+    u64* stale = s_object_stale[s_frame_index];
+    HgBuffer* buffer = s_frame_ring.buffer;
+    usize region = hg_frame_ring_region();
+
+    u32 begin = hg_bit_next(stale, 0, object_count);
+    while (begin < object_count) {
+        u32 end = begin + 1;
+        while (end < object_count && hg_bit_get(stale, end)) {
+            ++end;
+        }
+        for (u32 i = begin; i < end; ++i) {
+            hg_bit_put(stale, i, false);
+        }
+        hg_buffer_write(buffer, region + sizeof(HgModelTransform) * begin, s_transforms + begin,
+            sizeof(HgModelTransform) * (end - begin));
+        packet->stats.transforms_uploaded += end - begin;
+        begin = hg_bit_next(stale, end, object_count);
+    }
+
+    if (packet->queued_count > 0) {
+        hg_buffer_write(buffer, region + sizeof(HgModelTransform) * object_count, packet->queued_transforms,
+            sizeof(HgModelTransform) * packet->queued_count);
+        packet->stats.transforms_uploaded += packet->queued_count;
+    }
+    s_frame_ring.used = sizeof(HgModelTransform) * (object_count + packet->queued_count);
+    return (u32)(region / sizeof(HgModelTransform));
+}
+
+// Sorting contexts by id makes the order independent of the threads' timing
+static void hg_render_contexts_merge(HgFramePacket* packet) {
+    u32 context_count = 0;
+    mtx_lock(&s_context_mutex);
+    for (HgRenderContext3D* context = s_contexts; context != NULL; context = context->next) {
+        if (context_count >= s_context_order_capacity) {
+            s_context_order_capacity *= 2;
+            s_context_order = hg_heap_realloc(
+                s_context_order, s_context_order_capacity * sizeof(HgRenderContext3D*)
+            );
+        }
+        s_context_order[context_count++] = context;
+    }
+    mtx_unlock(&s_context_mutex);
+    for (u32 i = 1; i < context_count; ++i) {
+        HgRenderContext3D* context = s_context_order[i];
+        u32 j = i;
+        for (; j > 0 && s_context_order[j - 1]->id > context->id; --j) {
+            s_context_order[j] = s_context_order[j - 1];
+        }
+        s_context_order[j] = context;
+    }
+
+    // Sized up front, so each of the frame's arrays is one allocation
+    u32 model_count = 0;
+    u32 dir_light_count = 0;
+    u32 point_light_count = 0;
+    for (u32 i = 0; i < context_count; ++i) {
+        model_count += s_context_order[i]->models.count;
+        dir_light_count += s_context_order[i]->dir_lights.count;
+        point_light_count += s_context_order[i]->point_lights.count;
+    }
+    s_queued_count = 0;
+    s_queued_tickets = (HgTicketArrays){
+        .capacity = model_count,
+        .tickets = hg_frame_arena_alloc(&packet->arena, model_count * sizeof(HgModelTicket)),
+        .hot = hg_frame_arena_alloc(&packet->arena, model_count * sizeof(HgModelTicketHot)),
+        .bounds = hg_frame_arena_alloc(&packet->arena, 4 * model_count * sizeof(f32)),
+    };
+    s_dir_lights = hg_frame_arena_alloc(&packet->arena, dir_light_count * sizeof(HgDirectionalLight));
+    s_point_lights = hg_frame_arena_alloc(&packet->arena, point_light_count * sizeof(HgPointLight));
+
+    for (u32 i = 0; i < context_count; ++i) {
+        HgRenderContext3D* context = s_context_order[i];
+
+        for (HgQueueChunk* chunk = context->dir_lights.head; chunk != NULL; chunk = chunk->next) {
+            memcpy(s_dir_lights + s_dir_light_count, chunk->items, chunk->count * sizeof(HgDirectionalLight));
+            s_dir_light_count += chunk->count;
+        }
+        for (HgQueueChunk* chunk = context->point_lights.head; chunk != NULL; chunk = chunk->next) {
+            memcpy(s_point_lights + s_point_light_count, chunk->items, chunk->count * sizeof(HgPointLight));
+            s_point_light_count += chunk->count;
+        }
+        for (HgQueueChunk* chunk = context->models.head; chunk != NULL; chunk = chunk->next) {
+            hg_model_tickets_append((const HgModelTicket*)chunk->items, chunk->count);
+        }
+
+        s_stats.arena_bytes += context->arena.frame_bytes;
+        s_stats.arena_overflows += context->arena.overflows;
+        hg_frame_arena_reset(&context->arena);
+        context->models = (HgQueue){0};
+        context->dir_lights = (HgQueue){0};
+        context->point_lights = (HgQueue){0};
+    }
+}
+
+static bool hg_ticket_has_occluder(const HgModelTicket* ticket) {
+    return ticket->model.mesh != NULL && ticket->model.mesh->occluder_vertex_count > 0;
+}
+
+// Rasterizes the occluders of the tickets drawn last frame, then tests
+// visible against them. Returns how many are left
+static u32 hg_occlusion_cull(u32 count, u32* visible) {
+    hg_profiler_begin("occlusion");
+
+    hg_occlusion_begin(&s_occlusion, &s_view, &s_proj, s_near);
+    u32 occluders = 0;
+    for (u32 i = 0; i < count; ++i) {
+        const HgModelTicket* ticket = hg_ticket(visible[i]);
+        if (hg_ticket_has_occluder(ticket) && hg_occlusion_was_drawn(&s_occlusion, ticket->lod_key)
+            && hg_screen_coverage(visible[i]) >= HG_OCCLUDER_MIN_COVERAGE) {
+            const HgMesh3D* mesh = ticket->model.mesh;
+            hg_occlusion_rasterize(&s_occlusion, &ticket->transform, mesh->occluder_positions,
+                mesh->occluder_vertex_count, mesh->occluder_indices, mesh->occluder_index_count);
+            ++occluders;
+        }
+    }
+
+    u32 kept = count;
+    if (occluders > 0) {
+        hg_occlusion_build(&s_occlusion);
+        kept = 0;
+        for (u32 i = 0; i < count; ++i) {
+            if (!hg_occlusion_test(&s_occlusion, hg_ticket_sphere(visible[i])))
+                visible[kept++] = visible[i];
+        }
+    }
+
+    for (u32 i = 0; i < kept; ++i) {
+        const HgModelTicket* ticket = hg_ticket(visible[i]);
+        if (hg_ticket_has_occluder(ticket))
+            hg_occlusion_mark_drawn(&s_occlusion, ticket->lod_key);
+    }
+
+    s_stats.occluders = occluders;
+    s_stats.occluded = count - kept;
+    hg_profiler_end();
+    return kept;
+}
+
+void hg_3d_renderer_set_depth_prepass(bool enabled) {
+    s_depth_prepass = enabled;
+}
+
+void hg_3d_renderer_set_occlusion_culling(bool enabled) {
+    s_occlusion_culling = enabled;
+}
+
+void hg_3d_renderer_set_gpu_timing(bool enabled) {
+    s_gpu_timing = enabled;
+}
+
+void hg_3d_renderer_reserve(u32 model_count, u32 dir_light_count, u32 point_light_count) {
+    hg_render_thread_wait();
+
+    // Every per model and per light array of a frame, plus the initial
+    // capacity for the material tables
+    usize cluster_size = 2 * HG_CLUSTER_COUNT + 8 * (usize)point_light_count;
+    usize model_bytes = sizeof(HgModelTicket) + sizeof(HgModelTicketHot) + 4 * sizeof(f32)
+        + 4 * (sizeof(u64) + sizeof(u32)) + sizeof(u8) + HG_TRANSFORM_COMPONENT_COUNT * sizeof(f32)
+        + sizeof(HgModelInstance) + sizeof(HgDrawCall) + sizeof(HgModelTransform);
+    usize packet_bytes = HG_PACKET_ARENA_CAPACITY
+        + model_bytes * model_count
+        + sizeof(HgDirectionalLight) * dir_light_count
+        + (sizeof(HgPointLight) + sizeof(HgLightClusterRange)) * point_light_count
+        + sizeof(u32) * cluster_size;
+    for (u32 i = 0; i < HG_ARRAY_SIZE(s_packets); ++i) {
+        hg_frame_arena_reserve(&s_packets[i].arena, packet_bytes);
+    }
+
+    // Resetting would drop anything queued for the coming frame
+    HgRenderContext3D* context = s_main_context;
+    if (context->models.count == 0 && context->dir_lights.count == 0 && context->point_lights.count == 0) {
+        hg_frame_arena_reserve(&context->arena, HG_CONTEXT_ARENA_CAPACITY
+            + sizeof(HgModelTicket) * model_count
+            + sizeof(HgDirectionalLight) * dir_light_count
+            + sizeof(HgPointLight) * point_light_count);
+    }
+
+    u32 object_count = s_object_count < s_transform_capacity ? s_object_count : s_transform_capacity;
+    usize ring_size = hg_frame_ring_bound(model_count, dir_light_count, point_light_count, cluster_size);
+    hg_frame_ring_grow_objects(ring_size, object_count);
+}
+
+void hg_3d_renderer_get_stats(HgRenderer3DStats* stats) {
+    HG_ASSERT(stats != NULL);
+
+    mtx_lock(&s_render_mutex);
+    *stats = s_submitted_stats;
+    mtx_unlock(&s_render_mutex);
+}
+
+u32 hg_3d_renderer_get_draw_order(HgDrawRecord3D* records, u32 capacity) {
+    HG_ASSERT(records != NULL || capacity == 0);
+
+    u32 count = s_model_sort_count < capacity ? s_model_sort_count : capacity;
+    for (u32 i = 0; i < count; ++i) {
+        records[i] = (HgDrawRecord3D){
+            .sort_key = s_model_sort_keys[i],
+            .queue_index = s_model_sort_indices[i],
+            .transform = hg_ticket(s_model_sort_indices[i])->transform,
+        };
+    }
+    return s_model_sort_count;
+}
+
+void hg_3d_renderer_set_memory_budget(usize budget, HgMemoryEvictCallback3D evict, void* user_data) {
+    hg_memory_set_budget(&s_memory, budget, evict, user_data);
+}
+
+void hg_3d_renderer_get_memory_stats(HgMemoryStats3D* stats) {
+    HG_ASSERT(stats != NULL);
+
+    hg_memory_get_stats(&s_memory, stats);
+}
+
+void hg_3d_renderer_log_memory(void) {
+    hg_memory_log(&s_memory);
+}
+
+// Only call while the render thread is idle
+static void hg_frame_uploads(void) {
+    hg_profiler_begin("uploads");
+    hg_uploads_drain(s_upload_budget);
+    hg_profiler_end();
+    s_stats.uploads_pending = s_uploads.pending_count;
+}
+
+static void hg_frame_peaks_update(void) {
+    u32 model_count = s_object_count + s_queued_count;
+    if (model_count > s_peak_models)
+        s_peak_models = model_count;
+    if (s_dir_light_count > s_peak_dir_lights)
+        s_peak_dir_lights = s_dir_light_count;
+    if (s_point_light_count > s_peak_point_lights)
+        s_peak_point_lights = s_point_light_count;
+    if (s_stats.arena_bytes > s_peak_arena_bytes)
+        s_peak_arena_bytes = s_stats.arena_bytes;
+
+    s_stats.models = model_count;
+    s_stats.dir_lights = s_dir_light_count;
+    s_stats.point_lights = s_point_light_count;
+    s_stats.peak_models = s_peak_models;
+    s_stats.peak_dir_lights = s_peak_dir_lights;
+    s_stats.peak_point_lights = s_peak_point_lights;
+    s_stats.peak_arena_bytes = s_peak_arena_bytes;
+}
+
+// Batches break on buffers, shader variants and at table_end, the start of
+// the next material table
+static u32 hg_batch_end(const HgDrawCall* draws, u32 batch_begin, u32 table_end) {
+    const HgDrawCall* draw = &draws[batch_begin];
+    u32 batch_end = batch_begin + 1;
+    while (batch_end < table_end) {
+        const HgDrawCall* next = &draws[batch_end];
+        if (next->source != draw->source
+         || next->variant != draw->variant
+         || next->vertex_buffer != draw->vertex_buffer
+         || next->index_buffer != draw->index_buffer)
+            break;
+        ++batch_end;
+    }
+    return batch_end;
+}
+
+static u32 hg_material_table_end(const HgFramePacket* packet, u32* table, u32 batch_begin) {
+    while (*table + 1 < packet->material_table_count && packet->material_table_starts[*table + 1] <= batch_begin) {
+        ++*table;
+    }
+    return *table + 1 < packet->material_table_count ? packet->material_table_starts[*table + 1] : packet->draw_count;
+}
+
+// Pooled batches of more than one instance draw with merged index buffers
+static HgMergedIndices* hg_batch_merged_indices(const HgDrawCall* draw, u32 batch_size) {
+    if (draw->vertex_buffer != NULL || batch_size < 2)
+        return NULL;
+    return hg_merged_indices_get(draw->index_buffer);
+}
+
+static void hg_merged_batches_find(HgFramePacket* packet) {
+    packet->merged_batches = hg_frame_arena_alloc(&packet->arena, sizeof(HgMergedIndices*) * packet->draw_count);
+    packet->merged_batch_sizes = hg_frame_arena_alloc(&packet->arena, sizeof(u32) * packet->draw_count);
+    packet->merged_batch_count = 0;
+
+    u32 table = 0;
+    u32 batch_begin = 0;
+    while (batch_begin < packet->draw_count) {
+        u32 batch_end = hg_batch_end(packet->draws, batch_begin, hg_material_table_end(packet, &table, batch_begin));
+        HgMergedIndices* merged = hg_batch_merged_indices(&packet->draws[batch_begin], batch_end - batch_begin);
+        if (merged != NULL) {
+            packet->merged_batches[packet->merged_batch_count] = merged;
+            packet->merged_batch_sizes[packet->merged_batch_count] = batch_end - batch_begin;
+            ++packet->merged_batch_count;
+        }
+        batch_begin = batch_end;
+    }
+}
+
+// Makes no graphics calls, so it can run while the previous frame is
+// submitted
+static void hg_frame_prepare(HgFramePacket* packet, HgTexture* target, HgTexture* depth_buffer, bool present) {
+    hg_frame_arena_reset(&packet->arena);
+    packet->target = target;
+    packet->depth_buffer = depth_buffer;
+    packet->render_output = s_render_output;
+    packet->present = present;
+    packet->gpu_timing = s_gpu_timing;
+
+    hg_profiler_begin("merge");
+    hg_objects_resolve_pending();
+    hg_render_contexts_merge(packet);
+    hg_profiler_end();
+    s_stats.objects = s_object_count;
+
+    hg_profiler_begin("lights");
+    packet->world = (HgWorldUniform){
+        .view = s_view,
+        .proj = s_proj,
+        .dir_light_count = s_dir_light_count,
+        .cluster_z_scale = s_cluster_z_scale,
+        .cluster_z_bias = s_cluster_z_bias,
+        .render_scale = s_render_output != NULL ? s_render_scale : 1.0f,
+    };
+    packet->dir_lights = s_dir_lights;
+    packet->point_light_count = s_point_light_count;
+    packet->point_lights = s_point_lights;
+    packet->clusters = hg_light_clusters_build(&s_light_clusters, &s_view, &s_proj, s_near, s_far,
+        s_point_lights, s_point_light_count, &packet->arena, &packet->cluster_size);
+    hg_profiler_end();
+
+    hg_profiler_begin("cull");
+    u32 model_count = s_object_count + s_queued_count;
+    u32* visible = hg_frame_arena_alloc(&packet->arena, model_count * sizeof(u32));
+    f32 planes[6][4];
+    hg_frustum_planes(&s_view, &s_proj, planes);
+    u32 visible_count = hg_cull_models(planes, visible);
+    s_stats.culled = model_count - visible_count;
+    hg_profiler_end();
+
+    if (s_occlusion_culling)
+        visible_count = hg_occlusion_cull(visible_count, visible);
+    s_stats.visible = visible_count;
+
+    hg_profiler_begin("sort");
+    u64* keys = hg_frame_arena_alloc(&packet->arena, 2 * visible_count * sizeof(u64));
+    u32* indices_tmp = hg_frame_arena_alloc(&packet->arena, visible_count * sizeof(u32));
+    u8* levels = hg_frame_arena_alloc(&packet->arena, model_count * sizeof(u8));
+    for (u32 i = 0; i < visible_count; ++i) {
+        u32 index = visible[i];
+        u32 level = hg_select_lod(index);
+        levels[index] = (u8)level;
+
+        u32 index_count = hg_ticket_hot(index)->index_count;
+        if (level > 0)
+            index_count = hg_ticket(index)->model.lods[level - 1].index_count;
+        ++s_stats.lod_models[level];
+        s_stats.lod_triangles[level] += index_count / 3;
+
+        keys[i] = hg_model_sort_key(index, level);
+        s_stats.depth_complexity += hg_screen_coverage(index);
+    }
+    if (visible_count > 0)
+        hg_radix_sort(keys, visible, keys + visible_count, indices_tmp, visible_count);
+    s_model_sort_keys = keys;
+    s_model_sort_indices = visible;
+
+    packet->depth_prepass = s_depth_prepass;
+    packet->depth_bias = s_depth_bias;
+    if (s_depth_prepass && visible_count > 0) {
+        u64* prepass_keys = hg_frame_arena_alloc(&packet->arena, 2 * visible_count * sizeof(u64));
+        u32* prepass_order = hg_frame_arena_alloc(&packet->arena, 2 * visible_count * sizeof(u32));
+        for (u32 i = 0; i < visible_count; ++i) {
+            prepass_keys[i] = hg_prepass_sort_key(visible[i]);
+            prepass_order[i] = i;
+        }
+        hg_radix_sort(
+            prepass_keys,
+            prepass_order,
+            prepass_keys + visible_count,
+            prepass_order + visible_count,
+            visible_count
+        );
+        packet->prepass_order = prepass_order;
+    }
+    hg_profiler_end();
+
+    hg_profiler_begin("instances");
+    hg_objects_rebuild(packet);
+
+    // Instances are in draw order; queued tickets' transforms follow the
+    // objects'
+    HgModelInstance* instances = hg_frame_arena_alloc(&packet->arena, sizeof(HgModelInstance) * visible_count);
+    HgDrawCall* draws = hg_frame_arena_alloc(&packet->arena, sizeof(HgDrawCall) * visible_count);
+    HgModelTransform* queued = hg_frame_arena_alloc(&packet->arena, sizeof(HgModelTransform) * visible_count);
+    f32* components = hg_frame_arena_alloc(&packet->arena, HG_TRANSFORM_COMPONENT_COUNT * visible_count * sizeof(f32));
+    u32 queued_count = 0;
+    for (u32 i = 0; i < visible_count; ++i) {
+        u32 index = visible[i];
+        const HgModelTicket* ticket = hg_ticket(index);
+        const HgModel3D* model = &ticket->model;
+
+        instances[i].vertex_offset = model->mesh != NULL ? model->mesh->offset : 0;
+        if (index < s_object_count) {
+            instances[i].transform = index;
+        } else {
+            instances[i].transform = s_object_count + queued_count;
+            hg_transform_components_store(components, visible_count, queued_count, ticket);
+            ++queued_count;
+        }
+
+        u32 level = levels[index];
+        draws[i] = (HgDrawCall){
+            .vertex_buffer = model->mesh != NULL ? NULL : model->vertex_buffer,
+            .index_buffer = level > 0 ? model->lods[level - 1].index_buffer : model->index_buffer,
+            .source = hg_vertex_source(model),
+            .variant = hg_model_variant(model),
+        };
+    }
+    hg_build_transforms(components, visible_count, queued, queued_count);
+    s_stats.transforms_rebuilt += queued_count;
+    hg_build_material_tables(instances, visible_count);
+    packet->material_textures = hg_packet_copy(packet, s_material_textures,
+        sizeof(HgTexture*) * HG_MATERIAL_TABLE_SIZE * s_material_table_count);
+    packet->material_table_starts = hg_packet_copy(packet, s_material_table_starts,
+        sizeof(u32) * s_material_table_count);
+    packet->material_table_count = s_material_table_count;
+    packet->instances = instances;
+    packet->draws = draws;
+    packet->draw_count = visible_count;
+    s_model_sort_count = visible_count;
+    packet->object_count = s_object_count;
+    packet->queued_transforms = queued;
+    packet->queued_count = queued_count;
+    hg_merged_batches_find(packet);
+    hg_profiler_end();
+
+    s_stats.arena_bytes += packet->arena.frame_bytes;
+    s_stats.arena_overflows += packet->arena.overflows;
+    hg_frame_peaks_update();
+
+    // The queued tickets stay until the next merge, for
+    // hg_3d_renderer_get_draw_order
+    s_dir_light_count = 0;
+    s_point_light_count = 0;
+}
+
+static void hg_frame_stats_finish(HgFramePacket* packet) {
+    packet->stats = s_stats;
+    s_stats = (HgRenderer3DStats){0};
+}
+
+// The triangle sits at middle depth, so it passes against the cleared depth
+// buffer whichever way depth runs
+static void hg_upscale_record(HgFramePacket* packet) {
+    hg_profiler_begin("upscale");
+    hg_renderpass_begin(packet->render_output, packet->depth_buffer, false, true);
+
+    hg_shader_bind(hg_upscale_shader_get());
+    HgDescriptor upscale_descriptor_set[] = {{
+        .type = HG_DESCRIPTOR_TYPE_SAMPLED_TEXTURE,
+        .count = 1,
+        .textures = &packet->target,
+    }};
+    hg_bind_descriptor_set(0, upscale_descriptor_set, HG_ARRAY_SIZE(upscale_descriptor_set));
+    HgUpscalePush push = {.scale = packet->world.render_scale};
+    hg_bind_push_constant(&push, sizeof(push));
+    hg_draw(s_upscale_vertex_buffer, s_upscale_index_buffer, 0);
+
+    hg_renderpass_end();
+    hg_profiler_end();
+}
+
+static void hg_frame_record(HgFramePacket* packet) {
+    HgRenderer3DStats* stats = &packet->stats;
+
+    if (packet->present) {
+        packet->result = hg_frame_begin();
+        if (packet->result != HG_SUCCESS)
+            return;
+    }
+
+    hg_profiler_begin("frame buffers");
+    hg_retired_resources_collect();
+    hg_pool_frees_collect();
+    for (u32 i = 0; i < packet->merged_batch_count; ++i) {
+        hg_merged_indices_reserve(packet->merged_batches[i], packet->merged_batch_sizes[i]);
+    }
+    stats->mesh_allocations = s_vertex_pool.allocation_count;
+    stats->vertex_pool_capacity = s_vertex_pool.capacity;
+    stats->vertex_pool_used = s_vertex_pool.used;
+    u32 pool_free = s_vertex_pool.capacity - s_vertex_pool.used;
+    stats->vertex_pool_fragmentation = pool_free > 0
+        ? 1.0f - (f32)hg_suballocator_largest_free(&s_vertex_pool) / (f32)pool_free : 0.0f;
+
+    HgWorldUniform* world = &packet->world;
+    hg_frame_ring_grow_objects(hg_frame_ring_bound(
+        packet->object_count + packet->queued_count, world->dir_light_count,
+        packet->point_light_count, packet->cluster_size
+    ), packet->object_count);
+    world->transform_base = hg_transforms_upload(packet);
+    world->instance_base = hg_frame_ring_upload(packet->instances, packet->draw_count, sizeof(HgModelInstance));
+    world->dir_light_base = hg_frame_ring_upload(
+        packet->dir_lights, world->dir_light_count, sizeof(HgDirectionalLight)
+    );
+    world->point_light_base = hg_frame_ring_upload(
+        packet->point_lights, packet->point_light_count, sizeof(HgPointLight)
+    );
+    world->cluster_base = hg_frame_ring_upload(packet->clusters, packet->cluster_size, sizeof(u32));
+    HgBuffer* world_buffer = hg_frame_buffer_upload(&s_world_buffer, world, sizeof(*world));
+    HgBuffer* ring_buffer = s_frame_ring.buffer;
+    hg_profiler_end();
+
+    hg_profiler_begin("record");
+    hg_renderpass_begin(packet->target, packet->depth_buffer, true, true);
+
+    HgDescriptor world_descriptor_set[] = {{
+        .type = HG_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        .count = 1,
+        .buffers = &world_buffer,
+    }, {
+        .type = HG_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .count = 1,
+        .buffers = &ring_buffer,
+    }, {
+        .type = HG_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .count = 1,
+        .buffers = &ring_buffer,
+    }, {
+        .type = HG_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .count = 1,
+        .buffers = &ring_buffer,
+    }, {
+        .type = HG_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .count = 1,
+        .buffers = &ring_buffer,
+    }, {
+        .type = HG_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .count = 1,
+        .buffers = &s_vertex_pool_buffer,
+    }, {
+        .type = HG_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .count = 1,
+        .buffers = &ring_buffer,
+    }};
+
+    const HgDrawCall* draws = packet->draws;
+    u32 draw_count = packet->draw_count;
+    HgShader* bound_shader = NULL;
+
+    // Lays down depth front to back, in the same render pass as the main pass
+    if (packet->depth_prepass) {
+        const u32* order = packet->prepass_order;
+        for (u32 i = 0; i < draw_count; ++i) {
+            u32 instance = order[i];
+            const HgDrawCall* draw = &draws[instance];
+
+            HgShader* shader = hg_depth_shader_get(draw->source);
+            if (shader != bound_shader) {
+                bound_shader = shader;
+                hg_shader_bind(shader);
+                hg_bind_descriptor_set(0, world_descriptor_set, HG_ARRAY_SIZE(world_descriptor_set));
+            }
+
+            HgDepthPush push = {.instance = instance, .depth_bias = packet->depth_bias};
+            hg_bind_push_constant(&push, sizeof(push));
+            hg_draw(draw->vertex_buffer != NULL ? draw->vertex_buffer : s_vertex_pool_buffer, draw->index_buffer, 0);
+            ++stats->prepass_draws;
+        }
+    }
+
+    // Pooled meshes all use the pool's vertex buffer, so only their index
+    // buffers break batches
+    HgTexture** material_textures = packet->material_textures;
+    u32 bound_table = UINT32_MAX;
+    u32 batch_begin = 0;
+    while (batch_begin < draw_count) {
+        const HgDrawCall* draw = &draws[batch_begin];
+
+        HgShader* shader = hg_shader_get(draw->source, draw->variant);
+        if (shader != bound_shader) {
+            bound_shader = shader;
+            hg_shader_bind(shader);
+            hg_bind_descriptor_set(0, world_descriptor_set, HG_ARRAY_SIZE(world_descriptor_set));
+            bound_table = UINT32_MAX;
+        }
+
+        u32 table = bound_table == UINT32_MAX ? 0 : bound_table;
+        u32 batch_end = hg_batch_end(draws, batch_begin, hg_material_table_end(packet, &table, batch_begin));
+
+        if (table != bound_table) {
+            bound_table = table;
+
+            HgDescriptor material_descriptor_set[] = {{
+                .type = HG_DESCRIPTOR_TYPE_SAMPLED_TEXTURE,
+                .count = HG_MATERIAL_TABLE_SIZE,
+                .textures = material_textures + table * HG_MATERIAL_TABLE_SIZE,
+            }};
+            hg_bind_descriptor_set(1, material_descriptor_set, HG_ARRAY_SIZE(material_descriptor_set));
+            ++stats->descriptor_binds;
+        } else {
+            ++stats->descriptor_binds_skipped;
+        }
+
+        // Each merged draw takes the smallest level covering the rest of the
+        // batch
+        HgMergedIndices* merged = hg_batch_merged_indices(draw, batch_end - batch_begin);
+        if (merged != NULL) {
+            for (u32 i = batch_begin; i < batch_end;) {
+                u32 level = 0;
+                while (level + 1 < merged->level_count && (1u << level) < batch_end - i) {
+                    ++level;
+                }
+                u32 count = batch_end - i < (1u << level) ? batch_end - i : 1u << level;
+                HgModelPush push = {.instance = i, .instance_count = count, .vertex_stride = merged->vertex_stride};
+                hg_bind_push_constant(&push, sizeof(push));
+                hg_draw(s_vertex_pool_buffer, merged->levels[level], 0);
+                ++stats->draws;
+                i += count;
+            }
+        } else {
+            HgBuffer* vertex_buffer = draw->vertex_buffer != NULL ? draw->vertex_buffer : s_vertex_pool_buffer;
+            for (u32 i = batch_begin; i < batch_end; ++i) {
+                HgModelPush push = {.instance = i, .instance_count = 1, .vertex_stride = UINT32_MAX};
+                hg_bind_push_constant(&push, sizeof(push));
+                hg_draw(vertex_buffer, draw->index_buffer, 0);
+                ++stats->draws;
+            }
+        }
+        ++stats->batches;
+
+        batch_begin = batch_end;
+    }
+
+    hg_renderpass_end();
+    hg_profiler_end();
+
+    HgTexture* presented = packet->target;
+    if (packet->render_output != NULL) {
+        hg_upscale_record(packet);
+        presented = packet->render_output;
+    }
+
+    if (packet->present) {
+        u64 submitted = hg_profiler_time();
+        packet->result = hg_frame_end(presented);
+        if (packet->gpu_timing && packet->result == HG_SUCCESS) {
+            hg_graphics_wait();
+            u64 idle = hg_profiler_time();
+            hg_profiler_gpu_scope("gpu", submitted, idle);
+            stats->gpu_ms = (f32)((f64)(idle - submitted) * 1.0e-6);
+        }
+    }
+
+    u64 frame_number = atomic_fetch_add(&s_frame_number, 1) + 1;
+    s_frame_index = (u32)(frame_number % HG_3D_FRAMES_IN_FLIGHT);
+}
+
+// Runs on the render thread with pipelining on
+static void hg_frame_submit(HgFramePacket* packet) {
+    hg_profiler_begin("submit");
+
+    u32 shader_count = s_shader_count;
+    packet->result = HG_SUCCESS;
+    // Changed transforms apply even to a frame that fails to begin, as the
+    // objects' dirty bits are already cleared
+    hg_object_transforms_apply(packet);
+    hg_frame_record(packet);
+    packet->stats.shaders_created = s_shader_count - shader_count;
+
+    const HgRenderer3DStats* stats = &packet->stats;
+    u32 triangles = 0;
+    for (u32 level = 0; level < HG_3D_MAX_LODS; ++level) {
+        triangles += stats->lod_triangles[level];
+    }
+    hg_profiler_counter("draws", stats->draws + stats->prepass_draws);
+    hg_profiler_counter("descriptor binds", stats->descriptor_binds);
+    hg_profiler_counter("triangles", triangles);
+    hg_profiler_counter("visible", stats->visible);
+    hg_profiler_counter("occluded", stats->occluded);
+    hg_profiler_counter("lights", packet->world.dir_light_count + packet->point_light_count);
+    hg_profiler_counter("upload bytes", (f64)stats->upload_bytes);
+    hg_profiler_counter("transform uploads", stats->transforms_uploaded);
+
+    mtx_lock(&s_render_mutex);
+    s_submitted_stats = packet->stats;
+    s_submitted_result = packet->result;
+    mtx_unlock(&s_render_mutex);
+
+    hg_profiler_end();
+}
+
+static int hg_render_worker(void* arg) {
+    (void)arg;
+
+    mtx_lock(&s_render_mutex);
+    for (;;) {
+        while (s_render_packet == NULL && !s_render_quit) {
+            cnd_wait(&s_render_work, &s_render_mutex);
+        }
+        if (s_render_packet == NULL)
+            break;
+
+        HgFramePacket* packet = s_render_packet;
+        mtx_unlock(&s_render_mutex);
+        hg_frame_submit(packet);
+        mtx_lock(&s_render_mutex);
+
+        s_render_packet = NULL;
+        cnd_broadcast(&s_render_idle);
+    }
+    mtx_unlock(&s_render_mutex);
+    return 0;
+}
+
+void hg_3d_renderer_wait(void) {
+    hg_render_thread_wait();
+}
+
+void hg_3d_renderer_set_pipelined(bool enabled) {
+    if (enabled == s_pipelined)
+        return;
+
+    if (enabled) {
+        s_render_quit = false;
+        s_render_packet = NULL;
+        thrd_create(&s_render_thread, hg_render_worker, NULL);
+    } else {
+        hg_render_thread_wait();
+        mtx_lock(&s_render_mutex);
+        s_render_quit = true;
+        cnd_signal(&s_render_work);
+        mtx_unlock(&s_render_mutex);
+        thrd_join(s_render_thread, NULL);
+    }
+    s_pipelined = enabled;
+}
+
+static void hg_frame_serial(HgTexture* target, HgTexture* depth_buffer, bool present) {
+    HgFramePacket* packet = &s_packets[s_packet_index];
+    hg_frame_uploads();
+    hg_frame_prepare(packet, target, depth_buffer, present);
+    hg_frame_stats_finish(packet);
+    hg_frame_submit(packet);
+}
+
+HgError hg_3d_renderer_frame(HgTexture* target, HgTexture* depth_buffer) {
+    HG_ASSERT(target != NULL);
+    HG_ASSERT(depth_buffer != NULL);
+
+    hg_memory_frame(&s_memory);
+    hg_profiler_begin("draw");
+
+    HgError result;
+    if (!s_pipelined) {
+        hg_frame_serial(target, depth_buffer, true);
+        result = s_packets[s_packet_index].result;
+    } else {
+        HgFramePacket* packet = &s_packets[s_packet_index];
+        hg_frame_prepare(packet, target, depth_buffer, true);
+
+        // The frame's one sync point: the previous frame has to be
+        // submitted before its packet is handed back, and before uploads
+        // call into the graphics layer
+        hg_profiler_begin("wait");
+        hg_render_thread_wait();
+        hg_profiler_end();
+        hg_frame_uploads();
+        hg_frame_stats_finish(packet);
+        result = s_submitted_result;
+
+        mtx_lock(&s_render_mutex);
+        s_render_packet = packet;
+        cnd_signal(&s_render_work);
+        mtx_unlock(&s_render_mutex);
+        s_packet_index ^= 1;
+    }
+
+    hg_profiler_end();
+    hg_profiler_frame();
+    return result;
+}
+
+void hg_3d_renderer_draw(HgTexture* target, HgTexture* depth_buffer) {
+    HG_ASSERT(target != NULL);
+    HG_ASSERT(depth_buffer != NULL);
+    HG_ASSERT(!s_pipelined);
+
+    hg_memory_frame(&s_memory);
+    hg_profiler_begin("draw");
+    hg_frame_serial(target, depth_buffer, false);
+    hg_profiler_end();
+    hg_profiler_frame();
+}
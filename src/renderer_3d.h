@@ -13,13 +13,66 @@ typedef struct HgTransform3D {
 void hg_3d_renderer_init(void);
 void hg_3d_renderer_shutdown(void);
 
+// Creates every shader variant now rather than on first use
+void hg_3d_renderer_prepare_shaders(void);
+
+// Presizes per frame storage, e.g. from the peaks in HgRenderer3DStats
+void hg_3d_renderer_reserve(u32 model_count, u32 dir_light_count, u32 point_light_count);
+
+// depth_buffer may be NULL, for an output of hg_3d_renderer_set_render_scale
 void hg_3d_renderer_target_create(u32 width, u32 height, HgTexture** target, HgTexture** depth_buffer);
+// hg_3d_renderer_target_create sets this
+void hg_3d_renderer_set_target_size(u32 width, u32 height);
+// Below 1, frames draw to the top left scale of the target, which is then
+// upscaled to output, a target of the same size. Present output, not target
+void hg_3d_renderer_set_render_scale(f32 scale, HgTexture* output);
+
+// A radius of zero is never culled
+typedef struct HgBounds3D {
+    HgVec3 center;
+    f32 radius;
+} HgBounds3D;
+
+typedef enum HgVertexFormat3D {
+    HG_VERTEX_FORMAT_3D_FLOAT,
+    HG_VERTEX_FORMAT_3D_PACKED,
+} HgVertexFormat3D;
+
+// Maps packed snorm positions back to model space: position * scale + offset
+typedef struct HgVertexQuantization3D {
+    HgVec3 offset;
+    HgVec3 scale;
+} HgVertexQuantization3D;
+
+#define HG_3D_MAX_LODS 4
+
+// error is in model space
+typedef struct HgModelLod3D {
+    HgBuffer* index_buffer;
+    u32 index_count;
+    f32 error;
+} HgModelLod3D;
+
+// Vertices in the renderer's shared vertex pool
+typedef struct HgMesh3D HgMesh3D;
 
 typedef struct HgModel3D {
+    // Overrides vertex_buffer; indices are relative to the mesh
+    HgMesh3D* mesh;
     HgBuffer* vertex_buffer;
     HgBuffer* index_buffer;
     HgTexture* color_map;
     HgTexture* normal_map;
+    bool unlit;
+    HgBounds3D bounds;
+    HgVertexFormat3D vertex_format;
+    // Only used with HG_VERTEX_FORMAT_3D_PACKED
+    HgVertexQuantization3D quantization;
+    // For statistics
+    u32 index_count;
+    // Coarser levels after index_buffer, finest first
+    u32 lod_count;
+    HgModelLod3D lods[HG_3D_MAX_LODS - 1];
 } HgModel3D;
 
 typedef struct HgVertex3D {
@@ -29,17 +82,229 @@ typedef struct HgVertex3D {
     HgVec2 uv;
 } HgVertex3D;
 
-HgBuffer* hg_3d_vertex_buffer_create(const HgVertex3D* vertices, u32 vertex_count);
+// bounds may be NULL
+HgBuffer* hg_3d_vertex_buffer_create(const HgVertex3D* vertices, u32 vertex_count, HgBounds3D* bounds);
+HgMesh3D* hg_3d_mesh_create(const HgVertex3D* vertices, u32 vertex_count, HgBounds3D* bounds);
+void hg_3d_mesh_destroy(HgMesh3D* mesh);
+// A simplified shape inside the mesh's surface, for occlusion culling. A
+// vertex_count of 0 removes it
+void hg_3d_mesh_set_occluder(
+    HgMesh3D* mesh, const HgVec3* positions, u32 vertex_count, const u32* indices, u32 index_count
+);
+// Uploads the whole pool, so call it at a loading screen
+void hg_3d_renderer_defragment_meshes(void);
+
+// snorm16 position with the tangent sign in w, octahedral normal and
+// tangent, half float uv
+typedef struct HgPackedVertex3D {
+    i16 position[4];
+    i16 normal[2];
+    i16 tangent[2];
+    u16 uv[2];
+} HgPackedVertex3D;
+
+// bounds may be NULL
+void hg_3d_pack_vertices(
+    const HgVertex3D* vertices,
+    u32 vertex_count,
+    HgPackedVertex3D* packed,
+    HgVertexQuantization3D* quantization,
+    HgBounds3D* bounds
+);
+HgBuffer* hg_3d_packed_vertex_buffer_create(const HgPackedVertex3D* vertices, u32 vertex_count);
 HgBuffer* hg_3d_index_buffer_create(const u32* indices, u32 index_count);
-HgTexture* hg_3d_texture_map_create(const void* data, u32 width, u32 height, HgFormat format, bool filter);
+typedef enum HgTextureMapFlags3D {
+    HG_TEXTURE_MAP_3D_FILTER_BIT = 0x1,
+    HG_TEXTURE_MAP_3D_MIPMAPS_BIT = 0x2,
+} HgTextureMapFlags3D;
+
+typedef enum HgTextureCompression3D {
+    HG_TEXTURE_COMPRESSION_3D_NONE,
+    HG_TEXTURE_COMPRESSION_3D_BC1,
+    // Two channel normals, from snorm data
+    HG_TEXTURE_COMPRESSION_3D_BC5,
+    HG_TEXTURE_COMPRESSION_3D_BC7,
+} HgTextureCompression3D;
+
+// format describes data; flags is a combination of HgTextureMapFlags3D
+HgTexture* hg_3d_texture_map_create(
+    const void* data, u32 width, u32 height, HgFormat format, HgTextureCompression3D compression, u32 flags
+);
+
+// Upload over the following frames. data must stay valid until the resource
+// is ready; until then textures draw as the default and buffers are skipped
+HgBuffer* hg_3d_vertex_buffer_create_async(const HgVertex3D* vertices, u32 vertex_count, HgBounds3D* bounds);
+HgBuffer* hg_3d_index_buffer_create_async(const u32* indices, u32 index_count);
+HgTexture* hg_3d_texture_map_create_async(
+    const void* data, u32 width, u32 height, HgFormat format, HgTextureCompression3D compression, u32 flags
+);
+
+bool hg_3d_buffer_ready(const HgBuffer* buffer);
+bool hg_3d_texture_ready(const HgTexture* texture);
+
+// Freed once no frame in flight can use them
+void hg_3d_buffer_destroy(HgBuffer* buffer);
+void hg_3d_texture_destroy(HgTexture* texture);
+
+void hg_3d_renderer_set_upload_budget(usize bytes_per_frame);
+// Blocks until every upload is ready
+void hg_3d_renderer_flush_uploads(void);
+
+// Loads a mesh cooked by mesh_cooker into model
+bool hg_3d_mesh_load(const char* path, HgModel3D* model);
 
 void hg_3d_renderer_update_projection(f32 fov, f32 aspect, f32 near, f32 far);
 void hg_3d_renderer_update_view(HgVec3 position, f32 zoom, HgQuat rotation);
 
 void hg_3d_renderer_queue_directional_light(HgVec3 direction, HgVec3 color, f32 intensity);
-void hg_3d_renderer_queue_point_light(HgVec3 position, HgVec3 color, f32 intensity);
+void hg_3d_renderer_queue_point_light(HgVec3 position, HgVec3 color, f32 intensity, f32 range);
 
+// Level of detail hysteresis is keyed on the model and transform addresses
 void hg_3d_renderer_queue_model(HgModel3D* model, HgTransform3D* transform);
+void hg_3d_renderer_queue_models(const HgModel3D* models, const HgTransform3D* transforms, u32 count);
+
+// Not available with pipelining on
 void hg_3d_renderer_draw(HgTexture* target, HgTexture* depth_buffer);
 
+// Begins, draws and ends a frame. With pipelining on, returns the previous
+// frame's result
+HgError hg_3d_renderer_frame(HgTexture* target, HgTexture* depth_buffer);
+
+// Submits each frame on a render thread while the next is built, at a frame
+// of latency. Off by default
+void hg_3d_renderer_set_pipelined(bool enabled);
+
+// Call before using the graphics layer directly while pipelined
+void hg_3d_renderer_wait(void);
+
+// Drawn every frame until destroyed, without being queued. Not while a frame
+// is being drawn
+typedef struct HgObject3D HgObject3D;
+
+// model and transform are copied
+HgObject3D* hg_3d_object_create(const HgModel3D* model, const HgTransform3D* transform);
+void hg_3d_object_destroy(HgObject3D* object);
+void hg_3d_object_set_transform(HgObject3D* object, const HgTransform3D* transform);
+void hg_3d_object_set_model(HgObject3D* object, const HgModel3D* model);
+// NULL maps use the defaults
+void hg_3d_object_set_material(HgObject3D* object, HgTexture* color_map, HgTexture* normal_map);
+
+// A queue per thread, merged in creation order at draw. Threads may create,
+// destroy and queue into their own concurrently, but not while a frame is
+// being drawn
+typedef struct HgRenderContext3D HgRenderContext3D;
+
+HgRenderContext3D* hg_3d_render_context_create(void);
+void hg_3d_render_context_destroy(HgRenderContext3D* context);
+
+void hg_3d_render_context_queue_directional_light(
+    HgRenderContext3D* context, HgVec3 direction, HgVec3 color, f32 intensity
+);
+void hg_3d_render_context_queue_point_light(
+    HgRenderContext3D* context, HgVec3 position, HgVec3 color, f32 intensity, f32 range
+);
+void hg_3d_render_context_queue_model(HgRenderContext3D* context, HgModel3D* model, HgTransform3D* transform);
+void hg_3d_render_context_queue_models(
+    HgRenderContext3D* context, const HgModel3D* models, const HgTransform3D* transforms, u32 count
+);
+
+typedef struct HgRenderer3DStats {
+    u32 visible;
+    u32 culled;
+    u32 draws;
+    u32 batches;
+    u32 descriptor_binds;
+    u32 descriptor_binds_skipped;
+    u32 material_textures;
+    u32 lod_models[HG_3D_MAX_LODS];
+    u32 lod_triangles[HG_3D_MAX_LODS];
+    u32 uploads_completed;
+    u64 upload_bytes;
+    u32 uploads_pending;
+    u32 models_not_resident;
+    // Projected bounding sphere area over the target's
+    f32 depth_complexity;
+    u32 prepass_draws;
+    u32 occluders;
+    u32 occluded;
+    // In vertices
+    u32 mesh_allocations;
+    u32 vertex_pool_capacity;
+    u32 vertex_pool_used;
+    f32 vertex_pool_fragmentation;
+    u32 objects;
+    u32 transforms_rebuilt;
+    u32 transforms_uploaded;
+    u32 shaders_created;
+    u32 models;
+    u32 dir_lights;
+    u32 point_lights;
+    usize arena_bytes;
+    u32 arena_overflows;
+    // Since init
+    u32 peak_models;
+    u32 peak_dir_lights;
+    u32 peak_point_lights;
+    usize peak_arena_bytes;
+    // With GPU timing on
+    f32 gpu_ms;
+} HgRenderer3DStats;
+
+// Off by default
+void hg_3d_renderer_set_depth_prepass(bool enabled);
+
+// Culls against the occluders of last frame's drawn meshes, see
+// hg_3d_mesh_set_occluder. Off by default
+void hg_3d_renderer_set_occlusion_culling(bool enabled);
+
+// Waits for the GPU after each frame to time it, so for measuring only. Off
+// by default
+void hg_3d_renderer_set_gpu_timing(bool enabled);
+
+typedef enum HgMemoryCategory3D {
+    HG_MEMORY_CATEGORY_3D_MESH,
+    HG_MEMORY_CATEGORY_3D_TEXTURE,
+    // The renderer's per frame buffers
+    HG_MEMORY_CATEGORY_3D_FRAME,
+    HG_MEMORY_CATEGORY_3D_TARGET,
+    HG_MEMORY_CATEGORY_3D_COUNT,
+} HgMemoryCategory3D;
+
+// Estimated from sizes and formats, without driver padding
+typedef struct HgMemoryStats3D {
+    usize bytes[HG_MEMORY_CATEGORY_3D_COUNT];
+    usize peak_bytes[HG_MEMORY_CATEGORY_3D_COUNT];
+    u32 resources[HG_MEMORY_CATEGORY_3D_COUNT];
+    usize total_bytes;
+    usize peak_total_bytes;
+    // Over the last full frame
+    u32 frame_allocations;
+    u32 frame_frees;
+    usize frame_allocated_bytes;
+    usize frame_freed_bytes;
+    usize budget;
+} HgMemoryStats3D;
+
+// Called each frame while over budget. It may not draw
+typedef void (*HgMemoryEvictCallback3D)(usize excess, void* user_data);
+
+// A budget of 0 means none. evict may be NULL
+void hg_3d_renderer_set_memory_budget(usize budget, HgMemoryEvictCallback3D evict, void* user_data);
+void hg_3d_renderer_get_memory_stats(HgMemoryStats3D* stats);
+// Logs every resource still alive; shutdown calls it to report leaks
+void hg_3d_renderer_log_memory(void);
+
+typedef struct HgDrawRecord3D {
+    u64 sort_key;
+    // Objects first, then the queues in context creation order
+    u32 queue_index;
+    HgTransform3D transform;
+} HgDrawRecord3D;
+
+// The last prepared frame's models in draw order. Returns how many it drew
+u32 hg_3d_renderer_get_draw_order(HgDrawRecord3D* records, u32 capacity);
+
+// From the last submitted frame
+void hg_3d_renderer_get_stats(HgRenderer3DStats* stats);
+
 #endif // HG_3D_RENDERER_H
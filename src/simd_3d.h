@@ -0,0 +1,73 @@
+#ifndef HG_SIMD_3D_H
+#define HG_SIMD_3D_H
+
+#include "hg_math.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+// The widest float vector the target supports, so batch kernels over SoA
+// data are written once
+#if defined(__AVX__)
+
+#define HG_SIMD_WIDTH 8
+typedef __m256 HgSimd;
+static inline HgSimd hg_simd_load(const f32* p) { return _mm256_loadu_ps(p); }
+static inline void hg_simd_store(f32* p, HgSimd a) { _mm256_storeu_ps(p, a); }
+static inline HgSimd hg_simd_set(f32 a) { return _mm256_set1_ps(a); }
+static inline HgSimd hg_simd_add(HgSimd a, HgSimd b) { return _mm256_add_ps(a, b); }
+static inline HgSimd hg_simd_sub(HgSimd a, HgSimd b) { return _mm256_sub_ps(a, b); }
+static inline HgSimd hg_simd_mul(HgSimd a, HgSimd b) { return _mm256_mul_ps(a, b); }
+static inline HgSimd hg_simd_div(HgSimd a, HgSimd b) { return _mm256_div_ps(a, b); }
+static inline HgSimd hg_simd_and(HgSimd a, HgSimd b) { return _mm256_and_ps(a, b); }
+static inline HgSimd hg_simd_ge(HgSimd a, HgSimd b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+static inline u32 hg_simd_mask(HgSimd a) { return (u32)_mm256_movemask_ps(a); }
+
+#elif defined(__SSE__) || defined(_M_X64)
+
+#define HG_SIMD_WIDTH 4
+typedef __m128 HgSimd;
+static inline HgSimd hg_simd_load(const f32* p) { return _mm_loadu_ps(p); }
+static inline void hg_simd_store(f32* p, HgSimd a) { _mm_storeu_ps(p, a); }
+static inline HgSimd hg_simd_set(f32 a) { return _mm_set1_ps(a); }
+static inline HgSimd hg_simd_add(HgSimd a, HgSimd b) { return _mm_add_ps(a, b); }
+static inline HgSimd hg_simd_sub(HgSimd a, HgSimd b) { return _mm_sub_ps(a, b); }
+static inline HgSimd hg_simd_mul(HgSimd a, HgSimd b) { return _mm_mul_ps(a, b); }
+static inline HgSimd hg_simd_div(HgSimd a, HgSimd b) { return _mm_div_ps(a, b); }
+static inline HgSimd hg_simd_and(HgSimd a, HgSimd b) { return _mm_and_ps(a, b); }
+static inline HgSimd hg_simd_ge(HgSimd a, HgSimd b) { return _mm_cmpge_ps(a, b); }
+static inline u32 hg_simd_mask(HgSimd a) { return (u32)_mm_movemask_ps(a); }
+
+#else
+
+#define HG_SIMD_WIDTH 1
+typedef f32 HgSimd;
+static inline HgSimd hg_simd_load(const f32* p) { return *p; }
+static inline void hg_simd_store(f32* p, HgSimd a) { *p = a; }
+static inline HgSimd hg_simd_set(f32 a) { return a; }
+static inline HgSimd hg_simd_add(HgSimd a, HgSimd b) { return a + b; }
+static inline HgSimd hg_simd_sub(HgSimd a, HgSimd b) { return a - b; }
+static inline HgSimd hg_simd_mul(HgSimd a, HgSimd b) { return a * b; }
+static inline HgSimd hg_simd_div(HgSimd a, HgSimd b) { return a / b; }
+// Comparison results are 1 or 0 rather than a bit mask, so and is a multiply
+static inline HgSimd hg_simd_and(HgSimd a, HgSimd b) { return a * b; }
+static inline HgSimd hg_simd_ge(HgSimd a, HgSimd b) { return a >= b ? 1.0f : 0.0f; }
+static inline u32 hg_simd_mask(HgSimd a) { return a != 0.0f ? 1 : 0; }
+
+#endif
+
+// Kernels are compiled once for the baseline target, and on x86-64 once
+// more with AVX2, as separate objects. Each build names its kernels with
+// its own suffix, so both link into one program and the renderer picks one
+// at runtime
+#ifndef HG_SIMD_VARIANT
+#define HG_SIMD_VARIANT base
+#endif
+#define HG_SIMD_CONCAT(name, variant) name##_##variant
+#define HG_SIMD_NAME(name, variant) HG_SIMD_CONCAT(name, variant)
+#define HG_SIMD_KERNEL(name) HG_SIMD_NAME(name, HG_SIMD_VARIANT)
+
+#endif // HG_SIMD_3D_H
@@ -0,0 +1,207 @@
+#include "simd_kernels_3d.h"
+#include "simd_3d.h"
+
+#include <float.h>
+#include <string.h>
+
+// Bits set for the spheres of one vector inside all six planes
+static inline u32 hg_cull_spheres_mask(const f32* xs, const f32* ys, const f32* zs, const f32* rs, const f32 planes[6][4]) {
+    HgSimd x = hg_simd_load(xs);
+    HgSimd y = hg_simd_load(ys);
+    HgSimd z = hg_simd_load(zs);
+    HgSimd neg_r = hg_simd_sub(hg_simd_set(0.0f), hg_simd_load(rs));
+
+    HgSimd inside = hg_simd_ge(x, hg_simd_set(-FLT_MAX));
+    for (u32 p = 0; p < 6; ++p) {
+        HgSimd d = hg_simd_add(
+            hg_simd_add(hg_simd_mul(x, hg_simd_set(planes[p][0])), hg_simd_mul(y, hg_simd_set(planes[p][1]))),
+            hg_simd_add(hg_simd_mul(z, hg_simd_set(planes[p][2])), hg_simd_set(planes[p][3])));
+        inside = hg_simd_and(inside, hg_simd_ge(d, neg_r));
+    }
+    return hg_simd_mask(inside);
+}
+
+u32 HG_SIMD_KERNEL(hg_cull_spheres)(
+    const f32* xs, const f32* ys, const f32* zs, const f32* rs, u32 count, const f32 planes[6][4], u32* visible
+) {
+    u32 visible_count = 0;
+    u32 i = 0;
+    for (; i + HG_SIMD_WIDTH <= count; i += HG_SIMD_WIDTH) {
+        u32 mask = hg_cull_spheres_mask(xs + i, ys + i, zs + i, rs + i, planes);
+        for (u32 lane = 0; lane < HG_SIMD_WIDTH; ++lane) {
+            if (mask & (1u << lane))
+                visible[visible_count++] = i + lane;
+        }
+    }
+
+    // The last partial vector is copied out rather than loaded in place, so
+    // nothing past count is read
+    if (i < count) {
+        f32 tail[4][HG_SIMD_WIDTH] = {0};
+        u32 lanes = count - i;
+        memcpy(tail[0], xs + i, lanes * sizeof(f32));
+        memcpy(tail[1], ys + i, lanes * sizeof(f32));
+        memcpy(tail[2], zs + i, lanes * sizeof(f32));
+        memcpy(tail[3], rs + i, lanes * sizeof(f32));
+
+        u32 mask = hg_cull_spheres_mask(tail[0], tail[1], tail[2], tail[3], planes);
+        for (u32 lane = 0; lane < lanes; ++lane) {
+            if (mask & (1u << lane))
+                visible[visible_count++] = i + lane;
+        }
+    }
+
+    return visible_count;
+}
+
+// Builds lanes transforms, at most HG_SIMD_WIDTH, from the vector at src
+static inline void hg_build_transforms_block(
+    const f32* const src[HG_TRANSFORM_COMPONENT_COUNT], u32 lanes, HgModelTransform* dst
+) {
+    HgSimd qw = hg_simd_load(src[HG_TRANSFORM_ROTATION_W]);
+    HgSimd qx = hg_simd_load(src[HG_TRANSFORM_ROTATION_X]);
+    HgSimd qy = hg_simd_load(src[HG_TRANSFORM_ROTATION_Y]);
+    HgSimd qz = hg_simd_load(src[HG_TRANSFORM_ROTATION_Z]);
+
+    HgSimd two = hg_simd_set(2.0f);
+    HgSimd one = hg_simd_set(1.0f);
+    HgSimd xx = hg_simd_mul(qx, qx);
+    HgSimd yy = hg_simd_mul(qy, qy);
+    HgSimd zz = hg_simd_mul(qz, qz);
+    HgSimd xy = hg_simd_mul(qx, qy);
+    HgSimd xz = hg_simd_mul(qx, qz);
+    HgSimd yz = hg_simd_mul(qy, qz);
+    HgSimd wx = hg_simd_mul(qw, qx);
+    HgSimd wy = hg_simd_mul(qw, qy);
+    HgSimd wz = hg_simd_mul(qw, qz);
+
+    // Model matrix columns: rotation scaled per axis, then translation
+    HgSimd scale[3] = {
+        hg_simd_load(src[HG_TRANSFORM_SCALE_X]),
+        hg_simd_load(src[HG_TRANSFORM_SCALE_Y]),
+        hg_simd_load(src[HG_TRANSFORM_SCALE_Z]),
+    };
+    HgSimd model[4][3] = {{
+        hg_simd_sub(one, hg_simd_mul(two, hg_simd_add(yy, zz))),
+        hg_simd_mul(two, hg_simd_add(xy, wz)),
+        hg_simd_mul(two, hg_simd_sub(xz, wy)),
+    }, {
+        hg_simd_mul(two, hg_simd_sub(xy, wz)),
+        hg_simd_sub(one, hg_simd_mul(two, hg_simd_add(xx, zz))),
+        hg_simd_mul(two, hg_simd_add(yz, wx)),
+    }, {
+        hg_simd_mul(two, hg_simd_add(xz, wy)),
+        hg_simd_mul(two, hg_simd_sub(yz, wx)),
+        hg_simd_sub(one, hg_simd_mul(two, hg_simd_add(xx, yy))),
+    }, {
+        hg_simd_load(src[HG_TRANSFORM_POSITION_X]),
+        hg_simd_load(src[HG_TRANSFORM_POSITION_Y]),
+        hg_simd_load(src[HG_TRANSFORM_POSITION_Z]),
+    }};
+    for (u32 c = 0; c < 3; ++c) {
+        for (u32 r = 0; r < 3; ++r) {
+            model[c][r] = hg_simd_mul(model[c][r], scale[c]);
+        }
+    }
+
+    // The inverse transpose of columns a, b, c is (b x c, c x a, a x b) / det
+    HgSimd normal[3][3];
+    for (u32 c = 0; c < 3; ++c) {
+        const HgSimd* u = model[(c + 1) % 3];
+        const HgSimd* v = model[(c + 2) % 3];
+        normal[c][0] = hg_simd_sub(hg_simd_mul(u[1], v[2]), hg_simd_mul(u[2], v[1]));
+        normal[c][1] = hg_simd_sub(hg_simd_mul(u[2], v[0]), hg_simd_mul(u[0], v[2]));
+        normal[c][2] = hg_simd_sub(hg_simd_mul(u[0], v[1]), hg_simd_mul(u[1], v[0]));
+    }
+    HgSimd det = hg_simd_add(
+        hg_simd_add(hg_simd_mul(model[0][0], normal[0][0]), hg_simd_mul(model[0][1], normal[0][1])),
+        hg_simd_mul(model[0][2], normal[0][2]));
+    HgSimd inv_det = hg_simd_div(one, det);
+
+    // Dequantization only applies to positions, so it goes in after the
+    // normal matrix: model = model * translate(offset) * scale(scale)
+    HgSimd dequant_offset[3] = {
+        hg_simd_load(src[HG_TRANSFORM_DEQUANT_OFFSET_X]),
+        hg_simd_load(src[HG_TRANSFORM_DEQUANT_OFFSET_Y]),
+        hg_simd_load(src[HG_TRANSFORM_DEQUANT_OFFSET_Z]),
+    };
+    HgSimd dequant_scale[3] = {
+        hg_simd_load(src[HG_TRANSFORM_DEQUANT_SCALE_X]),
+        hg_simd_load(src[HG_TRANSFORM_DEQUANT_SCALE_Y]),
+        hg_simd_load(src[HG_TRANSFORM_DEQUANT_SCALE_Z]),
+    };
+    for (u32 r = 0; r < 3; ++r) {
+        model[3][r] = hg_simd_add(model[3][r], hg_simd_add(
+            hg_simd_add(hg_simd_mul(model[0][r], dequant_offset[0]), hg_simd_mul(model[1][r], dequant_offset[1])),
+            hg_simd_mul(model[2][r], dequant_offset[2])));
+    }
+    for (u32 c = 0; c < 3; ++c) {
+        for (u32 r = 0; r < 3; ++r) {
+            model[c][r] = hg_simd_mul(model[c][r], dequant_scale[c]);
+        }
+    }
+
+    f32 lane_model[4][4][HG_SIMD_WIDTH];
+    f32 lane_normal[3][3][HG_SIMD_WIDTH];
+    for (u32 c = 0; c < 4; ++c) {
+        for (u32 r = 0; r < 3; ++r) {
+            hg_simd_store(lane_model[c][r], model[c][r]);
+        }
+        hg_simd_store(lane_model[c][3], hg_simd_set(c == 3 ? 1.0f : 0.0f));
+    }
+    for (u32 c = 0; c < 3; ++c) {
+        for (u32 r = 0; r < 3; ++r) {
+            hg_simd_store(lane_normal[c][r], hg_simd_mul(normal[c][r], inv_det));
+        }
+    }
+
+    for (u32 lane = 0; lane < lanes; ++lane) {
+        f32 out_model[4][4];
+        for (u32 c = 0; c < 4; ++c) {
+            for (u32 r = 0; r < 4; ++r) {
+                out_model[c][r] = lane_model[c][r][lane];
+            }
+        }
+        HgModelTransform* transform = &dst[lane];
+        memcpy(&transform->model, out_model, sizeof(out_model));
+        for (u32 c = 0; c < 3; ++c) {
+            transform->normal[c] = (HgVec4){
+                lane_normal[c][0][lane], lane_normal[c][1][lane], lane_normal[c][2][lane], 0.0f
+            };
+        }
+    }
+}
+
+void HG_SIMD_KERNEL(hg_build_transforms)(
+    const f32* const components[HG_TRANSFORM_COMPONENT_COUNT], u32 count, HgModelTransform* dst
+) {
+    const f32* src[HG_TRANSFORM_COMPONENT_COUNT];
+    u32 i = 0;
+    for (; i + HG_SIMD_WIDTH <= count; i += HG_SIMD_WIDTH) {
+        for (u32 c = 0; c < HG_TRANSFORM_COMPONENT_COUNT; ++c) {
+            src[c] = components[c] + i;
+        }
+        hg_build_transforms_block(src, HG_SIMD_WIDTH, dst + i);
+    }
+
+    // As in culling, the last partial vector is copied out. The unused lanes
+    // hold an identity transform so they stay finite
+    if (i < count) {
+        f32 tail[HG_TRANSFORM_COMPONENT_COUNT][HG_SIMD_WIDTH] = {0};
+        u32 lanes = count - i;
+        for (u32 lane = lanes; lane < HG_SIMD_WIDTH; ++lane) {
+            tail[HG_TRANSFORM_SCALE_X][lane] = 1.0f;
+            tail[HG_TRANSFORM_SCALE_Y][lane] = 1.0f;
+            tail[HG_TRANSFORM_SCALE_Z][lane] = 1.0f;
+            tail[HG_TRANSFORM_ROTATION_W][lane] = 1.0f;
+            tail[HG_TRANSFORM_DEQUANT_SCALE_X][lane] = 1.0f;
+            tail[HG_TRANSFORM_DEQUANT_SCALE_Y][lane] = 1.0f;
+            tail[HG_TRANSFORM_DEQUANT_SCALE_Z][lane] = 1.0f;
+        }
+        for (u32 c = 0; c < HG_TRANSFORM_COMPONENT_COUNT; ++c) {
+            memcpy(tail[c], components[c] + i, lanes * sizeof(f32));
+            src[c] = tail[c];
+        }
+        hg_build_transforms_block(src, lanes, dst + i);
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef HG_SIMD_KERNELS_3D_H
+#define HG_SIMD_KERNELS_3D_H
+
+#include "hg_math.h"
+
+// World space model and normal matrices; the shaders apply the view. Matches
+// std430 layout, with the mat3 columns padded to vec4
+typedef struct HgModelTransform {
+    HgMat4 model;
+    HgVec4 normal[3];
+} HgModelTransform;
+
+// Transforms to build, one array per component. Packed vertex positions are
+// dequantized by folding their offset and scale into the model matrix
+typedef enum HgTransformComponent {
+    HG_TRANSFORM_POSITION_X,
+    HG_TRANSFORM_POSITION_Y,
+    HG_TRANSFORM_POSITION_Z,
+    HG_TRANSFORM_SCALE_X,
+    HG_TRANSFORM_SCALE_Y,
+    HG_TRANSFORM_SCALE_Z,
+    HG_TRANSFORM_ROTATION_W,
+    HG_TRANSFORM_ROTATION_X,
+    HG_TRANSFORM_ROTATION_Y,
+    HG_TRANSFORM_ROTATION_Z,
+    HG_TRANSFORM_DEQUANT_OFFSET_X,
+    HG_TRANSFORM_DEQUANT_OFFSET_Y,
+    HG_TRANSFORM_DEQUANT_OFFSET_Z,
+    HG_TRANSFORM_DEQUANT_SCALE_X,
+    HG_TRANSFORM_DEQUANT_SCALE_Y,
+    HG_TRANSFORM_DEQUANT_SCALE_Z,
+    HG_TRANSFORM_COMPONENT_COUNT,
+} HgTransformComponent;
+
+// Tests count bounding spheres, as arrays of x, y, z and radius, against
+// six normalized planes, writing the indices of those inside to visible in
+// ascending order. Returns how many there were
+typedef u32 (*HgCullSpheresKernel)(
+    const f32* xs, const f32* ys, const f32* zs, const f32* rs, u32 count, const f32 planes[6][4], u32* visible
+);
+
+// Builds the model and normal matrices of the first count entries of the
+// component arrays into dst. The normal matrix is the inverse transpose of
+// the model's upper 3x3
+typedef void (*HgBuildTransformsKernel)(
+    const f32* const components[HG_TRANSFORM_COMPONENT_COUNT], u32 count, HgModelTransform* dst
+);
+
+// Neither reads past count, so the arrays need no padding
+u32 hg_cull_spheres_base(
+    const f32* xs, const f32* ys, const f32* zs, const f32* rs, u32 count, const f32 planes[6][4], u32* visible
+);
+void hg_build_transforms_base(
+    const f32* const components[HG_TRANSFORM_COMPONENT_COUNT], u32 count, HgModelTransform* dst
+);
+
+// Only built on x86-64, which build.sh signals with HG_3D_AVX_KERNELS. Call
+// only when the CPU has AVX2 and FMA
+u32 hg_cull_spheres_avx(
+    const f32* xs, const f32* ys, const f32* zs, const f32* rs, u32 count, const f32 planes[6][4], u32* visible
+);
+void hg_build_transforms_avx(
+    const f32* const components[HG_TRANSFORM_COMPONENT_COUNT], u32 count, HgModelTransform* dst
+);
+
+#endif // HG_SIMD_KERNELS_3D_H
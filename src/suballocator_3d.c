@@ -0,0 +1,148 @@
+#include "suballocator_3d.h"
+
+#include <string.h>
+
+void hg_suballocator_init(HgSuballocator3D* allocator, u32 capacity) {
+    HG_ASSERT(allocator != NULL);
+
+    *allocator = (HgSuballocator3D){
+        .free_capacity = 16,
+        .capacity = capacity,
+    };
+    allocator->free_ranges = hg_heap_alloc(allocator->free_capacity * sizeof(HgRange3D));
+    if (capacity > 0)
+        allocator->free_ranges[allocator->free_count++] = (HgRange3D){0, capacity};
+}
+
+void hg_suballocator_destroy(HgSuballocator3D* allocator) {
+    HG_ASSERT(allocator != NULL);
+
+    hg_heap_free(allocator->free_ranges);
+    *allocator = (HgSuballocator3D){0};
+}
+
+static void hg_free_range_insert(HgSuballocator3D* allocator, u32 index, HgRange3D range) {
+    if (allocator->free_count == allocator->free_capacity) {
+        allocator->free_capacity *= 2;
+        allocator->free_ranges = hg_heap_realloc(
+            allocator->free_ranges, allocator->free_capacity * sizeof(HgRange3D)
+        );
+    }
+    memmove(allocator->free_ranges + index + 1, allocator->free_ranges + index,
+        (allocator->free_count - index) * sizeof(HgRange3D));
+    allocator->free_ranges[index] = range;
+    ++allocator->free_count;
+}
+
+static void hg_free_range_remove(HgSuballocator3D* allocator, u32 index) {
+    --allocator->free_count;
+    memmove(allocator->free_ranges + index, allocator->free_ranges + index + 1,
+        (allocator->free_count - index) * sizeof(HgRange3D));
+}
+
+bool hg_suballocator_alloc(HgSuballocator3D* allocator, u32 size, u32* offset) {
+    HG_ASSERT(allocator != NULL);
+    HG_ASSERT(size > 0);
+    HG_ASSERT(offset != NULL);
+
+    u32 best = allocator->free_count;
+    for (u32 i = 0; i < allocator->free_count; ++i) {
+        u32 range_size = allocator->free_ranges[i].size;
+        if (range_size >= size && (best == allocator->free_count || range_size < allocator->free_ranges[best].size)) {
+            best = i;
+            if (range_size == size)
+                break;
+        }
+    }
+    if (best == allocator->free_count)
+        return false;
+
+    HgRange3D* range = &allocator->free_ranges[best];
+    *offset = range->offset;
+    range->offset += size;
+    range->size -= size;
+    if (range->size == 0)
+        hg_free_range_remove(allocator, best);
+
+    allocator->used += size;
+    ++allocator->allocation_count;
+    return true;
+}
+
+void hg_suballocator_free(HgSuballocator3D* allocator, u32 offset, u32 size) {
+    HG_ASSERT(allocator != NULL);
+    HG_ASSERT(size > 0);
+    HG_ASSERT(offset + size <= allocator->capacity);
+    HG_ASSERT(allocator->allocation_count > 0);
+
+    // First free range after the freed one
+    u32 lo = 0;
+    u32 hi = allocator->free_count;
+    while (lo < hi) {
+        u32 mid = (lo + hi) / 2;
+        if (allocator->free_ranges[mid].offset < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    HG_ASSERT(lo == allocator->free_count || offset + size <= allocator->free_ranges[lo].offset);
+    HG_ASSERT(lo == 0 || allocator->free_ranges[lo - 1].offset + allocator->free_ranges[lo - 1].size <= offset);
+
+    bool merge_prev = lo > 0
+        && allocator->free_ranges[lo - 1].offset + allocator->free_ranges[lo - 1].size == offset;
+    bool merge_next = lo < allocator->free_count && allocator->free_ranges[lo].offset == offset + size;
+    if (merge_prev && merge_next) {
+        allocator->free_ranges[lo - 1].size += size + allocator->free_ranges[lo].size;
+        hg_free_range_remove(allocator, lo);
+    } else if (merge_prev) {
+        allocator->free_ranges[lo - 1].size += size;
+    } else if (merge_next) {
+        allocator->free_ranges[lo].offset = offset;
+        allocator->free_ranges[lo].size += size;
+    } else {
+        hg_free_range_insert(allocator, lo, (HgRange3D){offset, size});
+    }
+
+    allocator->used -= size;
+    --allocator->allocation_count;
+}
+
+void hg_suballocator_grow(HgSuballocator3D* allocator, u32 capacity) {
+    HG_ASSERT(allocator != NULL);
+    HG_ASSERT(capacity >= allocator->capacity);
+
+    if (capacity == allocator->capacity)
+        return;
+
+    u32 old_capacity = allocator->capacity;
+    allocator->capacity = capacity;
+
+    HgRange3D* last = allocator->free_count > 0 ? &allocator->free_ranges[allocator->free_count - 1] : NULL;
+    if (last != NULL && last->offset + last->size == old_capacity) {
+        last->size += capacity - old_capacity;
+    } else {
+        hg_free_range_insert(allocator, allocator->free_count, (HgRange3D){old_capacity, capacity - old_capacity});
+    }
+}
+
+void hg_suballocator_reset(HgSuballocator3D* allocator, u32 used, u32 allocation_count) {
+    HG_ASSERT(allocator != NULL);
+    HG_ASSERT(used <= allocator->capacity);
+
+    allocator->free_count = 0;
+    if (used < allocator->capacity)
+        allocator->free_ranges[allocator->free_count++] = (HgRange3D){used, allocator->capacity - used};
+    allocator->used = used;
+    allocator->allocation_count = allocation_count;
+}
+
+u32 hg_suballocator_largest_free(const HgSuballocator3D* allocator) {
+    HG_ASSERT(allocator != NULL);
+
+    u32 largest = 0;
+    for (u32 i = 0; i < allocator->free_count; ++i) {
+        if (allocator->free_ranges[i].size > largest)
+            largest = allocator->free_ranges[i].size;
+    }
+    return largest;
+}
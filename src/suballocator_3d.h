@@ -0,0 +1,39 @@
+#ifndef HG_SUBALLOCATOR_3D_H
+#define HG_SUBALLOCATOR_3D_H
+
+#include "hg_math.h"
+
+// Hands out ranges of a larger buffer, in whatever unit the caller uses. Free
+// ranges are kept sorted by offset and coalesced on free, and allocation is
+// best fit, which keeps fragmentation low for the mesh sized requests it is
+// used for. Only bookkeeping: the caller owns the buffer itself
+typedef struct HgRange3D {
+    u32 offset;
+    u32 size;
+} HgRange3D;
+
+typedef struct HgSuballocator3D {
+    HgRange3D* free_ranges;
+    u32 free_count;
+    u32 free_capacity;
+    u32 capacity;
+    u32 used;
+    u32 allocation_count;
+} HgSuballocator3D;
+
+void hg_suballocator_init(HgSuballocator3D* allocator, u32 capacity);
+void hg_suballocator_destroy(HgSuballocator3D* allocator);
+
+// Returns false, leaving offset untouched, if no free range is big enough
+bool hg_suballocator_alloc(HgSuballocator3D* allocator, u32 size, u32* offset);
+void hg_suballocator_free(HgSuballocator3D* allocator, u32 offset, u32 size);
+
+// Extends the range to capacity, adding the new tail as free space
+void hg_suballocator_grow(HgSuballocator3D* allocator, u32 capacity);
+// Forgets every allocation but leaves used units allocated at the start, for
+// after the caller has compacted its allocations there
+void hg_suballocator_reset(HgSuballocator3D* allocator, u32 used, u32 allocation_count);
+
+u32 hg_suballocator_largest_free(const HgSuballocator3D* allocator);
+
+#endif // HG_SUBALLOCATOR_3D_H
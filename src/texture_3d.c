@@ -0,0 +1,661 @@
+#include "texture_3d.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+u32 hg_texture_mip_count(u32 width, u32 height) {
+    u32 levels = 1;
+    while (width > 1 || height > 1) {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        ++levels;
+    }
+    return levels;
+}
+
+static bool hg_format_is_block(HgFormat format) {
+    return format == HG_FORMAT_BC1_RGBA_UNORM_BLOCK
+        || format == HG_FORMAT_BC1_RGBA_SRGB_BLOCK
+        || format == HG_FORMAT_BC5_SNORM_BLOCK
+        || format == HG_FORMAT_BC7_UNORM_BLOCK
+        || format == HG_FORMAT_BC7_SRGB_BLOCK;
+}
+
+// Bytes per texel, or per 4x4 block for block formats
+static usize hg_format_size(HgFormat format) {
+    switch (format) {
+        case HG_FORMAT_R8G8B8A8_UNORM:
+        case HG_FORMAT_R8G8B8A8_SRGB:
+        case HG_FORMAT_R8G8B8A8_SNORM:
+            return 4;
+        case HG_FORMAT_R32G32B32A32_SFLOAT:
+            return 16;
+        case HG_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case HG_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            return 8;
+        case HG_FORMAT_BC5_SNORM_BLOCK:
+        case HG_FORMAT_BC7_UNORM_BLOCK:
+        case HG_FORMAT_BC7_SRGB_BLOCK:
+            return 16;
+        default:
+            HG_ASSERT(false);
+            return 0;
+    }
+}
+
+static usize hg_level_size(u32 width, u32 height, HgFormat format) {
+    if (hg_format_is_block(format))
+        return (usize)((width + 3) / 4) * (usize)((height + 3) / 4) * hg_format_size(format);
+    return (usize)width * (usize)height * hg_format_size(format);
+}
+
+usize hg_texture_mip_chain_size(u32 width, u32 height, u32 mip_levels, HgFormat format) {
+    usize size = 0;
+    for (u32 level = 0; level < mip_levels; ++level) {
+        size += hg_level_size(width, height, format);
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return size;
+}
+
+static f32 hg_srgb_to_linear(f32 c) {
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static f32 hg_linear_to_srgb(f32 c) {
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+static u8 hg_pack_unorm8(f32 value) {
+    return (u8)lrintf(fminf(fmaxf(value, 0.0f), 1.0f) * 255.0f);
+}
+
+static i8 hg_pack_snorm8(f32 value) {
+    return (i8)lrintf(fminf(fmaxf(value, -1.0f), 1.0f) * 127.0f);
+}
+
+// Level texels to linear RGBA floats
+static void hg_level_load(const void* src, u32 texel_count, HgFormat format, f32* dst) {
+    switch (format) {
+        case HG_FORMAT_R8G8B8A8_UNORM: {
+            const u8* texels = src;
+            for (u32 i = 0; i < 4 * texel_count; ++i) {
+                dst[i] = (f32)texels[i] * (1.0f / 255.0f);
+            }
+        } break;
+        case HG_FORMAT_R8G8B8A8_SRGB: {
+            f32 table[256];
+            for (u32 i = 0; i < 256; ++i) {
+                table[i] = hg_srgb_to_linear((f32)i * (1.0f / 255.0f));
+            }
+            const u8* texels = src;
+            for (u32 i = 0; i < texel_count; ++i) {
+                dst[4 * i + 0] = table[texels[4 * i + 0]];
+                dst[4 * i + 1] = table[texels[4 * i + 1]];
+                dst[4 * i + 2] = table[texels[4 * i + 2]];
+                dst[4 * i + 3] = (f32)texels[4 * i + 3] * (1.0f / 255.0f);
+            }
+        } break;
+        case HG_FORMAT_R8G8B8A8_SNORM: {
+            const i8* texels = src;
+            for (u32 i = 0; i < 4 * texel_count; ++i) {
+                dst[i] = fmaxf((f32)texels[i] * (1.0f / 127.0f), -1.0f);
+            }
+        } break;
+        case HG_FORMAT_R32G32B32A32_SFLOAT:
+            memcpy(dst, src, 4 * texel_count * sizeof(f32));
+            break;
+        default:
+            HG_ASSERT(false);
+            break;
+    }
+}
+
+static void hg_level_store(const f32* src, u32 texel_count, HgFormat format, void* dst) {
+    switch (format) {
+        case HG_FORMAT_R8G8B8A8_UNORM: {
+            u8* texels = dst;
+            for (u32 i = 0; i < 4 * texel_count; ++i) {
+                texels[i] = hg_pack_unorm8(src[i]);
+            }
+        } break;
+        case HG_FORMAT_R8G8B8A8_SRGB: {
+            u8* texels = dst;
+            for (u32 i = 0; i < texel_count; ++i) {
+                texels[4 * i + 0] = hg_pack_unorm8(hg_linear_to_srgb(src[4 * i + 0]));
+                texels[4 * i + 1] = hg_pack_unorm8(hg_linear_to_srgb(src[4 * i + 1]));
+                texels[4 * i + 2] = hg_pack_unorm8(hg_linear_to_srgb(src[4 * i + 2]));
+                texels[4 * i + 3] = hg_pack_unorm8(src[4 * i + 3]);
+            }
+        } break;
+        case HG_FORMAT_R8G8B8A8_SNORM: {
+            i8* texels = dst;
+            for (u32 i = 0; i < 4 * texel_count; ++i) {
+                texels[i] = hg_pack_snorm8(src[i]);
+            }
+        } break;
+        case HG_FORMAT_R32G32B32A32_SFLOAT:
+            memcpy(dst, src, 4 * texel_count * sizeof(f32));
+            break;
+        default:
+            HG_ASSERT(false);
+            break;
+    }
+}
+
+// Mips are reduced with a Kaiser windowed sinc, which keeps detail a box
+// filter blurs away and aliases less. The width is in destination texels,
+// each side of the center
+#define HG_MIP_FILTER_WIDTH 3.0f
+#define HG_MIP_FILTER_ALPHA 4.0f
+
+// Zeroth order modified Bessel function of the first kind, from its series
+static f32 hg_bessel_i0(f32 x) {
+    f32 sum = 1.0f;
+    f32 term = 1.0f;
+    f32 quarter_x2 = 0.25f * x * x;
+    for (u32 k = 1; k < 32 && term > 1e-7f * sum; ++k) {
+        term *= quarter_x2 / ((f32)k * (f32)k);
+        sum += term;
+    }
+    return sum;
+}
+
+static f32 hg_mip_filter(f32 x) {
+    if (fabsf(x) >= HG_MIP_FILTER_WIDTH)
+        return 0.0f;
+    f32 sinc = x == 0.0f ? 1.0f : sinf((f32)HG_PI * x) / ((f32)HG_PI * x);
+    f32 r = x / HG_MIP_FILTER_WIDTH;
+    return sinc * hg_bessel_i0(HG_MIP_FILTER_ALPHA * sqrtf(1.0f - r * r)) / hg_bessel_i0(HG_MIP_FILTER_ALPHA);
+}
+
+// Filter taps per destination texel when reducing src_size texels to dst_size
+static u32 hg_mip_filter_taps(u32 src_size, u32 dst_size) {
+    f32 scale = (f32)src_size / (f32)dst_size;
+    return (u32)ceilf(2.0f * HG_MIP_FILTER_WIDTH * scale) + 1;
+}
+
+// Normalized weights of the taps of each destination texel, starting from
+// source texel first[i]. Indices past the edges are clamped by the caller,
+// so edge texels stand in for the missing ones
+static void hg_mip_filter_weights(u32 src_size, u32 dst_size, u32 taps, i32* first, f32* weights) {
+    f32 scale = (f32)src_size / (f32)dst_size;
+    for (u32 i = 0; i < dst_size; ++i) {
+        f32 center = ((f32)i + 0.5f) * scale;
+        first[i] = (i32)floorf(center - HG_MIP_FILTER_WIDTH * scale);
+
+        f32* w = weights + (usize)i * taps;
+        f32 sum = 0.0f;
+        for (u32 t = 0; t < taps; ++t) {
+            w[t] = hg_mip_filter(((f32)first[i] + (f32)t + 0.5f - center) / scale);
+            sum += w[t];
+        }
+        for (u32 t = 0; t < taps; ++t) {
+            w[t] /= sum;
+        }
+    }
+}
+
+static u32 hg_clamp_texel(i32 i, u32 size) {
+    return i < 0 ? 0 : (u32)i >= size ? size - 1 : (u32)i;
+}
+
+// Reduces a linear RGBA float level to the next size down, filtering rows
+// into scratch, width / 2 by height, then columns into dst
+static void hg_level_downsample(const f32* src, u32 width, u32 height, f32* scratch, f32* dst) {
+    u32 dst_width = width > 1 ? width / 2 : 1;
+    u32 dst_height = height > 1 ? height / 2 : 1;
+
+    u32 x_taps = hg_mip_filter_taps(width, dst_width);
+    u32 y_taps = hg_mip_filter_taps(height, dst_height);
+    i32* x_first = hg_heap_alloc(dst_width * sizeof(i32));
+    i32* y_first = hg_heap_alloc(dst_height * sizeof(i32));
+    f32* x_weights = hg_heap_alloc((usize)dst_width * x_taps * sizeof(f32));
+    f32* y_weights = hg_heap_alloc((usize)dst_height * y_taps * sizeof(f32));
+    hg_mip_filter_weights(width, dst_width, x_taps, x_first, x_weights);
+    hg_mip_filter_weights(height, dst_height, y_taps, y_first, y_weights);
+
+    for (u32 y = 0; y < height; ++y) {
+        const f32* row = src + 4 * (usize)width * y;
+        f32* out = scratch + 4 * (usize)dst_width * y;
+        for (u32 x = 0; x < dst_width; ++x) {
+            const f32* w = x_weights + (usize)x * x_taps;
+#if defined(__SSE__) || defined(_M_X64)
+            // One RGBA texel per vector
+            __m128 sum = _mm_setzero_ps();
+            for (u32 t = 0; t < x_taps; ++t) {
+                const f32* texel = row + 4 * hg_clamp_texel(x_first[x] + (i32)t, width);
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(texel), _mm_set1_ps(w[t])));
+            }
+            _mm_storeu_ps(out + 4 * x, sum);
+#else
+            f32 sum[4] = {0};
+            for (u32 t = 0; t < x_taps; ++t) {
+                const f32* texel = row + 4 * hg_clamp_texel(x_first[x] + (i32)t, width);
+                for (u32 c = 0; c < 4; ++c) {
+                    sum[c] += texel[c] * w[t];
+                }
+            }
+            memcpy(out + 4 * x, sum, sizeof(sum));
+#endif
+        }
+    }
+
+    // Columns are filtered a whole row at a time, so reads stay sequential
+    usize row_floats = 4 * (usize)dst_width;
+    for (u32 y = 0; y < dst_height; ++y) {
+        const f32* w = y_weights + (usize)y * y_taps;
+        f32* out = dst + row_floats * y;
+        memset(out, 0, row_floats * sizeof(f32));
+        for (u32 t = 0; t < y_taps; ++t) {
+            const f32* row = scratch + row_floats * hg_clamp_texel(y_first[y] + (i32)t, height);
+            usize i = 0;
+#if defined(__SSE__) || defined(_M_X64)
+            __m128 weight = _mm_set1_ps(w[t]);
+            for (; i + 4 <= row_floats; i += 4) {
+                _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(row + i), weight)));
+            }
+#endif
+            for (; i < row_floats; ++i) {
+                out[i] += row[i] * w[t];
+            }
+        }
+    }
+
+    hg_heap_free(y_weights);
+    hg_heap_free(x_weights);
+    hg_heap_free(y_first);
+    hg_heap_free(x_first);
+}
+
+static void hg_level_normalize(f32* texels, u32 texel_count) {
+    for (u32 i = 0; i < texel_count; ++i) {
+        f32* n = &texels[4 * i];
+        f32 length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length > 0.0f) {
+            n[0] /= length;
+            n[1] /= length;
+            n[2] /= length;
+        }
+    }
+}
+
+void hg_texture_generate_mips(void* chain, u32 width, u32 height, u32 mip_levels, HgFormat format) {
+    HG_ASSERT(chain != NULL);
+    HG_ASSERT(mip_levels <= hg_texture_mip_count(width, height));
+
+    if (mip_levels <= 1)
+        return;
+
+    // Each level filters the float copy of the one before, not its rounded
+    // store, so quantization error doesn't build up down the chain
+    f32* current = hg_heap_alloc(4 * (usize)width * height * sizeof(f32));
+    f32* next = hg_heap_alloc(4 * (usize)(width > 1 ? width / 2 : 1) * (height > 1 ? height / 2 : 1) * sizeof(f32));
+    f32* scratch = hg_heap_alloc(4 * (usize)(width > 1 ? width / 2 : 1) * height * sizeof(f32));
+    hg_level_load(chain, width * height, format, current);
+
+    u8* dst = chain;
+    for (u32 level = 1; level < mip_levels; ++level) {
+        dst += hg_level_size(width, height, format);
+        hg_level_downsample(current, width, height, scratch, next);
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+
+        if (format == HG_FORMAT_R8G8B8A8_SNORM)
+            hg_level_normalize(next, width * height);
+        hg_level_store(next, width * height, format, dst);
+
+        f32* swap = current;
+        current = next;
+        next = swap;
+    }
+
+    hg_heap_free(scratch);
+    hg_heap_free(next);
+    hg_heap_free(current);
+}
+
+// Gathers a 4x4 block as floats in the data's own encoding, clamping at the
+// edges of levels smaller than a block
+static void hg_block_load(const void* level, u32 width, u32 height, u32 bx, u32 by, bool is_signed, f32 block[16][4]) {
+    for (u32 y = 0; y < 4; ++y) {
+        u32 sy = 4 * by + y < height ? 4 * by + y : height - 1;
+        for (u32 x = 0; x < 4; ++x) {
+            u32 sx = 4 * bx + x < width ? 4 * bx + x : width - 1;
+            usize texel = 4 * ((usize)sy * width + sx);
+            for (u32 c = 0; c < 4; ++c) {
+                block[4 * y + x][c] = is_signed ? (f32)((const i8*)level)[texel + c] : (f32)((const u8*)level)[texel + c];
+            }
+        }
+    }
+}
+
+// Endpoints spanning the block's colors along their principal axis, found by
+// power iteration on the covariance. Works better than the bounding box when
+// channels are anti correlated
+static void hg_block_endpoints(f32 block[16][4], u32 channels, f32 e0[4], f32 e1[4]) {
+    f32 mean[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (u32 i = 0; i < 16; ++i) {
+        for (u32 c = 0; c < channels; ++c) {
+            mean[c] += block[i][c] * (1.0f / 16.0f);
+        }
+    }
+
+    f32 covariance[4][4] = {{0.0f}};
+    for (u32 i = 0; i < 16; ++i) {
+        for (u32 r = 0; r < channels; ++r) {
+            for (u32 c = 0; c < channels; ++c) {
+                covariance[r][c] += (block[i][r] - mean[r]) * (block[i][c] - mean[c]);
+            }
+        }
+    }
+
+    f32 axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    for (u32 iteration = 0; iteration < 8; ++iteration) {
+        f32 next[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        f32 length = 0.0f;
+        for (u32 r = 0; r < channels; ++r) {
+            for (u32 c = 0; c < channels; ++c) {
+                next[r] += covariance[r][c] * axis[c];
+            }
+            length = fmaxf(length, fabsf(next[r]));
+        }
+        if (length <= 0.0f)
+            break;
+        for (u32 c = 0; c < channels; ++c) {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    f32 t_min = FLT_MAX;
+    f32 t_max = -FLT_MAX;
+    f32 axis_sq = 0.0f;
+    for (u32 c = 0; c < channels; ++c) {
+        axis_sq += axis[c] * axis[c];
+    }
+    for (u32 i = 0; i < 16; ++i) {
+        f32 t = 0.0f;
+        for (u32 c = 0; c < channels; ++c) {
+            t += (block[i][c] - mean[c]) * axis[c];
+        }
+        t_min = fminf(t_min, t);
+        t_max = fmaxf(t_max, t);
+    }
+    if (axis_sq > 0.0f) {
+        t_min /= axis_sq;
+        t_max /= axis_sq;
+    } else {
+        t_min = 0.0f;
+        t_max = 0.0f;
+    }
+
+    for (u32 c = 0; c < 4; ++c) {
+        e0[c] = c < channels ? mean[c] + axis[c] * t_min : 255.0f;
+        e1[c] = c < channels ? mean[c] + axis[c] * t_max : 255.0f;
+    }
+}
+
+static u16 hg_pack_565(const f32 color[4]) {
+    u32 r = (u32)lrintf(fminf(fmaxf(color[0], 0.0f), 255.0f) * (31.0f / 255.0f));
+    u32 g = (u32)lrintf(fminf(fmaxf(color[1], 0.0f), 255.0f) * (63.0f / 255.0f));
+    u32 b = (u32)lrintf(fminf(fmaxf(color[2], 0.0f), 255.0f) * (31.0f / 255.0f));
+    return (u16)(r << 11 | g << 5 | b);
+}
+
+static void hg_unpack_565(u16 packed, f32 color[3]) {
+    color[0] = (f32)((packed >> 11) & 31) * (255.0f / 31.0f);
+    color[1] = (f32)((packed >> 5) & 63) * (255.0f / 63.0f);
+    color[2] = (f32)(packed & 31) * (255.0f / 31.0f);
+}
+
+static u32 hg_nearest_color(const f32 texel[4], f32 palette[][4], u32 palette_count, u32 channels) {
+    u32 best = 0;
+    f32 best_error = FLT_MAX;
+    for (u32 p = 0; p < palette_count; ++p) {
+        f32 error = 0.0f;
+        for (u32 c = 0; c < channels; ++c) {
+            f32 d = texel[c] - palette[p][c];
+            error += d * d;
+        }
+        if (error < best_error) {
+            best_error = error;
+            best = p;
+        }
+    }
+    return best;
+}
+
+// Two 565 endpoints and 2 bit indices. c0 > c1 selects four colors, and
+// c0 <= c1 three plus transparent black, used when any texel is cut out
+static void hg_encode_bc1(f32 block[16][4], u8 out[8]) {
+    bool transparent = false;
+    for (u32 i = 0; i < 16; ++i) {
+        transparent = transparent || block[i][3] < 128.0f;
+    }
+
+    f32 e0[4];
+    f32 e1[4];
+    hg_block_endpoints(block, 3, e0, e1);
+    u16 c0 = hg_pack_565(e1);
+    u16 c1 = hg_pack_565(e0);
+    if ((c0 < c1) != transparent && c0 != c1) {
+        u16 swap = c0;
+        c0 = c1;
+        c1 = swap;
+    }
+
+    f32 palette[4][4];
+    hg_unpack_565(c0, palette[0]);
+    hg_unpack_565(c1, palette[1]);
+    u32 palette_count;
+    if (c0 > c1) {
+        for (u32 c = 0; c < 3; ++c) {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+        palette_count = 4;
+    } else {
+        for (u32 c = 0; c < 3; ++c) {
+            palette[2][c] = 0.5f * (palette[0][c] + palette[1][c]);
+        }
+        palette_count = 3;
+    }
+
+    u32 indices = 0;
+    for (u32 i = 0; i < 16; ++i) {
+        u32 index = transparent && block[i][3] < 128.0f ? 3 : hg_nearest_color(block[i], palette, palette_count, 3);
+        indices |= index << (2 * i);
+    }
+
+    out[0] = (u8)c0;
+    out[1] = (u8)(c0 >> 8);
+    out[2] = (u8)c1;
+    out[3] = (u8)(c1 >> 8);
+    out[4] = (u8)indices;
+    out[5] = (u8)(indices >> 8);
+    out[6] = (u8)(indices >> 16);
+    out[7] = (u8)(indices >> 24);
+}
+
+// One signed channel: two endpoints with r0 > r1 selecting eight values
+// interpolated between them, and 3 bit indices
+static void hg_encode_bc4_snorm(f32 block[16][4], u32 channel, u8 out[8]) {
+    f32 lo = 127.0f;
+    f32 hi = -127.0f;
+    for (u32 i = 0; i < 16; ++i) {
+        lo = fminf(lo, fmaxf(block[i][channel], -127.0f));
+        hi = fmaxf(hi, fmaxf(block[i][channel], -127.0f));
+    }
+    i8 r0 = (i8)lrintf(hi);
+    i8 r1 = (i8)lrintf(lo);
+
+    u64 indices = 0;
+    if (r0 > r1) {
+        f32 scale = 7.0f / (f32)(r0 - r1);
+        for (u32 i = 0; i < 16; ++i) {
+            // Steps from r1 up to r0, which the index order interleaves
+            u32 step = (u32)lrintf((fmaxf(block[i][channel], -127.0f) - (f32)r1) * scale);
+            u64 index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+            indices |= index << (3 * i);
+        }
+    }
+
+    out[0] = (u8)r0;
+    out[1] = (u8)r1;
+    for (u32 b = 0; b < 6; ++b) {
+        out[2 + b] = (u8)(indices >> (8 * b));
+    }
+}
+
+static void hg_bits_write(u8 out[16], u32* bit, u32 value, u32 count) {
+    for (u32 i = 0; i < count; ++i, ++*bit) {
+        if (value & (1u << i))
+            out[*bit / 8] |= (u8)(1u << (*bit % 8));
+    }
+}
+
+// Mode 6: one subset, RGBA endpoints of 7 bits plus a shared low bit each,
+// and 4 bit indices, 63 bits since the first index's top bit is implied zero.
+// With one line through color space per block, blocks spanning a hard edge
+// between unrelated colors blur toward a blend of them; the partitioned
+// modes would fix that at many times the encode cost
+static void hg_encode_bc7(f32 block[16][4], u8 out[16]) {
+    static const u32 weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    f32 ends[2][4];
+    hg_block_endpoints(block, 4, ends[0], ends[1]);
+
+    u32 endpoints[2][4];
+    u32 endpoint_colors[2][4];
+    u32 p_bits[2];
+    for (u32 e = 0; e < 2; ++e) {
+        f32 best_error = FLT_MAX;
+        for (u32 p = 0; p < 2; ++p) {
+            f32 error = 0.0f;
+            u32 quantized[4];
+            for (u32 c = 0; c < 4; ++c) {
+                f32 value = fminf(fmaxf(ends[e][c], 0.0f), 255.0f);
+                i32 q = (i32)lrintf((value - (f32)p) * 0.5f);
+                quantized[c] = (u32)(q < 0 ? 0 : q > 127 ? 127 : q);
+                f32 d = (f32)(quantized[c] << 1 | p) - value;
+                error += d * d;
+            }
+            if (error < best_error) {
+                best_error = error;
+                p_bits[e] = p;
+                memcpy(endpoints[e], quantized, sizeof(quantized));
+            }
+        }
+        for (u32 c = 0; c < 4; ++c) {
+            endpoint_colors[e][c] = endpoints[e][c] << 1 | p_bits[e];
+        }
+    }
+
+    f32 palette[16][4];
+    for (u32 i = 0; i < 16; ++i) {
+        for (u32 c = 0; c < 4; ++c) {
+            palette[i][c] = (f32)(((64 - weights[i]) * endpoint_colors[0][c] + weights[i] * endpoint_colors[1][c] + 32) >> 6);
+        }
+    }
+    u32 indices[16];
+    for (u32 i = 0; i < 16; ++i) {
+        indices[i] = hg_nearest_color(block[i], palette, 16, 4);
+    }
+
+    // The first texel's index must have its top bit clear, which swapping
+    // the endpoints and mirroring the indices guarantees
+    if (indices[0] >= 8) {
+        for (u32 c = 0; c < 4; ++c) {
+            u32 swap = endpoints[0][c];
+            endpoints[0][c] = endpoints[1][c];
+            endpoints[1][c] = swap;
+        }
+        u32 swap = p_bits[0];
+        p_bits[0] = p_bits[1];
+        p_bits[1] = swap;
+        for (u32 i = 0; i < 16; ++i) {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    memset(out, 0, 16);
+    u32 bit = 0;
+    hg_bits_write(out, &bit, 1u << 6, 7);
+    for (u32 c = 0; c < 4; ++c) {
+        hg_bits_write(out, &bit, endpoints[0][c], 7);
+        hg_bits_write(out, &bit, endpoints[1][c], 7);
+    }
+    hg_bits_write(out, &bit, p_bits[0], 1);
+    hg_bits_write(out, &bit, p_bits[1], 1);
+    hg_bits_write(out, &bit, indices[0], 3);
+    for (u32 i = 1; i < 16; ++i) {
+        hg_bits_write(out, &bit, indices[i], 4);
+    }
+}
+
+void hg_texture_compress(
+    const void* chain, u32 width, u32 height, u32 mip_levels, HgFormat src_format, HgFormat dst_format, void* out
+) {
+    HG_ASSERT(chain != NULL);
+    HG_ASSERT(out != NULL);
+    HG_ASSERT(hg_format_is_block(dst_format));
+    HG_ASSERT(dst_format == HG_FORMAT_BC5_SNORM_BLOCK
+        ? src_format == HG_FORMAT_R8G8B8A8_SNORM
+        : src_format == HG_FORMAT_R8G8B8A8_UNORM || src_format == HG_FORMAT_R8G8B8A8_SRGB);
+
+    const u8* src = chain;
+    u8* dst = out;
+    usize block_size = hg_format_size(dst_format);
+    for (u32 level = 0; level < mip_levels; ++level) {
+        u32 blocks_x = (width + 3) / 4;
+        u32 blocks_y = (height + 3) / 4;
+        for (u32 by = 0; by < blocks_y; ++by) {
+            for (u32 bx = 0; bx < blocks_x; ++bx) {
+                f32 block[16][4];
+                hg_block_load(src, width, height, bx, by, src_format == HG_FORMAT_R8G8B8A8_SNORM, block);
+
+                u8* encoded = dst + ((usize)by * blocks_x + bx) * block_size;
+                switch (dst_format) {
+                    case HG_FORMAT_BC1_RGBA_UNORM_BLOCK:
+                    case HG_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                        hg_encode_bc1(block, encoded);
+                        break;
+                    case HG_FORMAT_BC5_SNORM_BLOCK:
+                        hg_encode_bc4_snorm(block, 0, encoded);
+                        hg_encode_bc4_snorm(block, 1, encoded + 8);
+                        break;
+                    default:
+                        hg_encode_bc7(block, encoded);
+                        break;
+                }
+            }
+        }
+
+        src += hg_level_size(width, height, src_format);
+        dst += hg_level_size(width, height, dst_format);
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+}
+
+void hg_texture_encode(
+    const void* data, u32 width, u32 height, HgFormat format, HgFormat gpu_format, u32 mip_levels, void* dst
+) {
+    if (gpu_format == format) {
+        memcpy(dst, data, hg_texture_mip_chain_size(width, height, 1, format));
+        hg_texture_generate_mips(dst, width, height, mip_levels, format);
+        return;
+    }
+
+    void* chain = hg_heap_alloc(hg_texture_mip_chain_size(width, height, mip_levels, format));
+    memcpy(chain, data, hg_texture_mip_chain_size(width, height, 1, format));
+    hg_texture_generate_mips(chain, width, height, mip_levels, format);
+    hg_texture_compress(chain, width, height, mip_levels, format, gpu_format, dst);
+    hg_heap_free(chain);
+}
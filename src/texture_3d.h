@@ -0,0 +1,34 @@
+#ifndef HG_TEXTURE_3D_H
+#define HG_TEXTURE_3D_H
+
+#include "hg_math.h"
+#include "hg_graphics.h"
+
+// Levels in a full mip chain, down to 1x1
+u32 hg_texture_mip_count(u32 width, u32 height);
+
+// Bytes in a tightly packed chain of mip_levels levels, level 0 first. The
+// format may be uncompressed RGBA or one of the BC formats
+usize hg_texture_mip_chain_size(u32 width, u32 height, u32 mip_levels, HgFormat format);
+
+// Fills levels 1 onward of chain from level 0, already at its start, with a
+// separable Kaiser windowed sinc filter. sRGB data is filtered in linear space; snorm data is
+// treated as normals, and renormalized at every level. Supports RGBA8 unorm,
+// sRGB and snorm, and RGBA32 float
+void hg_texture_generate_mips(void* chain, u32 width, u32 height, u32 mip_levels, HgFormat format);
+
+// Encodes a chain of RGBA8 levels into dst_format: BC1 or BC7 from unorm or
+// sRGB data, BC5 from snorm normals. out needs hg_texture_mip_chain_size bytes
+void hg_texture_compress(
+    const void* chain, u32 width, u32 height, u32 mip_levels, HgFormat src_format, HgFormat dst_format, void* out
+);
+
+// Writes a texture's final contents from its level 0 data to dst: every mip
+// level, packed level 0 first, in gpu_format, which is format or one of the
+// formats hg_texture_compress makes from it. hg_texture_write takes all the
+// levels at once
+void hg_texture_encode(
+    const void* data, u32 width, u32 height, HgFormat format, HgFormat gpu_format, u32 mip_levels, void* dst
+);
+
+#endif // HG_TEXTURE_3D_H
@@ -0,0 +1,314 @@
+#include "upload_queue_3d.h"
+#include "texture_3d.h"
+
+#include <stdint.h>
+#include <string.h>
+
+static void hg_upload_list_push(HgUploadList3D* list, HgUpload3D* upload) {
+    upload->next = NULL;
+    if (list->tail != NULL)
+        list->tail->next = upload;
+    else
+        list->head = upload;
+    list->tail = upload;
+}
+
+static HgUpload3D* hg_upload_list_pop(HgUploadList3D* list) {
+    HgUpload3D* upload = list->head;
+    if (upload != NULL) {
+        list->head = upload->next;
+        if (list->head == NULL)
+            list->tail = NULL;
+    }
+    return upload;
+}
+
+static u32 hg_pending_find(const HgUploadQueue3D* queue, const void* resource) {
+    u32 lo = 0;
+    u32 hi = queue->pending_count;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if ((uintptr_t)queue->pending[mid] < (uintptr_t)resource)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void hg_pending_insert(HgUploadQueue3D* queue, const void* resource) {
+    if (queue->pending_count >= queue->pending_capacity) {
+        queue->pending_capacity *= 2;
+        queue->pending = hg_heap_realloc(queue->pending, queue->pending_capacity * sizeof(const void*));
+    }
+    u32 index = hg_pending_find(queue, resource);
+    memmove(&queue->pending[index + 1], &queue->pending[index],
+        (queue->pending_count - index) * sizeof(const void*));
+    queue->pending[index] = resource;
+    ++queue->pending_count;
+}
+
+static void hg_pending_remove(HgUploadQueue3D* queue, const void* resource) {
+    u32 index = hg_pending_find(queue, resource);
+    HG_ASSERT(index < queue->pending_count && queue->pending[index] == resource);
+    memmove(&queue->pending[index], &queue->pending[index + 1],
+        (queue->pending_count - index - 1) * sizeof(const void*));
+    --queue->pending_count;
+}
+
+// Reserves staging in ring order, waiting for the renderer to free space.
+// Returns false if the queue is shutting down. Called with the mutex held
+static bool hg_staging_reserve(HgUploadQueue3D* queue, HgUpload3D* upload) {
+    usize size = upload->staged_size;
+    if (size > HG_STAGING_RING_SIZE) {
+        upload->staging = hg_heap_alloc(size);
+        upload->ring_reserved = 0;
+        return true;
+    }
+
+    for (;;) {
+        if (queue->quit)
+            return false;
+
+        // An upload never wraps; the end of the ring is skipped instead
+        usize offset = queue->staging_write;
+        usize padding = 0;
+        if (offset + size > HG_STAGING_RING_SIZE) {
+            padding = HG_STAGING_RING_SIZE - offset;
+            offset = 0;
+        }
+        if (queue->staging_used + padding + size <= HG_STAGING_RING_SIZE) {
+            upload->staging = queue->staging_ring + offset;
+            upload->ring_reserved = padding + size;
+            queue->staging_used += padding + size;
+            queue->staging_write = offset + size;
+            return true;
+        }
+        cnd_wait(&queue->space, &queue->mutex);
+    }
+}
+
+static void hg_staging_release(HgUploadQueue3D* queue, HgUpload3D* upload) {
+    if (upload->ring_reserved == 0) {
+        hg_heap_free(upload->staging);
+        return;
+    }
+    mtx_lock(&queue->mutex);
+    queue->staging_used -= upload->ring_reserved;
+    cnd_signal(&queue->space);
+    mtx_unlock(&queue->mutex);
+}
+
+static int hg_upload_worker(void* arg) {
+    HgUploadQueue3D* queue = arg;
+
+    mtx_lock(&queue->mutex);
+    for (;;) {
+        while (queue->requests.head == NULL && !queue->quit) {
+            cnd_wait(&queue->work, &queue->mutex);
+        }
+        if (queue->quit)
+            break;
+
+        HgUpload3D* upload = hg_upload_list_pop(&queue->requests);
+        queue->encoding = upload;
+        // Waits for the renderer to drain staged uploads while the ring is
+        // full, only failing on shutdown
+        if (!hg_staging_reserve(queue, upload)) {
+            queue->encoding = NULL;
+            hg_upload_list_push(&queue->requests, upload);
+            break;
+        }
+        bool cancelled = upload->cancelled;
+        mtx_unlock(&queue->mutex);
+
+        // A cancelled upload's data may be gone with its object
+        if (!cancelled && upload->kind == HG_UPLOAD_KIND_3D_TEXTURE) {
+            hg_texture_encode(
+                upload->data,
+                upload->width,
+                upload->height,
+                upload->format,
+                upload->gpu_format,
+                upload->mip_levels,
+                upload->staging
+            );
+        } else if (!cancelled) {
+            memcpy(upload->staging, upload->data, upload->data_size);
+        }
+
+        mtx_lock(&queue->mutex);
+        queue->encoding = NULL;
+        hg_upload_list_push(&queue->staged, upload);
+        cnd_broadcast(&queue->done);
+    }
+    mtx_unlock(&queue->mutex);
+
+    return 0;
+}
+
+void hg_upload_queue_init(HgUploadQueue3D* queue) {
+    HG_ASSERT(queue != NULL);
+
+    *queue = (HgUploadQueue3D){
+        .pending_capacity = 64,
+    };
+    queue->staging_ring = hg_heap_alloc(HG_STAGING_RING_SIZE);
+    queue->pending = hg_heap_alloc(queue->pending_capacity * sizeof(const void*));
+
+    mtx_init(&queue->mutex, mtx_plain);
+    cnd_init(&queue->work);
+    cnd_init(&queue->space);
+    cnd_init(&queue->done);
+    thrd_create(&queue->thread, hg_upload_worker, queue);
+}
+
+void hg_upload_queue_destroy(HgUploadQueue3D* queue) {
+    HG_ASSERT(queue != NULL);
+
+    mtx_lock(&queue->mutex);
+    queue->quit = true;
+    cnd_broadcast(&queue->work);
+    cnd_broadcast(&queue->space);
+    mtx_unlock(&queue->mutex);
+    thrd_join(queue->thread, NULL);
+
+    HgUploadList3D* lists[] = {&queue->requests, &queue->staged};
+    for (u32 i = 0; i < HG_ARRAY_SIZE(lists); ++i) {
+        HgUpload3D* upload;
+        while ((upload = hg_upload_list_pop(lists[i])) != NULL) {
+            if (upload->staging != NULL && upload->ring_reserved == 0)
+                hg_heap_free(upload->staging);
+            hg_heap_free(upload);
+        }
+    }
+
+    cnd_destroy(&queue->done);
+    cnd_destroy(&queue->space);
+    cnd_destroy(&queue->work);
+    mtx_destroy(&queue->mutex);
+
+    hg_heap_free(queue->pending);
+    hg_heap_free(queue->staging_ring);
+    *queue = (HgUploadQueue3D){0};
+}
+
+void hg_upload_queue_submit(HgUploadQueue3D* queue, HgUpload3D* upload) {
+    HG_ASSERT(queue != NULL);
+    HG_ASSERT(upload != NULL);
+
+    hg_pending_insert(queue,
+        upload->kind == HG_UPLOAD_KIND_3D_TEXTURE ? (const void*)upload->texture : (const void*)upload->buffer);
+
+    mtx_lock(&queue->mutex);
+    hg_upload_list_push(&queue->requests, upload);
+    ++queue->in_flight;
+    cnd_signal(&queue->work);
+    mtx_unlock(&queue->mutex);
+}
+
+u32 hg_upload_queue_drain(HgUploadQueue3D* queue, usize budget, usize* bytes) {
+    HG_ASSERT(queue != NULL);
+    HG_ASSERT(bytes != NULL);
+
+    usize uploaded = 0;
+    u32 count = 0;
+    for (;;) {
+        mtx_lock(&queue->mutex);
+        HgUpload3D* upload = queue->staged.head;
+        if (upload == NULL || (uploaded > 0 && uploaded + upload->staged_size > budget)) {
+            mtx_unlock(&queue->mutex);
+            break;
+        }
+        hg_upload_list_pop(&queue->staged);
+        mtx_unlock(&queue->mutex);
+
+        if (!upload->cancelled) {
+            if (upload->kind == HG_UPLOAD_KIND_3D_TEXTURE) {
+                hg_texture_write(upload->texture, upload->staging, HG_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+                hg_pending_remove(queue, upload->texture);
+            } else {
+                hg_buffer_write(upload->buffer, 0, upload->staging, upload->staged_size);
+                hg_pending_remove(queue, upload->buffer);
+            }
+            uploaded += upload->staged_size;
+            ++count;
+        }
+
+        hg_staging_release(queue, upload);
+        mtx_lock(&queue->mutex);
+        --queue->in_flight;
+        mtx_unlock(&queue->mutex);
+        hg_heap_free(upload);
+    }
+    *bytes = uploaded;
+    return count;
+}
+
+bool hg_upload_queue_wait(HgUploadQueue3D* queue) {
+    HG_ASSERT(queue != NULL);
+
+    mtx_lock(&queue->mutex);
+    bool in_flight = queue->in_flight > 0;
+    if (in_flight && queue->staged.head == NULL)
+        cnd_wait(&queue->done, &queue->mutex);
+    mtx_unlock(&queue->mutex);
+    return in_flight;
+}
+
+static bool hg_upload_targets(const HgUpload3D* upload, const void* resource) {
+    return (upload->kind == HG_UPLOAD_KIND_3D_TEXTURE ? (const void*)upload->texture : (const void*)upload->buffer)
+        == resource;
+}
+
+void hg_upload_queue_cancel(HgUploadQueue3D* queue, const void* resource) {
+    HG_ASSERT(queue != NULL);
+
+    if (!hg_upload_queue_pending(queue, resource))
+        return;
+    hg_pending_remove(queue, resource);
+
+    mtx_lock(&queue->mutex);
+    // Not yet picked up by the worker, so nothing is staged
+    HgUpload3D* prev = NULL;
+    for (HgUpload3D* upload = queue->requests.head; upload != NULL; prev = upload, upload = upload->next) {
+        if (!hg_upload_targets(upload, resource))
+            continue;
+        if (prev != NULL)
+            prev->next = upload->next;
+        else
+            queue->requests.head = upload->next;
+        if (queue->requests.tail == upload)
+            queue->requests.tail = prev;
+        --queue->in_flight;
+        mtx_unlock(&queue->mutex);
+        hg_heap_free(upload);
+        return;
+    }
+
+    // Staged or being staged, so it holds ring space that has to be released
+    // in order. Draining drops it instead of writing it. Once its staging is
+    // reserved the worker reads the caller's data, which may go with the
+    // object, so that is waited out
+    HgUpload3D* encoding = queue->encoding;
+    if (encoding != NULL && hg_upload_targets(encoding, resource)) {
+        encoding->cancelled = true;
+        while (encoding->staging != NULL && queue->encoding == encoding) {
+            cnd_wait(&queue->done, &queue->mutex);
+        }
+    }
+    for (HgUpload3D* upload = queue->staged.head; upload != NULL; upload = upload->next) {
+        if (hg_upload_targets(upload, resource))
+            upload->cancelled = true;
+    }
+    mtx_unlock(&queue->mutex);
+}
+
+bool hg_upload_queue_pending(const HgUploadQueue3D* queue, const void* resource) {
+    HG_ASSERT(queue != NULL);
+
+    if (queue->pending_count == 0 || resource == NULL)
+        return false;
+    u32 index = hg_pending_find(queue, resource);
+    return index < queue->pending_count && queue->pending[index] == resource;
+}
@@ -0,0 +1,94 @@
+#ifndef HG_UPLOAD_QUEUE_3D_H
+#define HG_UPLOAD_QUEUE_3D_H
+
+#include "hg_math.h"
+#include "hg_graphics.h"
+
+#include <threads.h>
+
+// Uploads to GPU objects the caller has already created. A worker thread
+// encodes and copies each upload's data into a staging ring, and the
+// renderer's thread drains finished ones to the GPU, within a budget per
+// frame. Until then the object is pending, and the renderer draws models
+// using it with a placeholder
+#define HG_STAGING_RING_SIZE (64u << 20)
+
+typedef enum HgUploadKind3D {
+    HG_UPLOAD_KIND_3D_BUFFER,
+    HG_UPLOAD_KIND_3D_TEXTURE,
+} HgUploadKind3D;
+
+// Allocated with hg_heap_alloc, and freed by the queue once written
+typedef struct HgUpload3D {
+    struct HgUpload3D* next;
+    HgUploadKind3D kind;
+    HgBuffer* buffer;
+    HgTexture* texture;
+    // Owned by the caller until the upload completes
+    const void* data;
+    usize data_size;
+    u32 width;
+    u32 height;
+    u32 mip_levels;
+    HgFormat format;
+    HgFormat gpu_format;
+    // Where the encoded data was staged. Uploads too big for the ring get
+    // their own allocation instead
+    u8* staging;
+    usize staged_size;
+    usize ring_reserved;
+    // Set when its object was destroyed first. It is dropped without being
+    // written, once its staging can be released in ring order
+    bool cancelled;
+} HgUpload3D;
+
+typedef struct HgUploadList3D {
+    HgUpload3D* head;
+    HgUpload3D* tail;
+} HgUploadList3D;
+
+typedef struct HgUploadQueue3D {
+    thrd_t thread;
+    mtx_t mutex;
+    cnd_t work;
+    cnd_t space;
+    cnd_t done;
+    bool quit;
+    HgUploadList3D requests;
+    HgUploadList3D staged;
+    // The upload the worker is encoding, outside both lists
+    HgUpload3D* encoding;
+    u32 in_flight;
+
+    u8* staging_ring;
+    usize staging_write;
+    usize staging_used;
+
+    // Sorted, and only touched by the renderer's thread
+    const void** pending;
+    u32 pending_count;
+    u32 pending_capacity;
+} HgUploadQueue3D;
+
+// Starts the worker thread
+void hg_upload_queue_init(HgUploadQueue3D* queue);
+// Uploads still queued are dropped; their GPU objects belong to the caller
+void hg_upload_queue_destroy(HgUploadQueue3D* queue);
+
+// Marks the upload's object pending and hands the upload to the worker
+void hg_upload_queue_submit(HgUploadQueue3D* queue, HgUpload3D* upload);
+// Writes staged uploads to the GPU until budget bytes have gone, though
+// always at least one, so an upload bigger than the budget still lands.
+// Returns how many were written, and their bytes in bytes
+u32 hg_upload_queue_drain(HgUploadQueue3D* queue, usize budget, usize* bytes);
+// Blocks until an upload is staged or none are left in flight, returning
+// false once none are
+bool hg_upload_queue_wait(HgUploadQueue3D* queue);
+
+// Drops the upload to resource, if any, so a destroyed object is never
+// written. Call before destroying an object that may still be pending
+void hg_upload_queue_cancel(HgUploadQueue3D* queue, const void* resource);
+
+bool hg_upload_queue_pending(const HgUploadQueue3D* queue, const void* resource);
+
+#endif // HG_UPLOAD_QUEUE_3D_H
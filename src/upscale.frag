@@ -0,0 +1,19 @@
+#version 460
+
+layout(location = 0) in vec2 v_uv;
+
+layout(location = 0) out vec4 out_color;
+
+layout(set = 0, binding = 0) uniform sampler2D u_target;
+
+// The fraction of the target's width and height the frame drew to
+layout(push_constant) uniform UpscalePush {
+    float p_scale;
+};
+
+void main() {
+    // Half a texel inside the drawn part, so filtering never blends in
+    // what lies outside it
+    vec2 drawn_max = vec2(p_scale) - 0.5 / vec2(textureSize(u_target, 0));
+    out_color = texture(u_target, min(v_uv * p_scale, drawn_max));
+}
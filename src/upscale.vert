@@ -0,0 +1,11 @@
+#version 460
+
+layout(location = 0) in vec3 in_pos;
+layout(location = 3) in vec2 in_uv;
+
+layout(location = 0) out vec2 f_uv;
+
+void main() {
+    f_uv = in_uv;
+    gl_Position = vec4(in_pos, 1.0);
+}